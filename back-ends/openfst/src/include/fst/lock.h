@@ -20,6 +20,7 @@
 #ifndef FST_LIB_LOCK_H__
 #define FST_LIB_LOCK_H__
 
+#include <atomic>
 #include <fst/compat.h>  // for DISALLOW_COPY_AND_ASSIGN
 
 namespace fst {
@@ -62,16 +63,18 @@ class MutexLock {
 };
 
 // Reference counting - single-thread implementation
+// HFST: the count is atomic so that copies sharing an implementation can
+// be changed or deleted in different threads.
 class RefCounter {
  public:
   RefCounter() : count_(1) {}
 
-  int count() const { return count_; }
+  int count() const { return count_.load(); }
   int Incr() const { return ++count_; }
   int Decr() const {  return --count_; }
 
  private:
-  mutable int count_;
+  mutable std::atomic<int> count_;
 
   DISALLOW_COPY_AND_ASSIGN(RefCounter);
 };
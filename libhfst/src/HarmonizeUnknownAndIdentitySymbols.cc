@@ -38,7 +38,7 @@ static StringSet remove_flags(const StringSet & alpha)
   for (StringSet::const_iterator it = alpha.begin();
       it != alpha.end(); it++)
     {
-        if (!FdOperation::is_diacritic(*it) && !hfst_ol::PmatchAlphabet::is_special(*it))
+        if (HarmonizeUnknownAndIdentitySymbols::is_expanded_to(*it))
         {
           retval.insert(*it);
         }
@@ -46,6 +46,13 @@ static StringSet remove_flags(const StringSet & alpha)
   return retval;
 }
 
+bool HarmonizeUnknownAndIdentitySymbols::is_expanded_to
+(const std::string &symbol)
+{
+  return !FdOperation::is_diacritic(symbol) &&
+    !hfst_ol::PmatchAlphabet::is_special(symbol);
+}
+
 HarmonizeUnknownAndIdentitySymbols::HarmonizeUnknownAndIdentitySymbols
 (HfstBasicTransducer &t1,HfstBasicTransducer &t2) :
   t1(t1),
@@ -46,6 +46,10 @@ class HarmonizeUnknownAndIdentitySymbols
   // symbols of its arguments.
   HFSTDLL HarmonizeUnknownAndIdentitySymbols
     (HfstBasicTransducer &,HfstBasicTransducer &);  
+
+  // Whether unknown and identity symbols are expanded to the symbol when
+  // harmonizing. Flag diacritics and special symbols of pmatch are not.
+  HFSTDLL static bool is_expanded_to(const std::string &symbol);
  protected:
 
   HfstBasicTransducer &t1;
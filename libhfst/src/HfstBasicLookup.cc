@@ -0,0 +1,261 @@
+//       This program is free software: you can redistribute it and/or modify
+//       it under the terms of the GNU General Public License as published by
+//       the Free Software Foundation, version 3 of the License.
+//
+//       This program is distributed in the hope that it will be useful,
+//       but WITHOUT ANY WARRANTY; without even the implied warranty of
+//       MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//       GNU General Public License for more details.
+//
+//       You should have received a copy of the GNU General Public License
+//       along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+#include "HfstBasicLookup.h"
+#include "HfstFlagDiacritics.h"
+
+#include <algorithm>
+
+namespace hfst {
+
+  /* The state of one lookup. */
+  struct HfstBasicLookup::Search
+  {
+    // the input as symbol numbers; a symbol that the transducer does not
+    // know is numbered past the symbols of the transducer by its position
+    std::vector<unsigned int> input;
+    // whether each input symbol is in the alphabet
+    std::vector<bool> known;
+    // the states passed by the current run of input epsilons, of which
+    // each search only uses a prefix, as HfstEpsilonHandler does
+    std::vector<unsigned int> epsilon_path;
+    // the symbol pairs of the current path
+    std::vector<std::pair<unsigned int, unsigned int> > path;
+    size_t max_cycles;
+    float * max_weight;
+    const StringVector * input_strings;
+    HfstTwoLevelPaths * results;
+  };
+
+  HfstBasicLookup::HfstBasicLookup(const HfstBasicTransducer & t)
+  {
+    get_number(internal_epsilon);
+    unknown = get_number(internal_unknown);
+    identity = get_number(internal_identity);
+
+    unsigned int state = 0;
+    for (HfstBasicTransducer::const_iterator it = t.begin();
+         it != t.end(); it++, state++)
+      {
+        states.push_back(State());
+        State & s = states.back();
+        s.final = t.is_final_state(state);
+        s.final_weight = s.final ? t.get_final_weight(state) : 0;
+        for (HfstBasicTransducer::HfstTransitions::const_iterator tr_it
+               = it->begin(); tr_it != it->end(); tr_it++)
+          {
+            const std::string & input = tr_it->get_input_symbol();
+            Arc arc;
+            arc.input = get_number(input);
+            arc.output = get_number(tr_it->get_output_symbol());
+            arc.target = tr_it->get_target_state();
+            arc.weight = tr_it->get_weight();
+            s.arcs.push_back(arc);
+            if (is_epsilon(input) || FdOperation::is_diacritic(input))
+              {
+                s.epsilon_arcs.push_back(arc);
+              }
+            else if (arc.input == unknown || arc.input == identity)
+              {
+                s.default_arcs.push_back(arc);
+              }
+          }
+        std::stable_sort(s.arcs.begin(), s.arcs.end());
+      }
+
+    const HfstBasicTransducer::HfstTransitionGraphAlphabet & a
+      = t.get_alphabet();
+    for (HfstBasicTransducer::HfstTransitionGraphAlphabet::const_iterator it
+           = a.begin(); it != a.end(); it++)
+      {
+        alphabet[get_number(*it)] = true;
+      }
+  }
+
+  unsigned int HfstBasicLookup::get_number(const std::string & symbol)
+  {
+    std::unordered_map<std::string, unsigned int>::const_iterator it
+      = symbol_numbers.find(symbol);
+    if (it != symbol_numbers.end())
+      {
+        return it->second;
+      }
+    unsigned int number = symbols.size();
+    symbols.push_back(symbol);
+    symbol_numbers[symbol] = number;
+    alphabet.push_back(false);
+    return number;
+  }
+
+  void HfstBasicLookup::lookup_fd
+  (const StringVector & lookup_path, HfstTwoLevelPaths & results,
+   size_t * infinite_cutoff, float * max_weight) const
+  {
+    Search search;
+    for (size_t i = 0; i < lookup_path.size(); i++)
+      {
+        std::unordered_map<std::string, unsigned int>::const_iterator it
+          = symbol_numbers.find(lookup_path[i]);
+        if (it != symbol_numbers.end())
+          {
+            search.input.push_back(it->second);
+            search.known.push_back(alphabet[it->second]);
+          }
+        else
+          {
+            search.input.push_back(symbols.size() + i);
+            search.known.push_back(false);
+          }
+      }
+    search.max_cycles = (infinite_cutoff != NULL) ? *infinite_cutoff : 100000;
+    search.max_weight = max_weight;
+    search.input_strings = &lookup_path;
+    search.results = &results;
+
+    if (!states.empty())
+      {
+        this->search(search, 0, 0, 0, 0, 0);
+      }
+  }
+
+  /* Search the paths from \a state on, \a index symbols of the input
+     having been consumed. The last \a epsilon_length states of the epsilon
+     path were passed by input epsilons, and \a cycles of them have been
+     cut off so far. */
+  void HfstBasicLookup::search
+  (Search & s, unsigned int state, size_t index, size_t epsilon_length,
+   size_t cycles, float weight) const
+  {
+    for (size_t i = 0; i < epsilon_length; i++)
+      {
+        if (s.epsilon_path[i] == state)
+          {
+            epsilon_length = i + 1;
+            if (++cycles > s.max_cycles)
+              {
+                return;
+              }
+            break;
+          }
+      }
+    if (s.max_weight != NULL && weight > *s.max_weight)
+      {
+        return;
+      }
+
+    const State & st = states[state];
+    if (index == s.input.size())
+      {
+        float final_weight = weight + st.final_weight;
+        if (st.final &&
+            (s.max_weight == NULL || !(final_weight > *s.max_weight)))
+          {
+            StringPairVector path;
+            for (std::vector<std::pair<unsigned int, unsigned int> >
+                   ::const_iterator it = s.path.begin();
+                 it != s.path.end(); it++)
+              {
+                path.push_back
+                  (StringPair(it->first < symbols.size() ?
+                              symbols[it->first] :
+                              s.input_strings->at(it->first - symbols.size()),
+                              it->second < symbols.size() ?
+                              symbols[it->second] :
+                              s.input_strings->at(it->second - symbols.size())));
+              }
+            s.results->insert(HfstTwoLevelPath(final_weight, path));
+          }
+      }
+    else
+      {
+        Arc key;
+        key.input = s.input[index];
+        for (std::vector<Arc>::const_iterator it
+               = std::lower_bound(st.arcs.begin(), st.arcs.end(), key);
+             it != st.arcs.end() && it->input == key.input; it++)
+          {
+            consume(s, *it, index, weight);
+          }
+        if (!s.known[index])
+          {
+            for (std::vector<Arc>::const_iterator it = st.default_arcs.begin();
+                 it != st.default_arcs.end(); it++)
+              {
+                consume(s, *it, index, weight);
+              }
+          }
+      }
+
+    if (st.epsilon_arcs.empty())
+      {
+        return;
+      }
+    // The searches below share the prefix of the epsilon path, so the
+    // slot after it is given back as it was
+    bool overwritten = false;
+    unsigned int overwritten_state = 0;
+    if (epsilon_length == 0 || s.epsilon_path[epsilon_length - 1] != state)
+      {
+        if (epsilon_length < s.epsilon_path.size())
+          {
+            overwritten = true;
+            overwritten_state = s.epsilon_path[epsilon_length];
+            s.epsilon_path[epsilon_length] = state;
+          }
+        else
+          {
+            s.epsilon_path.push_back(state);
+          }
+        epsilon_length++;
+      }
+    for (std::vector<Arc>::const_iterator it = st.epsilon_arcs.begin();
+         it != st.epsilon_arcs.end(); it++)
+      {
+        // an arc whose input is the next input symbol consumes it
+        if (index < s.input.size() && it->input == s.input[index])
+          {
+            continue;
+          }
+        s.path.push_back(std::make_pair(it->input, it->output));
+        search(s, it->target, index, epsilon_length, cycles,
+               weight + it->weight);
+        s.path.pop_back();
+      }
+    if (overwritten)
+      {
+        s.epsilon_path[epsilon_length - 1] = overwritten_state;
+      }
+  }
+
+  /* Follow \a arc, which consumes input symbol number \a index. An
+     identity symbol copies the input symbol to the output and an unknown
+     symbol is replaced with it on the input side. */
+  void HfstBasicLookup::consume
+  (Search & s, const Arc & arc, size_t index, float weight) const
+  {
+    unsigned int input = arc.input;
+    unsigned int output = arc.output;
+    if (input == identity)
+      {
+        input = symbols.size() + index;
+        output = input;
+      }
+    else if (input == unknown)
+      {
+        input = symbols.size() + index;
+      }
+    s.path.push_back(std::make_pair(input, output));
+    search(s, arc.target, index + 1, 0, 0, weight + arc.weight);
+    s.path.pop_back();
+  }
+
+}
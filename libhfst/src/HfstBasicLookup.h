@@ -0,0 +1,113 @@
+//       This program is free software: you can redistribute it and/or modify
+//       it under the terms of the GNU General Public License as published by
+//       the Free Software Foundation, version 3 of the License.
+//
+//       This program is distributed in the hope that it will be useful,
+//       but WITHOUT ANY WARRANTY; without even the implied warranty of
+//       MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//       GNU General Public License for more details.
+//
+//       You should have received a copy of the GNU General Public License
+//       along with this program.  If not, see <http://www.gnu.org/licenses/>.
+#ifndef _HFST_BASIC_LOOKUP_H_
+#define _HFST_BASIC_LOOKUP_H_
+
+#include <unordered_map>
+#include "HfstTransducer.h"
+#include "hfstdll.h"
+
+/** @file HfstBasicLookup.h
+    \brief Declaration of class HfstBasicLookup. */
+
+namespace hfst {
+
+  /** \brief Lookup in an HfstBasicTransducer that has been indexed for it.
+
+      HfstBasicTransducer::lookup_fd follows the transitions of the
+      transducer as they are, comparing the strings of their symbols.
+      HfstBasicLookup numbers the symbols of the transducer once and
+      sorts the transitions of each state by input symbol, so each step
+      of a lookup is a binary search over numbers. The strings of a path
+      are put together only when it is a result.
+
+      The results are the same as those of HfstBasicTransducer::lookup_fd:
+      flag diacritics are treated as epsilons and kept in the results,
+      unknown and identity symbols match the input symbols that are not in
+      the alphabet of the transducer, and at most \a infinite_cutoff cycles
+      of input epsilons are followed between two input symbols.
+
+      The transducer is copied, so it can change or go away afterwards.
+      lookup_fd does not change the object, so several threads can look up
+      strings at the same time.
+
+      An example:
+\verbatim
+      HfstBasicTransducer fsm(transducer);
+      HfstBasicLookup lookup(fsm);
+      HfstTwoLevelPaths results;
+      lookup.lookup_fd(TOK.tokenize_one_level("cats"), results);
+\endverbatim
+  */
+  class HfstBasicLookup
+  {
+  protected:
+    struct Arc
+    {
+      unsigned int input;
+      unsigned int output;
+      unsigned int target;
+      float weight;
+      bool operator<(const Arc & another) const
+      { return input < another.input; }
+    };
+
+    struct State
+    {
+      // all arcs sorted by input
+      std::vector<Arc> arcs;
+      // arcs whose input is an epsilon or a flag diacritic
+      std::vector<Arc> epsilon_arcs;
+      // arcs whose input is the unknown or the identity symbol
+      std::vector<Arc> default_arcs;
+      bool final;
+      float final_weight;
+    };
+
+    struct Search;
+
+    std::vector<State> states;
+    // the symbols of the transducer, numbered from zero
+    std::vector<std::string> symbols;
+    std::unordered_map<std::string, unsigned int> symbol_numbers;
+    // whether a symbol number is in the alphabet of the transducer
+    std::vector<bool> alphabet;
+    unsigned int identity;
+    unsigned int unknown;
+
+    unsigned int get_number(const std::string & symbol);
+
+    void search(Search & s, unsigned int state, size_t index,
+                size_t epsilon_length, size_t cycles, float weight) const;
+    void consume(Search & s, const Arc & arc, size_t index,
+                 float weight) const;
+
+  public:
+    /** \brief Index \a transducer for lookup. */
+    HFSTDLL HfstBasicLookup(const HfstBasicTransducer & transducer);
+
+    /** \brief Look up \a lookup_path like
+        HfstBasicTransducer::lookup_fd and add the paths found to
+        \a results.
+
+        At most \a infinite_cutoff input epsilon cycles are followed, or
+        100000 if it is not given. If \a max_weight is given, paths
+        heavier than it are not followed. */
+    HFSTDLL void lookup_fd(const StringVector & lookup_path,
+                           HfstTwoLevelPaths & results,
+                           size_t * infinite_cutoff = NULL,
+                           float * max_weight = NULL) const;
+  };
+
+}
+
+#endif // _HFST_BASIC_LOOKUP_H_
@@ -0,0 +1,126 @@
+//       This program is free software: you can redistribute it and/or modify
+//       it under the terms of the GNU General Public License as published by
+//       the Free Software Foundation, version 3 of the License.
+//
+//       This program is distributed in the hope that it will be useful,
+//       but WITHOUT ANY WARRANTY; without even the implied warranty of
+//       MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//       GNU General Public License for more details.
+//
+//       You should have received a copy of the GNU General Public License
+//       along with this program.  If not, see <http://www.gnu.org/licenses/>.
+#ifndef _HFST_CLOCK_CACHE_H_
+#define _HFST_CLOCK_CACHE_H_
+
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+/** @file HfstClockCache.h
+    \brief Declaration of class template HfstClockCache. */
+
+namespace hfst {
+
+/** @brief A map from strings to values of at most a fixed number of
+ * entries, which forgets entries with the CLOCK algorithm.
+ *
+ * CLOCK approximates least recently used but does not have to reorder
+ * anything on a hit: find() only sets the reference bit of the entry.
+ * When the cache is full, insert() replaces the first entry after the
+ * clock hand whose bit is not set, clearing the bits it passes. A new
+ * entry gets no reference bit, so entries found only once are the first
+ * to go.
+ *
+ * The lookup caches of the tools and of HfstLookupCache use it. It is
+ * not thread-safe.
+ */
+template <class Value>
+class HfstClockCache
+{
+ public:
+  //! @brief Create a cache of at most @a capacity entries. Nothing can be
+  //! inserted if @a capacity is zero.
+  explicit HfstClockCache(size_t capacity):
+    capacity(capacity), hand(0)
+  {
+    entries.reserve(capacity);
+  }
+
+  //! @brief The value of @a key, or NULL if it is not cached.
+  //!
+  //! The pointer is valid until the next insert() or clear().
+  Value * find(const std::string & key)
+  {
+    typename std::unordered_map<std::string, size_t>::iterator it
+      = index.find(key);
+    if (it == index.end())
+      {
+        return NULL;
+      }
+    entries[it->second].referenced = true;
+    return &entries[it->second].value;
+  }
+
+  //! @brief Add @a key, which must not be cached yet, with @a value,
+  //! forgetting another entry if the cache is full.
+  //!
+  //! The reference is valid until the next insert() or clear().
+  Value & insert(const std::string & key, const Value & value = Value())
+  {
+    size_t slot;
+    if (entries.size() < capacity)
+      {
+        slot = entries.size();
+        entries.push_back(Entry());
+      }
+    else
+      {
+        while (entries[hand].referenced)
+          {
+            entries[hand].referenced = false;
+            hand = (hand + 1) % capacity;
+          }
+        slot = hand;
+        hand = (hand + 1) % capacity;
+        index.erase(entries[slot].key);
+      }
+    Entry & entry = entries[slot];
+    entry.key = key;
+    entry.value = value;
+    entry.referenced = false;
+    index[key] = slot;
+    return entry.value;
+  }
+
+  //! @brief The number of cached entries.
+  size_t size() const
+  {
+    return index.size();
+  }
+
+  //! @brief Forget all entries.
+  void clear()
+  {
+    entries.clear();
+    index.clear();
+    hand = 0;
+  }
+
+ private:
+  struct Entry
+  {
+    std::string key;
+    Value value;
+    // the CLOCK reference bit
+    bool referenced;
+  };
+
+  size_t capacity;
+  std::vector<Entry> entries;
+  std::unordered_map<std::string, size_t> index;
+  size_t hand;
+};
+
+}
+
+#endif // _HFST_CLOCK_CACHE_H_
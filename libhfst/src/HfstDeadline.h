@@ -0,0 +1,108 @@
+//       This program is free software: you can redistribute it and/or modify
+//       it under the terms of the GNU General Public License as published by
+//       the Free Software Foundation, version 3 of the License.
+//
+//       This program is distributed in the hope that it will be useful,
+//       but WITHOUT ANY WARRANTY; without even the implied warranty of
+//       MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//       GNU General Public License for more details.
+//
+//       You should have received a copy of the GNU General Public License
+//       along with this program.  If not, see <http://www.gnu.org/licenses/>.
+#ifndef _HFST_DEADLINE_H_
+#define _HFST_DEADLINE_H_
+
+#include <atomic>
+#include <chrono>
+
+/** @file HfstDeadline.h
+    \brief Declaration of class HfstDeadline. */
+
+namespace hfst {
+
+/** @brief The time limit and cancellation of one search.
+ *
+ * A search calls expired() at each of its steps. That only counts the
+ * step; the clock is read, and the cancellation flag looked at, once
+ * every CHECK_INTERVAL steps, so a time limit costs next to nothing even
+ * when the steps are short. The clock is a monotonic wall clock, so a
+ * limit means the same whatever the other threads of the process do.
+ *
+ * cancel() may be called from any thread while the search runs. The
+ * search then stops within CHECK_INTERVAL steps, as if its time had run
+ * out.
+ */
+class HfstDeadline
+{
+ public:
+  typedef std::chrono::steady_clock Clock;
+
+  //! @brief How many steps are taken between looks at the clock.
+  static const unsigned int CHECK_INTERVAL = 256;
+
+  HfstDeadline():
+    steps(0), limited(false), stopped(false), cancel_requested(false) {}
+
+  //! @brief Start a search that may run for @a seconds, or without a time
+  //! limit if @a seconds is not positive.
+  //!
+  //! A cancellation of the previous search is forgotten.
+  void start(double seconds)
+  {
+    steps = 0;
+    stopped = false;
+    cancel_requested.store(false, std::memory_order_relaxed);
+    limited = seconds > 0.0;
+    if (limited)
+      {
+        end = Clock::now() + std::chrono::duration_cast<Clock::duration>
+          (std::chrono::duration<double>(seconds));
+      }
+  }
+
+  //! @brief Count a step and tell whether the search should stop.
+  //!
+  //! Once this has returned true, it returns true until the next start().
+  bool expired()
+  {
+    if (stopped)
+      {
+        return true;
+      }
+    if (++steps < CHECK_INTERVAL)
+      {
+        return false;
+      }
+    steps = 0;
+    stopped = cancel_requested.load(std::memory_order_relaxed)
+      || (limited && Clock::now() >= end);
+    return stopped;
+  }
+
+  //! @brief Ask the running search to stop. Safe to call from another
+  //! thread.
+  void cancel()
+  {
+    cancel_requested.store(true, std::memory_order_relaxed);
+  }
+
+  //! @brief Whether cancel() has been called since the search started.
+  bool cancelled() const
+  {
+    return cancel_requested.load(std::memory_order_relaxed);
+  }
+
+ private:
+  HfstDeadline(const HfstDeadline &);
+  HfstDeadline & operator=(const HfstDeadline &);
+
+  unsigned int steps;
+  bool limited;
+  bool stopped;
+  Clock::time_point end;
+  std::atomic<bool> cancel_requested;
+};
+
+}
+
+#endif // _HFST_DEADLINE_H_
@@ -0,0 +1,361 @@
+//       This program is free software: you can redistribute it and/or modify
+//       it under the terms of the GNU General Public License as published by
+//       the Free Software Foundation, version 3 of the License.
+//
+//       This program is distributed in the hope that it will be useful,
+//       but WITHOUT ANY WARRANTY; without even the implied warranty of
+//       MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//       GNU General Public License for more details.
+//
+//       You should have received a copy of the GNU General Public License
+//       along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+#include "HfstDelayedComposition.h"
+
+#include <algorithm>
+
+namespace hfst {
+
+  /* The state of one lookup. The configuration is changed in place while
+     searching and changed back when a move has been searched. */
+  struct HfstDelayedComposition::Search
+  {
+    std::vector<unsigned int> input;
+    size_t index;
+    std::vector<unsigned int> states;
+    std::vector<FdState<unsigned int> > flag_states;
+    std::vector<unsigned int> output;
+    // the weight of the path in each transducer, so that the same path
+    // gets the same weight whatever order its moves were made in
+    std::vector<float> weights;
+    // the state tuples after the last input symbol, for finding cycles
+    std::vector<std::vector<unsigned int> > epsilon_path;
+    size_t infinite_cutoff;
+    // whether a path was cut at infinite_cutoff cycles
+    bool cycles_cut;
+    float * max_weight;
+    const StringVector * input_strings;
+    HfstOneLevelPaths * results;
+  };
+
+  HfstDelayedComposition::HfstDelayedComposition
+  (const std::vector<HfstTransducer> & cascade)
+  {
+    if (cascade.empty())
+      {
+        HFST_THROW_MESSAGE(HfstFatalException,
+                           "delayed composition of an empty cascade");
+      }
+    get_number(internal_epsilon);
+    get_number(internal_unknown);
+    get_number(internal_identity);
+    for (std::vector<HfstTransducer>::const_iterator it = cascade.begin();
+         it != cascade.end(); it++)
+      {
+        add_stage(HfstBasicTransducer(*it));
+      }
+  }
+
+  HfstDelayedComposition::HfstDelayedComposition
+  (const std::vector<HfstBasicTransducer> & cascade)
+  {
+    if (cascade.empty())
+      {
+        HFST_THROW_MESSAGE(HfstFatalException,
+                           "delayed composition of an empty cascade");
+      }
+    get_number(internal_epsilon);
+    get_number(internal_unknown);
+    get_number(internal_identity);
+    for (std::vector<HfstBasicTransducer>::const_iterator it
+           = cascade.begin(); it != cascade.end(); it++)
+      {
+        add_stage(*it);
+      }
+  }
+
+  unsigned int HfstDelayedComposition::get_number(const std::string & symbol)
+  {
+    std::unordered_map<std::string, unsigned int>::const_iterator it
+      = symbol_numbers.find(symbol);
+    if (it != symbol_numbers.end())
+      {
+        return it->second;
+      }
+    unsigned int number = symbols.size();
+    symbols.push_back(symbol);
+    symbol_numbers[symbol] = number;
+    flag_symbols.push_back(FdOperation::is_diacritic(symbol));
+    if (flag_symbols.back())
+      {
+        flag_table.define_diacritic(number, symbol);
+      }
+    return number;
+  }
+
+  void HfstDelayedComposition::add_stage(const HfstBasicTransducer & t)
+  {
+    stages.push_back(Stage());
+    Stage & stage = stages.back();
+
+    std::vector<unsigned int> alphabet;
+    const HfstBasicTransducer::HfstTransitionGraphAlphabet & a
+      = t.get_alphabet();
+    for (HfstBasicTransducer::HfstTransitionGraphAlphabet::const_iterator it
+           = a.begin(); it != a.end(); it++)
+      {
+        alphabet.push_back(get_number(*it));
+      }
+
+    unsigned int state = 0;
+    for (HfstBasicTransducer::const_iterator it = t.begin();
+         it != t.end(); it++, state++)
+      {
+        stage.states.push_back(State());
+        State & s = stage.states.back();
+        s.final = t.is_final_state(state);
+        s.final_weight = s.final ? t.get_final_weight(state) : 0;
+        for (HfstBasicTransducer::HfstTransitions::const_iterator tr_it
+               = it->begin(); tr_it != it->end(); tr_it++)
+          {
+            Arc arc;
+            arc.input = get_number(tr_it->get_input_symbol());
+            arc.output = get_number(tr_it->get_output_symbol());
+            arc.target = tr_it->get_target_state();
+            arc.weight = tr_it->get_weight();
+            if (arc.input == 0 || flag_symbols[arc.input])
+              {
+                s.epsilon_arcs.push_back(arc);
+              }
+            else
+              {
+                s.arcs.push_back(arc);
+              }
+          }
+        std::stable_sort(s.arcs.begin(), s.arcs.end());
+      }
+
+    // Symbols that are added by later stages are not in this alphabet
+    stage.alphabet.resize(symbols.size(), false);
+    for (std::vector<unsigned int>::const_iterator it = alphabet.begin();
+         it != alphabet.end(); it++)
+      {
+        stage.alphabet[*it] = true;
+      }
+  }
+
+  size_t HfstDelayedComposition::size() const
+  {
+    return stages.size();
+  }
+
+  HfstOneLevelPaths * HfstDelayedComposition::lookup
+  (const StringVector & s, size_t infinite_cutoff, float * max_weight,
+   bool * infinitely_ambiguous) const
+  {
+    Search search;
+    // A symbol that the cascade does not know gets a number of its own
+    // past the symbols of the cascade
+    for (size_t i = 0; i < s.size(); i++)
+      {
+        std::unordered_map<std::string, unsigned int>::const_iterator it
+          = symbol_numbers.find(s[i]);
+        search.input.push_back(it != symbol_numbers.end() ?
+                               it->second : symbols.size() + i);
+      }
+    search.index = 0;
+    search.states.resize(stages.size(), 0);
+    search.flag_states.resize
+      (stages.size(), FdState<unsigned int>(flag_table));
+    search.weights.resize(stages.size(), 0);
+    search.infinite_cutoff = infinite_cutoff;
+    search.cycles_cut = false;
+    search.max_weight = max_weight;
+    search.input_strings = &s;
+    search.results = new HfstOneLevelPaths;
+
+    this->search(search, 0);
+    if (infinitely_ambiguous != NULL)
+      {
+        *infinitely_ambiguous = search.cycles_cut;
+      }
+    return search.results;
+  }
+
+  /* Search all paths from the current configuration of \a s. The
+     epsilon moves that only change one transducer commute with each
+     other, so of a run of them only the order where the transducers do
+     not decrease is followed: \a pure_stage is the first transducer
+     that may still make such a move. */
+  void HfstDelayedComposition::search(Search & s, size_t pure_stage) const
+  {
+    float weight = 0;
+    for (size_t i = 0; i < stages.size(); i++)
+      {
+        weight += s.weights[i];
+      }
+    if (s.max_weight != NULL && weight > *s.max_weight)
+      {
+        return;
+      }
+    size_t repeats = std::count(s.epsilon_path.begin(), s.epsilon_path.end(),
+                                s.states);
+    if (repeats > s.infinite_cutoff)
+      {
+        s.cycles_cut = true;
+        return;
+      }
+
+    if (s.index == s.input.size())
+      {
+        bool final = true;
+        for (size_t i = 0; i < stages.size() && final; i++)
+          {
+            const State & state = stages[i].states[s.states[i]];
+            final = state.final;
+            weight += state.final_weight;
+          }
+        if (final && (s.max_weight == NULL || !(weight > *s.max_weight)))
+          {
+            StringVector path;
+            for (std::vector<unsigned int>::const_iterator it
+                   = s.output.begin(); it != s.output.end(); it++)
+              {
+                path.push_back(*it < symbols.size() ? symbols[*it] :
+                               s.input_strings->at(*it - symbols.size()));
+              }
+            s.results->insert(HfstOneLevelPath(weight, path));
+          }
+      }
+
+    s.epsilon_path.push_back(s.states);
+
+    for (size_t i = 0; i < stages.size(); i++)
+      {
+        const State & state = stages[i].states[s.states[i]];
+        for (std::vector<Arc>::const_iterator it = state.epsilon_arcs.begin();
+             it != state.epsilon_arcs.end(); it++)
+          {
+            bool pure = it->output == 0 || flag_symbols[it->input]
+              || flag_symbols[it->output] || i + 1 == stages.size();
+            if (pure && i < pure_stage)
+              {
+                continue;
+              }
+            FdStateValues flag_values;
+            if (flag_symbols[it->input])
+              {
+                flag_values = s.flag_states[i].save();
+                if (!s.flag_states[i].apply_operation(it->input))
+                  {
+                    s.flag_states[i].restore(flag_values);
+                    continue;
+                  }
+              }
+            unsigned int source = s.states[i];
+            float source_weight = s.weights[i];
+            s.states[i] = it->target;
+            s.weights[i] += it->weight;
+            if (pure)
+              {
+                bool outputs = !(it->output == 0 || flag_symbols[it->input]
+                                 || flag_symbols[it->output]);
+                if (outputs)
+                  {
+                    s.output.push_back(it->output);
+                  }
+                search(s, i);
+                if (outputs)
+                  {
+                    s.output.pop_back();
+                  }
+              }
+            else
+              {
+                feed(s, i + 1, it->output);
+              }
+            s.weights[i] = source_weight;
+            s.states[i] = source;
+            if (flag_symbols[it->input])
+              {
+                s.flag_states[i].restore(flag_values);
+              }
+          }
+      }
+
+    s.epsilon_path.pop_back();
+
+    if (s.index < s.input.size())
+      {
+        std::vector<std::vector<unsigned int> > epsilon_path;
+        epsilon_path.swap(s.epsilon_path);
+        s.index++;
+        feed(s, 0, s.input[s.index - 1]);
+        s.index--;
+        epsilon_path.swap(s.epsilon_path);
+      }
+  }
+
+  /* Let transducer number \a stage consume \a symbol in all possible ways
+     and continue the search from each of them. */
+  void HfstDelayedComposition::feed
+  (Search & s, size_t stage, unsigned int symbol) const
+  {
+    if (stage == stages.size())
+      {
+        s.output.push_back(symbol);
+        search(s, 0);
+        s.output.pop_back();
+        return;
+      }
+
+    const Stage & st = stages[stage];
+    const State & state = st.states[s.states[stage]];
+    bool known = symbol < st.alphabet.size() && st.alphabet[symbol];
+
+    Arc key;
+    key.input = symbol;
+    std::vector<Arc>::const_iterator it
+      = std::lower_bound(state.arcs.begin(), state.arcs.end(), key);
+    for (; it != state.arcs.end() && it->input == symbol; it++)
+      {
+        move(s, stage, *it);
+      }
+    if (!known)
+      {
+        // the unknown and identity arcs are the first ones
+        for (it = state.arcs.begin();
+             it != state.arcs.end() && it->input <= 2; it++)
+          {
+            Arc arc = *it;
+            if (arc.input == 2)
+              {
+                arc.output = symbol;
+              }
+            move(s, stage, arc);
+          }
+      }
+  }
+
+  /* Move transducer number \a stage over \a arc, whose input has just
+     been matched, and pass its output on. */
+  void HfstDelayedComposition::move
+  (Search & s, size_t stage, const Arc & arc) const
+  {
+    unsigned int source = s.states[stage];
+    float source_weight = s.weights[stage];
+    s.states[stage] = arc.target;
+    s.weights[stage] += arc.weight;
+    if (arc.output == 0 || flag_symbols[arc.output])
+      {
+        search(s, 0);
+      }
+    else
+      {
+        feed(s, stage + 1, arc.output);
+      }
+    s.weights[stage] = source_weight;
+    s.states[stage] = source;
+  }
+
+}
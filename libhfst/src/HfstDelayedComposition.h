@@ -0,0 +1,138 @@
+//       This program is free software: you can redistribute it and/or modify
+//       it under the terms of the GNU General Public License as published by
+//       the Free Software Foundation, version 3 of the License.
+//
+//       This program is distributed in the hope that it will be useful,
+//       but WITHOUT ANY WARRANTY; without even the implied warranty of
+//       MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//       GNU General Public License for more details.
+//
+//       You should have received a copy of the GNU General Public License
+//       along with this program.  If not, see <http://www.gnu.org/licenses/>.
+#ifndef _HFST_DELAYED_COMPOSITION_H_
+#define _HFST_DELAYED_COMPOSITION_H_
+
+#include <unordered_map>
+#include "HfstTransducer.h"
+#include "HfstFlagDiacritics.h"
+#include "hfstdll.h"
+
+/** @file HfstDelayedComposition.h
+    \brief Declaration of class HfstDelayedComposition. */
+
+namespace hfst {
+
+  /** \brief The composition of a cascade of transducers, computed only
+      as far as a lookup needs it.
+
+      Looking up a string in the composition of transducers T1, ..., Tn
+      gives the same results as looking up the string in
+      T1 .o. ... .o. Tn, but the composed transducer is never built.
+      Each lookup follows the tuples of states that are reachable from
+      its input, so a cascade whose composition would not fit in memory
+      can still be used for lookup.
+
+      Symbols are matched as in HfstTransducer::lookup_fd: an unknown or
+      identity input symbol of a transducer matches any symbol that is
+      not in the alphabet of that transducer, and an identity symbol
+      passes the matched symbol on. Flag diacritics are checked in each
+      transducer separately, as if each had been looked up on its own,
+      and they are not passed on to the next transducer or to the
+      results.
+
+      The transducers are copied, so the cascade does not depend on
+      them afterwards. lookup does not change the cascade, so several
+      threads can look up strings in one cascade at the same time.
+
+      An example:
+\verbatim
+      std::vector<HfstTransducer> cascade;
+      cascade.push_back(morphology);
+      cascade.push_back(disambiguation);
+      cascade.push_back(normalisation);
+      HfstDelayedComposition composition(cascade);
+      HfstOneLevelPaths * results = composition.lookup(TOK.tokenize_one_level("cats"));
+      // ... use results ...
+      delete results;
+\endverbatim
+  */
+  class HfstDelayedComposition
+  {
+  protected:
+    struct Arc
+    {
+      unsigned int input;
+      unsigned int output;
+      unsigned int target;
+      float weight;
+      bool operator<(const Arc & another) const
+      { return input < another.input; }
+    };
+
+    struct State
+    {
+      // arcs whose input is an epsilon or a flag diacritic
+      std::vector<Arc> epsilon_arcs;
+      // the other arcs sorted by input, unknown and identity arcs first
+      std::vector<Arc> arcs;
+      bool final;
+      float final_weight;
+    };
+
+    struct Stage
+    {
+      std::vector<State> states;
+      // whether a symbol number is in the alphabet of the transducer
+      std::vector<bool> alphabet;
+    };
+
+    struct Search;
+
+    std::vector<Stage> stages;
+    // the symbols of the whole cascade, numbered from zero
+    std::vector<std::string> symbols;
+    std::unordered_map<std::string, unsigned int> symbol_numbers;
+    std::vector<bool> flag_symbols;
+    FdTable<unsigned int> flag_table;
+
+    unsigned int get_number(const std::string & symbol);
+    void add_stage(const HfstBasicTransducer & transducer);
+
+    void search(Search & s, size_t pure_stage) const;
+    void feed(Search & s, size_t stage, unsigned int symbol) const;
+    void move(Search & s, size_t stage, const Arc & arc) const;
+
+  public:
+    /** \brief Create the composition of \a cascade, the first transducer
+        being applied first.
+
+        @pre \a cascade is not empty. */
+    HFSTDLL HfstDelayedComposition(const std::vector<HfstTransducer> & cascade);
+    /** \brief Create the composition of \a cascade, the first transducer
+        being applied first.
+
+        @pre \a cascade is not empty. */
+    HFSTDLL HfstDelayedComposition
+      (const std::vector<HfstBasicTransducer> & cascade);
+
+    /** \brief Look up \a s in the composition of the cascade.
+
+        At most \a infinite_cutoff cycles of epsilon moves are followed
+        between two input symbols, so the results are finite even if the
+        lookup is infinitely ambiguous. If \a infinitely_ambiguous is
+        given, it is set to whether some path was cut there. If \a
+        max_weight is given, paths heavier than it are not followed. The
+        caller owns the returned paths. */
+    HFSTDLL HfstOneLevelPaths * lookup(const StringVector & s,
+                                       size_t infinite_cutoff = 5,
+                                       float * max_weight = NULL,
+                                       bool * infinitely_ambiguous = NULL)
+      const;
+
+    /** \brief The number of transducers in the cascade. */
+    HFSTDLL size_t size() const;
+  };
+
+}
+
+#endif // _HFST_DELAYED_COMPOSITION_H_
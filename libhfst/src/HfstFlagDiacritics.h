@@ -62,23 +62,109 @@ public:
     HFSTDLL static bool has_value(const std::string& diacritic); 
 };
 
+/** \brief The values of the features of an FdState, as a value that can
+    be saved and restored.
+
+    When the table has few enough features and values, the values are
+    packed into a fixed number of bits and the vector is left empty, so
+    copying, comparing and restoring them takes constant time. Otherwise
+    the values are kept in the vector, indexed with values of type
+    FdFeature.
+*/
+struct FdStateValues
+{
+    static const unsigned int packed_words = 2;
+    unsigned long long packed[packed_words];
+    std::vector<FdValue> unpacked;
+
+    FdStateValues(): unpacked()
+        {
+            for (unsigned int i = 0; i < packed_words; i++)
+                packed[i] = 0;
+        }
+
+    bool operator==(const FdStateValues& another) const
+        {
+            for (unsigned int i = 0; i < packed_words; i++)
+            {
+                if (packed[i] != another.packed[i])
+                    return false;
+            }
+            return unpacked == another.unpacked;
+        }
+    bool operator!=(const FdStateValues& another) const
+        { return !(*this == another); }
+    bool operator<(const FdStateValues& another) const
+        {
+            for (unsigned int i = 0; i < packed_words; i++)
+            {
+                if (packed[i] != another.packed[i])
+                    return packed[i] < another.packed[i];
+            }
+            return unpacked < another.unpacked;
+        }
+};
+
 template<class T> class FdState;
   
 /** \brief A collection of the flag diacritics from a symbol table indexed
     by keys of type \a T
+
+    The operations are found through a vector indexed with the symbol, so
+    checking a symbol during lookup does not search a tree. Symbols that
+    are too large to index a vector, or negative, are kept in a map.
 */
 template<class T>
 class FdTable
 {
 private:
+    // Symbols below this are found through dense_operations
+    static const unsigned long long dense_limit = 1 << 20;
+
     // Used for generating IDs that stand in for feature and value strings
     std::map<std::string, FdFeature> feature_map;
     std::map<std::string, FdValue> value_map;
     
-    std::map<T, FdOperation> operations;
+    std::vector<FdOperation> operations;
+    // The index of the operation of a symbol plus one, or zero if the
+    // symbol is not a diacritic
+    std::vector<unsigned int> dense_operations;
+    std::map<T, unsigned int> sparse_operations;
     std::map<std::string, T> symbol_map;
+
+    // Each feature takes 1 << value_shift bits of a packed FdStateValues
+    unsigned int value_shift;
+    bool packed;
+
+    static bool is_dense(T symbol)
+        { return static_cast<unsigned long long>(symbol) < dense_limit; }
+
+    unsigned int operation_number(T symbol) const
+        {
+            if (is_dense(symbol))
+            {
+                size_t i = static_cast<size_t>(symbol);
+                return (i < dense_operations.size()) ? dense_operations[i] : 0;
+            }
+            typename std::map<T, unsigned int>::const_iterator it
+              = sparse_operations.find(symbol);
+            return (it == sparse_operations.end()) ? 0 : it->second;
+        }
+
+    // Values are stored as 2v for v >= 0 and -2v-1 for v < 0, so the
+    // bits needed depend on the largest value ID.
+    void update_packing()
+        {
+            unsigned long long largest = 2 * value_map.size();
+            value_shift = 0;
+            while ((1ULL << (1U << value_shift)) <= largest)
+                value_shift++;
+            packed = (1U << value_shift) <= 16 &&
+              (static_cast<unsigned long long>(num_features()) << value_shift)
+              <= 64 * FdStateValues::packed_words;
+        }
 public:
-    FdTable(): feature_map(), value_map()
+    FdTable(): feature_map(), value_map(), value_shift(0), packed(true)
         { value_map[std::string()] = 0; } // empty value = neutral
     
     void define_diacritic(T symbol, const std::string& str)
@@ -119,33 +205,48 @@ public:
                 FdValue next = value_map.size()+1;
                 value_map[val] = next;
             }
+            update_packing();
       
-            operations.insert
-              (std::pair<T,FdOperation>
-               (symbol, 
-                FdOperation(op, feature_map[feat], value_map[val], str)));
+            if (operation_number(symbol) == 0)
+            {
+                operations.push_back
+                  (FdOperation(op, feature_map[feat], value_map[val], str));
+                if (is_dense(symbol))
+                {
+                    size_t i = static_cast<size_t>(symbol);
+                    if (dense_operations.size() <= i)
+                        dense_operations.resize(i + 1, 0);
+                    dense_operations[i] = operations.size();
+                }
+                else
+                {
+                    sparse_operations[symbol] = operations.size();
+                }
+            }
             symbol_map.insert(std::pair<std::string,T>(str, symbol));
         }
     
     FdFeature num_features() const { return feature_map.size(); }
     bool is_diacritic(T symbol) const
-        { return operations.find(symbol) != operations.end(); }
+        { return operation_number(symbol) != 0; }
       
+    /** The operation of \a symbol, or NULL if it is not a diacritic. The
+        pointer is valid until the next call to define_diacritic. */
     const FdOperation* get_operation(T symbol) const
         {
-          // for some reason this fails to compile???
-          //std::map<T,FdOperation>::const_iterator i 
-          //  = operations.find(symbol);
-          //return (i==operations.end()) ? NULL : &(i->second);
-        
-          return (operations.find(symbol)==operations.end()) ? NULL : 
-            &(operations.find(symbol)->second);
+            unsigned int i = operation_number(symbol);
+            return (i == 0) ? NULL : &operations[i - 1];
         }
     const FdOperation* get_operation(const std::string& symbol) const
         {
             return (symbol_map.find(symbol)==symbol_map.end()) ? NULL : 
               get_operation(symbol_map.find(symbol)->second);
         }
+
+    /** Whether an FdState of this table packs its values into the
+        fixed-width part of an FdStateValues. */
+    bool packs_values() const { return packed; }
+    unsigned int get_value_shift() const { return value_shift; }
     
     bool is_valid_string(const std::vector<T>& symbols) const
         {
@@ -183,6 +284,9 @@ public:
 
 /** \brief Contains the values of each of the flag diacritic features from a
     table. It allows for evaluating a series of diacritic operations
+
+    The values can be saved with save() and put back with restore(). For
+    most tables this copies a couple of words, see FdStateValues.
 */
 template<class T>
 class FdState
@@ -190,34 +294,94 @@ class FdState
 private:
     const FdTable<T>* table;
     
-    // This is indexed with values of type FdFeature
-    typename std::vector<FdValue> values;
+    FdStateValues values;
     T num_features;
+    // The packing of the table when this state was made
+    bool packed;
+    unsigned int value_shift;
+    unsigned long long value_mask;
     
     bool error_flag;
+
+    void init_packing()
+        {
+            packed = (table == NULL) || table->packs_values();
+            value_shift = (table == NULL) ? 0 : table->get_value_shift();
+            value_mask = (1ULL << (1U << value_shift)) - 1;
+        }
+
+    FdValue get_value(FdFeature feature) const
+        {
+            if (!packed)
+                return values.unpacked[feature];
+            unsigned int bit = static_cast<unsigned int>(feature) << value_shift;
+            unsigned long long code
+              = (values.packed[bit >> 6] >> (bit & 63)) & value_mask;
+            return (code & 1) ? -static_cast<FdValue>(code >> 1) - 1
+              : static_cast<FdValue>(code >> 1);
+        }
+    void set_value(FdFeature feature, FdValue value)
+        {
+            if (!packed)
+            {
+                values.unpacked[feature] = value;
+                return;
+            }
+            unsigned int bit = static_cast<unsigned int>(feature) << value_shift;
+            unsigned long long code = (value < 0) ?
+              2ULL * static_cast<unsigned long long>(-(value + 1)) + 1 :
+              2ULL * static_cast<unsigned long long>(value);
+            unsigned long long & word = values.packed[bit >> 6];
+            word = (word & ~(value_mask << (bit & 63))) | (code << (bit & 63));
+        }
 public:
     FdState(const FdTable<T>& t):
-    table(&t), values(table->num_features()),
-    num_features(table->num_features()), error_flag(false)
-        {}
+    table(&t), values(), num_features(table->num_features()),
+    error_flag(false)
+        {
+            init_packing();
+            if (!packed)
+                values.unpacked.resize(num_features, 0);
+        }
 
     FdState():
     table(NULL), values(), num_features(0), error_flag(false)
-    {}
+    { init_packing(); }
 
     const FdTable<T>& get_table() const {return *table;}
 
-    const std::vector<FdValue> & get_values(void) const
-    { return values; }
+    std::vector<FdValue> get_values(void) const
+    {
+        if (!packed)
+            return values.unpacked;
+        std::vector<FdValue> vals(num_features);
+        for (size_t i = 0; i < vals.size(); i++)
+            vals[i] = get_value(i);
+        return vals;
+    }
 
     void assign_values(std::vector<FdValue> const & vals)
     {
-        values = vals;
-        if (values.size() != num_features) {
+        if (vals.size() != num_features) {
             error_flag = true;
         }
+        if (!packed) {
+            values.unpacked = vals;
+            return;
+        }
+        values = FdStateValues();
+        for (size_t i = 0; i < vals.size() && i < num_features; i++)
+            set_value(i, vals[i]);
     }
 
+    /** The values of the features, to be put back with restore(). */
+    const FdStateValues & save(void) const
+    { return values; }
+
+    /** Put back values saved from this state or one of the same table. */
+    void restore(const FdStateValues & vals)
+    { values = vals; }
+
     bool apply_operation(T symbol)
         {
             const FdOperation* op = table->get_operation(symbol);
@@ -227,44 +391,45 @@ public:
         }    
     bool apply_operation(const FdOperation& op)
         {
+            FdValue value = get_value(op.Feature());
             switch(op.Operator()) {
             case Pop: // positive set
-                values[op.Feature()] = op.Value();
+                set_value(op.Feature(), op.Value());
                 return true;
           
             case Nop: // negative set (literally, in this implementation)
-                values[op.Feature()] = -1*op.Value();
+                set_value(op.Feature(), -1*op.Value());
                 return true;
           
             case Rop: // require
                 if (op.Value() == 0) // empty require
-                    return (values[op.Feature()] != 0);
+                    return (value != 0);
                 else // nonempty require
-                    return (values[op.Feature()] == op.Value());
+                    return (value == op.Value());
             
             case Dop: // disallow
                 if (op.Value() == 0) // empty disallow
-                    return (values[op.Feature()] == 0);
+                    return (value == 0);
                 else // nonempty disallow
-                    return (values[op.Feature()] != op.Value());
+                    return (value != op.Value());
             
             case Cop: // clear
-                values[op.Feature()] = 0;
+                set_value(op.Feature(), 0);
                 return true;
           
             case Uop: // unification
-              if(values[op.Feature()] == 0 || /* if the feature is unset or */
-                 values[op.Feature()] == op.Value() || /* the feature is at 
-                                                          this value already 
-                                                          or */
-                 (values[op.Feature()] < 0 &&
-                  (values[op.Feature()]*(-1) != op.Value())) /* the feature is 
-                                                              negatively set 
-                                                              to something 
-                                                              else */
+              if(value == 0 || /* if the feature is unset or */
+                 value == op.Value() || /* the feature is at 
+                                           this value already 
+                                           or */
+                 (value < 0 &&
+                  (value*(-1) != op.Value())) /* the feature is 
+                                                 negatively set 
+                                                 to something 
+                                                 else */
                  )
                 {
-                    values[op.Feature()] = op.Value();
+                    set_value(op.Feature(), op.Value());
                     return true;
                 }
                 return false;
@@ -283,8 +448,9 @@ public:
     void reset()
         {
             error_flag = false;
-            values.clear();
-            values.insert(values.begin(), table->num_features(), 0);
+            values = FdStateValues();
+            if (!packed)
+                values.unpacked.resize(table->num_features(), 0);
         }
 };
 
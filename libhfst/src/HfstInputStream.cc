@@ -1174,6 +1174,12 @@ namespace hfst
       }
   }
 
+  void HfstInputStream::set_mmap_tables(bool value)
+  {
+    if (type == HFST_OL_TYPE || type == HFST_OLW_TYPE)
+      { implementation.hfst_ol->set_mmap_tables(value); }
+  }
+
   bool HfstInputStream::is_eof(void)
   {
     switch (type)
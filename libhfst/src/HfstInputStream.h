@@ -270,6 +270,16 @@ For documentation on the HFST binary transducer format, see
     transducer that has a different type than the previous ones. */
     HFSTDLL ImplementationType get_type(void) const;
 
+    /** \brief Whether optimized-lookup transducers read from the stream
+        map their transition tables from the file into memory.
+
+        Mapped tables are read in place instead of being copied, so loading
+        is nearly instantaneous and processes that map the same file share
+        one physical copy of it. Copies of a transducer read this way share
+        the mapping. Has no effect on other transducer types or when reading
+        from standard input. */
+    HFSTDLL void set_mmap_tables(bool value);
+
     friend class HfstTransducer;
   };
 
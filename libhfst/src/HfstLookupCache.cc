@@ -0,0 +1,139 @@
+//       This program is free software: you can redistribute it and/or modify
+//       it under the terms of the GNU General Public License as published by
+//       the Free Software Foundation, version 3 of the License.
+//
+//       This program is distributed in the hope that it will be useful,
+//       but WITHOUT ANY WARRANTY; without even the implied warranty of
+//       MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//       GNU General Public License for more details.
+//
+//       You should have received a copy of the GNU General Public License
+//       along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+#include "HfstLookupCache.h"
+
+namespace hfst {
+
+  HfstLookupCache::HfstLookupCache(const HfstTransducer & t, size_t c):
+    transducer(t), entries(c), hits(0), misses(0)
+  {
+    if (c == 0)
+      {
+        HFST_THROW_MESSAGE(HfstFatalException,
+                           "lookup cache capacity must be positive");
+      }
+  }
+
+  /* Return the entry of \a input, setting \a found to whether it was
+     already cached. Each call counts as a use of the entry. */
+  HfstLookupCache::Entry & HfstLookupCache::find_entry
+  (const std::string & input, bool & found)
+  {
+    Entry * entry = entries.find(input);
+    found = (entry != NULL);
+    if (!found)
+      {
+        entry = &entries.insert(input);
+      }
+    return *entry;
+  }
+
+  HfstOneLevelPaths * HfstLookupCache::lookup_entry
+  (Entry & entry, bool found, const std::string & s, ssize_t limit,
+   double time_cutoff)
+  {
+    if (found && entry.has_paths &&
+        entry.limit == limit && entry.time_cutoff == time_cutoff)
+      {
+        ++hits;
+        return new HfstOneLevelPaths(entry.paths);
+      }
+    ++misses;
+    HfstOneLevelPaths * results = transducer.lookup_fd(s, limit, time_cutoff);
+    entry.paths = *results;
+    entry.has_paths = true;
+    entry.limit = limit;
+    entry.time_cutoff = time_cutoff;
+    return results;
+  }
+
+  bool HfstLookupCache::is_entry_infinitely_ambiguous
+  (Entry & entry, const std::string & s)
+  {
+    if (entry.infinitely_ambiguous == -1)
+      {
+        entry.infinitely_ambiguous =
+          transducer.is_lookup_infinitely_ambiguous(s) ? 1 : 0;
+      }
+    return entry.infinitely_ambiguous == 1;
+  }
+
+  std::string HfstLookupCache::join(const StringVector & s)
+  {
+    std::string input;
+    for (StringVector::const_iterator it = s.begin(); it != s.end(); ++it)
+      {
+        input.append(*it);
+      }
+    return input;
+  }
+
+  HfstOneLevelPaths * HfstLookupCache::lookup_fd
+  (const std::string & s, ssize_t limit, double time_cutoff)
+  {
+    bool found;
+    Entry & entry = find_entry(s, found);
+    return lookup_entry(entry, found, s, limit, time_cutoff);
+  }
+
+  HfstOneLevelPaths * HfstLookupCache::lookup_fd
+  (const StringVector & s, ssize_t limit, double time_cutoff)
+  {
+    return lookup_fd(join(s), limit, time_cutoff);
+  }
+
+  bool HfstLookupCache::is_lookup_infinitely_ambiguous(const std::string & s)
+  {
+    bool found;
+    Entry & entry = find_entry(s, found);
+    return is_entry_infinitely_ambiguous(entry, s);
+  }
+
+  bool HfstLookupCache::is_lookup_infinitely_ambiguous(const StringVector & s)
+  {
+    return is_lookup_infinitely_ambiguous(join(s));
+  }
+
+  HfstOneLevelPaths * HfstLookupCache::lookup_fd_bounded
+  (const StringVector & s, ssize_t infinite_limit,
+   bool & infinitely_ambiguous)
+  {
+    std::string input = join(s);
+    bool found;
+    Entry & entry = find_entry(input, found);
+    infinitely_ambiguous = is_entry_infinitely_ambiguous(entry, input);
+    return lookup_entry(entry, found, input,
+                        infinitely_ambiguous ? infinite_limit : -1, 0.0);
+  }
+
+  unsigned long HfstLookupCache::get_hits() const
+  {
+    return hits;
+  }
+
+  unsigned long HfstLookupCache::get_misses() const
+  {
+    return misses;
+  }
+
+  size_t HfstLookupCache::size() const
+  {
+    return entries.size();
+  }
+
+  void HfstLookupCache::clear()
+  {
+    entries.clear();
+  }
+
+}
@@ -0,0 +1,132 @@
+//       This program is free software: you can redistribute it and/or modify
+//       it under the terms of the GNU General Public License as published by
+//       the Free Software Foundation, version 3 of the License.
+//
+//       This program is distributed in the hope that it will be useful,
+//       but WITHOUT ANY WARRANTY; without even the implied warranty of
+//       MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//       GNU General Public License for more details.
+//
+//       You should have received a copy of the GNU General Public License
+//       along with this program.  If not, see <http://www.gnu.org/licenses/>.
+#ifndef _HFST_LOOKUP_CACHE_H_
+#define _HFST_LOOKUP_CACHE_H_
+
+#include "HfstTransducer.h"
+#include "HfstClockCache.h"
+#include "hfstdll.h"
+
+/** @file HfstLookupCache.h
+    \brief Declaration of class HfstLookupCache. */
+
+namespace hfst {
+
+  /** \brief A bounded cache of the lookup results of a transducer.
+
+      In running text a small number of word forms makes up most of the
+      tokens, so looking each of them up only once saves most of the work.
+      The cache keeps the results of at most \a capacity input strings and
+      evicts with the CLOCK algorithm of HfstClockCache.
+
+      The cache is not thread-safe. The transducer it wraps is only read,
+      so threads can share one transducer if each has a cache of its own.
+
+      An example:
+\verbatim
+      HfstLookupCache cache(analyser, 10000);
+      HfstOneLevelPaths * results = cache.lookup_fd("cats");
+      // ... use results ...
+      delete results;
+      std::cerr << cache.get_hits() << " hits" << std::endl;
+\endverbatim
+  */
+  class HfstLookupCache
+  {
+  protected:
+    struct Entry
+    {
+      // results of the most recent lookup_fd, valid if has_paths
+      HfstOneLevelPaths paths;
+      bool has_paths;
+      ssize_t limit;
+      double time_cutoff;
+      // -1 if is_lookup_infinitely_ambiguous has not been asked yet
+      int infinitely_ambiguous;
+
+      Entry(): paths(), has_paths(false), limit(-1), time_cutoff(0.0),
+               infinitely_ambiguous(-1) {}
+    };
+
+    const HfstTransducer & transducer;
+    HfstClockCache<Entry> entries;
+    unsigned long hits;
+    unsigned long misses;
+
+    Entry & find_entry(const std::string & input, bool & found);
+    HfstOneLevelPaths * lookup_entry(Entry & entry, bool found,
+                                     const std::string & s, ssize_t limit,
+                                     double time_cutoff);
+    bool is_entry_infinitely_ambiguous(Entry & entry, const std::string & s);
+    static std::string join(const StringVector & s);
+
+  public:
+    /** \brief Create a cache of at most \a capacity input strings for
+        lookups in \a transducer.
+
+        \a transducer must outlive the cache and must not change while
+        the cache is in use.
+
+        @pre \a capacity is greater than zero. */
+    HFSTDLL HfstLookupCache(const HfstTransducer & transducer,
+                            size_t capacity);
+
+    /** \brief Look up \a s like HfstTransducer::lookup_fd, reusing the
+        results of an earlier lookup of \a s if they are still in the
+        cache.
+
+        Results are reused only if they were looked up with the same
+        \a limit and \a time_cutoff. Results of a lookup that ran out of
+        time are cached as they are. The caller owns the returned paths. */
+    HFSTDLL HfstOneLevelPaths * lookup_fd(const std::string & s,
+                                          ssize_t limit = -1,
+                                          double time_cutoff = 0.0);
+
+    /** \brief Like lookup_fd(const std::string&, ssize_t, double) with
+        the symbols of \a s joined into one input string. */
+    HFSTDLL HfstOneLevelPaths * lookup_fd(const StringVector & s,
+                                          ssize_t limit = -1,
+                                          double time_cutoff = 0.0);
+
+    /** \brief Whether lookup of \a s is infinitely ambiguous, remembered
+        in the same entry as the lookup results of \a s.
+
+        @see HfstTransducer::is_lookup_infinitely_ambiguous */
+    HFSTDLL bool is_lookup_infinitely_ambiguous(const std::string & s);
+    HFSTDLL bool is_lookup_infinitely_ambiguous(const StringVector & s);
+
+    /** \brief Look up \a s like lookup_fd, first finding out like
+        is_lookup_infinitely_ambiguous whether \a s has infinitely many
+        results. If it has, \a infinitely_ambiguous is set and at most
+        \a infinite_limit results are returned.
+
+        Calling is_lookup_infinitely_ambiguous and then lookup_fd would
+        count as two uses of the entry of \a s, so an input string
+        looked up only once would be kept as if it were used again. */
+    HFSTDLL HfstOneLevelPaths * lookup_fd_bounded(const StringVector & s,
+                                                  ssize_t infinite_limit,
+                                                  bool & infinitely_ambiguous);
+
+    /** \brief The number of lookups answered from the cache. */
+    HFSTDLL unsigned long get_hits() const;
+    /** \brief The number of lookups that had to traverse the
+        transducer. */
+    HFSTDLL unsigned long get_misses() const;
+    /** \brief The number of input strings in the cache. */
+    HFSTDLL size_t size() const;
+    /** \brief Forget all cached results. The counters are kept. */
+    HFSTDLL void clear();
+  };
+
+}
+
+#endif // _HFST_LOOKUP_CACHE_H_
@@ -0,0 +1,168 @@
+//       This program is free software: you can redistribute it and/or modify
+//       it under the terms of the GNU General Public License as published by
+//       the Free Software Foundation, version 3 of the License.
+//
+//       This program is distributed in the hope that it will be useful,
+//       but WITHOUT ANY WARRANTY; without even the implied warranty of
+//       MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//       GNU General Public License for more details.
+//
+//       You should have received a copy of the GNU General Public License
+//       along with this program.  If not, see <http://www.gnu.org/licenses/>.
+#ifndef _HFST_THREAD_POOL_H_
+#define _HFST_THREAD_POOL_H_
+
+#include <atomic>
+#include <condition_variable>
+#include <exception>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/** @file HfstThreadPool.h
+    \brief Declaration of class HfstThreadPool. */
+
+namespace hfst {
+
+/** @brief Runs batches of jobs on a fixed set of threads.
+ *
+ * The batch modes of the tools and the parallel parts of the compilers
+ * use it: they split their work into independent jobs, run them in the
+ * pool and combine the results in the original order.
+ *
+ * The thread calling run() works on the batch too, so a pool of size 1
+ * starts no threads at all.
+ */
+class HfstThreadPool
+{
+ public:
+  typedef std::function<void(unsigned int, size_t)> Job;
+
+  //! @brief Create a pool of @a threads threads, at least one.
+  explicit HfstThreadPool(unsigned int threads):
+    job(NULL), count(0), next(0), busy(0), generation(0), quit(false)
+  {
+    for (unsigned int t = 1; t < threads; ++t)
+      {
+        workers.push_back(std::thread(&HfstThreadPool::work, this, t));
+      }
+  }
+
+  ~HfstThreadPool()
+  {
+    {
+      std::lock_guard<std::mutex> lock(mutex);
+      quit = true;
+    }
+    wake.notify_all();
+    for (size_t t = 0; t < workers.size(); ++t)
+      {
+        workers[t].join();
+      }
+  }
+
+  //! @brief The number of threads, the calling one included.
+  unsigned int size() const
+  {
+    return workers.size() + 1;
+  }
+
+  //! @brief Call @a job (thread, i) for each i in [0, @a count) and return
+  //! when all the calls have returned.
+  //!
+  //! thread is below size() and no two calls with the same thread run at
+  //! once, so jobs can keep their scratch space in a vector indexed by it.
+  //! If a job throws, the rest of the batch is skipped and the exception
+  //! is rethrown here.
+  void run(size_t count, const Job & job)
+  {
+    {
+      std::lock_guard<std::mutex> lock(mutex);
+      this->job = &job;
+      this->count = count;
+      next = 0;
+      busy = workers.size();
+      error = std::exception_ptr();
+      ++generation;
+    }
+    wake.notify_all();
+    take_jobs(0);
+    std::unique_lock<std::mutex> lock(mutex);
+    while (busy > 0)
+      {
+        done.wait(lock);
+      }
+    this->job = NULL;
+    if (error)
+      {
+        std::rethrow_exception(error);
+      }
+  }
+
+ private:
+  HfstThreadPool(const HfstThreadPool &);
+  HfstThreadPool & operator=(const HfstThreadPool &);
+
+  void work(unsigned int thread)
+  {
+    unsigned long seen = 0;
+    while (true)
+      {
+        {
+          std::unique_lock<std::mutex> lock(mutex);
+          while (!quit && generation == seen)
+            {
+              wake.wait(lock);
+            }
+          if (quit)
+            {
+              return;
+            }
+          seen = generation;
+        }
+        take_jobs(thread);
+        std::lock_guard<std::mutex> lock(mutex);
+        if (--busy == 0)
+          {
+            done.notify_one();
+          }
+      }
+  }
+
+  void take_jobs(unsigned int thread)
+  {
+    for (size_t i = next++; i < count; i = next++)
+      {
+        try
+          {
+            (*job)(thread, i);
+          }
+        catch (...)
+          {
+            std::lock_guard<std::mutex> lock(mutex);
+            if (!error)
+              {
+                error = std::current_exception();
+              }
+            next = count;
+          }
+      }
+  }
+
+  std::vector<std::thread> workers;
+  std::mutex mutex;
+  std::condition_variable wake;
+  std::condition_variable done;
+  const Job * job;
+  size_t count;
+  std::atomic<size_t> next;
+  unsigned int busy;
+  unsigned long generation;
+  bool quit;
+  std::exception_ptr error;
+};
+
+}
+
+#endif // _HFST_THREAD_POOL_H_
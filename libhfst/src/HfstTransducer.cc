@@ -16,6 +16,7 @@
     The implementations call backend implementations that are declared in
     files in the directory implementations. */
 
+#include <algorithm>
 #include <string>
 #include <map>
 
@@ -26,6 +27,7 @@ using std::map;
 #include "HfstFlagDiacritics.h"
 #include "HfstExceptionDefs.h"
 #include "implementations/compose_intersect/ComposeIntersectLexicon.h"
+#include "implementations/HfstMinimalAcyclicBuilder.h"
 
 using hfst::implementations::ConversionFunctions;
 
@@ -465,6 +467,19 @@ HfstTransducer * HfstTransducer::harmonize_(const HfstTransducer &another)
       HFST_THROW_MESSAGE
     (HfstFatalException, "harmonize_ with anonymous transducers"); }
 
+#if HAVE_OPENFST
+    // Tropical transducers are harmonized in place, without a round trip
+    // through HfstBasicTransducer
+    if (this->type == TROPICAL_OPENFST_TYPE)
+      {
+        HfstTransducer * another_harmonized = new HfstTransducer(another);
+        this->tropical_ofst_interface.harmonize
+          (this->implementation.tropical_ofst,
+           another_harmonized->implementation.tropical_ofst);
+        return another_harmonized;
+      }
+#endif
+
     HfstTransducer another_copy(another);
 
     // Prevent flag diacritics from being harmonized by inserting them to
@@ -516,7 +531,6 @@ HfstTransducer * HfstTransducer::harmonize_(const HfstTransducer &another)
 #endif // HAVE_XFSM
 #if HAVE_SFST || HAVE_OPENFST
     case (SFST_TYPE):
-    case (TROPICAL_OPENFST_TYPE):
 #if HAVE_OPENFST_LOG
     case (LOG_OPENFST_TYPE):
 #endif
@@ -594,9 +608,15 @@ void HfstTransducer::harmonize(HfstTransducer &another)
         // no need to harmonize as xfsm's functions take care of harmonizing
         break;
 #endif // HAVE_XFSM
+#if HAVE_OPENFST
+    case (TROPICAL_OPENFST_TYPE):
+      this->tropical_ofst_interface.harmonize
+        (this->implementation.tropical_ofst,
+         another.implementation.tropical_ofst);
+      break;
+#endif
 #if HAVE_SFST || HAVE_OPENFST
     case (SFST_TYPE):
-    case (TROPICAL_OPENFST_TYPE):
 #if HAVE_OPENFST_LOG
     case (LOG_OPENFST_TYPE):
 #endif
@@ -1182,6 +1202,29 @@ HfstTransducer::HfstTransducer(const std::string& upper_utf8_str,
     }
 }
 
+HfstTransducer HfstTransducer::from_word_list
+(StringVector words,
+ const HfstTokenizer &multichar_symbol_tokenizer,
+ ImplementationType type)
+{
+    if (! is_implementation_type_available(type))
+    HFST_THROW(ImplementationTypeNotAvailableException);
+
+    std::sort(words.begin(), words.end());
+    words.erase(std::unique(words.begin(), words.end()), words.end());
+
+    // Sorted strings keep the paths with a common prefix together, so the
+    // builder makes the automaton in one pass. The rare path that comes
+    // out of order through a multicharacter symbol is merged in at the end.
+    implementations::HfstMinimalAcyclicBuilder builder;
+    for (StringVector::const_iterator it = words.begin();
+         it != words.end(); it++)
+      {
+        builder.add(multichar_symbol_tokenizer.tokenize(*it), 0);
+      }
+    return HfstTransducer(builder.get_transducer(), type);
+}
+
 
 HfstTransducer::HfstTransducer(HfstInputStream &in):
     type(in.type), anonymous(false),is_trie(false), name("")
@@ -4042,7 +4085,12 @@ HfstTransducer &HfstTransducer::compose
     another_copy->insert_missing_symbols_to_alphabet_from(*this, true);
 
     // Harmonize, FOMA and XFSM take care of this by default.
-    if (this->type != FOMA_TYPE && this->type != XFSM_TYPE)
+    // another_copy is ours, so a tropical one is harmonized in place.
+    if (this->type == TROPICAL_OPENFST_TYPE)
+      {
+        this->harmonize(*another_copy);
+      }
+    else if (this->type != FOMA_TYPE && this->type != XFSM_TYPE)
       {
         HfstTransducer * tmp =
           this->harmonize_(const_cast<HfstTransducer&>(*another_copy));
@@ -4052,6 +4100,18 @@ HfstTransducer &HfstTransducer::compose
 
     /* Take care of unknown and identity symbols being handled right in
        composition, FOMA and XFSM take care of this by default. */
+#if HAVE_OPENFST
+    if (this->type == TROPICAL_OPENFST_TYPE && unknown_symbols_in_use)
+      {
+        this->tropical_ofst_interface.substitute_in_place
+          (this->implementation.tropical_ofst,
+           "@_IDENTITY_SYMBOL_@","@_UNKNOWN_SYMBOL_@",false,true);
+        this->tropical_ofst_interface.substitute_in_place
+          (another_copy->implementation.tropical_ofst,
+           "@_IDENTITY_SYMBOL_@","@_UNKNOWN_SYMBOL_@",true,false);
+      }
+    else
+#endif
     if ( (this->type != FOMA_TYPE && this->type != XFSM_TYPE) && unknown_symbols_in_use)
       {
         this->substitute("@_IDENTITY_SYMBOL_@","@_UNKNOWN_SYMBOL_@",false,true);
@@ -5325,6 +5385,15 @@ void HfstTransducer::write_in_att_format
 #if HAVE_XFSM
   if (this->type == XFSM_TYPE)
     HFST_THROW(FunctionNotImplementedException);
+#endif
+#if HAVE_OPENFST
+    // A tropical transducer is written as it is.
+    if (this->type == TROPICAL_OPENFST_TYPE)
+      {
+        tropical_ofst_interface.write_in_att_format
+          (implementation.tropical_ofst, ofile, print_weights);
+        return;
+      }
 #endif
     // Implemented only for internal transducer format.
     hfst::implementations::HfstBasicTransducer net(*this);
@@ -5392,6 +5461,17 @@ HfstTransducer::HfstTransducer(FILE * ifile,
 
     HfstTokenizer::check_utf8_correctness(epsilon_symbol);
 
+#if HAVE_OPENFST
+    // A tropical transducer is built as it is read.
+    if (type == TROPICAL_OPENFST_TYPE)
+      {
+        implementation.tropical_ofst =
+          tropical_ofst_interface.read_in_att_format
+          (ifile, epsilon_symbol, linecount);
+        return;
+      }
+#endif
+
     // Implemented only for internal transducer format.
     hfst::implementations::HfstBasicTransducer net =
     hfst::implementations::HfstTransitionGraph<hfst::implementations::
@@ -5470,6 +5550,17 @@ HfstTransducer::HfstTransducer(FILE * ifile,
 
     HfstTokenizer::check_utf8_correctness(epsilon_symbol);
 
+#if HAVE_OPENFST
+    // A tropical transducer is built as it is read.
+    if (type == TROPICAL_OPENFST_TYPE)
+      {
+        implementation.tropical_ofst =
+          tropical_ofst_interface.read_in_att_format
+          (ifile, epsilon_symbol, linecount);
+        return;
+      }
+#endif
+
     // Implemented only for internal transducer format.
     hfst::implementations::HfstBasicTransducer net =
     hfst::implementations::HfstTransitionGraph<hfst::implementations::
@@ -522,6 +522,34 @@ An example:
                    const HfstTokenizer &multichar_symbol_tokenizer,
                    ImplementationType type);
 
+    /** \brief Create a transducer of type \a type that accepts the
+        strings in \a words, each tokenized with tokenizer
+        \a multichar_symbol_tokenizer.
+
+        A copy of the strings is sorted and its duplicates removed, and
+        the minimal acyclic transducer is built from it in one pass. This is
+        much faster than disjuncting the strings one at a time, and the
+        result needs no minimization. An empty string is accepted as the
+        empty path.
+
+        An example:
+\verbatim
+       StringVector words;
+       words.push_back("dog");
+       words.push_back("cats");
+       words.push_back("cat");
+       HfstTokenizer TOK;
+       HfstTransducer tr
+         = HfstTransducer::from_word_list(words, TOK, TROPICAL_OPENFST_TYPE);
+       // tr now accepts "cat", "cats" and "dog"
+\endverbatim
+
+        @see HfstTokenizer **/
+    HFSTDLL static HfstTransducer from_word_list
+      (StringVector words,
+       const HfstTokenizer &multichar_symbol_tokenizer,
+       ImplementationType type);
+
     /* @brief Create a transducer that recognizes the union of string pairs in 
        \a sps. The type of the transducer is defined by \a type. \a cyclic
        defines whether the transducer recognizes any number (from zero to
@@ -1085,6 +1113,9 @@ ccc : ddd
     //!               if infinitely ambiguous.
     //! \return{A pointer to a HfstOneLevelPaths container allocated by callee}
     //! 
+    //! Lookups do not modify the transducer, so several threads may call
+    //! this function at the same time on one shared transducer.
+    //!
     //! @see HfstTokenizer::tokenize_one_level
     //! @see is_lookup_infinitely_ambiguous(const StringVector&) const
     //!
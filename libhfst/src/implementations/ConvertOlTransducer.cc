@@ -348,12 +348,10 @@ void get_states_and_symbols(
         if (it->is_simple()) {
             continue;
         }
-        unsigned int i = first_available_index;
-
-        // While this index is not suitable for a starting index, keep looking
-        while (!used_indices->fits(*it, flag_symbols, i)) {
-            ++i;
-        }
+        // The first index from the floor on that is suitable for a
+        // starting index
+        unsigned int i = used_indices->first_fit(*it, flag_symbols,
+                                                 first_available_index);
         it->start_index = i;
         previous_successful_index = i;
         // Once we've found a starting index, insert a finality marker and
@@ -459,7 +457,18 @@ HfstTransducer * ConversionFunctions::hfst_ol_to_hfst_transducer(
 {
     hfst::ImplementationType type = t->is_weighted() ? HFST_OLW_TYPE : HFST_OL_TYPE;
     HfstTransducer * retval = new HfstTransducer(type);
-    retval->implementation.hfst_ol = new hfst_ol::Transducer(*t);
+    if (t->is_weighted())
+      {
+        retval->implementation.hfst_ol = new hfst_ol::Transducer
+          (t->get_header(), t->get_alphabet(),
+           t->copy_windex_table(), t->copy_transitionw_table());
+      }
+    else
+      {
+        retval->implementation.hfst_ol = new hfst_ol::Transducer
+          (t->get_header(), t->get_alphabet(),
+           t->copy_index_table(), t->copy_transition_table());
+      }
     return retval;
 }
 
@@ -0,0 +1,312 @@
+//       This program is free software: you can redistribute it and/or modify
+//       it under the terms of the GNU General Public License as published by
+//       the Free Software Foundation, version 3 of the License.
+//
+//       This program is distributed in the hope that it will be useful,
+//       but WITHOUT ANY WARRANTY; without even the implied warranty of
+//       MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//       GNU General Public License for more details.
+//
+//       You should have received a copy of the GNU General Public License
+//       along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+#ifndef _HFST_ATT_READER_H_
+#define _HFST_ATT_READER_H_
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "../HfstExceptionDefs.h"
+
+namespace hfst {
+
+  namespace implementations {
+
+    /** @brief A reader of one transducer in AT&T text format.
+
+        The lines are read into one buffer that grows to the longest line
+        and are split into fields in place, so reading a line copies
+        nothing. A symbol field is unescaped only the first time it is
+        seen: the symbols get local numbers in the order they are first
+        seen, and a line gives the local numbers of its symbols. The
+        caller maps each local number to its own once.
+
+        The transducer ends at the end of the input, at a separator line
+        "--" or at an empty line. The lines are as in
+        HfstTransitionGraph::read_in_att_format.
+
+        An example:
+\verbatim
+        HfstAttReader reader(std::cin, file, "@0@", linecount);
+        while (reader.read_line())
+          {
+            if (reader.is_final_line())
+              // reader.get_state() is final with reader.get_weight()
+            else
+              // a transition from reader.get_state() to
+              // reader.get_target() with the symbols numbered
+              // reader.get_input() and reader.get_output()
+          }
+\endverbatim
+    */
+    class HfstAttReader
+    {
+    public:
+      /** @brief Read from \a file or, if it is NULL, from \a is.
+          \a epsilon_symbol is read as the epsilon and \a linecount is
+          incremented for each line read.
+          @throws EndOfStreamException if the input is at its end. */
+      HfstAttReader(std::istream & is, FILE * file,
+                    const std::string & epsilon_symbol,
+                    unsigned int & linecount):
+        is(is), file(file), epsilon_symbol(epsilon_symbol),
+        linecount(linecount), buffer(256), field_count(0)
+      {
+        if (file == NULL ? is.eof() : feof(file) != 0)
+          {
+            HFST_THROW(EndOfStreamException);
+          }
+      }
+
+      /** @brief Read the next line of the transducer.
+          @return false if the transducer has ended.
+          @throws NotValidAttFormatException if the line is not a
+          transition or a final state. */
+      bool read_line()
+      {
+        if (! get_line())
+          {
+            return false;
+          }
+        linecount++;
+
+        char * line = &buffer[0];
+        // an empty line signifying an empty transducer,
+        // a special case that is accepted if it is the only
+        // transducer in the stream
+        if ( // empty line with or without a newline
+            (line[0] == '\0') ||
+            (line[0] == '\n' && line[1] == '\0') ||
+            // windows newline
+            (line[0] == '\r' && line[1] == '\n' && line[2] == '\0')
+             )
+          {
+            // make sure that the end-of-file is reached
+            if (file == NULL)
+              is.get();
+            else
+              fgetc(file);
+            return false;
+          }
+
+        if (*line == '-') // transducer separator line is "--"
+          return false;
+
+        // split the line into at most five fields, as sscanf "%s" would
+        char ends [5];
+        char * p = line;
+        field_count = 0;
+        while (field_count < 5)
+          {
+            while (*p != '\0' && is_space(*p))
+              p++;
+            if (*p == '\0')
+              break;
+            fields[field_count] = p;
+            while (*p != '\0' && ! is_space(*p))
+              p++;
+            ends[field_count] = *p;
+            field_count++;
+            if (*p == '\0')
+              break;
+            *p = '\0';
+            p++;
+          }
+
+        if (field_count == 1 || field_count == 2) // a final state line
+          {
+            state = atoi(fields[0]);
+            weight = (field_count == 2) ? atof(fields[1]) : 0;
+            return true;
+          }
+        if (field_count == 4 || field_count == 5) // a transition line
+          {
+            state = atoi(fields[0]);
+            target = atoi(fields[1]);
+            input = get_symbol_number(fields[2]);
+            output = get_symbol_number(fields[3]);
+            weight = (field_count == 5) ? atof(fields[4]) : 0;
+            return true;
+          }
+
+        // line could not be parsed, put it back together for the message
+        for (unsigned int i = 0; i < field_count; i++)
+          {
+            fields[i][strlen(fields[i])] = ends[i];
+          }
+        std::string message(line);
+        HFST_THROW_MESSAGE
+          (NotValidAttFormatException,
+           message);
+      }
+
+      /** @brief Whether the line read last is a final state line. */
+      bool is_final_line() const
+      { return field_count < 4; }
+
+      /** @brief The source state of a transition or the final state. */
+      unsigned int get_state() const
+      { return state; }
+
+      /** @brief The target state of a transition. */
+      unsigned int get_target() const
+      { return target; }
+
+      /** @brief The local number of the input symbol of a transition. */
+      unsigned int get_input() const
+      { return input; }
+
+      /** @brief The local number of the output symbol of a transition. */
+      unsigned int get_output() const
+      { return output; }
+
+      /** @brief The weight of a transition or a final state. */
+      float get_weight() const
+      { return weight; }
+
+      /** @brief How many symbols have been seen. */
+      unsigned int get_symbol_count() const
+      { return symbols.size(); }
+
+      /** @brief The symbol that has the local number \a number, with
+          "@_SPACE_@", "@_TAB_@", "@_COLON_@", "@0@" and the epsilon
+          symbol replaced. */
+      const std::string & get_symbol(unsigned int number) const
+      { return symbols[number]; }
+
+      /** @brief Replace " ", "@_EPSILON_SYMBOL_@" and tabulators in
+          \a symbol as they are written in AT&T format. */
+      static void escape_symbol(std::string & symbol)
+      {
+        replace_all(symbol, " ", "@_SPACE_@");
+        replace_all(symbol, "@_EPSILON_SYMBOL_@", "@0@");
+        replace_all(symbol, "\t", "@_TAB_@");
+      }
+
+    protected:
+      std::istream & is;
+      FILE * file;
+      const std::string & epsilon_symbol;
+      unsigned int & linecount;
+
+      // the current line, ended with a zero
+      std::vector<char> buffer;
+      char * fields [5];
+      unsigned int field_count;
+
+      unsigned int state;
+      unsigned int target;
+      unsigned int input;
+      unsigned int output;
+      float weight;
+
+      // the symbols in the order they were first seen
+      std::vector<std::string> symbols;
+      // the local numbers of the symbol fields as they are in the input
+      std::unordered_map<std::string, unsigned int> symbol_numbers;
+      // the key of the last lookup, kept to reuse its memory
+      std::string key;
+
+      static bool is_space(char c)
+      {
+        return c == ' ' || c == '\t' || c == '\n' || c == '\r'
+          || c == '\v' || c == '\f';
+      }
+
+      /* Read the next line into the buffer, growing it if needed.
+         Return false at the end of the input. */
+      bool get_line()
+      {
+        if (file == NULL)
+          {
+            if (! std::getline(is, key))
+              {
+                return false;
+              }
+            buffer.assign(key.begin(), key.end());
+            buffer.push_back('\0');
+            return true;
+          }
+
+        size_t length = 0;
+        while (true)
+          {
+            if (fgets(&buffer[length], buffer.size() - length, file) == NULL)
+              {
+                if (length == 0)
+                  {
+                    return false;
+                  }
+                break;
+              }
+            length += strlen(&buffer[length]);
+            if (buffer[length - 1] == '\n' || feof(file))
+              {
+                break;
+              }
+            buffer.resize(buffer.size() * 2);
+          }
+        return true;
+      }
+
+      /* Get the local number of the symbol field \a field. */
+      unsigned int get_symbol_number(const char * field)
+      {
+        key.assign(field);
+        std::unordered_map<std::string, unsigned int>::const_iterator it
+          = symbol_numbers.find(key);
+        if (it != symbol_numbers.end())
+          {
+            return it->second;
+          }
+
+        unsigned int number = symbols.size();
+        symbol_numbers[key] = number;
+
+        // replace "@_SPACE_@"s with " " and "@0@"s with
+        // "@_EPSILON_SYMBOL_@"
+        std::string symbol(key);
+        replace_all(symbol, "@_SPACE_@", " ");
+        replace_all(symbol, "@0@", "@_EPSILON_SYMBOL_@");
+        replace_all(symbol, "@_TAB_@", "\t");
+        replace_all(symbol, "@_COLON_@", ":");
+        if (epsilon_symbol.compare(symbol) == 0)
+          symbol = "@_EPSILON_SYMBOL_@";
+        symbols.push_back(symbol);
+        return number;
+      }
+
+      /* Replace all strings \a str1 in \a symbol with \a str2. */
+      static void replace_all(std::string & symbol,
+                              const std::string & str1,
+                              const std::string & str2)
+      {
+        size_t pos = symbol.find(str1);
+        while (pos != std::string::npos)
+          {
+            symbol.replace(pos, str1.size(), str2);
+            pos = symbol.find(str1, pos + str2.size());
+          }
+      }
+    };
+
+  }
+
+}
+
+#endif // _HFST_ATT_READER_H_
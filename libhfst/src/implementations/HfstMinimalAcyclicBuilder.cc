@@ -0,0 +1,450 @@
+//       This program is free software: you can redistribute it and/or modify
+//       it under the terms of the GNU General Public License as published by
+//       the Free Software Foundation, version 3 of the License.
+//
+//       This program is distributed in the hope that it will be useful,
+//       but WITHOUT ANY WARRANTY; without even the implied warranty of
+//       MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//       GNU General Public License for more details.
+//
+//       You should have received a copy of the GNU General Public License
+//       along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+#include "HfstMinimalAcyclicBuilder.h"
+#include "HfstTransitionGraph.h"
+
+#include <algorithm>
+#include <cstring>
+
+#ifndef MAIN_TEST
+
+namespace hfst {
+
+  namespace implementations {
+
+    bool HfstMinimalAcyclicBuilder::Arc::operator<(const Arc &another) const
+    {
+      if (input != another.input)
+        return input < another.input;
+      if (output != another.output)
+        return output < another.output;
+      return target < another.target;
+    }
+
+    bool HfstMinimalAcyclicBuilder::Arc::operator==(const Arc &another) const
+    {
+      return input == another.input && output == another.output &&
+        target == another.target;
+    }
+
+    size_t HfstMinimalAcyclicBuilder::StateHash::operator()
+      (unsigned int s) const
+    {
+      const State &state = (*states)[s];
+      size_t h = state.final ? 1 : 0;
+      if (state.final)
+        {
+          // 0 and -0 are equal but have different bits
+          float weight = (state.weight == 0) ? 0 : state.weight;
+          unsigned int weight_bits;
+          memcpy(&weight_bits, &weight, sizeof(weight_bits));
+          h = h * 31 + weight_bits;
+        }
+      for (std::vector<Arc>::const_iterator it = state.arcs.begin();
+           it != state.arcs.end(); it++)
+        {
+          h = h * 31 + it->input;
+          h = h * 31 + it->output;
+          h = h * 31 + it->target;
+        }
+      return h;
+    }
+
+    bool HfstMinimalAcyclicBuilder::StateEqual::operator()
+      (unsigned int s1, unsigned int s2) const
+    {
+      const State &state1 = (*states)[s1];
+      const State &state2 = (*states)[s2];
+      if (state1.final != state2.final)
+        return false;
+      if (state1.final && state1.weight != state2.weight)
+        return false;
+      return state1.arcs == state2.arcs;
+    }
+
+    HfstMinimalAcyclicBuilder::HfstMinimalAcyclicBuilder():
+      states(), free_states(),
+      register_(0, StateHash(&states), StateEqual(&states)),
+      previous(), previous_states(), unsorted()
+    {
+      previous_states.push_back(new_state());
+    }
+
+    HfstMinimalAcyclicBuilder::NumberPairVector
+    HfstMinimalAcyclicBuilder::to_numbers(const StringPairVector &spv)
+    {
+      NumberPairVector path;
+      path.reserve(spv.size());
+      for (StringPairVector::const_iterator it = spv.begin();
+           it != spv.end(); it++)
+        {
+          path.push_back(NumberPair
+                         (HfstTropicalTransducerTransitionData::get_number
+                          (it->first),
+                          HfstTropicalTransducerTransitionData::get_number
+                          (it->second)));
+        }
+      return path;
+    }
+
+    /* Paths with the same numbers compare equal whatever their weights */
+    static bool same_path
+    (const HfstMinimalAcyclicBuilder::WeightedPath &path1,
+     const HfstMinimalAcyclicBuilder::WeightedPath &path2)
+    {
+      return path1.first == path2.first;
+    }
+
+    HfstBasicTransducer HfstMinimalAcyclicBuilder::build
+    (WeightedPathVector &paths)
+    {
+      // The lightest of equal paths comes first and is kept
+      std::sort(paths.begin(), paths.end());
+      paths.erase(std::unique(paths.begin(), paths.end(), same_path),
+                  paths.end());
+
+      HfstMinimalAcyclicBuilder builder;
+      for (WeightedPathVector::const_iterator it = paths.begin();
+           it != paths.end(); it++)
+        {
+          builder.add(it->first, it->second);
+        }
+      return builder.get_transducer();
+    }
+
+    unsigned int HfstMinimalAcyclicBuilder::new_state()
+    {
+      unsigned int s;
+      if (free_states.empty())
+        {
+          s = states.size();
+          states.push_back(State());
+        }
+      else
+        {
+          s = free_states.back();
+          free_states.pop_back();
+        }
+      states[s].arcs.clear();
+      states[s].final = false;
+      states[s].weight = 0;
+      return s;
+    }
+
+    /* Finish the states on the path of the previous entry from position
+       \a length on, replacing each by an equivalent finished state if
+       there is one. The deepest states are finished first, so that the
+       arcs of a state point to finished states when it is looked up. */
+    void HfstMinimalAcyclicBuilder::replace_or_register(size_t length)
+    {
+      for (size_t i = previous_states.size() - 1; i >= length; i--)
+        {
+          unsigned int s = previous_states[i];
+          std::sort(states[s].arcs.begin(), states[s].arcs.end());
+          std::pair<Register::iterator, bool> inserted = register_.insert(s);
+          if (! inserted.second)
+            {
+              // The arc to a state on the path is always the last one
+              // added to its parent
+              states[previous_states[i-1]].arcs.back().target
+                = *inserted.first;
+              std::vector<Arc>().swap(states[s].arcs);
+              free_states.push_back(s);
+            }
+        }
+      previous_states.resize(length);
+    }
+
+    void HfstMinimalAcyclicBuilder::add(const NumberPairVector &path,
+                                        float weight)
+    {
+      size_t prefix = 0;
+      while (prefix < path.size() && prefix < previous.size() &&
+             path[prefix] == previous[prefix])
+        {
+          prefix++;
+        }
+
+      // Any arc on the next pair of this path leads to a finished state
+      if (prefix < path.size())
+        {
+          const std::vector<Arc> &arcs = states[previous_states[prefix]].arcs;
+          for (std::vector<Arc>::const_iterator it = arcs.begin();
+               it != arcs.end(); it++)
+            {
+              if (it->input == path[prefix].first &&
+                  it->output == path[prefix].second)
+                {
+                  unsorted.push_back(WeightedPath(path, weight));
+                  return;
+                }
+            }
+        }
+
+      replace_or_register(prefix + 1);
+      for (size_t i = prefix; i < path.size(); i++)
+        {
+          unsigned int s = new_state();
+          Arc arc = { path[i].first, path[i].second, s };
+          states[previous_states.back()].arcs.push_back(arc);
+          previous_states.push_back(s);
+        }
+
+      State &last = states[previous_states.back()];
+      if (! last.final || weight < last.weight)
+        {
+          last.final = true;
+          last.weight = weight;
+        }
+      previous = path;
+    }
+
+    void HfstMinimalAcyclicBuilder::add(const StringPairVector &spv,
+                                        float weight)
+    {
+      add(to_numbers(spv), weight);
+    }
+
+    size_t HfstMinimalAcyclicBuilder::get_state_count() const
+    {
+      return states.size() - free_states.size();
+    }
+
+    size_t HfstMinimalAcyclicBuilder::get_unsorted_count() const
+    {
+      return unsorted.size();
+    }
+
+    /* Add the paths of this automaton and the unsorted paths to \a merged
+       in sorted order. The paths of this automaton come in sorted order
+       when its arcs are followed depth first in sorted order. */
+    void HfstMinimalAcyclicBuilder::merge_into
+    (HfstMinimalAcyclicBuilder &merged)
+    {
+      std::sort(unsorted.begin(), unsorted.end());
+      std::vector<WeightedPath>::const_iterator next = unsorted.begin();
+
+      NumberPairVector path;
+      // the states on the path and the index of the next arc to follow
+      std::vector<std::pair<unsigned int, size_t> > agenda;
+      agenda.push_back(std::pair<unsigned int, size_t>(0, 0));
+      if (states[0].final)
+        {
+          for ( ; next != unsorted.end() && next->first < path; next++)
+            merged.add(next->first, next->second);
+          merged.add(path, states[0].weight);
+        }
+      while (! agenda.empty())
+        {
+          unsigned int s = agenda.back().first;
+          size_t i = agenda.back().second++;
+          if (i == states[s].arcs.size())
+            {
+              agenda.pop_back();
+              if (! path.empty())
+                path.pop_back();
+              continue;
+            }
+          const Arc &arc = states[s].arcs[i];
+          path.push_back(NumberPair(arc.input, arc.output));
+          agenda.push_back(std::pair<unsigned int, size_t>(arc.target, 0));
+          if (states[arc.target].final)
+            {
+              for ( ; next != unsorted.end() && next->first < path; next++)
+                merged.add(next->first, next->second);
+              merged.add(path, states[arc.target].weight);
+            }
+        }
+      for ( ; next != unsorted.end(); next++)
+        merged.add(next->first, next->second);
+    }
+
+    /* Finish all states but the initial one, and merge in the unsorted
+       paths. */
+    void HfstMinimalAcyclicBuilder::finish()
+    {
+      replace_or_register(1);
+      std::sort(states[0].arcs.begin(), states[0].arcs.end());
+      previous.clear();
+      if (unsorted.empty())
+        {
+          return;
+        }
+
+      HfstMinimalAcyclicBuilder merged;
+      merge_into(merged);
+      merged.finish();
+      unsorted.clear();
+      states.swap(merged.states);
+      free_states.swap(merged.free_states);
+      // The register hashes states through this builder's state vector,
+      // so it is filled again rather than swapped
+      register_.clear();
+      register_.insert(merged.register_.begin(), merged.register_.end());
+    }
+
+    HfstBasicTransducer HfstMinimalAcyclicBuilder::get_transducer()
+    {
+      finish();
+
+      // Number the states in the order they are reached, so that the
+      // initial state is zero and the states of merged paths are skipped
+      const unsigned int no_number = (unsigned int)-1;
+      std::vector<unsigned int> numbers(states.size(), no_number);
+      std::vector<unsigned int> agenda(1, 0);
+      numbers[0] = 0;
+      for (size_t i = 0; i < agenda.size(); i++)
+        {
+          const std::vector<Arc> &arcs = states[agenda[i]].arcs;
+          for (std::vector<Arc>::const_iterator it = arcs.begin();
+               it != arcs.end(); it++)
+            {
+              if (numbers[it->target] == no_number)
+                {
+                  numbers[it->target] = agenda.size();
+                  agenda.push_back(it->target);
+                }
+            }
+        }
+
+      HfstBasicTransducer result;
+      result.add_state(agenda.size() - 1);
+      std::vector<bool> symbols_used;
+      for (size_t i = 0; i < agenda.size(); i++)
+        {
+          const State &state = states[agenda[i]];
+          if (state.final)
+            {
+              result.set_final_weight(i, state.weight);
+            }
+          for (std::vector<Arc>::const_iterator it = state.arcs.begin();
+               it != state.arcs.end(); it++)
+            {
+              result.add_transition
+                (i, HfstBasicTransition(numbers[it->target], it->input,
+                                        it->output, 0, true), false);
+              unsigned int max_number = std::max(it->input, it->output);
+              if (symbols_used.size() <= max_number)
+                symbols_used.resize(max_number + 1, false);
+              symbols_used[it->input] = true;
+              symbols_used[it->output] = true;
+            }
+        }
+      for (unsigned int n = 0; n < symbols_used.size(); n++)
+        {
+          if (symbols_used[n])
+            {
+              result.add_symbol_to_alphabet
+                (HfstTropicalTransducerTransitionData::get_symbol(n));
+            }
+        }
+      return result;
+    }
+
+  }
+
+}
+
+#else // MAIN_TEST was defined
+
+#include <cassert>
+#include <cstdlib>
+#include <iostream>
+#include "../HfstTransducer.h"
+#include "../HfstTokenizer.h"
+
+using namespace hfst;
+using namespace hfst::implementations;
+
+int main(int argc, char * argv[])
+{
+  std::cout << "Unit tests for " __FILE__ ":" << std::endl;
+
+  HfstTokenizer TOK;
+  const char * words[] =
+    { "cat", "cats", "dog", "dogs", "do", "category", "cat", "" };
+  const float weights[] = { 0.5, 0.5, 0.5, 0.5, 1, 2, 0.25, 3 };
+  const size_t word_count = sizeof(words) / sizeof(words[0]);
+
+  // The same paths in the given order and sorted
+  HfstBasicTransducer trie;
+  HfstMinimalAcyclicBuilder unsorted_builder;
+  std::vector<std::pair<StringPairVector, float> > sorted_paths;
+  for (size_t i = 0; i < word_count; i++)
+    {
+      StringPairVector spv = TOK.tokenize(words[i]);
+      trie.disjunct(spv, weights[i]);
+      unsorted_builder.add(spv, weights[i]);
+      sorted_paths.push_back(std::make_pair(spv, weights[i]));
+    }
+  std::sort(sorted_paths.begin(), sorted_paths.end());
+  HfstMinimalAcyclicBuilder sorted_builder;
+  for (size_t i = 0; i < sorted_paths.size(); i++)
+    {
+      sorted_builder.add(sorted_paths[i].first, sorted_paths[i].second);
+    }
+  assert(sorted_builder.get_unsorted_count() == 0);
+  assert(unsorted_builder.get_unsorted_count() > 0);
+
+  HfstBasicTransducer sorted_result = sorted_builder.get_transducer();
+  HfstBasicTransducer unsorted_result = unsorted_builder.get_transducer();
+  assert(unsorted_builder.get_unsorted_count() == 0);
+  assert(unsorted_builder.get_state_count() == 13);
+
+  // "cat" and "dog" share their final states, "do" and "category" do not
+  assert(sorted_result.get_max_state() == 12);
+  assert(unsorted_result.get_max_state() == 12);
+
+  HfstTransducer expected(trie, TROPICAL_OPENFST_TYPE);
+  HfstTransducer sorted_fst(sorted_result, TROPICAL_OPENFST_TYPE);
+  HfstTransducer unsorted_fst(unsorted_result, TROPICAL_OPENFST_TYPE);
+  assert(expected.compare(sorted_fst, false));
+  assert(expected.compare(unsorted_fst, false));
+
+  // Paths can still be added after the transducer has been built
+  trie.disjunct(TOK.tokenize("cow"), 0.5);
+  trie.disjunct(TOK.tokenize("ca"), 1);
+  unsorted_builder.add(TOK.tokenize("cow"), 0.5);
+  unsorted_builder.add(TOK.tokenize("ca"), 1);
+  HfstTransducer expected_more(trie, TROPICAL_OPENFST_TYPE);
+  HfstTransducer more_fst(unsorted_builder.get_transducer(),
+                          TROPICAL_OPENFST_TYPE);
+  assert(expected_more.compare(more_fst, false));
+
+  // All paths at once, in any order and with duplicates
+  HfstMinimalAcyclicBuilder::WeightedPathVector paths;
+  for (size_t i = 0; i < word_count; i++)
+    {
+      paths.push_back(HfstMinimalAcyclicBuilder::WeightedPath
+                      (HfstMinimalAcyclicBuilder::to_numbers
+                       (TOK.tokenize(words[i])), weights[i]));
+    }
+  HfstBasicTransducer built = HfstMinimalAcyclicBuilder::build(paths);
+  assert(paths.size() == word_count - 1);
+  assert(built.get_max_state() == 12);
+  HfstTransducer built_fst(built, TROPICAL_OPENFST_TYPE);
+  assert(expected.compare(built_fst, false));
+
+  // Two-level paths with symbols that are new to the alphabet
+  HfstMinimalAcyclicBuilder pair_builder;
+  pair_builder.add(TOK.tokenize("walk+V", "walk"), 0);
+  pair_builder.add(TOK.tokenize("talk+V", "talk"), 0);
+  HfstBasicTransducer pair_result = pair_builder.get_transducer();
+  assert(pair_result.get_alphabet().count("+") == 1);
+  assert(pair_result.get_max_state() == 6);
+
+  std::cout << "ok" << std::endl;
+  return EXIT_SUCCESS;
+}
+
+#endif // MAIN_TEST
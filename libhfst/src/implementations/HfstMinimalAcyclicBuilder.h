@@ -0,0 +1,159 @@
+//       This program is free software: you can redistribute it and/or modify
+//       it under the terms of the GNU General Public License as published by
+//       the Free Software Foundation, version 3 of the License.
+//
+//       This program is distributed in the hope that it will be useful,
+//       but WITHOUT ANY WARRANTY; without even the implied warranty of
+//       MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//       GNU General Public License for more details.
+//
+//       You should have received a copy of the GNU General Public License
+//       along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+#ifndef _HFST_MINIMAL_ACYCLIC_BUILDER_H_
+#define _HFST_MINIMAL_ACYCLIC_BUILDER_H_
+
+#include <unordered_set>
+#include <utility>
+#include <vector>
+
+#include "../HfstDataTypes.h"
+#include "../hfstdll.h"
+
+namespace hfst {
+
+  namespace implementations {
+
+    /** @brief A builder of minimal acyclic transducers from a list of
+        paths.
+
+        Paths are added one at a time and the automaton is kept minimal as
+        it grows, so building a large lexicon never needs the memory of
+        the full trie. The paths are best added in sorted order, or at
+        least so that paths with a common prefix follow each other. A path
+        that would have to change a part of the automaton that is already
+        finished is kept aside in number form, and the kept paths are
+        merged in when the transducer is asked for.
+
+        Weights are kept in final states. If the same path is added more
+        than once, the smallest weight remains, as in
+        HfstTransitionGraph::disjunct(const StringPairVector&, float).
+
+        An example:
+\verbatim
+        HfstMinimalAcyclicBuilder builder;
+        HfstTokenizer TOK;
+        builder.add(TOK.tokenize("cat"), 0.5);
+        builder.add(TOK.tokenize("cats"), 0.6);
+        builder.add(TOK.tokenize("dog"), 0.5);
+        builder.add(TOK.tokenize("dogs"), 0.6);
+        HfstBasicTransducer lexicon = builder.get_transducer();
+\endverbatim
+
+        \internal This is the algorithm for sorted data of Daciuk et al.
+        (2000), "Incremental construction of minimal acyclic finite-state
+        automata". The states on the path of the previous entry are the
+        only ones that can still change; the others are in a register
+        where equivalent states are found by hashing. */
+    class HfstMinimalAcyclicBuilder
+    {
+    public:
+      /** @brief An input and an output symbol number. */
+      typedef std::pair<unsigned int, unsigned int> NumberPair;
+      /** @brief A path as symbol numbers. */
+      typedef std::vector<NumberPair> NumberPairVector;
+      /** @brief A path as symbol numbers and its weight. */
+      typedef std::pair<NumberPairVector, float> WeightedPath;
+      /** @brief A list of weighted paths. */
+      typedef std::vector<WeightedPath> WeightedPathVector;
+
+      HFSTDLL HfstMinimalAcyclicBuilder();
+
+      /** @brief The symbol numbers of the path \a spv, in the numbering
+          of HfstBasicTransducer. */
+      HFSTDLL static NumberPairVector to_numbers(const StringPairVector &spv);
+
+      /** @brief The minimal transducer of the paths \a paths.
+
+          The paths are sorted and duplicates removed in place first, so
+          the automaton is built in one pass. Of equal paths, the one with
+          the smallest weight remains. */
+      HFSTDLL static HfstBasicTransducer build(WeightedPathVector &paths);
+
+      /** @brief Add the path \a path with weight \a weight. */
+      HFSTDLL void add(const NumberPairVector &path, float weight);
+
+      /** @brief Add the path \a spv with weight \a weight. */
+      HFSTDLL void add(const StringPairVector &spv, float weight);
+
+      /** @brief The number of states that are in use, including those of
+          the path of the previous entry. */
+      HFSTDLL size_t get_state_count() const;
+
+      /** @brief The number of paths that came out of order and will be
+          merged in by get_transducer. */
+      HFSTDLL size_t get_unsorted_count() const;
+
+      /** @brief The minimal transducer of all paths added so far.
+
+          More paths can be added afterwards, but they are likely to come
+          out of order. */
+      HFSTDLL HfstBasicTransducer get_transducer();
+
+    protected:
+      struct Arc
+      {
+        unsigned int input;
+        unsigned int output;
+        unsigned int target;
+        bool operator<(const Arc &another) const;
+        bool operator==(const Arc &another) const;
+      };
+
+      struct State
+      {
+        std::vector<Arc> arcs;
+        bool final;
+        float weight;
+      };
+
+      /* Hashing and equality of states through their numbers, so that the
+         register can hold numbers into the state vector */
+      struct StateHash
+      {
+        const std::vector<State> * states;
+        StateHash(const std::vector<State> * s): states(s) {}
+        size_t operator()(unsigned int s) const;
+      };
+      struct StateEqual
+      {
+        const std::vector<State> * states;
+        StateEqual(const std::vector<State> * s): states(s) {}
+        bool operator()(unsigned int s1, unsigned int s2) const;
+      };
+      typedef std::unordered_set<unsigned int, StateHash, StateEqual>
+        Register;
+
+      std::vector<State> states;
+      std::vector<unsigned int> free_states;
+      Register register_;
+      // the previous entry and the states on its path
+      NumberPairVector previous;
+      std::vector<unsigned int> previous_states;
+      std::vector<WeightedPath> unsorted;
+
+      unsigned int new_state();
+      void replace_or_register(size_t length);
+      void finish();
+      void merge_into(HfstMinimalAcyclicBuilder &merged);
+
+    private:
+      HfstMinimalAcyclicBuilder(const HfstMinimalAcyclicBuilder &);
+      HfstMinimalAcyclicBuilder &operator=(const HfstMinimalAcyclicBuilder &);
+    };
+
+  } // namespace implementations
+
+} // namespace hfst
+
+#endif // _HFST_MINIMAL_ACYCLIC_BUILDER_H_
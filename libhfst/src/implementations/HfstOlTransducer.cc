@@ -17,13 +17,13 @@
 namespace hfst { namespace implementations
 {
   HfstOlInputStream::HfstOlInputStream(bool weighted):
-    i_stream(),input_stream(std::cin), weighted(weighted)
+    i_stream(),input_stream(std::cin), weighted(weighted), mmap_tables(false)
   {}
   HfstOlInputStream::HfstOlInputStream
   (const std::string &filename, bool weighted):
     filename(std::string(filename)),
     i_stream(filename.c_str(), std::ios::in | std::ios::binary),
-    input_stream(i_stream),weighted(weighted)
+    input_stream(i_stream),weighted(weighted), mmap_tables(false)
   {}
   
   /* Skip the identifier string "HFST_OL_TYPE" or "HFST_OLW_TYPE" */
@@ -145,6 +145,11 @@ void HfstOlInputStream::ignore(unsigned int n)
     input_stream.ignore(n);
 }
 
+void HfstOlInputStream::set_mmap_tables(bool value)
+{
+    mmap_tables = value;
+}
+
   bool HfstOlInputStream::operator() (void) const
   { return is_good(); }
 
@@ -158,7 +163,12 @@ void HfstOlInputStream::ignore(unsigned int n)
       if (has_header)
         skip_hfst_header();
 
-      hfst_ol::Transducer* t = new hfst_ol::Transducer(input_stream);
+      hfst_ol::Transducer* t;
+      // Standard input can't be mapped
+      if (mmap_tables && filename != string())
+        t = new hfst_ol::Transducer(input_stream, filename);
+      else
+        t = new hfst_ol::Transducer(input_stream);
       //t->display();
       return t;
     }
@@ -40,6 +40,7 @@ namespace hfst { namespace implementations
     ifstream i_stream;
     istream &input_stream;
     bool weighted;
+    bool mmap_tables;
     void skip_identifier_version_3_0(void);
     void skip_hfst_header(void);
   public:
@@ -57,6 +58,9 @@ namespace hfst { namespace implementations
     short stream_get_short();
     void stream_unget(char c);
     void ignore(unsigned int n);
+    /* Whether the transition tables of the transducers read from a file
+       are mapped into memory instead of copied. */
+    void set_mmap_tables(bool value);
     
     bool operator() (void) const;
     hfst_ol::Transducer * read_transducer(bool has_header);
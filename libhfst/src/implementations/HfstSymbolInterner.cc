@@ -0,0 +1,224 @@
+//       This program is free software: you can redistribute it and/or modify
+//       it under the terms of the GNU General Public License as published by
+//       the Free Software Foundation, version 3 of the License.
+//
+//       This program is distributed in the hope that it will be useful,
+//       but WITHOUT ANY WARRANTY; without even the implied warranty of
+//       MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//       GNU General Public License for more details.
+//
+//       You should have received a copy of the GNU General Public License
+//       along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+#include "HfstSymbolInterner.h"
+
+#include <functional>
+
+#ifndef MAIN_TEST
+
+namespace hfst {
+
+  namespace implementations {
+
+    HfstSymbolInterner::HfstSymbolInterner
+    (const std::vector<std::string> & initial_symbols):
+      symbol_count(0), table(new_table(256)), retired_tables()
+    {
+      for (unsigned int k = 0; k < SEGMENT_COUNT; k++)
+        {
+          segments[k].store(NULL);
+        }
+      for (std::vector<std::string>::const_iterator it
+             = initial_symbols.begin(); it != initial_symbols.end(); it++)
+        {
+          get_number(*it);
+        }
+    }
+
+    HfstSymbolInterner::~HfstSymbolInterner()
+    {
+      for (unsigned int k = 0; k < SEGMENT_COUNT; k++)
+        {
+          delete[] segments[k].load();
+        }
+      retired_tables.push_back(table.load());
+      for (std::vector<HashTable *>::iterator it = retired_tables.begin();
+           it != retired_tables.end(); it++)
+        {
+          delete[] (*it)->slots;
+          delete *it;
+        }
+    }
+
+    size_t HfstSymbolInterner::hash(const std::string & symbol)
+    {
+      return std::hash<std::string>()(symbol);
+    }
+
+    HfstSymbolInterner::HashTable * HfstSymbolInterner::new_table
+    (size_t capacity)
+    {
+      HashTable * t = new HashTable();
+      t->capacity = capacity;
+      t->slots = new std::atomic<unsigned int>[capacity];
+      for (size_t i = 0; i < capacity; i++)
+        {
+          t->slots[i].store(0, std::memory_order_relaxed);
+        }
+      return t;
+    }
+
+    bool HfstSymbolInterner::find_in
+    (const HashTable * t, const std::string & symbol, size_t h,
+     unsigned int & number) const
+    {
+      size_t mask = t->capacity - 1;
+      // The table is never more than half full, so there is always an
+      // empty slot to stop at
+      for (size_t i = h & mask; ; i = (i + 1) & mask)
+        {
+          unsigned int slot = t->slots[i].load(std::memory_order_acquire);
+          if (slot == 0)
+            {
+              return false;
+            }
+          if (get_symbol(slot - 1) == symbol)
+            {
+              number = slot - 1;
+              return true;
+            }
+        }
+    }
+
+    void HfstSymbolInterner::insert_into
+    (HashTable * t, size_t h, unsigned int number)
+    {
+      size_t mask = t->capacity - 1;
+      size_t i = h & mask;
+      while (t->slots[i].load(std::memory_order_relaxed) != 0)
+        {
+          i = (i + 1) & mask;
+        }
+      t->slots[i].store(number + 1, std::memory_order_release);
+    }
+
+    bool HfstSymbolInterner::find_number
+    (const std::string & symbol, unsigned int & number) const
+    {
+      return find_in(table.load(std::memory_order_acquire), symbol,
+                     hash(symbol), number);
+    }
+
+    unsigned int HfstSymbolInterner::get_number(const std::string & symbol)
+    {
+      size_t h = hash(symbol);
+      unsigned int number;
+      if (find_in(table.load(std::memory_order_acquire), symbol, h, number))
+        {
+          return number;
+        }
+
+      std::lock_guard<std::mutex> lock(insert_mutex);
+      // Another thread may have added the symbol meanwhile
+      HashTable * t = table.load(std::memory_order_relaxed);
+      if (find_in(t, symbol, h, number))
+        {
+          return number;
+        }
+
+      number = symbol_count.load(std::memory_order_relaxed);
+      unsigned int segment;
+      unsigned int offset;
+      locate(number, segment, offset);
+      std::string * symbols =
+        segments[segment].load(std::memory_order_relaxed);
+      if (symbols == NULL)
+        {
+          symbols = new std::string[FIRST_SEGMENT_SIZE << segment];
+          segments[segment].store(symbols, std::memory_order_release);
+        }
+      symbols[offset] = symbol;
+      symbol_count.store(number + 1, std::memory_order_release);
+
+      if (2 * ((size_t)number + 1) > t->capacity)
+        {
+          HashTable * bigger = new_table(2 * t->capacity);
+          for (unsigned int n = 0; n < number; n++)
+            {
+              insert_into(bigger, hash(get_symbol(n)), n);
+            }
+          retired_tables.push_back(t);
+          table.store(bigger, std::memory_order_release);
+          t = bigger;
+        }
+      insert_into(t, h, number);
+      return number;
+    }
+
+  }
+
+}
+
+#else // MAIN_TEST was defined
+
+#include <cassert>
+#include <cstdlib>
+#include <iostream>
+#include <sstream>
+#include <thread>
+
+int main(int argc, char * argv[])
+{
+  using namespace hfst::implementations;
+  std::cout << "Unit tests for " __FILE__ ":" << std::endl;
+
+  std::vector<std::string> initial;
+  initial.push_back("@_EPSILON_SYMBOL_@");
+  initial.push_back("@_UNKNOWN_SYMBOL_@");
+  HfstSymbolInterner interner(initial);
+  assert(interner.size() == 2);
+  assert(interner.get_number("@_UNKNOWN_SYMBOL_@") == 1);
+  assert(interner.get_number("a") == 2);
+  assert(interner.get_symbol(2) == "a");
+  unsigned int number = 0;
+  assert(!interner.find_number("b", number));
+  assert(interner.find_number("a", number) && number == 2);
+
+  // Threads that add overlapping sets of symbols must agree on the numbers
+  const unsigned int threads = 4;
+  const unsigned int symbols_per_thread = 5000;
+  std::vector<std::vector<unsigned int> > numbers(threads);
+  std::vector<std::thread> workers;
+  for (unsigned int t = 0; t < threads; t++)
+    {
+      workers.push_back(std::thread([&interner, &numbers, t] {
+            for (unsigned int i = 0; i < symbols_per_thread; i++)
+              {
+                std::ostringstream oss;
+                oss << "sym" << (i + t * symbols_per_thread / 2);
+                numbers[t].push_back(interner.get_number(oss.str()));
+              }
+          }));
+    }
+  for (unsigned int t = 0; t < threads; t++)
+    {
+      workers[t].join();
+    }
+  assert(interner.size() ==
+         3 + symbols_per_thread + (threads - 1) * symbols_per_thread / 2);
+  for (unsigned int t = 0; t < threads; t++)
+    {
+      for (unsigned int i = 0; i < symbols_per_thread; i++)
+        {
+          std::ostringstream oss;
+          oss << "sym" << (i + t * symbols_per_thread / 2);
+          assert(interner.get_symbol(numbers[t][i]) == oss.str());
+          assert(interner.get_number(oss.str()) == numbers[t][i]);
+        }
+    }
+
+  std::cout << "ok" << std::endl;
+  return EXIT_SUCCESS;
+}
+
+#endif // MAIN_TEST
@@ -0,0 +1,125 @@
+//       This program is free software: you can redistribute it and/or modify
+//       it under the terms of the GNU General Public License as published by
+//       the Free Software Foundation, version 3 of the License.
+//
+//       This program is distributed in the hope that it will be useful,
+//       but WITHOUT ANY WARRANTY; without even the implied warranty of
+//       MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//       GNU General Public License for more details.
+//
+//       You should have received a copy of the GNU General Public License
+//       along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+#ifndef _HFST_SYMBOL_INTERNER_H_
+#define _HFST_SYMBOL_INTERNER_H_
+
+#include <atomic>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "../hfstdll.h"
+
+namespace hfst {
+
+  namespace implementations {
+
+    /** @brief A thread-safe mapping between symbol strings and numbers.
+
+        Numbers are given out in the order the symbols are first seen,
+        starting from zero, and a symbol keeps its number for the lifetime
+        of the interner. Looking up a symbol that already has a number, or
+        the symbol of a number, takes no locks; only adding a new symbol
+        does. The strings never move once added, so references returned by
+        get_symbol stay valid as long as the interner.
+
+        \internal Symbols are kept in segments of doubling size that are
+        never reallocated, and numbers are found by a linear probing hash
+        table whose slots hold number + 1. A full table is replaced by a
+        bigger one under the lock; readers that still hold the old one see
+        every symbol that was in it, and fall back to the lock if the
+        symbol is not found. Retired tables are freed with the interner. */
+    class HfstSymbolInterner
+    {
+    public:
+      /** @brief Create an interner where the symbols of \a initial_symbols
+          have the numbers of their positions. */
+      HFSTDLL HfstSymbolInterner(const std::vector<std::string> &
+                                 initial_symbols);
+      HFSTDLL ~HfstSymbolInterner();
+
+      /** @brief The number of \a symbol, given a new number if it has
+          none yet. */
+      HFSTDLL unsigned int get_number(const std::string & symbol);
+
+      /** @brief Whether \a symbol has a number. If it has, the number is
+          stored in \a number. */
+      HFSTDLL bool find_number(const std::string & symbol,
+                               unsigned int & number) const;
+
+      /** @brief The symbol of \a number.
+
+          @pre \a number is less than size(). */
+      const std::string & get_symbol(unsigned int number) const
+      {
+        unsigned int segment;
+        unsigned int offset;
+        locate(number, segment, offset);
+        return segments[segment].load(std::memory_order_acquire)[offset];
+      }
+
+      /** @brief The number of symbols. */
+      unsigned int size() const
+      {
+        return symbol_count.load(std::memory_order_acquire);
+      }
+
+    protected:
+      struct HashTable
+      {
+        size_t capacity;
+        std::atomic<unsigned int> * slots;
+      };
+
+      // Segment k holds FIRST_SEGMENT_SIZE << k symbols, so 32 segments
+      // are enough for any unsigned int
+      static const unsigned int FIRST_SEGMENT_SIZE = 64;
+      static const unsigned int SEGMENT_COUNT = 32;
+
+      std::atomic<std::string *> segments[SEGMENT_COUNT];
+      std::atomic<unsigned int> symbol_count;
+      std::atomic<HashTable *> table;
+      std::vector<HashTable *> retired_tables;
+      std::mutex insert_mutex;
+
+      static void locate(unsigned int number, unsigned int & segment,
+                         unsigned int & offset)
+      {
+        // Segment k starts at FIRST_SEGMENT_SIZE * (2^k - 1)
+        unsigned int q = number / FIRST_SEGMENT_SIZE + 1;
+#if defined(__GNUC__)
+        segment = 31 - __builtin_clz(q);
+#else
+        segment = 0;
+        while (q >>= 1)
+          { ++segment; }
+#endif
+        offset = number - FIRST_SEGMENT_SIZE * ((1u << segment) - 1);
+      }
+
+      static size_t hash(const std::string & symbol);
+      bool find_in(const HashTable * t, const std::string & symbol,
+                   size_t h, unsigned int & number) const;
+      void insert_into(HashTable * t, size_t h, unsigned int number);
+      HashTable * new_table(size_t capacity);
+
+    private:
+      HfstSymbolInterner(const HfstSymbolInterner &);
+      HfstSymbolInterner & operator=(const HfstSymbolInterner &);
+    };
+
+  } // namespace implementations
+
+} // namespace hfst
+
+#endif // _HFST_SYMBOL_INTERNER_H_
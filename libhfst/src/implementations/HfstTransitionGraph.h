@@ -21,6 +21,7 @@
  #include "ConvertTransducerFormat.h"
  #include "HfstTransition.h"
  #include "HfstTropicalTransducerTransitionData.h"
+ #include "HfstAttReader.h"
 //#include "HfstFastTransitionData.h"
 
  #include "../hfstdll.h"
@@ -797,6 +798,21 @@
            return;
          }
 
+         /* Get the symbol numbered \a number as it is written in AT&T
+            format. Each symbol is escaped once and kept in \a cache. */
+         static const std::string &get_att_symbol
+           (unsigned int number, std::vector<std::string> &cache)
+         {
+           if (number >= cache.size())
+             cache.resize(number + 1);
+           std::string &symbol = cache[number];
+           if (symbol.empty()) {
+             symbol = C::get_symbol(number);
+             HfstAttReader::escape_symbol(symbol);
+           }
+           return symbol;
+         }
+
          static void xfstize(std::string & symbol)
          {
            std::string escaped_symbol;
@@ -1553,6 +1569,7 @@
              \a write_weights defines whether weights are printed. */
          HFSTDLL void write_in_att_format(std::ostream &os, bool write_weights=true) 
          {
+           std::vector<std::string> symbols;
            unsigned int source_state=0;
            for (iterator it = begin(); it != end(); it++)
              {
@@ -1560,35 +1577,26 @@
                       = it->begin();
                     tr_it != it->end(); tr_it++)
                  {
-                   C data = tr_it->get_transition_data();
-
-                   std::string isymbol = data.get_input_symbol();
-                   replace_all(isymbol, " ", "@_SPACE_@");
-                   replace_all(isymbol, "@_EPSILON_SYMBOL_@", "@0@");
-                   replace_all(isymbol, "\t", "@_TAB_@");
-
-                   std::string osymbol = data.get_output_symbol();
-                   replace_all(osymbol, " ", "@_SPACE_@");
-                   replace_all(osymbol, "@_EPSILON_SYMBOL_@", "@0@");
-                   replace_all(osymbol, "\t", "@_TAB_@");
-
                    os <<  source_state << "\t" 
                       <<  tr_it->get_target_state() << "\t"
-                      <<  isymbol << "\t"
-                      <<  osymbol;
+                      <<  get_att_symbol(tr_it->get_input_number(), symbols)
+                      << "\t"
+                      <<  get_att_symbol(tr_it->get_output_number(), symbols);
 
                    if (write_weights) {
                      os <<  "\t";
-                     write_weight(os, data.get_weight());
+                     write_weight(os, tr_it->get_weight());
                    }
                    os << "\n";
                  }
-               if (is_final_state(source_state))
+               typename FinalWeightMap::const_iterator final_it
+                 = final_weight_map.find(source_state);
+               if (final_it != final_weight_map.end())
                  {
                    os <<  source_state;
                    if (write_weights) {
                      os << "\t";
-                     write_weight(os, get_final_weight(source_state));
+                     write_weight(os, final_it->second);
                    }
                    os << "\n";
                  }
@@ -1600,52 +1608,54 @@
              \a write_weights defines whether weights are printed. */
          HFSTDLL void write_in_att_format(FILE *file, bool write_weights=true) 
          {
+           std::vector<std::string> symbols;
+           // the lines of one state, written at once
+           std::string lines;
+           char buffer [128];
            unsigned int source_state=0;
            for (iterator it = begin(); it != end(); it++)
              {
+               lines.clear();
                for (typename HfstTransitions::iterator tr_it
                       = it->begin();
                     tr_it != it->end(); tr_it++)
                  {
-                   C data = tr_it->get_transition_data();
-
-                   std::string isymbol = data.get_input_symbol();
-                   replace_all(isymbol, " ", "@_SPACE_@");
-                   replace_all(isymbol, "@_EPSILON_SYMBOL_@", "@0@");
-                   replace_all(isymbol, "\t", "@_TAB_@");
-
-                   std::string osymbol = data.get_output_symbol();
-                   replace_all(osymbol, " ", "@_SPACE_@");
-                   replace_all(osymbol, "@_EPSILON_SYMBOL_@", "@0@");
-                   replace_all(osymbol, "\t", "@_TAB_@");
-
-                   fprintf(file, "%i\t%i\t%s\t%s",
+                   sprintf(buffer, "%i\t%i\t",
                            source_state,
-                           tr_it->get_target_state(),
-                           isymbol.c_str(),
-                           osymbol.c_str());
+                           tr_it->get_target_state());
+                   lines.append(buffer);
+                   lines.append
+                     (get_att_symbol(tr_it->get_input_number(), symbols));
+                   lines.push_back('\t');
+                   lines.append
+                     (get_att_symbol(tr_it->get_output_number(), symbols));
 
                    if (write_weights) {
-                     fprintf(file, "\t");
-                     write_weight(file, data.get_weight());
+                     sprintf(buffer, "\t%f", tr_it->get_weight());
+                     lines.append(buffer);
                    } 
-                   fprintf(file, "\n");
+                   lines.push_back('\n');
                  }
-               if (is_final_state(source_state))
+               typename FinalWeightMap::const_iterator final_it
+                 = final_weight_map.find(source_state);
+               if (final_it != final_weight_map.end())
                  {
-                   fprintf(file, "%i", source_state);
+                   sprintf(buffer, "%i", source_state);
+                   lines.append(buffer);
                    if (write_weights) {
-                     fprintf(file, "\t"); 
-                     write_weight(file, get_final_weight(source_state));
+                     sprintf(buffer, "\t%f", final_it->second);
+                     lines.append(buffer);
                    }
-                   fprintf(file, "\n");
+                   lines.push_back('\n');
                  }
+               fwrite(lines.data(), 1, lines.size(), file);
            source_state++;
              }          
          }
 
          HFSTDLL void write_in_att_format(char * ptr, bool write_weights=true) 
          {
+       std::vector<std::string> symbols;
        unsigned int source_state=0;
        size_t cwt = 0; // characters written in total
        size_t cw = 0; // characters written in latest call to sprintf
@@ -1657,15 +1667,10 @@
                  {
                    C data = tr_it->get_transition_data();
 
-                   std::string isymbol = data.get_input_symbol();
-                   replace_all(isymbol, " ", "@_SPACE_@");
-                   replace_all(isymbol, "@_EPSILON_SYMBOL_@", "@0@");
-                   replace_all(isymbol, "\t", "@_TAB_@");
-
-                   std::string osymbol = data.get_output_symbol();
-                   replace_all(osymbol, " ", "@_SPACE_@");
-                   replace_all(osymbol, "@_EPSILON_SYMBOL_@", "@0@");
-                   replace_all(osymbol, "\t", "@_TAB_@");
+                   const std::string &isymbol
+                     = get_att_symbol(data.get_input_number(), symbols);
+                   const std::string &osymbol
+                     = get_att_symbol(data.get_output_number(), symbols);
 
                    cw = sprintf(ptr + cwt, "%i\t%i\t%s\t%s",
                                 source_state,
@@ -1752,101 +1757,32 @@
             std::string epsilon_symbol,
             unsigned int & linecount) {
 
-           if (file == NULL) {
-             if (is.eof()) {
-               HFST_THROW(EndOfStreamException);
-             }
-           }
-           else {
-             if (feof(file)) {
-               HFST_THROW(EndOfStreamException);
-             }
-           }
-
+           HfstAttReader reader(is, file, epsilon_symbol, linecount);
            HfstTransitionGraph retval;
-           char line [255];
-           while(true) {
+           // the numbers of the symbols of the reader in this graph
+           std::vector<unsigned int> symbol_numbers;
 
-             if (file == NULL) { /* we use streams */
-               if (! is.getline(line,255).eof())
-                 break;
-             }
-             else { /* we use FILEs */            
-               if (NULL == fgets(line, 255, file))
-                 break;
-             }
+           while (reader.read_line()) {
 
-             linecount++;
-
-             // an empty line signifying an empty transducer,
-             // a special case that is accepted if it is the only
-             // transducer in the stream
-             if ( // empty line with or without a newline  
-                 (line[0] == '\0') ||
-                 (line[0] == '\n' && line[1] == '\0') ||
-                 // windows newline
-                 (line[0] == '\r' && line[1] == '\n' && line[2] == '\0')
-                  ) {
-
-               // make sure that the end-of-file is reached
-               if (file == NULL)
-                 is.get();
-               else
-                 fgetc(file);
-               break;
+             if (reader.is_final_line()) {
+               retval.set_final_weight
+                 (reader.get_state(), reader.get_weight());
+               continue;
              }
 
-             if (*line == '-') // transducer separator line is "--"
-               return retval;
-
-             // scan one line that can have a maximum of five fields
-             char a1 [100]; char a2 [100]; char a3 [100]; 
-             char a4 [100]; char a5 [100];
-             // how many fields could be parsed
-             int n = sscanf(line, "%s%s%s%s%s", a1, a2, a3, a4, a5);
-
-             // set value of weight
-             float weight = 0;
-             if (n == 2) // a final state line with weight
-               weight = atof(a2);
-             if (n == 5) // a transition line with weight
-               weight = atof(a5);
-
-             if (n == 1 || n == 2)  // a final state line
-               retval.set_final_weight( atoi(a1), weight );
-
-             else if (n == 4 || n == 5) { // a transition line
-               std::string input_symbol=std::string(a3);
-               std::string output_symbol=std::string(a4);
-
-               // replace "@_SPACE_@"s with " " and "@0@"s with 
-               // "@_EPSILON_SYMBOL_@" 
-               replace_all(input_symbol, "@_SPACE_@", " ");
-               replace_all(input_symbol, "@0@", "@_EPSILON_SYMBOL_@");
-               replace_all(input_symbol, "@_TAB_@", "\t");
-               replace_all(input_symbol, "@_COLON_@", ":");
-
-               replace_all(output_symbol, "@_SPACE_@", " ");
-               replace_all(output_symbol, "@0@", "@_EPSILON_SYMBOL_@");
-               replace_all(output_symbol, "@_TAB_@", "\t");
-               replace_all(output_symbol, "@_COLON_@", ":");
-
-               if (epsilon_symbol.compare(input_symbol) == 0)
-                 input_symbol="@_EPSILON_SYMBOL_@";
-               if (epsilon_symbol.compare(output_symbol) == 0)
-                 output_symbol="@_EPSILON_SYMBOL_@";
-
-               HfstTransition <C> tr( atoi(a2), input_symbol, 
-                                       output_symbol, weight );
-               retval.add_transition( atoi(a1), tr );
+             // a symbol is added to the alphabet when it is first seen
+             while (symbol_numbers.size() < reader.get_symbol_count()) {
+               const std::string &symbol
+                 = reader.get_symbol(symbol_numbers.size());
+               symbol_numbers.push_back(retval.get_symbol_number(symbol));
+               retval.alphabet.insert(symbol);
              }
 
-             else  {  // line could not be parsed
-               std::string message(line);
-               HFST_THROW_MESSAGE
-                 (NotValidAttFormatException,
-                  message);
-             }    
+             HfstTransition <C> tr( reader.get_target(),
+                                    symbol_numbers[reader.get_input()],
+                                    symbol_numbers[reader.get_output()],
+                                    reader.get_weight(), false );
+             retval.add_transition( reader.get_state(), tr, false );
            }
            return retval;
          }
@@ -3803,7 +3739,7 @@
             HfstState state,
             unsigned int lookup_index, // an iterator instead?
             HfstTwoLevelPath &path_so_far,
-            StringSet &alphabet,
+            const StringSet &alphabet,
             HfstEpsilonHandler Eh,
             size_t infinite_cutoff,
             float * max_weight = NULL)
@@ -3910,7 +3846,7 @@
            HfstState state = 0;
            unsigned int lookup_index = 0;
            HfstTwoLevelPath path_so_far;
-           StringSet alphabet = this->get_alphabet();
+           const StringSet & alphabet = this->get_alphabet();
            if (infinite_cutoff != NULL)
              {
                HfstEpsilonHandler Eh(*infinite_cutoff);
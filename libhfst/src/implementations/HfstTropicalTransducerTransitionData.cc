@@ -4,17 +4,17 @@ namespace hfst {
 
   namespace implementations {
 
-    HfstTropicalTransducerTransitionData::Number2SymbolVector
-    HfstTropicalTransducerTransitionData::number2symbol_map;
-    Number2SymbolVectorInitializer 
-    dummy1(HfstTropicalTransducerTransitionData::number2symbol_map);
-    
-    HfstTropicalTransducerTransitionData::Symbol2NumberMap 
-    HfstTropicalTransducerTransitionData::symbol2number_map;
-    Symbol2NumberMapInitializer 
-    dummy2(HfstTropicalTransducerTransitionData::symbol2number_map);
-    
-    unsigned int HfstTropicalTransducerTransitionData::max_number=2;
+    /* A function-local static, so that it is constructed on first use even
+       if that happens during the static initialization of another file,
+       and the construction is thread-safe. */
+    HfstSymbolInterner & HfstTropicalTransducerTransitionData::get_interner()
+    {
+      static const char * const special_symbols[] =
+        { "@_EPSILON_SYMBOL_@", "@_UNKNOWN_SYMBOL_@", "@_IDENTITY_SYMBOL_@" };
+      static HfstSymbolInterner interner
+        (std::vector<std::string>(special_symbols, special_symbols + 3));
+      return interner;
+    }
 
   }
 
@@ -6,6 +6,7 @@
 #include <iostream>
 #include <vector>
 #include "../HfstExceptionDefs.h"
+#include "HfstSymbolInterner.h"
 
 #include "../hfstdll.h"
 
@@ -29,8 +30,9 @@ namespace hfst {
         \internal Actually a HfstTropicalTransducerTransitionData has an 
         input and an output number of type unsigned int, but this 
         implementation is hidden from the user.
-        The class has two static maps and functions that take care of conversion
-        between strings and internal numbers.
+        The numbers are shared by all transducers of this type and kept in
+        one HfstSymbolInterner, so transitions can be created and their
+        symbols read from several threads at once.
         
         @see HfstTransition HfstBasicTransition */
     class HfstTropicalTransducerTransitionData {
@@ -42,11 +44,6 @@ namespace hfst {
       /** @brief A set of symbols. */
       typedef std::set<SymbolType> SymbolTypeSet;
       
-      typedef std::vector<SymbolType> 
-        Number2SymbolVector;
-      typedef std::map<SymbolType, unsigned int, string_comparison> 
-        Symbol2NumberMap;
-
       HFSTDLL static SymbolType get_epsilon()
       {
         return SymbolType("@_EPSILON_SYMBOL_@");
@@ -62,17 +59,14 @@ namespace hfst {
         return SymbolType("@_IDENTITY_SYMBOL_@");
       }
       
-    public: /* FIXME: Should be private. */
-      /* Maps that contain information of the mappings between strings 
-         and numbers */
-      HFSTDLL static Number2SymbolVector number2symbol_map;
-      HFSTDLL static Symbol2NumberMap symbol2number_map;
-      /* The biggest number in use. */
-      HFSTDLL static unsigned int max_number;
+    protected:
+      /* The mapping between strings and numbers */
+      HFSTDLL static HfstSymbolInterner & get_interner();
 
+    public:
       /* Get the biggest number used to represent a symbol. */
       HFSTDLL static unsigned int get_max_number() {
-        return max_number;
+        return get_interner().size() - 1;
       }
 
       /* 
@@ -110,6 +104,7 @@ namespace hfst {
         (const std::map<SymbolType, unsigned int> &symbols)
       {
         std::vector<unsigned int> harmv;
+        unsigned int max_number = get_max_number();
         harmv.reserve(max_number+1);
         harmv.resize(max_number+1, 0);
         for (unsigned int i=0; i<harmv.size(); i++)
@@ -126,7 +121,8 @@ namespace hfst {
       /* Get the symbol that is mapped as \a number */
       static const std::string &get_symbol(unsigned int number) 
       { 
-        if (number >= number2symbol_map.size()) {
+        HfstSymbolInterner & interner = get_interner();
+        if (number >= interner.size()) {
           std::string message("HfstTropicalTransducerTransitionData: "
                               "number ");
           std::ostringstream oss;
@@ -136,34 +132,25 @@ namespace hfst {
           HFST_THROW_MESSAGE
             (HfstFatalException, message);
         }
-        return number2symbol_map[number];
+        return interner.get_symbol(number);
       }
 
       /* Get the number that is used to represent \a symbol */
       static unsigned int get_number(const std::string &symbol) 
       {
         if(symbol == "") { // FAIL
-          Symbol2NumberMap::iterator it = symbol2number_map.find(symbol);
-          if (it == symbol2number_map.end()) {
+          unsigned int number;
+          if (!get_interner().find_number(symbol, number)) {
             std::cerr << "ERROR: No number for the empty symbol\n" 
                       << std::endl;
           }
           else {
             std::cerr << "ERROR: The empty symbol corresdponds to number " 
-                      << it->second << std::endl;
+                      << number << std::endl;
           }
           assert(false);
         }
-        
-        Symbol2NumberMap::iterator it = symbol2number_map.find(symbol);
-        if (it == symbol2number_map.end()) 
-          {
-            max_number++;
-            symbol2number_map[symbol] = max_number;
-            number2symbol_map.push_back(symbol);            
-            return max_number;
-          }
-        return it->second;
+        return get_interner().get_number(symbol);
       }
 
       //private: TEST
@@ -311,39 +298,16 @@ namespace hfst {
           weight = another.weight;
         }
       
-      friend class Number2SymbolVectorInitializer;
-      friend class Symbol2NumberMapInitializer;
-
       friend class ComposeIntersectFst;
       friend class ComposeIntersectLexicon;
       friend class ComposeIntersectRule;
       friend class ComposeIntersectRulePair;
       template <class C> friend class HfstTransitionGraph;
+      friend class HfstMinimalAcyclicBuilder;
+      friend class TropicalWeightTransducer;
 
     };
 
-    // Initialization of static members in class 
-    // HfstTropicalTransducerTransitionData..
-    class Number2SymbolVectorInitializer {
-    public:
-      HFSTDLL Number2SymbolVectorInitializer
-        (HfstTropicalTransducerTransitionData::Number2SymbolVector &vect) {
-        vect.push_back(std::string("@_EPSILON_SYMBOL_@"));
-        vect.push_back(std::string("@_UNKNOWN_SYMBOL_@"));
-        vect.push_back(std::string("@_IDENTITY_SYMBOL_@"));
-      }
-    };
-
-    class Symbol2NumberMapInitializer {
-    public:
-      HFSTDLL Symbol2NumberMapInitializer
-        (HfstTropicalTransducerTransitionData::Symbol2NumberMap &map) {
-        map["@_EPSILON_SYMBOL_@"] = 0;
-        map["@_UNKNOWN_SYMBOL_@"] = 1;
-        map["@_IDENTITY_SYMBOL_@"] = 2;
-      }
-    };
-
   } // namespace implementations
 
 } // namespace hfst
@@ -14,7 +14,9 @@
 #include "HfstSymbolDefs.h"
 #include "HfstLookupFlagDiacritics.h"
 #include "HfstTransitionGraph.h"
+#include "HfstAttReader.h"
 #include "ConvertTransducerFormat.h"
+#include "HarmonizeUnknownAndIdentitySymbols.h"
 
 #ifndef MAIN_TEST
 
@@ -405,89 +407,94 @@ namespace hfst {
     return t;
   }
 
+  /* Write \a t in AT&T format to \a ofile one state at a time, in the
+     same form as HfstBasicTransducer::write_in_att_format writes it. */
   void TropicalWeightTransducer::write_in_att_format
-    (StdVectorFst *t, FILE *ofile)
+    (StdVectorFst *t, FILE *ofile, bool write_weights)
   {
-
-    const SymbolTable *sym = t->InputSymbols();
-    assert(sym != NULL);
+    StringVector symbol_vector = get_symbol_vector(t);
+    // the symbols as they are printed, made when first needed
+    std::vector<std::string> att_symbols(symbol_vector.size());
 
     // this takes care that initial state is always printed as number zero
     // and state number zero (if it is not initial) is printed as another number
     // (basically as the number of the initial state in that case, i.e.
     // the numbers of initial state and state number zero are swapped)
-    StateId zero_print=0;
     StateId initial_state = t->Start();
-    if (initial_state != 0) {
-      zero_print = initial_state;
-    }
-      
-    for (fst::StateIterator<StdVectorFst> siter(*t); 
-         ! siter.Done(); siter.Next()) 
+    if (initial_state == fst::kNoStateId)
+      initial_state = 0;
+
+    // the lines of one state, written at once
+    std::string lines;
+    char buffer [128];
+    for (StateId origin = 0; origin < t->NumStates(); origin++)
       {
-        StateId s = siter.Value();
-        if (s == initial_state) {
-        int origin;  // how origin state is printed, see the first comment
-        if (s == 0)
-          origin = zero_print;
-        else if (s == initial_state)
-          origin = 0;
-        else
-          origin = (int)s;
+        StateId s = origin;
+        if (origin == 0)
+          s = initial_state;
+        else if (origin == initial_state)
+          s = 0;
+
+        lines.clear();
         for (fst::ArcIterator<StdVectorFst> aiter(*t,s); 
              !aiter.Done(); aiter.Next())
           {
             const StdArc &arc = aiter.Value();
-            int target;  // how target state is printed, see the first comment
-            if (arc.nextstate == 0)
-              target = zero_print;
-            else if (arc.nextstate == initial_state)
+            StateId target = arc.nextstate;
+            if (target == initial_state)
               target = 0;
-            else
-              target = (int)arc.nextstate;
-            fprintf(ofile, "%i\t%i\t%s\t%s\t%f\n", origin, target,
-                    sym->Find(arc.ilabel).c_str(), 
-                    sym->Find(arc.olabel).c_str(),
-                    arc.weight.Value());
+            else if (target == 0)
+              target = initial_state;
+
+            sprintf(buffer, "%i\t%i\t", (int)origin, (int)target);
+            lines.append(buffer);
+            lines.append(get_att_symbol(arc.ilabel, symbol_vector,
+                                        att_symbols));
+            lines.push_back('\t');
+            lines.append(get_att_symbol(arc.olabel, symbol_vector,
+                                        att_symbols));
+            if (write_weights)
+              {
+                sprintf(buffer, "\t%f", arc.weight.Value());
+                lines.append(buffer);
+              }
+            lines.push_back('\n');
           }
         if (t->Final(s) != TropicalWeight::Zero())
-          fprintf(ofile, "%i\t%f\n", origin, t->Final(s).Value());
-        break;
-        }
+          {
+            sprintf(buffer, "%i", (int)origin);
+            lines.append(buffer);
+            if (write_weights)
+              {
+                sprintf(buffer, "\t%f", t->Final(s).Value());
+                lines.append(buffer);
+              }
+            lines.push_back('\n');
+          }
+        fwrite(lines.data(), 1, lines.size(), ofile);
       }
+  }
 
-    for (fst::StateIterator<StdVectorFst> siter(*t); 
-         ! siter.Done(); siter.Next())
+  /* Get the symbol numbered \a number in \a symbol_vector as it is
+     written in AT&T format. Each symbol is escaped once and kept in
+     \a att_symbols. */
+  const std::string & TropicalWeightTransducer::get_att_symbol
+    (unsigned int number, const StringVector &symbol_vector,
+     std::vector<std::string> &att_symbols)
+  {
+    if (number >= symbol_vector.size())
       {
-        StateId s = siter.Value();
-        if (s != initial_state) {
-          int origin;  // how origin state is printed, see the first comment
-          if (s == 0)
-            origin = zero_print;
-          else if (s == initial_state)
-            origin = 0;
-          else
-            origin = (int)s;
-          for (fst::ArcIterator<StdVectorFst> aiter(*t,s); 
-               !aiter.Done(); aiter.Next())
-            {
-              const StdArc &arc = aiter.Value();
-              int target;  // how target state is printed, see the first comment
-              if (arc.nextstate == 0)
-                target = zero_print;
-              else if (arc.nextstate == initial_state)
-                target = 0;
-              else
-                target = (int)arc.nextstate;
-              fprintf(ofile, "%i\t%i\t%s\t%s\t%f\n", origin, target,
-                      sym->Find(arc.ilabel).c_str(), 
-                      sym->Find(arc.olabel).c_str(),
-                      arc.weight.Value());
-            }
-          if (t->Final(s) != TropicalWeight::Zero())
-            fprintf(ofile, "%i\t%f\n", origin, t->Final(s).Value());
-        }
+        std::ostringstream oss;
+        oss << "FATAL ERROR: number " << number << " not in symbol_vector";
+        HFST_THROW_MESSAGE(HfstFatalException, oss.str());
       }
+    std::string &symbol = att_symbols[number];
+    if (symbol.empty())
+      {
+        symbol = symbol_vector[number];
+        HfstAttReader::escape_symbol(symbol);
+      }
+    return symbol;
   }
 
 
@@ -750,93 +757,65 @@ namespace hfst {
 
   // AT&T format is handled here ------------------------------
 
-  /* Maps state numbers in AT&T text format to state ids used by 
-     OpenFst transducers. */
-  typedef std::map<int, StateId> StateMap;
-
-  /* A method used by function 'read_in_att_format'.
-     Returns the state id of state number state_number and adds a new
-     state to t if state_number is encountered for the first time and
-     updates state_map accordingly. */
-  StateId TropicalWeightTransducer::
-  add_and_map_state(StdVectorFst *t, int state_number, 
-                    StateMap &state_map)
-  {
-    StateMap::iterator it = state_map.find(state_number);
-    if (it == state_map.end()) {
-      StateId retval  = t->AddState();
-      state_map.insert( std::pair<int, StateId>(state_number, retval) );
-      return retval;
-    }
-    else
-      return it->second;
-  }
-
-  // FIXME?: atof and atoi
-  /* Reads a description of a transducer in AT&T text format and returns 
-     a corresponding binary transducer. 
-     @note The initial state must be numbered as zero. */
-  StdVectorFst * TropicalWeightTransducer::read_in_att_format(FILE * ifile)
+  /* Read a transducer in AT&T text format from \a ifile straight into an
+     StdVectorFst. The lines and the symbol numbers are as in
+     HfstBasicTransducer::read_in_att_format, so the result is the same as
+     reading an HfstBasicTransducer and converting it, without having both
+     in memory at the same time. */
+  StdVectorFst * TropicalWeightTransducer::read_in_att_format
+  (FILE * ifile, const std::string & epsilon_symbol, unsigned int & linecount)
   {
-    StdVectorFst *t = new StdVectorFst();
-    SymbolTable st = create_symbol_table("");
+    HfstAttReader reader(std::cin /* a dummy variable */, ifile,
+                         epsilon_symbol, linecount);
 
-    char line [255];
-    StateMap state_map;
-
-    // Add initial state that is numbered as zero.
-    StateId initial_state = add_and_map_state(t, 0, state_map);
-    t->SetStart(initial_state);
+    StdVectorFst *t = new StdVectorFst();
+    t->SetStart(t->AddState()); // always zero
 
+    fst::SymbolTable st("");
+    st.AddSymbol(internal_epsilon, 0);
+    st.AddSymbol(internal_unknown, 1);
+    st.AddSymbol(internal_identity, 2);
+    // the numbers of the symbols of the reader
+    std::vector<unsigned int> symbol_numbers;
 
-    while ( fgets(line, 255, ifile) != NULL ) 
+    try
       {
-        if (*line == '-') // transducer separator
-          return t;
-
-        char a1 [100]; char a2 [100]; char a3 [100]; 
-        char a4 [100]; char a5 [100];
-        int n = sscanf(line, "%s\t%s\t%s\t%s\t%s", a1, a2, a3, a4, a5);
+        while (reader.read_line())
+          {
+            StateId state = reader.get_state();
+            while (t->NumStates() <= state)
+              t->AddState();
 
-        // set value of weight
-        float weight = 0;
-        if (n == 2)
-          weight = atof(a2);
-        if (n == 5)
-          weight = atof(a5);
+            if (reader.is_final_line())
+              {
+                t->SetFinal(state, reader.get_weight());
+                continue;
+              }
 
-        if (n == 1 || n == 2)  // final state line
-          {
-            int final_number = atoi(a1);
-            StateId final_state = add_and_map_state(t, final_number, state_map);
-            t->SetFinal(final_state, weight);
-          }
+            StateId target = reader.get_target();
+            while (t->NumStates() <= target)
+              t->AddState();
 
-        else if (n == 4 || n == 5)  // transition line
-          {
-            int origin_number = atoi(a1);
-            int target_number = atoi(a2);
-            StateId origin_state 
-              = add_and_map_state(t, origin_number, state_map);
-            StateId target_state 
-              = add_and_map_state(t, target_number, state_map);
-
-            int input_number = st.AddSymbol(std::string(a3));
-            int output_number = st.AddSymbol(std::string(a4));
-
-            t->AddArc(origin_state, 
-                      StdArc(input_number, output_number, 
-                             weight, target_state));
-          }
+            while (symbol_numbers.size() < reader.get_symbol_count())
+              {
+                const std::string &symbol
+                  = reader.get_symbol(symbol_numbers.size());
+                unsigned int number
+                  = HfstTropicalTransducerTransitionData::get_number(symbol);
+                st.AddSymbol(symbol, number);
+                symbol_numbers.push_back(number);
+              }
 
-        else  // line could not be parsed
-          {
-            std::string message(line);
-            HFST_THROW_MESSAGE
-              (NotValidAttFormatException,
-               message);
+            t->AddArc(state,
+                      StdArc(symbol_numbers[reader.get_input()],
+                             symbol_numbers[reader.get_output()],
+                             reader.get_weight(), target));
           }
-
+      }
+    catch (...)
+      {
+        delete t;
+        throw;
       }
 
     t->SetInputSymbols(&st);
@@ -1039,11 +1018,99 @@ namespace hfst {
     return retval;
   }
 
-  std::pair<StdVectorFst*, StdVectorFst*> TropicalWeightTransducer::harmonize
-  (StdVectorFst *t1, StdVectorFst *t2, bool unknown_symbols_in_use)
+  /* Recode \a t to the symbol numbers of HfstBasicTransducer and add its
+     symbols to \a st with those numbers. Arcs are visited only if some
+     symbol of \a t has a different number. */
+  void TropicalWeightTransducer::recode_to_basic_numbers
+  (StdVectorFst *t, fst::SymbolTable &st)
   {
-    bool DEBUG=false;
+    StringVector symbols = get_symbol_vector(t);
+    std::vector<unsigned int> numbers =
+      HfstTropicalTransducerTransitionData::get_harmonization_vector(symbols);
+
+    bool recode = false;
+    for (unsigned int i = 0; i < symbols.size(); i++)
+      {
+        if (symbols[i] != "")
+          {
+            st.AddSymbol(symbols[i], numbers[i]);
+            if (numbers[i] != i)
+              recode = true;
+          }
+      }
+    if (! recode)
+      return;
+
+    for (fst::StateIterator<StdVectorFst> siter(*t);
+         ! siter.Done(); siter.Next())
+      {
+        for (fst::MutableArcIterator<StdVectorFst> aiter(t, siter.Value());
+             !aiter.Done(); aiter.Next())
+          {
+            StdArc arc = aiter.Value();
+            arc.ilabel = numbers[arc.ilabel];
+            arc.olabel = numbers[arc.olabel];
+            aiter.SetValue(arc);
+          }
+      }
+  }
+
+  /* Add to \a t an arc for each symbol in \a missing that an unknown or
+     identity arc of \a t stands for, as HarmonizeUnknownAndIdentitySymbols
+     does for HfstBasicTransducers. */
+  void TropicalWeightTransducer::expand_unknown_and_identity
+  (StdVectorFst *t, const std::vector<int64> &missing)
+  {
+    if (missing.empty())
+      return;
+
+    std::vector<StdArc> added;
+    for (fst::StateIterator<StdVectorFst> siter(*t);
+         ! siter.Done(); siter.Next())
+      {
+        StateId s = siter.Value();
+        added.clear();
+        for (fst::ArcIterator<StdVectorFst> aiter(*t, s);
+             !aiter.Done(); aiter.Next())
+          {
+            const StdArc &arc = aiter.Value();
+            if (arc.ilabel == 2)  // identity "?:?"
+              {
+                for (size_t i = 0; i < missing.size(); i++)
+                  added.push_back(StdArc(missing[i], missing[i],
+                                         arc.weight, arc.nextstate));
+                continue;
+              }
+            if (arc.ilabel == 1)  // "?:x" and "?:?"
+              {
+                for (size_t i = 0; i < missing.size(); i++)
+                  added.push_back(StdArc(missing[i], arc.olabel,
+                                         arc.weight, arc.nextstate));
+              }
+            if (arc.olabel == 1)  // "x:?" and "?:?"
+              {
+                for (size_t i = 0; i < missing.size(); i++)
+                  added.push_back(StdArc(arc.ilabel, missing[i],
+                                         arc.weight, arc.nextstate));
+              }
+            if (arc.ilabel == 1 && arc.olabel == 1)
+              {
+                for (size_t i = 0; i < missing.size(); i++)
+                  for (size_t j = 0; j < missing.size(); j++)
+                    if (i != j)
+                      added.push_back(StdArc(missing[j], missing[i],
+                                             arc.weight, arc.nextstate));
+              }
+          }
+        for (std::vector<StdArc>::const_iterator it = added.begin();
+             it != added.end(); it++)
+          t->AddArc(s, *it);
+      }
+  }
 
+  void TropicalWeightTransducer::harmonize
+  (StdVectorFst *t1, StdVectorFst *t2, bool unknown_symbols_in_use)
+  {
 #ifdef PROFILE_MINIMIZATION
     clock_t startclock = clock();
 #endif
@@ -1056,79 +1123,83 @@ namespace hfst {
     StringSet t1_symbols = get_alphabet(t1);
     StringSet t2_symbols = get_alphabet(t2);
     hfst::symbols::collect_unknown_sets(t1_symbols, unknown_t1,
-                    t2_symbols, unknown_t2);
-    
-    if (DEBUG)
-      {
-    fprintf(stderr, "New symbols for t1: ");
-    for (StringSet::const_iterator it = unknown_t1.begin(); 
-         it != unknown_t1.end(); it++)
-      fprintf(stderr, "'%s', ", it->c_str());
-    fprintf(stderr, "\n");
-    fprintf(stderr, "New symbols for t2: ");
-    for (StringSet::const_iterator it = unknown_t2.begin(); 
-         it != unknown_t2.end(); it++)
-      fprintf(stderr, "'%s', ", it->c_str());
-    fprintf(stderr, "\n");
-      }
-
-
-    // 2. Add new symbols from transducer t1 to the symbol table of 
-    //    transducer t2...
+                                        t2_symbols, unknown_t2);
 
-    SymbolTable * st2 = t2->InputSymbols()->Copy();
-    for ( StringSet::const_iterator it = unknown_t2.begin();
-          it != unknown_t2.end(); it++ ) {
-      if(st2->AddSymbol(*it) < 3) {
-        std::cerr << "ERROR: string " << *it << " got strange number" << std::endl;
-        assert(false);
-      }
-    }
-    t2->SetInputSymbols(st2);
-    
-    // ...calculate the number mappings needed in harmonization...
-    NumberNumberMap km = create_mapping(t1, t2);
+    // 2. Give both transducers the symbol numbers of HfstBasicTransducer,
+    //    which they already have if they have been converted from one.
 
-    // ... replace the symbol table of t1 with a copy of t2's symbol table
-    t1->SetInputSymbols(st2);
-    delete st2;
-
-    // ...and recode the symbol numbers of transducer t1 so that
-    //    it follows the new symbol table.
-    recode_symbol_numbers(t1, km);
+    SymbolTable st = create_symbol_table("");
+    recode_to_basic_numbers(t1, st);
+    recode_to_basic_numbers(t2, st);
+    t1->SetInputSymbols(&st);
+    t1->SetOutputSymbols(NULL);
+    t2->SetInputSymbols(&st);
+    t2->SetOutputSymbols(NULL);
 
-    // 3. Calculate the set of symbol pairs to which a non-identity "?:?"
-    //    transition is expanded for both transducers.
-    
-    fst::StdVectorFst *harmonized_t1;
-    fst::StdVectorFst *harmonized_t2;
-
-    if (! unknown_symbols_in_use)
-      harmonized_t1 = t1;
-    else {
-      harmonized_t1 = expand_arcs(t1, unknown_t1, unknown_symbols_in_use);
-      harmonized_t1->SetInputSymbols(t1->InputSymbols());
-    }
+    // 3. Expand the unknown and identity arcs of both transducers to the
+    //    symbols that they did not know.
 
-    if (! unknown_symbols_in_use)
-      harmonized_t2 = t2;
-    else {
-      harmonized_t2 = expand_arcs(t2, unknown_t2, unknown_symbols_in_use);
-      harmonized_t2->SetInputSymbols(t2->InputSymbols());
-    }
+    if (unknown_symbols_in_use)
+      {
+        std::vector<int64> missing_t1;
+        for (StringSet::const_iterator it = unknown_t1.begin();
+             it != unknown_t1.end(); it++)
+          {
+            if (*it != internal_unknown && *it != internal_identity &&
+                HarmonizeUnknownAndIdentitySymbols::is_expanded_to(*it))
+              missing_t1.push_back(st.Find(*it));
+          }
+        std::vector<int64> missing_t2;
+        for (StringSet::const_iterator it = unknown_t2.begin();
+             it != unknown_t2.end(); it++)
+          {
+            if (*it != internal_unknown && *it != internal_identity &&
+                HarmonizeUnknownAndIdentitySymbols::is_expanded_to(*it))
+              missing_t2.push_back(st.Find(*it));
+          }
+        expand_unknown_and_identity(t1, missing_t1);
+        expand_unknown_and_identity(t2, missing_t2);
+      }
 
 #ifdef PROFILE_MINIMIZATION
     clock_t endclock = clock();
     tropical_seconds_in_harmonize = tropical_seconds_in_harmonize + 
       ( (float)(endclock - startclock) / CLOCKS_PER_SEC);
 #endif
-
-    return std::pair<StdVectorFst*, StdVectorFst*>
-      (harmonized_t1, harmonized_t2);
-
   }
 
+  void TropicalWeightTransducer::substitute_in_place
+  (StdVectorFst *t, const std::string &old_symbol,
+   const std::string &new_symbol, bool input_side, bool output_side)
+  {
+    int64 old_number = t->InputSymbols()->Find(old_symbol);
+    if (old_number < 0)
+      return;
+    SymbolTable * st = t->InputSymbols()->Copy();
+    int64 new_number = st->AddSymbol(new_symbol);
+    t->SetInputSymbols(st);
+    delete st;
 
+    for (fst::StateIterator<StdVectorFst> siter(*t);
+         ! siter.Done(); siter.Next())
+      {
+        for (fst::MutableArcIterator<StdVectorFst> aiter(t, siter.Value());
+             !aiter.Done(); aiter.Next())
+          {
+            const StdArc &arc = aiter.Value();
+            if ((input_side && arc.ilabel == old_number) ||
+                (output_side && arc.olabel == old_number))
+              {
+                StdArc new_arc = arc;
+                if (input_side && arc.ilabel == old_number)
+                  new_arc.ilabel = new_number;
+                if (output_side && arc.olabel == old_number)
+                  new_arc.olabel = new_number;
+                aiter.SetValue(new_arc);
+              }
+          }
+      }
+  }
 
   /* Skip the identifier string "TROPICAL_OFST_TYPE" */
   void TropicalWeightInputStream::skip_identifier_version_3_0(void)
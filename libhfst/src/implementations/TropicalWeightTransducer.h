@@ -225,10 +225,21 @@ namespace implementations
       static StdVectorFst * push_weights
         (StdVectorFst * t, bool to_initial_state);
 
-      static std::pair<StdVectorFst*, StdVectorFst*> harmonize
+      /* Harmonize \a t1 and \a t2 in place: give them the same symbol
+         table, numbered as in HfstBasicTransducer, and expand their
+         unknown and identity arcs to the symbols known only to the other
+         one, if \a unknown_symbols_in_use. */
+      static void harmonize
         (StdVectorFst *t1, StdVectorFst *t2, bool unknown_symbols_in_use=true);
 
-      static void write_in_att_format(StdVectorFst * t, FILE *ofile);
+      /* Substitute \a old_symbol with \a new_symbol on the given sides of
+         the arcs of \a t in place. \a old_symbol stays in the alphabet. */
+      static void substitute_in_place
+        (StdVectorFst *t, const std::string &old_symbol,
+         const std::string &new_symbol, bool input_side, bool output_side);
+
+      static void write_in_att_format(StdVectorFst * t, FILE *ofile,
+                                      bool write_weights=true);
       static void write_in_att_format_number(StdVectorFst * t, FILE *ofile);
       
       //static void test_minimize(void);
@@ -237,7 +248,9 @@ namespace implementations
       static void write_in_att_format_number
         (StdVectorFst * t, std::ostream &os);
 
-      static StdVectorFst * read_in_att_format(FILE *ifile);
+      static StdVectorFst * read_in_att_format
+        (FILE *ifile, const std::string &epsilon_symbol,
+         unsigned int &linecount);
       
       static bool are_equivalent(StdVectorFst *one, StdVectorFst *another);
       static bool is_cyclic(StdVectorFst * t);
@@ -297,6 +310,10 @@ namespace implementations
       static StdVectorFst * expand_arcs
         (StdVectorFst * t, hfst::StringSet &unknown, 
          bool unknown_symbols_in_use);
+      static void recode_to_basic_numbers
+        (StdVectorFst * t, fst::SymbolTable &st);
+      static void expand_unknown_and_identity
+        (StdVectorFst * t, const std::vector<int64> &missing);
 
 #ifdef FOO
       static StdVectorFst * compose_intersect(StdVectorFst * t,
@@ -323,11 +340,9 @@ namespace implementations
 
       static std::ostream * warning_stream;
 
-      /* Maps state numbers in AT&T text format to state ids used by 
-         OpenFst transducers. */
-      typedef std::map<int, StateId> StateMap;
-      static StateId add_and_map_state(StdVectorFst *t, int state_number, 
-                                       StateMap &state_map);
+      static const std::string &get_att_symbol
+        (unsigned int number, const StringVector &symbol_vector,
+         std::vector<std::string> &att_symbols);
 
       static int has_arc(StdVectorFst &t,
                   StdArc::StateId sourcestate,                          
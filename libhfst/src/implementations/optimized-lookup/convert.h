@@ -199,10 +199,15 @@ bool compare_states_by_input_size(
 bool compare_states_by_state_number(
     const StatePlaceholder & lhs, const StatePlaceholder & rhs);
 
+/* The index table being packed. Besides the entries, there is a bitmap
+   of the used positions, so that a state can be tried at 64 starting
+   positions at a time with a few word operations. */
 struct IndexPlaceholders
 {
     std::vector<unsigned int> indices;
     std::vector<std::pair<unsigned int, SymbolNumber> > targets;
+    // bit k of used_bits[w] tells whether position 64*w+k is used
+    std::vector<unsigned long long> used_bits;
 
     bool used(unsigned int const position) const
         {
@@ -211,10 +216,12 @@ struct IndexPlaceholders
 
     void assign(unsigned int const position, unsigned int target, SymbolNumber sym)
         {
-            while (position >= indices.size()) {
-                indices.push_back(NO_TABLE_INDEX);
+            if (position >= indices.size()) {
+                indices.resize(position + 1, NO_TABLE_INDEX);
+                used_bits.resize(position / 64 + 1, 0);
             }
             indices[position] = targets.size();
+            used_bits[position / 64] |= 1ULL << (position % 64);
             targets.push_back(std::pair<unsigned int, SymbolNumber>(target, sym));
         }
 
@@ -222,25 +229,108 @@ struct IndexPlaceholders
         {
             return targets[indices[index]];
         }
-    
-    bool fits(StatePlaceholder const & state,
-              std::set<SymbolNumber> const & flag_symbols,
-              unsigned int const position) const
+
+    /* The positions that a state at position 0 would use: its finality
+       marker and one entry for each input symbol. */
+    static std::vector<unsigned int> signature(
+        StatePlaceholder const & state,
+        std::set<SymbolNumber> const & flag_symbols)
         {
-            if (used(position)) {
-                return false;
-            }
+            std::vector<unsigned int> offsets(1, 0);
             for (std::vector<std::vector<TransitionPlaceholder> >::const_iterator it = state.transition_placeholders.begin();
                  it != state.transition_placeholders.end(); ++it) {
                 SymbolNumber index_offset = it->at(0).input;
                 if (flag_symbols.count(index_offset) != 0) {
                     index_offset = 0;
                 }
-                if (used(index_offset + position + 1)) {
-                    return false;
+                offsets.push_back(index_offset + 1);
+            }
+            std::sort(offsets.begin(), offsets.end());
+            offsets.erase(std::unique(offsets.begin(), offsets.end()),
+                          offsets.end());
+            return offsets;
+        }
+
+    /* The used bits of positions position...position+63 */
+    unsigned long long used_window(unsigned int const position) const
+        {
+            size_t word = position / 64;
+            unsigned int shift = position % 64;
+            if (word >= used_bits.size()) {
+                return 0;
+            }
+            unsigned long long window = used_bits[word] >> shift;
+            if (shift != 0 && word + 1 < used_bits.size()) {
+                window |= used_bits[word + 1] << (64 - shift);
+            }
+            return window;
+        }
+
+    /* The position of the lowest set bit of \a bits, which is not 0 */
+    static unsigned int lowest_bit(unsigned long long bits)
+        {
+#if defined(__GNUC__)
+            return __builtin_ctzll(bits);
+#else
+            unsigned int position = 0;
+            while ((bits & 1) == 0) {
+                bits >>= 1;
+                ++position;
+            }
+            return position;
+#endif
+        }
+
+    /* The number of set bits of \a bits */
+    static unsigned int bit_count(unsigned long long bits)
+        {
+#if defined(__GNUC__)
+            return __builtin_popcountll(bits);
+#else
+            unsigned int count = 0;
+            while (bits != 0) {
+                bits &= bits - 1;
+                ++count;
+            }
+            return count;
+#endif
+        }
+
+    /* The first position from \a position on where \a state fits. */
+    unsigned int first_fit(StatePlaceholder const & state,
+                           std::set<SymbolNumber> const & flag_symbols,
+                           unsigned int position) const
+        {
+            std::vector<unsigned int> offsets = signature(state, flag_symbols);
+            while (true) {
+                // bit k tells whether the state fits at position+k
+                unsigned long long candidates = ~0ULL;
+                for (std::vector<unsigned int>::const_iterator it = offsets.begin();
+                     it != offsets.end() && candidates != 0; ++it) {
+                    candidates &= ~used_window(position + *it);
+                }
+                if (candidates != 0) {
+                    return position + lowest_bit(candidates);
                 }
+                position += 64;
             }
-            return true;
+        }
+
+    /* The number of used positions from \a position on, up to
+       \a count positions. */
+    unsigned int count_used(unsigned int position, unsigned int count) const
+        {
+            unsigned int filled = 0;
+            while (count >= 64) {
+                filled += bit_count(used_window(position));
+                position += 64;
+                count -= 64;
+            }
+            if (count != 0) {
+                filled += bit_count(
+                    used_window(position) & ((1ULL << count) - 1));
+            }
+            return filled;
         }
 
     bool unsuitable(unsigned int const index,
@@ -260,14 +350,10 @@ struct IndexPlaceholders
         return false;
         }*/
 
-    unsigned int filled = 0;
-    for (unsigned int i = 0; i < symbols; ++i) {
-        filled += used(index + i + 1);
-        if (filled >= (packing_aggression*symbols)) {
-            return true; // too full
-        }
-    }
-    return false;
+    // Too full if the symbols after index are filled above the
+    // packing aggression
+    unsigned int filled = count_used(index + 1, symbols);
+    return filled != 0 && filled >= (packing_aggression*symbols);
     }
 };
 
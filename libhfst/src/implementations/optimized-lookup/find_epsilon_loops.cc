@@ -21,12 +21,7 @@ bool TraversalState::operator==(const TraversalState & rhs) const
     if (this->index != rhs.index) {
         return false;
     }
-    for (size_t i = 0; i < this->flags.size(); ++i) {
-        if (this->flags[i] != rhs.flags[i]) {
-            return false;
-        }
-    }
-    return true;
+    return this->flags == rhs.flags;
 }
 
 bool TraversalState::operator<(const TraversalState & rhs) const
@@ -37,27 +32,40 @@ bool TraversalState::operator<(const TraversalState & rhs) const
     if (this->index > rhs.index) {
         return false;
     }
-    for (size_t i = 0; i < this->flags.size(); ++i) {
-        if (this->flags[i] < rhs.flags[i]) {
-            return true;
-        }
-        if (this->flags[i] > rhs.flags[i]) {
-            return false;
-        }
+    return this->flags < rhs.flags;
+}
+
+EpsilonLoopFinder::EpsilonLoopFinder(const Transducer & t):
+    tables(*t.tables),
+    alphabet(*t.alphabet),
+    input_tape(NULL),
+    flag_state(t.alphabet->get_fd_table()),
+    found_transition(false)
+{}
+
+bool EpsilonLoopFinder::has_loop(const SymbolNumber * input)
+{
+    input_tape = input;
+    traversal_states.clear();
+    try {
+        find_loop(0, 0);
+    } catch (bool e) {
+        flag_state = alphabet.get_fd_table();
+        return e;
     }
-    return false;    
+    return false;
 }
 
-void Transducer::find_loop_epsilon_transitions(
+void EpsilonLoopFinder::find_loop_epsilon_transitions(
     unsigned int input_pos,
     TransitionTableIndex i)
 {
-    FlagDiacriticState flags = flag_state.get_values();
+    FlagDiacriticState flags = flag_state.save();
     while (true)
     {
-        TransitionTableIndex target = tables->get_transition_target(i);
+        TransitionTableIndex target = tables.get_transition_target(i);
         TraversalState epsilon_reachable(target, flags);
-        if (tables->get_transition_input(i) == 0) // epsilon
+        if (tables.get_transition_input(i) == 0) // epsilon
         {
             // We try to trap non-progressing loops
             if (traversal_states.count(epsilon_reachable) == 1) {
@@ -69,12 +77,12 @@ void Transducer::find_loop_epsilon_transitions(
             traversal_states.erase(epsilon_reachable);
             found_transition = true;
             ++i;
-        } else if (alphabet->is_flag_diacritic(
-                       tables->get_transition_input(i))) {
+        } else if (alphabet.is_flag_diacritic(
+                       tables.get_transition_input(i))) {
             
             if (flag_state.apply_operation(
-                    *(alphabet->get_operation(
-                          tables->get_transition_input(i))))) {
+                    *(alphabet.get_operation(
+                          tables.get_transition_input(i))))) {
                 // flag diacritic allowed
                 if (traversal_states.count(epsilon_reachable) == 1) {
                     // We've been here before
@@ -84,7 +92,7 @@ void Transducer::find_loop_epsilon_transitions(
                 find_loop(input_pos, target);
                 traversal_states.erase(epsilon_reachable);
             }
-            flag_state.assign_values(flags);
+            flag_state.restore(flags);
             ++i;
         } else { // it's not epsilon and it's not a flag, so nothing to do
             return;
@@ -92,28 +100,28 @@ void Transducer::find_loop_epsilon_transitions(
     }
 }
 
-void Transducer::find_loop_epsilon_indices(unsigned int input_pos,
+void EpsilonLoopFinder::find_loop_epsilon_indices(unsigned int input_pos,
                                                 TransitionTableIndex i)
 {
-    if (tables->get_index_input(i) == 0)
+    if (tables.get_index_input(i) == 0)
     {
         find_loop_epsilon_transitions(
             input_pos,
-            tables->get_index_target(i) - TRANSITION_TARGET_TABLE_START);
+            tables.get_index_target(i) - TRANSITION_TARGET_TABLE_START);
         found_transition = true;
     }
 }
 
-void Transducer::find_loop_transitions(SymbolNumber input,
+void EpsilonLoopFinder::find_loop_transitions(SymbolNumber input,
                                             unsigned int input_pos,
                                             TransitionTableIndex i)
 {
 
-    while (tables->get_transition_input(i) != NO_SYMBOL_NUMBER) {
-        if (tables->get_transition_input(i) == input) {
+    while (tables.get_transition_input(i) != NO_SYMBOL_NUMBER) {
+        if (tables.get_transition_input(i) == input) {
             // We're not going to find an epsilon / flag loop
             traversal_states.clear();
-            find_loop(input_pos, tables->get_transition_target(i));
+            find_loop(input_pos, tables.get_transition_target(i));
             found_transition = true;
         } else {
             return;
@@ -122,15 +130,15 @@ void Transducer::find_loop_transitions(SymbolNumber input,
     }
 }
 
-void Transducer::find_loop_index(SymbolNumber input,
+void EpsilonLoopFinder::find_loop_index(SymbolNumber input,
                                       unsigned int input_pos,
                                       TransitionTableIndex i)
 {
-    if (tables->get_index_input(i+input) == input)
+    if (tables.get_index_input(i+input) == input)
     {
         find_loop_transitions(input,
                               input_pos,
-                              tables->get_index_target(i+input) - 
+                              tables.get_index_target(i+input) - 
                               TRANSITION_TARGET_TABLE_START);
         found_transition = true;
     }
@@ -139,7 +147,7 @@ void Transducer::find_loop_index(SymbolNumber input,
 
 
 
-void Transducer::find_loop(unsigned int input_pos,
+void EpsilonLoopFinder::find_loop(unsigned int input_pos,
                            TransitionTableIndex i)
 {
     found_transition = false;
@@ -159,9 +167,9 @@ void Transducer::find_loop(unsigned int input_pos,
         ++input_pos;
 
         find_loop_transitions(input, input_pos, i+1);
-        if (alphabet->get_default_symbol() != NO_SYMBOL_NUMBER &&
+        if (alphabet.get_default_symbol() != NO_SYMBOL_NUMBER &&
             !found_transition) {
-            find_loop_transitions(alphabet->get_default_symbol(),
+            find_loop_transitions(alphabet.get_default_symbol(),
                                   input_pos, i+1);
         }
     }
@@ -180,8 +188,8 @@ void Transducer::find_loop(unsigned int input_pos,
         find_loop_index(input, input_pos, i+1);
         // If we have a default symbol defined and we didn't find an index,
         // check for that
-        if (alphabet->get_default_symbol() != NO_SYMBOL_NUMBER && !found_transition) {
-            find_loop_index(alphabet->get_default_symbol(),
+        if (alphabet.get_default_symbol() != NO_SYMBOL_NUMBER && !found_transition) {
+            find_loop_index(alphabet.get_default_symbol(),
                             input_pos, i+1);
         }
     }
@@ -36,7 +36,7 @@ bool InputString::initialize(const Encoder & encoder,
     
     while (**inpointer != '\0') {
 	oldpointer = *inpointer;
-	k = const_cast<Encoder&>(encoder).find_key(inpointer);
+	k = encoder.find_key(inpointer);
 	
 	if (k == NO_SYMBOL_NUMBER) { // no tokenization from alphabet
 	    int n = nByte_utf8(static_cast<unsigned char>(*oldpointer));
@@ -59,85 +59,96 @@ bool InputString::initialize(const Encoder & encoder,
     return true;
 }
 
-TreeNode TreeNode::update_lexicon(SymbolNumber next_symbol,
-				  TransitionTableIndex next_lexicon,
-				  Weight weight)
+void Speller::start_search(void)
 {
-    SymbolNumberVector str(this->string);
-    str.push_back(next_symbol);
-    return TreeNode(str,
-		    this->input_state,
-		    this->mutator_state,
-		    next_lexicon,
-		    this->flag_state,
-		    this->weight + weight);
+    queue = TreeNodeQueue();
+    best_weights.clear();
+    string_nodes.clear();
+    string_numbers.clear();
+    StringNode empty = {0, 0};
+    string_nodes.push_back(empty);
+    flag_state.reset();
 }
 
-TreeNode TreeNode::update_mutator(SymbolNumber next_symbol,
-				  TransitionTableIndex next_mutator,
-				  Weight weight)
+unsigned int Speller::extend_string(unsigned int string, SymbolNumber symbol)
 {
-    SymbolNumberVector str(this->string);
-    str.push_back(next_symbol);
-    return TreeNode(str,
-		    this->input_state,
-		    next_mutator,
-		    this->lexicon_state,
-		    this->flag_state,
-		    this->weight + weight);
+    // Epsilons and flag diacritics are not written out. The symbol table
+    // may name them, as the transducers converted in memory do, so
+    // writing them would put "@_EPSILON_SYMBOL_@" into the suggestions.
+    if (!record_strings || symbol == 0 || lexicon->is_flag(symbol)) {
+	return string;
+    }
+    unsigned long long key =
+	(static_cast<unsigned long long>(string) << 16) | symbol;
+    std::unordered_map<unsigned long long, unsigned int>::const_iterator it =
+	string_numbers.find(key);
+    if (it != string_numbers.end()) {
+	return it->second;
+    }
+    StringNode node = {string, symbol};
+    string_nodes.push_back(node);
+    string_numbers[key] = string_nodes.size() - 1;
+    return string_nodes.size() - 1;
 }
 
-TreeNode TreeNode::update(SymbolNumber next_symbol,
-			  unsigned int next_input,
-			  TransitionTableIndex next_mutator,
-			  TransitionTableIndex next_lexicon,
-			  Weight weight)
+void Speller::push(const TreeNode & node,
+		   SymbolNumber symbol,
+		   unsigned int input_state,
+		   TransitionTableIndex mutator_state,
+		   TransitionTableIndex lexicon_state,
+		   Weight weight)
 {
-    SymbolNumberVector str(this->string);
-    str.push_back(next_symbol);
-    return TreeNode(str,
-		    next_input,
-		    next_mutator,
-		    next_lexicon,
-		    this->flag_state,
-		    this->weight + weight);
+    TreeNode next(node);
+    next.weight = node.weight + weight;
+    if (next.weight > weight_limit) {
+	return;
+    }
+    next.string = extend_string(node.string, symbol);
+    next.input_state = input_state;
+    next.mutator_state = mutator_state;
+    next.lexicon_state = lexicon_state;
+
+    std::pair<std::unordered_map<TreeNode, Weight, TreeNodeConfiguration,
+				 TreeNodeConfiguration>::iterator, bool>
+	seen = best_weights.insert(std::make_pair(next, next.weight));
+    if (!seen.second) {
+	if (!(next.weight < seen.first->second)) {
+	    return; // reached already at least as cheaply
+	}
+	seen.first->second = next.weight;
+    }
+    queue.push(next);
 }
 
-TreeNode TreeNode::update(SymbolNumber next_symbol,
-			  TransitionTableIndex next_mutator,
-			  TransitionTableIndex next_lexicon,
-			  Weight weight)
+bool Speller::is_stale(const TreeNode & node) const
 {
-    SymbolNumberVector str(this->string);
-    str.push_back(next_symbol);
-    return TreeNode(str,
-		    this->input_state,
-		    next_mutator,
-		    next_lexicon,
-		    this->flag_state,
-		    this->weight + weight);
+    // a cheaper way to the same configuration has been found since
+    std::unordered_map<TreeNode, Weight, TreeNodeConfiguration,
+		       TreeNodeConfiguration>::const_iterator it =
+	best_weights.find(node);
+    return it != best_weights.end() && it->second < node.weight;
 }
 
-void Speller::lexicon_epsilons(void)
+void Speller::lexicon_epsilons(const TreeNode & node)
 {
-    if (!lexicon->has_epsilons_or_flags(queue.front().lexicon_state + 1)) {
+    if (!lexicon->has_epsilons_or_flags(node.lexicon_state + 1)) {
 	return;
     }
-    TransitionTableIndex next = lexicon->next(queue.front().lexicon_state, 0);
+    TransitionTableIndex next = lexicon->next(node.lexicon_state, 0);
     STransition i_s = lexicon->take_epsilons_and_flags(next);
     
     while (i_s.symbol != NO_SYMBOL_NUMBER) {
 	if (lexicon->get_transition(next).get_input_symbol() == 0) {
-	    queue.push_back(queue.front().update_lexicon(i_s.symbol,
-                                                         i_s.index,
-                                                         i_s.weight));
+	    push(node, i_s.symbol, node.input_state, node.mutator_state,
+		 i_s.index, i_s.weight);
 	} else {
-	    TreeNode front = queue.front();
-	    if (front.flag_state.apply_operation(
+	    flag_state.restore(node.flag_values);
+	    if (flag_state.apply_operation(
 		    lexicon->get_transition(next).get_input_symbol())) {
-		queue.push_back(front.update_lexicon(i_s.symbol,
-						     i_s.index,
-						     i_s.weight));
+		TreeNode flagged(node);
+		flagged.flag_values = flag_state.save();
+		push(flagged, i_s.symbol, node.input_state,
+		     node.mutator_state, i_s.index, i_s.weight);
 	    }
 	}
 	++next;
@@ -145,27 +156,23 @@ void Speller::lexicon_epsilons(void)
     }
 }
 
-void Speller::lexicon_consume(void)
+void Speller::lexicon_consume(const TreeNode & node)
 {
-    unsigned int input_state = queue.front().input_state;
+    unsigned int input_state = node.input_state;
     if (input_state >= input.len()||
 	!lexicon->has_transitions(
-	    queue.front().lexicon_state + 1, input[input_state])) {
+	    node.lexicon_state + 1, input[input_state])) {
 	return;
     }
 
-    TransitionTableIndex next = lexicon->next(queue.front().lexicon_state,
+    TransitionTableIndex next = lexicon->next(node.lexicon_state,
 					      input[input_state]);
     STransition i_s = lexicon->take_non_epsilons(next,
 						 input[input_state]);
 
     while (i_s.symbol != NO_SYMBOL_NUMBER) {
-	queue.push_back(queue.front().update(
-			    i_s.symbol,
-			    input_state + 1,
-			    queue.front().mutator_state,
-			    i_s.index,
-			    i_s.weight));
+	push(node, i_s.symbol, input_state + 1, node.mutator_state,
+	     i_s.index, i_s.weight);
 	
 	++next;
 	i_s = lexicon->take_non_epsilons(next, input[input_state]);
@@ -173,40 +180,37 @@ void Speller::lexicon_consume(void)
     
 }
 
-void Speller::mutator_epsilons(void)
+void Speller::mutator_epsilons(const TreeNode & node)
 {
-    if (!mutator->has_transitions(queue.front().mutator_state + 1, 0)) {
+    if (!mutator->has_transitions(node.mutator_state + 1, 0)) {
 	return;
     }
-    TransitionTableIndex next_m = mutator->next(queue.front().mutator_state, 0);
+    TransitionTableIndex next_m = mutator->next(node.mutator_state, 0);
     STransition mutator_i_s = mutator->take_epsilons(next_m);
    
     while (mutator_i_s.symbol != NO_SYMBOL_NUMBER) {
 	if (mutator_i_s.symbol == 0) {
-	    queue.push_back(queue.front().update_mutator(mutator_i_s.symbol,
-							 mutator_i_s.index,
-							 mutator_i_s.weight));
+	    push(node, 0, node.input_state, mutator_i_s.index,
+		 node.lexicon_state, mutator_i_s.weight);
 	} else {
 	    if (!lexicon->has_transitions(
-		    queue.front().lexicon_state + 1,
+		    node.lexicon_state + 1,
 		    alphabet_translator[mutator_i_s.symbol])) {
 		++next_m;
 		mutator_i_s = mutator->take_epsilons(next_m);
 		continue;
 	    }
 	    TransitionTableIndex next_l = lexicon->next(
-		queue.front().lexicon_state,
+		node.lexicon_state,
 		alphabet_translator[mutator_i_s.symbol]);
 	    STransition lexicon_i_s = lexicon->take_non_epsilons(
 		next_l,
 		alphabet_translator[mutator_i_s.symbol]);
 	    
 	    while (lexicon_i_s.symbol != NO_SYMBOL_NUMBER) {
-		queue.push_back(queue.front().update(
-				    lexicon_i_s.symbol,
-				    mutator_i_s.index,
-				    lexicon_i_s.index,
-				    lexicon_i_s.weight + mutator_i_s.weight));
+		push(node, lexicon_i_s.symbol, node.input_state,
+		     mutator_i_s.index, lexicon_i_s.index,
+		     lexicon_i_s.weight + mutator_i_s.weight);
 		++next_l;
 		lexicon_i_s = lexicon->take_non_epsilons(
 		    next_l,
@@ -218,16 +222,16 @@ void Speller::mutator_epsilons(void)
     }
 }
 
-void Speller::consume_input(void)
+void Speller::consume_input(const TreeNode & node)
 {
-    unsigned int input_state = queue.front().input_state;
+    unsigned int input_state = node.input_state;
     if (input_state >= input.len()||
-	!mutator->has_transitions(queue.front().mutator_state + 1,
+	!mutator->has_transitions(node.mutator_state + 1,
 				  input[input_state])) {
 	return; // not enough input to consume of no suitable transitions
     }
     
-    TransitionTableIndex next_m = mutator->next(queue.front().mutator_state,
+    TransitionTableIndex next_m = mutator->next(node.mutator_state,
 						input[input_state]);
     
     STransition mutator_i_s = mutator->take_non_epsilons(next_m,
@@ -236,15 +240,11 @@ void Speller::consume_input(void)
     while (mutator_i_s.symbol != NO_SYMBOL_NUMBER) {
 
 	if (mutator_i_s.symbol == 0) {
-	    
-	    queue.push_back(queue.front().update(0,
-						 input_state + 1,
-						 mutator_i_s.index,
-						 queue.front().lexicon_state,
-						 mutator_i_s.weight));
+	    push(node, 0, input_state + 1, mutator_i_s.index,
+		 node.lexicon_state, mutator_i_s.weight);
 	} else {
 	    if (!lexicon->has_transitions(
-		    queue.front().lexicon_state + 1,
+		    node.lexicon_state + 1,
 		    alphabet_translator[mutator_i_s.symbol])) {
 		++next_m;
 		mutator_i_s = mutator->take_non_epsilons(next_m,
@@ -252,7 +252,7 @@ void Speller::consume_input(void)
 		continue;
 	    }
 	    TransitionTableIndex next_l = lexicon->next(
-		queue.front().lexicon_state,
+		node.lexicon_state,
 		alphabet_translator[mutator_i_s.symbol]);
 	    
 	    STransition lexicon_i_s = lexicon->take_non_epsilons(
@@ -260,12 +260,9 @@ void Speller::consume_input(void)
 		alphabet_translator[mutator_i_s.symbol]);
 	    
 	    while (lexicon_i_s.symbol != NO_SYMBOL_NUMBER) {
-		queue.push_back(
-		    queue.front().update(lexicon_i_s.symbol,
-					 input_state + 1,
-					 mutator_i_s.index,
-					 lexicon_i_s.index,
-					 lexicon_i_s.weight + mutator_i_s.weight));
+		push(node, lexicon_i_s.symbol, input_state + 1,
+		     mutator_i_s.index, lexicon_i_s.index,
+		     lexicon_i_s.weight + mutator_i_s.weight);
 		++next_l;
 		lexicon_i_s = lexicon->take_non_epsilons(
 		    next_l,
@@ -279,46 +276,136 @@ void Speller::consume_input(void)
 }
 
 
-CorrectionQueue Speller::correct(char * line)
+bool Speller::has_negative_weights(const Transducer * t)
+{
+    if (!t->get_header().probe_flag(Weighted)) {
+	return false;
+    }
+    for (TransitionTableIndex i = 0;
+	 i < t->get_header().index_table_size(); ++i) {
+	if (t->get_index(i).final() && t->get_index(i).final_weight() < 0.0) {
+	    return true;
+	}
+    }
+    // final weights of states without an index entry are here too
+    for (TransitionTableIndex i = 0;
+	 i < t->get_header().target_table_size(); ++i) {
+	if (t->get_transition(i).get_weight() < 0.0) {
+	    return true;
+	}
+    }
+    return false;
+}
+
+static bool lighter_correction(const StringWeightPair & lhs,
+			       const StringWeightPair & rhs)
+{
+    return lhs.second < rhs.second;
+}
+
+/* Apply the limits of correct() to all the \a corrections there are. */
+static CorrectionQueue limit_corrections(
+    const std::unordered_map<std::string, Weight> & corrections,
+    int nbest, Weight max_weight, Weight beam)
 {
+    std::vector<StringWeightPair> sorted(corrections.begin(),
+					 corrections.end());
+    std::sort(sorted.begin(), sorted.end(), lighter_correction);
+    CorrectionQueue correction_queue;
+    for (size_t i = 0; i < sorted.size(); ++i) {
+	if ((max_weight >= 0.0 && sorted[i].second > max_weight) ||
+	    (beam >= 0.0 && sorted[i].second > sorted[0].second + beam) ||
+	    (nbest > 0 && i >= static_cast<size_t>(nbest))) {
+	    break;
+	}
+	correction_queue.push(sorted[i]);
+    }
+    return correction_queue;
+}
+
+CorrectionQueue Speller::correct(char * line, int nbest,
+				 Weight max_weight, Weight beam,
+				 double time_cutoff)
+{
+    CorrectionQueue correction_queue;
     // if input initialization fails, return empty correction queue
     if (!init_input(line, mutator->get_encoder(),
-                    mutator->get_unknown_symbol())) {
-	return CorrectionQueue();
+		    mutator->get_unknown_symbol())) {
+	return correction_queue;
     }
-    std::map<std::string, Weight> corrections;
-    TreeNode start_node(lexicon->get_fd_table());
-    queue.assign(1, start_node);
+    start_search();
+    record_strings = true;
+    // with negative weights a configuration may yet get lighter, so
+    // nothing is cut off before the search is over
+    weight_limit = (max_weight < 0.0 || negative_weights) ?
+	std::numeric_limits<Weight>::max() : max_weight;
+    deadline.start(time_cutoff);
+    std::set<std::string> corrections;
+    std::unordered_map<std::string, Weight> all_corrections;
+    queue.push(TreeNode(flag_state.save()));
 
     while (queue.size() > 0) {
-	lexicon_epsilons();
-	mutator_epsilons();
-	if (queue.front().input_state == input.len()) {
+	TreeNode node = queue.top();
+	queue.pop();
+	if (node.weight > weight_limit) {
+	    break; // the rest are heavier still
+	}
+	if (node.finished && negative_weights) {
+	    std::string string = stringify(node.string);
+	    std::pair<std::unordered_map<std::string, Weight>::iterator, bool>
+		seen = all_corrections.insert(
+		    std::make_pair(string, node.weight));
+	    if (!seen.second && node.weight < seen.first->second) {
+		seen.first->second = node.weight;
+	    }
+	    continue;
+	}
+	if (node.finished) {
+	    /* corrections come out lightest first, so a correction
+	     * that has been seen is already there with a better weight
+	     */
+	    std::string string = stringify(node.string);
+	    if (corrections.insert(string).second) {
+		correction_queue.push(StringWeightPair(string, node.weight));
+		if (beam >= 0.0 && corrections.size() == 1 &&
+		    node.weight + beam < weight_limit) {
+		    weight_limit = node.weight + beam;
+		}
+		if (nbest > 0 &&
+		    correction_queue.size() >= static_cast<size_t>(nbest)) {
+		    break;
+		}
+	    }
+	    continue;
+	}
+	if (is_stale(node)) {
+	    continue;
+	}
+	if (deadline.expired()) {
+	    break;
+	}
+	lexicon_epsilons(node);
+	mutator_epsilons(node);
+	if (node.input_state == input.len()) {
 	    /* if our transducers are in final states
 	     * we generate the correction
 	     */
-	    if (mutator->final_index(queue.front().mutator_state)&&
-		lexicon->final_index(queue.front().lexicon_state)) {
-		std::string string = stringify(queue.front().string);
-		Weight weight = queue.front().weight +
-		    lexicon->final_weight(queue.front().lexicon_state) +
-		    mutator->final_weight(queue.front().mutator_state);
-		/* if the correction is novel or better than before, insert it
-		 */
-		if (corrections.count(string) == 0||
-		    corrections[string] > weight) {
-		    corrections[string] = weight;
+	    if (mutator->final_index(node.mutator_state)&&
+		lexicon->final_index(node.lexicon_state)) {
+		TreeNode finished(node);
+		finished.weight += lexicon->final_weight(node.lexicon_state) +
+		    mutator->final_weight(node.mutator_state);
+		finished.finished = true;
+		if (!(finished.weight > weight_limit)) {
+		    queue.push(finished);
 		}
 	    }
 	} else {
-	    consume_input();
+	    consume_input(node);
 	}
-	queue.pop_front();
     }
-    CorrectionQueue correction_queue;
-    std::map<std::string, Weight>::iterator it;
-    for (it = corrections.begin(); it != corrections.end(); ++it) {
-	correction_queue.push(StringWeightPair(it->first, it->second));
+    if (negative_weights) {
+	return limit_corrections(all_corrections, nbest, max_weight, beam);
     }
     return correction_queue;
 }
@@ -328,26 +415,40 @@ bool Speller::check(char * line)
     if (!init_input(line, lexicon->get_encoder(), NO_SYMBOL_NUMBER)) {
 	return false;
     }
-    TreeNode start_node(lexicon->get_fd_table());
-    queue.assign(1, start_node);
+    start_search();
+    record_strings = false;
+    weight_limit = std::numeric_limits<Weight>::max();
+    deadline.start(0.0);
+    queue.push(TreeNode(flag_state.save()));
 
     while (queue.size() > 0) {
-	if (queue.front().input_state == input.len()&&
-	    lexicon->final_index(queue.front().lexicon_state)) {
+	TreeNode node = queue.top();
+	queue.pop();
+	if (node.input_state == input.len()&&
+	    lexicon->final_index(node.lexicon_state)) {
 	    return true;
 	}
-	lexicon_epsilons();
-	lexicon_consume();
-	queue.pop_front();
+	if (is_stale(node)) {
+	    continue;
+	}
+	if (deadline.expired()) {
+	    break;
+	}
+	lexicon_epsilons(node);
+	lexicon_consume(node);
     }
     return false;
 }
 
-std::string Speller::stringify(SymbolNumberVector symbol_vector)
+std::string Speller::stringify(unsigned int string)
 {
+    SymbolNumberVector symbol_vector;
+    for (; string != 0; string = string_nodes[string].parent) {
+	symbol_vector.push_back(string_nodes[string].symbol);
+    }
     std::string s;
-    for (SymbolNumberVector::iterator it = symbol_vector.begin();
-	 it != symbol_vector.end(); ++it) {
+    for (SymbolNumberVector::reverse_iterator it = symbol_vector.rbegin();
+	 it != symbol_vector.rend(); ++it) {
 	s.append(symbol_table[*it]);
     }
     return s;
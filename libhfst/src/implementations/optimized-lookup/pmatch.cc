@@ -35,11 +35,29 @@ void PmatchAlphabet::add_symbol(const std::string & symbol)
     printable_vector.push_back(true);
 }
 
-bool PmatchAlphabet::is_printable(SymbolNumber symbol)
+bool PmatchAlphabet::is_printable(SymbolNumber symbol) const
 {
     return symbol < printable_vector.size() && printable_vector[symbol];
 }
 
+bool PmatchAlphabet::is_printable(SymbolNumber symbol,
+                                  const SymbolTable & extra_symbols) const
+{
+    if (symbol >= symbol_table.size()) {
+        return symbol - symbol_table.size() < extra_symbols.size();
+    }
+    return is_printable(symbol);
+}
+
+std::string PmatchAlphabet::string_from_symbol(
+    SymbolNumber symbol, const SymbolTable & extra_symbols) const
+{
+    if (symbol >= symbol_table.size()) {
+        return extra_symbols.at(symbol - symbol_table.size());
+    }
+    return TransducerAlphabet::string_from_symbol(symbol);
+}
+
 void PmatchAlphabet::add_special_symbol(const std::string & str,
                                          SymbolNumber symbol_number)
 {
@@ -151,20 +169,18 @@ void PmatchAlphabet::process_counter(std::string str, SymbolNumber sym)
     counters.push_back(0);
 }
 
-void PmatchAlphabet::count(SymbolNumber sym)
+void PmatchSession::count(SymbolNumber sym)
 {
-    if (is_counter(sym)) {
+    if (alphabet.is_counter(sym)) {
         counters[sym]++;
     }
 }
 
 PmatchContainer::PmatchContainer(std::istream & inputstream):
     verbose(false),
-    locate_mode(false),
     profile_mode(false),
     single_codepoint_tokenization(false),
-    recursion_depth_left(PMATCH_MAX_RECURSION_DEPTH),
-    entry_stack()
+    session(NULL)
 {
     std::string transducer_name;
     transducer_name = parse_name_from_hfst3_header(inputstream);
@@ -173,16 +189,14 @@ PmatchContainer::PmatchContainer(std::istream & inputstream):
 
     TransducerHeader header(inputstream);
     alphabet = PmatchAlphabet(inputstream, header.symbol_count());
-    orig_symbol_count = symbol_count = alphabet.get_orig_symbol_count();
-    alphabet.extract_tags = locate_mode;
-    line_number = 0;
+    orig_symbol_count = alphabet.get_orig_symbol_count();
+    alphabet.extract_tags = false;
     encoder = new Encoder(alphabet.get_symbol_table(), orig_symbol_count);
     toplevel = new hfst_ol::PmatchTransducer(
         inputstream,
         header.index_table_size(),
         header.target_table_size(),
-        alphabet,
-        this);
+        alphabet);
     while (inputstream.good()) {
         try {
             transducer_name = parse_name_from_hfst3_header(inputstream);
@@ -196,33 +210,36 @@ PmatchContainer::PmatchContainer(std::istream & inputstream):
             new hfst_ol::PmatchTransducer(inputstream,
                                           header.index_table_size(),
                                           header.target_table_size(),
-                                          alphabet,
-                                          this);
+                                          alphabet);
         if (!alphabet.has_rtn(transducer_name)) {
             alphabet.add_rtn(rtn, transducer_name);
         } else {
             delete rtn;
         }
     }
-    
-    toplevel->collect_possible_first_symbols();
+
+    // Collecting the first symbols walks the transducers, so it's done
+    // with our session's copies of them
+    session = new PmatchSession(*this);
+    session->toplevel->collect_possible_first_symbols();
 
     // Finally fetch the first symbols from any
     // first-position rtn arcs in TOP. If they are potential epsilon loops,
     // clear out the set.
     SymbolNumber max_input_sym = 0;
-    std::set<SymbolNumber> & possible_firsts = toplevel->possible_first_symbols;
+    std::set<SymbolNumber> & possible_firsts =
+        session->toplevel->possible_first_symbols;
     for (std::set<SymbolNumber>::iterator it = possible_firsts.begin();
          it != possible_firsts.end(); ++it) {
         if (*it > max_input_sym) { max_input_sym = *it; }
         if (alphabet.has_rtn(*it)) {
-            if (alphabet.get_rtn(*it) == toplevel) {
+            if (session->get_rtn(*it) == session->toplevel) {
                 possible_firsts.clear();
                 break;
             }
-            alphabet.get_rtn(*it)->collect_possible_first_symbols();
+            session->get_rtn(*it)->collect_possible_first_symbols();
             std::set<SymbolNumber> rtn_firsts =
-                alphabet.get_rtn(*it)->possible_first_symbols;
+                session->get_rtn(*it)->possible_first_symbols;
             for (RtnNameMap::const_iterator it = alphabet.rtn_names.begin();
                  it != alphabet.rtn_names.end(); ++it) {
                 if (rtn_firsts.count(it->second) == 1) {
@@ -266,7 +283,10 @@ PmatchContainer::PmatchContainer(std::istream & inputstream):
 
 }
 
-PmatchContainer::PmatchContainer(void)
+PmatchContainer::PmatchContainer(void):
+    encoder(NULL),
+    toplevel(NULL),
+    session(NULL)
 {
     // Not used, but apparently needed by swig to construct these
 }
@@ -336,27 +356,32 @@ std::string PmatchAlphabet::name_from_insertion(const std::string & symbol)
     return symbol.substr(sizeof("@I.") - 1, symbol.size() - (sizeof("@I.@") - 1));
 }
 
-std::string PmatchAlphabet::end_tag(const SymbolNumber symbol)
+std::string PmatchAlphabet::end_tag(const SymbolNumber symbol) const
 {
-    if (end_tag_map.count(symbol) == 0) {
+    std::map<SymbolNumber, std::string>::const_iterator it =
+        end_tag_map.find(symbol);
+    if (it == end_tag_map.end()) {
         return "";
     } else {
-        return "</" + end_tag_map[symbol] + ">";
+        return "</" + it->second + ">";
     }
 }
 
-std::string PmatchAlphabet::start_tag(const SymbolNumber symbol)
+std::string PmatchAlphabet::start_tag(const SymbolNumber symbol) const
 {
-    if (end_tag_map.count(symbol) == 0) {
+    std::map<SymbolNumber, std::string>::const_iterator it =
+        end_tag_map.find(symbol);
+    if (it == end_tag_map.end()) {
         return "";
     } else {
-        return "<" + end_tag_map[symbol] + ">";
+        return "<" + it->second + ">";
     }
     
 }
 
 PmatchContainer::~PmatchContainer(void)
 {
+    delete session;
     delete encoder;
     delete toplevel;
 }
@@ -454,12 +479,12 @@ bool PmatchAlphabet::has_rtn(SymbolNumber symbol) const
     return symbol < rtns.size() && rtns[symbol] != NULL;
 }
 
-PmatchTransducer * PmatchAlphabet::get_rtn(SymbolNumber symbol)
+PmatchTransducer * PmatchAlphabet::get_rtn(SymbolNumber symbol) const
 {
     return rtns[symbol];
 }
 
-std::string PmatchAlphabet::get_counter_name(SymbolNumber symbol)
+std::string PmatchAlphabet::get_counter_name(SymbolNumber symbol) const
 {
     if (symbol_table.size() <= symbol) {
         return "INVALID_COUNTER";
@@ -477,7 +502,40 @@ SymbolNumber PmatchAlphabet::get_special(SpecialSymbol special) const
     return special_symbols.at(special);
 }
 
-void PmatchContainer::process(std::string & input_str)
+PmatchSession::PmatchSession(const PmatchContainer & cont):
+    container(cont),
+    alphabet(cont.alphabet),
+    toplevel(NULL),
+    rtns(cont.alphabet.rtns.size(), NULL),
+    symbol_count(cont.alphabet.get_symbol_table().size()),
+    counters(cont.alphabet.counters),
+    locate_mode(false),
+    recursion_depth_left(PMATCH_MAX_RECURSION_DEPTH),
+    limit_reached(false),
+    line_number(0),
+    messages(&std::cerr)
+{
+    toplevel = new PmatchTransducer(*container.toplevel, this);
+    for (SymbolNumber i = 0; i < rtns.size(); ++i) {
+        if (alphabet.rtns[i] == container.toplevel) {
+            rtns[i] = toplevel;
+        } else if (alphabet.rtns[i] != NULL) {
+            rtns[i] = new PmatchTransducer(*alphabet.rtns[i], this);
+        }
+    }
+}
+
+PmatchSession::~PmatchSession(void)
+{
+    for (RtnVector::iterator it = rtns.begin(); it != rtns.end(); ++it) {
+        if (*it != toplevel) {
+            delete *it;
+        }
+    }
+    delete toplevel;
+}
+
+void PmatchSession::process(const std::string & input_str)
 {
     initialize_input(input_str.c_str());
     unsigned int input_pos = 0;
@@ -489,10 +547,10 @@ void PmatchContainer::process(std::string & input_str)
     DoubleTape nonmatching_locations;
     while (has_queued_input(input_pos)) {
         SymbolNumber current_input = input[input_pos];
-        if (not_possible_first_symbol(current_input)) {
+        if (container.not_possible_first_symbol(current_input)) {
             copy_to_output(current_input, current_input);
             ++input_pos;
-            if (locate_mode && alphabet.is_printable(current_input)) {
+            if (locate_mode && is_printable(current_input)) {
                 ++printable_input_pos;
                 nonmatching_locations.push_back(
                     SymbolPair(current_input, current_input));
@@ -509,7 +567,8 @@ void PmatchContainer::process(std::string & input_str)
                 if (!nonmatching_locations.empty()) {
                     LocationVector ls;
                     Location nonmatching = alphabet.locatefy(printable_input_pos - nonmatching_locations.size(),
-                                                             WeightedDoubleTape(nonmatching_locations, 0.0));
+                                                             WeightedDoubleTape(nonmatching_locations, 0.0),
+                                                             extra_symbols);
                     nonmatching.output = "@_NONMATCHING_@";
                     ls.push_back(nonmatching);
                     locations.push_back(ls);
@@ -519,7 +578,7 @@ void PmatchContainer::process(std::string & input_str)
                 for (WeightedDoubleTapeVector::iterator it = (toplevel->locations)->begin();
                      it != (toplevel->locations)->end(); ++it) {
                     ls.push_back(alphabet.locatefy(printable_input_pos,
-                                                          *it));
+                                                   *it, extra_symbols));
                 }
                 sort(ls.begin(), ls.end());
                 locations.push_back(ls);
@@ -532,7 +591,7 @@ void PmatchContainer::process(std::string & input_str)
             // If nothing happened, we move one position up
             copy_to_output(current_input, current_input);
             ++input_pos;
-            if (locate_mode && alphabet.is_printable(current_input)) {
+            if (locate_mode && is_printable(current_input)) {
                 ++printable_input_pos;
                 nonmatching_locations.push_back(SymbolPair(current_input, current_input));
             }
@@ -541,41 +600,60 @@ void PmatchContainer::process(std::string & input_str)
     if (locate_mode && !nonmatching_locations.empty()) {
         LocationVector ls;
         Location nonmatching = alphabet.locatefy(printable_input_pos - nonmatching_locations.size(),
-                                                 WeightedDoubleTape(nonmatching_locations, 0.0));
+                                                 WeightedDoubleTape(nonmatching_locations, 0.0),
+                                                 extra_symbols);
         nonmatching.output = "@_NONMATCHING_@";
         ls.push_back(nonmatching);
         locations.push_back(ls);
     }
 }
 
-std::string PmatchContainer::match(std::string & input,
-                                   double time_cutoff)
+void PmatchSession::start_timing(double time_cutoff)
 {
-    max_time = time_cutoff;
-    if (max_time > 0.0) {
-        start_clock = clock();
-        call_counter = 0;
-        limit_reached = false;
-    }
+    deadline.start(time_cutoff);
+    limit_reached = false;
+}
+
+std::string PmatchSession::match(const std::string & input,
+                                 double time_cutoff)
+{
+    start_timing(time_cutoff);
     locate_mode = false;
     process(input);
-    return stringify_output();
+    return stringify(output);
 }
 
-LocationVectorVector PmatchContainer::locate(std::string & input,
-                                             double time_cutoff)
+LocationVectorVector PmatchSession::locate(const std::string & input,
+                                           double time_cutoff)
 {
-    max_time = time_cutoff;
-    if (max_time > 0.0) {
-        start_clock = clock();
-        call_counter = 0;
-        limit_reached = false;
-    }
+    start_timing(time_cutoff);
     locate_mode = true;
     process(input);
     return locations;
 }
 
+std::string PmatchContainer::match(std::string & input,
+                                   double time_cutoff)
+{
+    return session->match(input, time_cutoff);
+}
+
+LocationVectorVector PmatchContainer::locate(std::string & input,
+                                             double time_cutoff)
+{
+    return session->locate(input, time_cutoff);
+}
+
+void PmatchContainer::cancel(void)
+{
+    session->cancel();
+}
+
+std::string PmatchContainer::get_profiling_info(void)
+{
+    return session->get_profiling_info();
+}
+
 // A utility comparing function for get_profiling_info
 bool counter_comp(std::pair<std::string, unsigned long> l,
                   std::pair<std::string, unsigned long> r)
@@ -584,22 +662,22 @@ bool counter_comp(std::pair<std::string, unsigned long> l,
     return l.second > r.second;
 }
 
-std::string PmatchContainer::get_profiling_info(void)
+std::string PmatchSession::get_profiling_info(void) const
 {
     std::stringstream retval;
     size_t max_name_len = 0;
     retval << "Profiling information:\n";
     retval << "  Traversals of Counter() positions:\n";
     std::vector<std::pair<std::string, unsigned long> > counter_name_val_pairs;
-    for(SymbolNumber i = 0; i < alphabet.counters.size(); ++i) {
-        if (alphabet.counters[i] != NO_COUNTER) {
+    for(SymbolNumber i = 0; i < counters.size(); ++i) {
+        if (counters[i] != NO_COUNTER) {
             std::string counter_name = alphabet.get_counter_name(i);
             if (counter_name.size() > max_name_len) {
                 max_name_len = counter_name.size();
             }
             counter_name_val_pairs.push_back(
                 std::pair<std::string, unsigned long>(counter_name,
-                                                      alphabet.counters[i]));
+                                                      counters[i]));
         }
     }
     std::sort(counter_name_val_pairs.begin(), counter_name_val_pairs.end(),
@@ -617,7 +695,7 @@ std::string PmatchContainer::get_profiling_info(void)
     return retval.str();
 }
 
-void PmatchContainer::copy_to_output(const DoubleTape & best_result)
+void PmatchSession::copy_to_output(const DoubleTape & best_result)
 {
     for (DoubleTape::const_iterator it = best_result.begin();
          it != best_result.end(); ++it) {
@@ -625,22 +703,14 @@ void PmatchContainer::copy_to_output(const DoubleTape & best_result)
     }
 }
 
-void PmatchContainer::copy_to_output(SymbolNumber input_sym, SymbolNumber output_sym)
+void PmatchSession::copy_to_output(SymbolNumber input_sym, SymbolNumber output_sym)
 {
     output.push_back(SymbolPair(input_sym, output_sym));
 }
 
-std::string PmatchContainer::stringify_output(void)
-{
-    return alphabet.stringify(output);
-}
-
-//LocationVector PmatchContainer::locatefy_output(void)
-//{
-//    return alphabet.locatefy(output);
-//}
-
-std::string PmatchAlphabet::stringify(const DoubleTape & str)
+std::string PmatchAlphabet::stringify(const DoubleTape & str,
+                                      const SymbolTable & extra_symbols,
+                                      std::ostream & messages) const
 {
     std::string retval;
     std::stack<unsigned int> start_tag_pos;
@@ -656,7 +726,7 @@ std::string PmatchAlphabet::stringify(const DoubleTape & str)
         } else if (is_end_tag(output)) {
             unsigned int pos;
             if (start_tag_pos.size() == 0) {
-                std::cerr << "Warning: end tag without start tag\n";
+                messages << "Warning: end tag without start tag\n";
                 pos = 0;
             } else {
                 pos = start_tag_pos.top();
@@ -665,8 +735,8 @@ std::string PmatchAlphabet::stringify(const DoubleTape & str)
             retval.append(end_tag(output));
         } else {
             if ((!extract_tags || start_tag_pos.size() != 0)
-                && is_printable(output)) {
-                retval.append(string_from_symbol(output));
+                && is_printable(output, extra_symbols)) {
+                retval.append(string_from_symbol(output, extra_symbols));
             }
         }
     }
@@ -674,7 +744,8 @@ std::string PmatchAlphabet::stringify(const DoubleTape & str)
 }
 
 Location PmatchAlphabet::locatefy(unsigned int input_offset,
-                                  const WeightedDoubleTape & str)
+                                  const WeightedDoubleTape & str,
+                                  const SymbolTable & extra_symbols) const
 {
     Location retval;
     retval.start = input_offset;
@@ -691,10 +762,10 @@ Location PmatchAlphabet::locatefy(unsigned int input_offset,
             retval.tag = start_tag(output);
             continue;
         }
-        if (is_printable(output)) {
-            retval.output.append(string_from_symbol(output));
+        if (is_printable(output, extra_symbols)) {
+            retval.output.append(string_from_symbol(output, extra_symbols));
         }
-        if (is_printable(input)) {
+        if (is_printable(input, extra_symbols)) {
             orig_input.push_back(input);
             ++input_offset;
         }
@@ -702,7 +773,7 @@ Location PmatchAlphabet::locatefy(unsigned int input_offset,
     retval.length = input_offset - retval.start;
     for(SymbolNumberVector::const_iterator input_it = orig_input.begin();
         input_it != orig_input.end(); ++input_it) {
-        retval.input.append(string_from_symbol(*input_it));
+        retval.input.append(string_from_symbol(*input_it, extra_symbols));
     }
     return retval;
 }
@@ -717,18 +788,16 @@ std::string PmatchContainer::get_unsatisfied_rtn_name(void) const
     return "";
 }
 
-bool PmatchContainer::has_queued_input(unsigned int input_pos)
-{
-    return input_pos < input.size();
-}
-
 PmatchTransducer::PmatchTransducer(std::istream & is,
                                    TransitionTableIndex index_table_size,
                                    TransitionTableIndex transition_table_size,
-                                   PmatchAlphabet & alpha,
-                                   PmatchContainer * cont):
+                                   const PmatchAlphabet & alpha):
+    tables(new Tables),
+    owns_tables(true),
+    transition_table(tables->transition_table),
+    index_table(tables->index_table),
     alphabet(alpha),
-    container(cont),
+    session(NULL),
     locations(NULL)
 {
     orig_symbol_count = alphabet.get_symbol_table().size();
@@ -757,21 +826,21 @@ PmatchTransducer::PmatchTransducer(std::istream & is,
     is.read(indextab, TransitionWIndex::size * index_table_size);
     is.read(transitiontab, TransitionW::size * transition_table_size);
     char * orig_p = indextab;
-    index_table.reserve(index_table_size);
+    tables->index_table.reserve(index_table_size);
     while(index_table_size) {
         // index_table.push_back(
         //     SimpleIndex(*(SymbolNumber *) indextab,
         //                 *(TransitionTableIndex *) (indextab + sizeof(SymbolNumber))));
         // --index_table_size;
-        index_table.push_back(TransitionWIndex(indextab));
+        tables->index_table.push_back(TransitionWIndex(indextab));
         --index_table_size;
         indextab += TransitionWIndex::size;
     }
     free(orig_p);
     orig_p = transitiontab;
-    transition_table.reserve(transition_table_size);
+    tables->transition_table.reserve(transition_table_size);
     while(transition_table_size) {
-        transition_table.push_back(TransitionW(transitiontab));
+        tables->transition_table.push_back(TransitionW(transitiontab));
             // SimpleTransition(*(SymbolNumber *) transitiontab,
             //                  *(SymbolNumber *) (transitiontab + sizeof(SymbolNumber)),
             //                  *(TransitionTableIndex *) (transitiontab + 2*sizeof(SymbolNumber))));
@@ -781,6 +850,28 @@ PmatchTransducer::PmatchTransducer(std::istream & is,
     free(orig_p);
 }
 
+PmatchTransducer::PmatchTransducer(const PmatchTransducer & other,
+                                   PmatchSession * sess):
+    local_stack(other.local_stack),
+    rtn_stack(other.rtn_stack),
+    tables(other.tables),
+    owns_tables(false),
+    transition_table(other.transition_table),
+    index_table(other.index_table),
+    alphabet(other.alphabet),
+    orig_symbol_count(other.orig_symbol_count),
+    session(sess),
+    locations(NULL)
+{}
+
+PmatchTransducer::~PmatchTransducer(void)
+{
+    delete locations;
+    if (owns_tables) {
+        delete tables;
+    }
+}
+
 // Precompute which symbols may be at the start of a match.
 // For now we ignore default arcs, as does the rest of pmatch.
 void PmatchTransducer::collect_possible_first_symbols(void)
@@ -888,7 +979,7 @@ void PmatchTransducer::collect_first_transition(TransitionTableIndex i,
                 // if this is unknown or identity, game over
                 if (*it == alphabet.get_identity_symbol() ||
                     *it == alphabet.get_unknown_symbol()) {
-                    container->reset_recursion();
+                    session->reset_recursion();
                     throw true;
                 }
                 if (alphabet.list2symbols[*it] != NO_SYMBOL_NUMBER) {
@@ -928,12 +1019,12 @@ void PmatchTransducer::collect_first(TransitionTableIndex i,
                                      SymbolNumberVector const& input_symbols,
                                      std::set<TransitionTableIndex> & seen_indices)
 {
-    if (!container->try_recurse()) {
-        container->reset_recursion();
+    if (!session->try_recurse()) {
+        session->reset_recursion();
         throw true;
     }
     if (seen_indices.count(i) == 1) {
-        container->unrecurse();
+        session->unrecurse();
         return;
     } else {
         seen_indices.insert(i);
@@ -945,7 +1036,7 @@ void PmatchTransducer::collect_first(TransitionTableIndex i,
         // If we can get to finality without any input,
         // throw a bool indicating that the full input set is needed
         if (transition_table[i].final()) {
-            container->reset_recursion();
+            session->reset_recursion();
             throw true;
         }
 
@@ -954,7 +1045,7 @@ void PmatchTransducer::collect_first(TransitionTableIndex i,
         
     } else {
         if (index_table[i].final()) {
-            container->reset_recursion();
+            session->reset_recursion();
             throw true;
         }
         collect_first_epsilon_index(i+1, input_symbols, seen_indices);
@@ -964,7 +1055,7 @@ void PmatchTransducer::collect_first(TransitionTableIndex i,
 
 
 
-void PmatchContainer::initialize_input(const char * input_s)
+void PmatchSession::initialize_input(const char * input_s)
 {
     input.clear();
     char * input_str = const_cast<char *>(input_s);
@@ -973,6 +1064,9 @@ void PmatchContainer::initialize_input(const char * input_s)
     SymbolNumber boundary_sym = alphabet.get_special(boundary);
     char * single_codepoint_scratch;
     char * single_codepoint_scratch_orig;
+    bool single_codepoint_tokenization =
+        container.single_codepoint_tokenization;
+    const Encoder * encoder = container.encoder;
     if (single_codepoint_tokenization) {
         single_codepoint_scratch = new char[5];
         single_codepoint_scratch_orig = single_codepoint_scratch;
@@ -1010,10 +1104,16 @@ void PmatchContainer::initialize_input(const char * input_s)
             memcpy(new_symbol, *input_str_ptr, bytes_to_tokenize);
             new_symbol[bytes_to_tokenize] = '\0';
             (*input_str_ptr) += bytes_to_tokenize;
-            alphabet.add_symbol(new_symbol);
-            encoder->read_input_symbol(new_symbol, symbol_count);
-            k = symbol_count;
-            ++symbol_count;
+            StringSymbolMap::const_iterator extra_it =
+                extra_symbol_numbers.find(new_symbol);
+            if (extra_it != extra_symbol_numbers.end()) {
+                k = extra_it->second;
+            } else {
+                extra_symbols.push_back(new_symbol);
+                extra_symbol_numbers[new_symbol] = symbol_count;
+                k = symbol_count;
+                ++symbol_count;
+            }
         }
         input.push_back(k);
     }
@@ -1021,7 +1121,7 @@ void PmatchContainer::initialize_input(const char * input_s)
         input.push_back(boundary_sym);
     }
     if (single_codepoint_tokenization) {
-        delete single_codepoint_scratch_orig;
+        delete[] single_codepoint_scratch_orig;
     }
     return;
 }
@@ -1045,7 +1145,7 @@ void PmatchTransducer::match(unsigned int & input_tape_pos,
         delete locations;
         locations = NULL;
     }
-    if (container->locate_mode) {
+    if (session->locate_mode) {
         locations = new WeightedDoubleTapeVector();
     }
     get_analyses(input_tape_pos, tape_pos, 0);
@@ -1098,20 +1198,20 @@ void PmatchTransducer::note_analysis(unsigned int input_pos,
     if ((input_pos > rtn_stack.top().candidate_input_pos) ||
         (input_pos == rtn_stack.top().candidate_input_pos &&
          rtn_stack.top().best_weight > local_stack.top().running_weight)) {
-        rtn_stack.top().best_result = container->tape.extract_slice(
+        rtn_stack.top().best_result = session->tape.extract_slice(
             rtn_stack.top().tape_entry, tape_pos);
         rtn_stack.top().candidate_tape_pos = tape_pos;
         rtn_stack.top().candidate_input_pos = input_pos;
         rtn_stack.top().best_weight = local_stack.top().running_weight;
-    } else if (container->verbose &&
+    } else if (session->container.verbose &&
                input_pos == rtn_stack.top().candidate_input_pos &&
                rtn_stack.top().best_weight == local_stack.top().running_weight) {
-        DoubleTape discarded(container->tape.extract_slice(
+        DoubleTape discarded(session->tape.extract_slice(
                                  rtn_stack.top().tape_entry, tape_pos));
-        std::cerr << "\n\tline " << container->line_number << ": conflicting equally weighted matches found, keeping:\n\t"
-                  << alphabet.stringify(rtn_stack.top().best_result) << std::endl
+        *session->messages << "\n\tline " << session->line_number << ": conflicting equally weighted matches found, keeping:\n\t"
+                  << session->stringify(rtn_stack.top().best_result) << std::endl
                   << "\tdiscarding:\n\t"
-                  << alphabet.stringify(discarded) << std::endl << std::endl; 
+                  << session->stringify(discarded) << std::endl << std::endl; 
     }
 }
 
@@ -1128,7 +1228,7 @@ void PmatchTransducer::grab_location(unsigned int input_pos, unsigned int tape_p
     }
     rtn_stack.top().candidate_tape_pos = tape_pos;
     rtn_stack.top().candidate_input_pos = input_pos;
-    WeightedDoubleTape rv(container->tape.extract_slice(
+    WeightedDoubleTape rv(session->tape.extract_slice(
                               rtn_stack.top().tape_entry, tape_pos),
                           local_stack.top().running_weight);
     locations->push_back(rv);
@@ -1147,29 +1247,29 @@ void PmatchTransducer::take_epsilons(unsigned int input_pos,
         Weight weight = transition_table[i].get_weight();
         // We handle paths where we're checking contexts here
         if (input == 0) {
-            if (container->profile_mode) {
-                alphabet.count(output);
+            if (session->container.profile_mode) {
+                session->count(output);
             }
             if (!checking_context()) {
                 if (!try_entering_context(output)) {
                     // no context to enter, regular input epsilon
-                    container->tape.write(tape_pos, 0, output);
+                    session->tape.write(tape_pos, 0, output);
                     Weight old_weight = local_stack.top().running_weight;
                     local_stack.top().running_weight += weight;
 
                     // if it's an entry or exit arc, adjust entry stack
                     if (output == alphabet.get_special(entry)) {
-                        container->entry_stack.push(input_pos);
+                        session->entry_stack.push(input_pos);
                     } else if (output == alphabet.get_special(exit)) {
-                        container->entry_stack.pop();
+                        session->entry_stack.pop();
                     }
                     
                     get_analyses(input_pos, tape_pos + 1, target);
 
                     if (output == alphabet.get_special(entry)) {
-                        container->entry_stack.pop();
+                        session->entry_stack.pop();
                     } else if (output == alphabet.get_special(exit)) {
-                        container->entry_stack.unpop();
+                        session->entry_stack.unpop();
                     }
                     
                     local_stack.top().running_weight = old_weight;
@@ -1211,7 +1311,7 @@ void PmatchTransducer::check_context(unsigned int input_pos,
     if (local_stack.top().context == LC ||
         local_stack.top().context == NLC) {
         // Jump to the left-hand side of the input
-        input_pos = container->entry_stack.top() - 1;
+        input_pos = session->entry_stack.top() - 1;
     }
     get_analyses(input_pos, tape_pos, transition_table[i].get_target());
     // In case we have a negative context, we check to see if the context matched.
@@ -1241,7 +1341,7 @@ void PmatchTransducer::take_rtn(SymbolNumber input,
     local_stack.top().running_weight += transition_table[i].get_weight();
     // Pass control
     PmatchTransducer * rtn_target =
-        alphabet.get_rtn(input);
+        session->get_rtn(input);
     rtn_target->rtn_call(input_pos, tape_pos);
     if (tape_pos != original_tape_pos) {
         // Tape moved, fetch result
@@ -1250,7 +1350,7 @@ void PmatchTransducer::take_rtn(SymbolNumber input,
                 rtn_target->get_best_result().begin();
             it != rtn_target->get_best_result().end();
             ++it) {
-            container->tape.write(tape_pos++, it->input, it->output);
+            session->tape.write(tape_pos++, it->input, it->output);
         }
         local_stack.top().running_weight += rtn_target->get_best_weight();
         rtn_target->rtn_exit();
@@ -1267,18 +1367,18 @@ void PmatchTransducer::take_flag(SymbolNumber input,
                                  unsigned int tape_pos,
                                  TransitionTableIndex i)
 {
-    std::vector<short> old_values(local_stack.top().flag_state.get_values());
+    hfst::FdStateValues old_values(local_stack.top().flag_state.save());
     if (local_stack.top().flag_state.apply_operation(
             *(alphabet.get_operation(input)))) {
         // flag diacritic allowed
         // generally we shouldn't care to write flags
-//                container->tape.write(tape_pos, input, output);
+//                session->tape.write(tape_pos, input, output);
         Weight old_weight = local_stack.top().running_weight;
         local_stack.top().running_weight += transition_table[i].get_weight();
         get_analyses(input_pos, tape_pos, transition_table[i].get_target());
         local_stack.top().running_weight = old_weight;
     }
-    local_stack.top().flag_state.assign_values(old_values);
+    local_stack.top().flag_state.restore(old_values);
 }
 
 void PmatchTransducer::take_transitions(SymbolNumber input,
@@ -1301,12 +1401,12 @@ void PmatchTransducer::take_transitions(SymbolNumber input,
                     (alphabet.list2symbols[this_output] != NO_SYMBOL_NUMBER)) {
                 // we got here via a meta-arc, so look back in the
                 // input tape to find the symbol we want to write
-                    this_output = container->input[input_pos];
+                    this_output = session->input[input_pos];
                 }
                 if (this_input == alphabet.get_identity_symbol() ||
                     (this_input == alphabet.get_unknown_symbol()) ||
                     (alphabet.list2symbols[this_input] != NO_SYMBOL_NUMBER)) {
-                    this_input = container->input[input_pos];
+                    this_input = session->input[input_pos];
                 }
                 Weight tmp = local_stack.top().running_weight;
                 local_stack.top().running_weight +=
@@ -1314,7 +1414,7 @@ void PmatchTransducer::take_transitions(SymbolNumber input,
                 if (this_input == alphabet.get_special(Pmatch_passthrough)) {
                     get_analyses(input_pos, tape_pos, target); // FIXME
                 } else {
-                    container->tape.write(tape_pos, this_input, this_output);
+                    session->tape.write(tape_pos, this_input, this_output);
                     get_analyses(input_pos + 1, tape_pos + 1, target);
                 }
                 local_stack.top().running_weight = tmp;
@@ -1334,21 +1434,17 @@ void PmatchTransducer::get_analyses(unsigned int input_pos,
                                     unsigned int tape_pos,
                                     TransitionTableIndex i)
 {
-    if (container->max_time > 0.0) {
-        ++container->call_counter;
-        // Have we spent too much time?
-        if (container->limit_reached ||
-            (container->call_counter % 1000000 == 0 &&
-             (rtn_stack.top().candidate_found &&
-              // if we have at least something, stop doing more work
-              (((double)(clock() - container->start_clock)) / CLOCKS_PER_SEC) > container->max_time))) {
-            container->limit_reached = true;
-            return;
-        }
+    // Have we spent too much time? If we have at least something, stop
+    // doing more work
+    if (session->limit_reached ||
+        (session->deadline.expired() &&
+         (rtn_stack.top().candidate_found || session->deadline.cancelled()))) {
+        session->limit_reached = true;
+        return;
     }
-    if (!container->try_recurse()) {
-        if (container->verbose) {
-            std::cerr << "pmatch: out of stack space, truncating result\n";
+    if (!session->try_recurse()) {
+        if (session->container.verbose) {
+            *session->messages << "pmatch: out of stack space, truncating result\n";
         }
         return;
     }
@@ -1370,14 +1466,15 @@ void PmatchTransducer::get_analyses(unsigned int input_pos,
     }
 
     SymbolNumber input;
-    if (!container->has_queued_input(input_pos)) {
-        container->unrecurse();
+    if (!session->has_queued_input(input_pos)) {
+        session->unrecurse();
         return;
     } else {
-        input = container->input[input_pos];
+        input = session->input[input_pos];
     }
     
-    if (alphabet.symbol2lists[input] != NO_SYMBOL_NUMBER) {
+    if (input < alphabet.symbol2lists.size() &&
+        alphabet.symbol2lists[input] != NO_SYMBOL_NUMBER) {
 // At least one symbol list contains this symbol
         for(SymbolNumberVector::const_iterator it =
                 alphabet.symbol_lists[alphabet.symbol2lists[input]].begin();
@@ -1396,7 +1493,7 @@ void PmatchTransducer::get_analyses(unsigned int input_pos,
             take_transitions(alphabet.get_unknown_symbol(), input_pos, tape_pos, i+1);
         }
     }
-    container->unrecurse();
+    session->unrecurse();
 }
 
 bool PmatchTransducer::checking_context(void) const
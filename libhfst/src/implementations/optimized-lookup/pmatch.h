@@ -12,6 +12,7 @@ namespace hfst_ol {
 
     class PmatchTransducer;
     class PmatchContainer;
+    class PmatchSession;
     struct Location;
     class WeightedDoubleTape;
 
@@ -104,8 +105,12 @@ namespace hfst_ol {
         bool is_end_tag(const SymbolNumber symbol) const;
         bool is_guard(const SymbolNumber symbol) const;
         bool is_counter(const SymbolNumber symbol) const;
-        std::string end_tag(const SymbolNumber symbol);
-        std::string start_tag(const SymbolNumber symbol);
+        std::string end_tag(const SymbolNumber symbol) const;
+        std::string start_tag(const SymbolNumber symbol) const;
+        bool is_printable(SymbolNumber symbol,
+                          const SymbolTable & extra_symbols) const;
+        std::string string_from_symbol(SymbolNumber symbol,
+                                       const SymbolTable & extra_symbols) const;
         bool extract_tags;
 
     public:
@@ -121,54 +126,47 @@ namespace hfst_ol {
         static bool is_special(const std::string & symbol);
         static std::string name_from_insertion(
             const std::string & symbol);
-        bool is_printable(SymbolNumber symbol);
+        bool is_printable(SymbolNumber symbol) const;
         void add_special_symbol(const std::string & str, SymbolNumber symbol_number);
         void process_symbol_list(std::string str, SymbolNumber sym);
         void process_counter(std::string str, SymbolNumber sym);
-        void count(SymbolNumber sym);
         void add_rtn(PmatchTransducer * rtn, std::string const & name);
         bool has_rtn(std::string const & name) const;
         bool has_rtn(SymbolNumber symbol) const;
-        PmatchTransducer * get_rtn(SymbolNumber symbol);
-        std::string get_counter_name(SymbolNumber symbol);
+        PmatchTransducer * get_rtn(SymbolNumber symbol) const;
+        std::string get_counter_name(SymbolNumber symbol) const;
         SymbolNumber get_special(SpecialSymbol special) const;
         SymbolNumberVector get_specials(void) const;
-        std::string stringify(const DoubleTape & str);
+// Symbols numbered from the end of the symbol table on are looked up in
+// extra_symbols, see PmatchSession
+        std::string stringify(const DoubleTape & str,
+                              const SymbolTable & extra_symbols,
+                              std::ostream & messages) const;
         Location locatefy(unsigned int input_offset,
-                          const WeightedDoubleTape & str);
+                          const WeightedDoubleTape & str,
+                          const SymbolTable & extra_symbols) const;
 
         friend class PmatchTransducer;
         friend class PmatchContainer;
+        friend class PmatchSession;
     };
 
+// The compiled network and alphabet of a pmatch ruleset. They are not
+// changed by matching, so any number of PmatchSessions, eg. one per thread,
+// can match with the same container at once. The container's own match()
+// and locate() go through a session of its own and are not thread-safe.
     class PmatchContainer
     {
     protected:
         PmatchAlphabet alphabet;
         Encoder * encoder;
         SymbolNumber orig_symbol_count;
-        SymbolNumber symbol_count;
         PmatchTransducer * toplevel;
-        size_t io_size;
-        SymbolNumberVector input;
-        PositionStack entry_stack;
-        DoubleTape tape;
-        DoubleTape output;
-        LocationVectorVector locations;
         std::vector<char> possible_first_symbols;
         bool verbose;
-        bool locate_mode;
         bool profile_mode;
         bool single_codepoint_tokenization;
-        unsigned int recursion_depth_left;
-        // An optional time limit for operations
-        double max_time;
-        // When we started work
-        clock_t start_clock;
-        // A counter to avoid checking the clock too often
-        unsigned long call_counter;
-        // A flag to set for when time has been overstepped
-        bool limit_reached;
+        PmatchSession * session;
 
     public:
 
@@ -176,19 +174,16 @@ namespace hfst_ol {
         PmatchContainer(void);
         ~PmatchContainer(void);
 
-        unsigned long line_number;
-
-        void initialize_input(const char * input);
         bool has_unsatisfied_rtns(void) const;
         std::string get_unsatisfied_rtn_name(void) const;
-        void process(std::string & input);
         std::string match(std::string & input,
                           double time_cutoff = 0.0);
         LocationVectorVector locate(std::string & input,
                                     double time_cutoff = 0.0);
+        // Stop the match() or locate() that is running in another thread
+        void cancel(void);
         std::string get_profiling_info(void);
-        bool has_queued_input(unsigned int input_pos);
-        bool not_possible_first_symbol(SymbolNumber sym)
+        bool not_possible_first_symbol(SymbolNumber sym) const
         {
             if (possible_first_symbols.size() == 0) {
                 return false;
@@ -196,10 +191,6 @@ namespace hfst_ol {
             return sym >= possible_first_symbols.size() ||
                 possible_first_symbols[sym] == 0;
         }
-        void copy_to_output(const DoubleTape & best_result);
-        void copy_to_output(SymbolNumber input, SymbolNumber output);
-        std::string stringify_output(void);
-//        LocationVector locatefy_output(void);
         static std::string parse_name_from_hfst3_header(std::istream & f);
         void set_verbose(bool b) { verbose = b; }
         void set_extract_tags_mode(bool b)
@@ -207,6 +198,74 @@ namespace hfst_ol {
         void set_single_codepoint_tokenization(bool b)
             { single_codepoint_tokenization = b; }
         void set_profile(bool b) { profile_mode = b; }
+
+        friend class PmatchTransducer;
+        friend class PmatchSession;
+    };
+
+// The state of matching with a PmatchContainer: the input and output tapes,
+// the stacks of the transducers, recursion and time limits, profiling
+// counters and the symbols seen in the input that the alphabet doesn't have.
+// A session is not thread-safe, but sessions of the same container are
+// independent of each other. The container must outlive its sessions.
+    class PmatchSession
+    {
+    protected:
+        const PmatchContainer & container;
+        const PmatchAlphabet & alphabet;
+        // Our copies of the container's transducers
+        PmatchTransducer * toplevel;
+        RtnVector rtns;
+        SymbolNumber symbol_count;
+        // Input symbols missing from the alphabet are numbered from
+        // the end of its symbol table on
+        SymbolTable extra_symbols;
+        StringSymbolMap extra_symbol_numbers;
+        SymbolNumberVector input;
+        PositionStack entry_stack;
+        DoubleTape tape;
+        DoubleTape output;
+        LocationVectorVector locations;
+        std::vector<unsigned long int> counters;
+        bool locate_mode;
+        unsigned int recursion_depth_left;
+        // An optional time limit for operations, and cancellation
+        hfst::HfstDeadline deadline;
+        // A flag to set for when time has been overstepped
+        bool limit_reached;
+
+        void initialize_input(const char * input);
+        void process(const std::string & input);
+        void start_timing(double time_cutoff);
+        bool has_queued_input(unsigned int input_pos) const
+        { return input_pos < input.size(); }
+        bool is_printable(SymbolNumber symbol) const
+        { return alphabet.is_printable(symbol, extra_symbols); }
+        void copy_to_output(const DoubleTape & best_result);
+        void copy_to_output(SymbolNumber input, SymbolNumber output);
+        std::string stringify(const DoubleTape & str) const
+        { return alphabet.stringify(str, extra_symbols, *messages); }
+        PmatchTransducer * get_rtn(SymbolNumber symbol) const
+        { return rtns[symbol]; }
+        void count(SymbolNumber sym);
+
+    public:
+        PmatchSession(const PmatchContainer & container);
+        ~PmatchSession(void);
+
+        unsigned long line_number;
+        // Where the warnings and verbose messages of matching go,
+        // std::cerr by default
+        std::ostream * messages;
+
+        std::string match(const std::string & input,
+                          double time_cutoff = 0.0);
+        LocationVectorVector locate(const std::string & input,
+                                    double time_cutoff = 0.0);
+        // Stop the match() or locate() that is running, as if its time
+        // had run out. May be called from another thread.
+        void cancel(void) { deadline.cancel(); }
+        std::string get_profiling_info(void) const;
         bool try_recurse(void)
         {
             if (recursion_depth_left > 0) {
@@ -220,6 +279,7 @@ namespace hfst_ol {
         void reset_recursion(void) { recursion_depth_left = PMATCH_MAX_RECURSION_DEPTH; }
 
         friend class PmatchTransducer;
+        friend class PmatchContainer;
     };
 
     struct Location
@@ -275,13 +335,23 @@ namespace hfst_ol {
 
         std::stack<LocalVariables> local_stack;
         std::stack<RtnVariables> rtn_stack;
-    
-        std::vector<TransitionW> transition_table;
-        std::vector<TransitionWIndex> index_table;
 
-        PmatchAlphabet & alphabet;
+// The tables don't change after loading, so the copies PmatchSessions make
+// of a transducer share them with the original, which owns them.
+        struct Tables
+        {
+            std::vector<TransitionW> transition_table;
+            std::vector<TransitionWIndex> index_table;
+        };
+
+        Tables * tables;
+        bool owns_tables;
+        const std::vector<TransitionW> & transition_table;
+        const std::vector<TransitionWIndex> & index_table;
+
+        const PmatchAlphabet & alphabet;
         SymbolNumber orig_symbol_count;
-        PmatchContainer * container;
+        PmatchSession * session;
         WeightedDoubleTapeVector * locations;
 
         bool is_final(TransitionTableIndex i)
@@ -370,8 +440,11 @@ namespace hfst_ol {
         PmatchTransducer(std::istream& is,
                          TransitionTableIndex index_table_size,
                          TransitionTableIndex transition_table_size,
-                         PmatchAlphabet & alphabet,
-                         PmatchContainer * container);
+                         const PmatchAlphabet & alphabet);
+        // A transducer for session sharing the tables of another
+        PmatchTransducer(const PmatchTransducer & other,
+                         PmatchSession * session);
+        ~PmatchTransducer(void);
 
         std::set<SymbolNumber> possible_first_symbols;
 
@@ -405,6 +478,7 @@ namespace hfst_ol {
         void collect_possible_first_symbols(void);
 
         friend class PmatchContainer;
+        friend class PmatchSession;
     };
 
 }
@@ -14,6 +14,12 @@
 
 #include <cstdio> // testing
 
+#ifndef _MSC_VER
+#  include <sys/mman.h>
+#  include <sys/stat.h>
+#  include <fcntl.h>
+#endif
+
 #ifndef MAIN_TEST
 
 namespace hfst_ol {
@@ -159,28 +165,6 @@ bool Transition::matches(SymbolNumber s) const
     return input_symbol != NO_SYMBOL_NUMBER && input_symbol == s;
 }
 
-bool TransitionIndex::final() const
-{
-    return input_symbol == NO_SYMBOL_NUMBER
-        && first_transition_index != NO_TABLE_INDEX;
-}
-bool Transition::final() const
-{
-    return input_symbol == NO_SYMBOL_NUMBER
-        && output_symbol == NO_SYMBOL_NUMBER && target_index == 1;
-}
-
-Weight TransitionWIndex::final_weight(void) const
-{
-    union to_weight
-    {
-        TransitionTableIndex i;
-        Weight w;
-    } weight;
-    weight.i = first_transition_index;
-    return weight.w;
-}
-
 void OlLetterTrie::add_string(const char * p, SymbolNumber symbol_key)
 {
     if (*(p+1) == 0)
@@ -200,7 +184,7 @@ bool OlLetterTrie::has_key_starting_with(const char c) const
     return letters[(unsigned char) c] != NULL;
 }
 
-SymbolNumber OlLetterTrie::find_key(char ** p)
+SymbolNumber OlLetterTrie::find_key(char ** p) const
 {
     const char * old_p = *p;
     ++(*p);
@@ -239,7 +223,7 @@ void Encoder::read_input_symbol(const char * s, const int s_num)
     letters.add_string(s, s_num);
 }
 
-SymbolNumber Encoder::find_key(char ** p)
+SymbolNumber Encoder::find_key(char ** p) const
 {
     if (!should_ascii_tokenize((unsigned char) **p) ||
         ascii_symbols[(unsigned char)(**p)] == NO_SYMBOL_NUMBER)
@@ -251,40 +235,8 @@ SymbolNumber Encoder::find_key(char ** p)
     return s;
 }
 
-bool Transducer::initialize_input(const char * input)
-{
-    char * input_str = const_cast<char *>(input);
-    char ** input_str_ptr = &input_str;
-    unsigned int i = 0;
-    SymbolNumber k = NO_SYMBOL_NUMBER;
-    while(**input_str_ptr != 0) {
-        char * original_input_loc = *input_str_ptr;
-        k = encoder->find_key(input_str_ptr);
-        if (k == NO_SYMBOL_NUMBER) {
-            // Add what we assume to be an unknown utf-8 symbol to the alphabet
-            *input_str_ptr = original_input_loc;
-            int bytes_to_tokenize = nByte_utf8(**input_str_ptr);
-            if (bytes_to_tokenize == 0) {
-                return false; // tokenization failed
-            }
-            char * new_symbol = new char[bytes_to_tokenize + 1];
-            memcpy(new_symbol, *input_str_ptr, bytes_to_tokenize);
-            new_symbol[bytes_to_tokenize] = '\0';
-            (*input_str_ptr) += bytes_to_tokenize;
-            alphabet->add_symbol(new_symbol);
-            k = alphabet->get_symbol_table().size() - 1;
-            encoder->read_input_symbol(new_symbol, k);
-            delete [] new_symbol;
-        }
-        input_tape.write(i, k);
-        ++i;
-    }
-    input_tape.write(i, NO_SYMBOL_NUMBER);
-    return true;
-}
-
 HfstOneLevelPaths * Transducer::lookup_fd(const StringVector & s, ssize_t limit,
-                                          double time_cutoff)
+                                          double time_cutoff) const
 {
     std::string input_str;
     for (StringVector::const_iterator it = s.begin(); it != s.end(); ++it) {
@@ -294,28 +246,29 @@ HfstOneLevelPaths * Transducer::lookup_fd(const StringVector & s, ssize_t limit,
 }
 
 HfstOneLevelPaths * Transducer::lookup_fd(const std::string & s, ssize_t limit,
-                                          double time_cutoff)
+                                          double time_cutoff) const
 {
     return lookup_fd(s.c_str(), limit, time_cutoff);
 }
 
-bool Transducer::is_lookup_infinitely_ambiguous(const std::string & s)
+bool Transducer::is_lookup_infinitely_ambiguous(const std::string & s) const
 {
-    if (!initialize_input(s.c_str())) {
-        return false;
-    }
-    traversal_states.clear();
+    LookupContext * context = acquire_lookup_context();
+    bool result = false;
     try {
-        find_loop(0, 0);
-    } catch (bool e) {
-        current_weight = 0.0;
-        flag_state = alphabet->get_fd_table();
-        return e;
+        if (context->engine.tokenize(s.c_str())) {
+            result = context->loop_finder.has_loop(
+                &context->engine.get_input_tape()[0]);
+        }
+    } catch (...) {
+        release_lookup_context(context);
+        throw;
     }
-    return false;
+    release_lookup_context(context);
+    return result;
 }
 
-bool Transducer::is_lookup_infinitely_ambiguous(const StringVector & s)
+bool Transducer::is_lookup_infinitely_ambiguous(const StringVector & s) const
 {
     std::string input_str;
     for (StringVector::const_iterator it = s.begin(); it != s.end(); ++it) {
@@ -326,311 +279,565 @@ bool Transducer::is_lookup_infinitely_ambiguous(const StringVector & s)
 
 
 HfstOneLevelPaths * Transducer::lookup_fd(const char * s, ssize_t limit,
-                                          double time_cutoff)
+                                          double time_cutoff) const
 {
-    max_lookups = limit;
-    max_time = 0.0;
-    if (time_cutoff > 0.0) {
-        max_time = time_cutoff;
-        start_clock = clock();
+    LookupContext * context = acquire_lookup_context();
+    HfstOneLevelPaths * results;
+    try {
+        results = lookup_fd(s, *context, limit, time_cutoff);
+    } catch (...) {
+        release_lookup_context(context);
+        throw;
     }
-    HfstOneLevelPaths * results = new HfstOneLevelPaths;
-    lookup_paths = results;
-    if (!initialize_input(s)) {
-        lookup_paths = NULL;
-        return results;
-    }
-    traversal_states.clear();
-    //current_weight += s.second;
-    get_analyses(0, 0, 0);
-    //current_weight -= s.second;
-    lookup_paths = NULL;
+    release_lookup_context(context);
     return results;
 }
 
+HfstOneLevelPaths * Transducer::lookup_fd(const char * s,
+                                          LookupContext & context,
+                                          ssize_t limit,
+                                          double time_cutoff) const
+{
+    HfstOneLevelPaths * results = new HfstOneLevelPaths;
+    if (context.engine.lookup(s, context.paths, limit, time_cutoff)) {
+        context.engine.collect_paths(context.paths, *results);
+    }
+    return results;
+}
 
-void Transducer::try_epsilon_transitions(unsigned int input_pos,
-                                         unsigned int output_pos,
-                                         TransitionTableIndex i)
+LookupContext * Transducer::acquire_lookup_context(void) const
 {
-    while (true)
     {
-        SymbolNumber input = tables->get_transition_input(i);
-        SymbolNumber output = tables->get_transition_output(i);
-        TransitionTableIndex target = tables->get_transition_target(i);
-        Weight weight = tables->get_weight(i);
-        if (input == 0) // epsilon
-        {
-            output_tape.write(output_pos, output);
-            current_weight += weight;
-            get_analyses(input_pos, output_pos + 1, target);
-            found_transition = true;
-            current_weight -= weight;
-            ++i;
-        } else if (alphabet->is_flag_diacritic(input)) {
-            FlagDiacriticState flags = flag_state.get_values();
-            if (flag_state.apply_operation(
-                    *(alphabet->get_operation(input)))) {
-                // flag diacritic allowed
-                TraversalState flag_reachable(target, flags);
-                if (traversal_states.count(flag_reachable) == 1) {
-                    // We've been here before at this input, back out
-                    flag_state.assign_values(flags);
-                    ++i;
-                    continue;
-                }
+        std::lock_guard<std::mutex> lock(idle_contexts_mutex);
+        if (!idle_contexts.empty()) {
+            LookupContext * context = idle_contexts.back();
+            idle_contexts.pop_back();
+            return context;
+        }
+    }
+    return new LookupContext(*this);
+}
 
-                traversal_states.insert(flag_reachable);
-                output_tape.write(output_pos, output);
-                current_weight += weight;
-                get_analyses(input_pos, output_pos + 1, target);
-                found_transition = true;
-                current_weight -= weight;
-                traversal_states.erase(flag_reachable);
-            }
-            flag_state.assign_values(flags);
-            ++i;
-        } else { // it's not epsilon and it's not a flag, so nothing to do
-            return;
+void Transducer::release_lookup_context(LookupContext * context) const
+{
+    std::lock_guard<std::mutex> lock(idle_contexts_mutex);
+    idle_contexts.push_back(context);
+}
+
+void SymbolPathArena::grow_slots(void)
+{
+    slots.assign(slots.empty() ? 16 : slots.size() * 2, 0);
+    size_t mask = slots.size() - 1;
+    for (size_t i = 0; i < paths.size(); ++i) {
+        size_t slot = paths[i].hash & mask;
+        while (slots[slot] != 0) {
+            slot = (slot + 1) & mask;
         }
+        slots[slot] = i + 1;
     }
 }
 
-void Transducer::try_epsilon_indices(unsigned int input_pos,
-                                     unsigned int output_pos,
-                                     TransitionTableIndex i)
+bool SymbolPathArena::add(const SymbolNumber * path, size_t length,
+                          Weight weight)
 {
-    if (tables->get_index_input(i) == 0)
-    {
-        try_epsilon_transitions(input_pos,
-                                output_pos,
-                                tables->get_index_target(i) - 
-                                TRANSITION_TARGET_TABLE_START);
-        found_transition = true;
+    size_t hash = length;
+    for (size_t i = 0; i < length; ++i) {
+        hash = hash * 31 + path[i];
     }
+    if ((paths.size() + 1) * 2 > slots.size()) {
+        grow_slots();
+    }
+    size_t mask = slots.size() - 1;
+    size_t slot = hash & mask;
+    while (slots[slot] != 0) {
+        const PathEntry & entry = paths[slots[slot] - 1];
+        if (entry.hash == hash && entry.weight == weight &&
+            entry.end - entry.begin == length &&
+            std::equal(path, path + length, symbols.begin() + entry.begin)) {
+            return false;
+        }
+        slot = (slot + 1) & mask;
+    }
+    PathEntry entry;
+    entry.begin = symbols.size();
+    symbols.insert(symbols.end(), path, path + length);
+    entry.end = symbols.size();
+    entry.weight = weight;
+    entry.hash = hash;
+    paths.push_back(entry);
+    slots[slot] = paths.size();
+    return true;
 }
 
-void Transducer::find_transitions(SymbolNumber input,
-                                  unsigned int input_pos,
-                                  unsigned int output_pos,
-                                  TransitionTableIndex i)
+// Whether tables is an instance of Tables
+template <class Tables>
+static bool tables_are(const TransducerTablesInterface & tables)
 {
+    return dynamic_cast<const Tables *>(&tables) != NULL;
+}
 
-    while (tables->get_transition_input(i) != NO_SYMBOL_NUMBER)
-    {
-        if (tables->get_transition_input(i) == input)
-        {
-            // We're not going to find an epsilon / flag loop
-            traversal_states.clear();
-            SymbolNumber output = tables->get_transition_output(i);
-            if (output == alphabet->get_default_symbol()
-                || output == alphabet->get_identity_symbol()
-                || output == alphabet->get_unknown_symbol()) {
-                // we got here via default, identity or unknown, so look
-                // back in the input tape to find the symbol we want to write
-                output = input_tape[input_pos - 1];
-            }
-            output_tape.write(output_pos, output);
-            current_weight += tables->get_weight(i);
-            get_analyses(input_pos,
-                         output_pos + 1,
-                         tables->get_transition_target(i));
-            current_weight -= tables->get_weight(i);
-            found_transition = true;
+LookupEngine::LookupEngine(const Transducer & t):
+    transducer(t),
+    alphabet(*t.alphabet),
+    search(NULL),
+    orig_symbol_count(t.alphabet->get_orig_symbol_count()),
+    identity_symbol(t.alphabet->get_identity_symbol()),
+    unknown_symbol(t.alphabet->get_unknown_symbol()),
+    default_symbol(t.alphabet->get_default_symbol()),
+    first_extra_symbol(t.alphabet->get_symbol_table().size()),
+    extra_symbol_count(0),
+    depth(0),
+    flag_state(t.alphabet->get_fd_table()),
+    visited_count(0),
+    results(NULL),
+    max_lookups(-1),
+    stopped(false)
+{
+    typedef TransducerTables<TransitionWIndex, TransitionW> WeightedTables;
+    typedef TransducerTables<TransitionIndex, Transition> UnweightedTables;
+    typedef MappedTransducerTables<TransitionWIndex, TransitionW>
+        MappedWeightedTables;
+    typedef MappedTransducerTables<TransitionIndex, Transition>
+        MappedUnweightedTables;
+    if (tables_are<WeightedTables>(*t.tables)) {
+        search = &LookupEngine::run_search<WeightedTables>;
+    } else if (tables_are<UnweightedTables>(*t.tables)) {
+        search = &LookupEngine::run_search<UnweightedTables>;
+    } else if (tables_are<MappedWeightedTables>(*t.tables)) {
+        search = &LookupEngine::run_search<MappedWeightedTables>;
+    } else if (tables_are<MappedUnweightedTables>(*t.tables)) {
+        search = &LookupEngine::run_search<MappedUnweightedTables>;
+    } else {
+        // Some other kind of tables, read through virtual calls
+        search = &LookupEngine::run_search<TransducerTablesInterface>;
+    }
+}
+
+SymbolNumber LookupEngine::add_extra_symbol(const char * p, int bytes)
+{
+    for (size_t i = 0; i < extra_symbol_count; ++i) {
+        if (extra_symbols[i].size() == static_cast<size_t>(bytes) &&
+            extra_symbols[i].compare(0, bytes, p, bytes) == 0) {
+            return first_extra_symbol + i;
         }
-        else
-        {
-            return;
+    }
+    if (first_extra_symbol + extra_symbol_count >= NO_SYMBOL_NUMBER) {
+        return NO_SYMBOL_NUMBER;
+    }
+    if (extra_symbol_count == extra_symbols.size()) {
+        extra_symbols.push_back(std::string());
+        extra_outputs.push_back(NO_SYMBOL_NUMBER);
+    }
+    std::string & symbol = extra_symbols[extra_symbol_count];
+    symbol.assign(p, bytes);
+    SymbolNumber number = first_extra_symbol + extra_symbol_count;
+    extra_outputs[extra_symbol_count] = number;
+    const SymbolTable & symbol_table = alphabet.get_symbol_table();
+    for (SymbolNumber i = transducer.get_header().input_symbol_count();
+         i < orig_symbol_count; ++i) {
+        if (symbol_table[i] == symbol) {
+            extra_outputs[extra_symbol_count] = i;
+            break;
         }
-        ++i;
     }
+    ++extra_symbol_count;
+    return number;
 }
 
-void Transducer::find_index(SymbolNumber input,
-                            unsigned int input_pos,
-                            unsigned int output_pos,
-                            TransitionTableIndex i)
+bool LookupEngine::tokenize(const char * input)
 {
-    if (tables->get_index_input(i+input) == input)
-    {
-        find_transitions(input,
-                         input_pos,
-                         output_pos,
-                         tables->get_index_target(i+input) - 
-                         TRANSITION_TARGET_TABLE_START);
-        found_transition = true;
+    const Encoder & encoder = transducer.get_encoder();
+    input_tape.clear();
+    extra_symbol_count = 0;
+    char * p = const_cast<char *>(input);
+    while (*p != '\0') {
+        char * original_p = p;
+        SymbolNumber k = encoder.find_key(&p);
+        if (k == NO_SYMBOL_NUMBER) {
+            // Not in the alphabet, so number it as an unknown symbol
+            p = original_p;
+            int bytes = nByte_utf8(static_cast<unsigned char>(*p));
+            if (bytes == 0) {
+                return false; // tokenization failed
+            }
+            for (int j = 1; j < bytes; ++j) {
+                if (p[j] == '\0') {
+                    return false;
+                }
+            }
+            k = add_extra_symbol(p, bytes);
+            if (k == NO_SYMBOL_NUMBER) {
+                return false;
+            }
+            p += bytes;
+        }
+        input_tape.push_back(k);
     }
+    input_tape.push_back(NO_SYMBOL_NUMBER);
+    return true;
 }
 
+std::string LookupEngine::symbol_string(SymbolNumber symbol) const
+{
+    if (symbol >= first_extra_symbol &&
+        (size_t)(symbol - first_extra_symbol) < extra_symbol_count) {
+        return extra_symbols[symbol - first_extra_symbol];
+    }
+    return alphabet.string_from_symbol(symbol);
+}
 
+void LookupEngine::collect_paths(const SymbolPathArena & paths,
+                                 HfstOneLevelPaths & result) const
+{
+    for (size_t i = 0; i < paths.size(); ++i) {
+        HfstOneLevelPath path;
+        path.first = paths.weight(i);
+        path.second.reserve(paths.length(i));
+        for (const SymbolNumber * it = paths.begin(i);
+             it != paths.end(i); ++it) {
+            path.second.push_back(symbol_string(*it));
+        }
+        result.insert(path);
+    }
+}
+
+bool LookupEngine::lookup(const char * input, SymbolPathArena & paths,
+                          ssize_t limit, double time_cutoff)
+{
+    paths.clear();
+    if (!tokenize(input)) {
+        return false;
+    }
+    results = &paths;
+    max_lookups = limit;
+    deadline.start(time_cutoff);
+    stopped = false;
+    depth = 0;
+    visited_count = 0;
+    flag_state.reset();
+
+    enter(0, 0, 0, 0.0);
+    (this->*search)();
+    depth = 0;
+    results = NULL;
+    return true;
+}
 
+template <class Tables>
+void LookupEngine::run_search(void)
+{
+    const Tables & tables = static_cast<const Tables &>(*transducer.tables);
+    while (depth > 0 && !stopped) {
+        size_t level = depth - 1;
+        switch (frames[level].stage) {
+        case START:
+            start_frame(tables, level);
+            break;
+        case EPSILONS:
+            step_epsilons(tables, level);
+            break;
+        case INPUT:
+            step_input(tables, level);
+            break;
+        case MATCH:
+            step_match(tables, level);
+            break;
+        }
+    }
+}
 
-void Transducer::get_analyses(unsigned int input_pos,
-                              unsigned int output_pos,
-                              TransitionTableIndex i)
+bool LookupEngine::enter(TransitionTableIndex i, unsigned int input_pos,
+                         unsigned int output_pos, Weight weight)
 {
-    found_transition = false;
-    
-    if (recursion_depth_left == 0) {
-//        std::cerr << __FILE__ <<
-//            ": maximum recursion depth exceeded, discarding results\n";
-        return;
+    if (depth >= MAX_RECURSION_DEPTH) {
+        return false;
     }
-    if (max_lookups >= 0 && lookup_paths->size() >= max_lookups) {
-        // Back out because we have enough results already
-        return;
+    if (max_lookups >= 0 &&
+        results->size() >= static_cast<size_t>(max_lookups)) {
+        // We have enough results already, and no more will be collected
+        stopped = true;
+        return false;
     }
-    if (max_time > 0.0) {
-        // quit if we've overspent our time
-        if ((((double) clock() - start_clock) / CLOCKS_PER_SEC) > max_time) {
-            return;
-        }
+    if (deadline.expired()) {
+        stopped = true;
+        return false;
     }
-    --recursion_depth_left;
-    if (indexes_transition_table(i))
-    {
-        i -= TRANSITION_TARGET_TABLE_START;
-        // First we check for finality and collect the result
-        if (input_tape[input_pos] == NO_SYMBOL_NUMBER) {
-            if (max_lookups < 0 || lookup_paths->size() < max_lookups) {
-                output_tape.write(output_pos, NO_SYMBOL_NUMBER);
-                if (tables->get_transition_finality(i)) {
-                    current_weight += tables->get_weight(i);
-                    note_analysis();
-                    current_weight -= tables->get_weight(i);
-                }
-            }
-        }
+    if (depth == frames.size()) {
+        frames.push_back(LookupFrame());
+    }
+    LookupFrame & frame = frames[depth++];
+    frame.state = i;
+    frame.input_pos = input_pos;
+    frame.output_pos = output_pos;
+    frame.weight = weight;
+    frame.stage = START;
+    frame.pending = NONE;
+    frame.found = false;
+    frame.tried_default = false;
+    return true;
+}
 
-        // Then we check epsilons
-        try_epsilon_transitions(input_pos,
-                                output_pos,
-                                i+1);
+void LookupEngine::write_output(unsigned int output_pos, SymbolNumber symbol)
+{
+    if (output_tape.size() <= output_pos) {
+        output_tape.resize(output_pos + 1, NO_SYMBOL_NUMBER);
+    }
+    output_tape[output_pos] = symbol;
+}
 
-        if (input_tape[input_pos] == NO_SYMBOL_NUMBER) {
-            // No more input
-            ++recursion_depth_left;
-            return;
+void LookupEngine::note_analysis(unsigned int output_pos, Weight weight)
+{
+    results->add(output_pos == 0 ? NULL : &output_tape[0], output_pos, weight);
+}
+
+template <class Tables>
+void LookupEngine::start_frame(const Tables & tables, size_t level)
+{
+    LookupFrame & frame = frames[level];
+    bool input_ended = input_tape[frame.input_pos] == NO_SYMBOL_NUMBER;
+    bool may_note = input_ended && (max_lookups < 0 ||
+        results->size() < static_cast<size_t>(max_lookups));
+    prepare_input(frame);
+    if (indexes_transition_table(frame.state)) {
+        TransitionTableIndex i = frame.state - TRANSITION_TARGET_TABLE_START;
+        if (may_note && tables.get_transition_finality(i)) {
+            note_analysis(frame.output_pos, frame.weight + tables.get_weight(i));
         }
-        
-        SymbolNumber input = input_tape[input_pos];
-        ++input_pos;
-
-        if (input < alphabet->get_orig_symbol_count()) {
-            // Input is in the alphabet
-            find_transitions(input,
-                             input_pos,
-                             output_pos,
-                             i+1);
-        } else {
-            if (alphabet->get_identity_symbol() != NO_SYMBOL_NUMBER) {
-                find_transitions(alphabet->get_identity_symbol(),
-                                 input_pos, output_pos, i+1);
+        frame.cursor = i + 1;
+        frame.stage = EPSILONS;
+    } else {
+        if (may_note && tables.get_index_finality(frame.state)) {
+            note_analysis(frame.output_pos,
+                          frame.weight + tables.get_final_weight(frame.state));
+        }
+        if (tables.get_index_input(frame.state + 1) == 0) {
+            frame.cursor = tables.get_index_target(frame.state + 1) -
+                TRANSITION_TARGET_TABLE_START;
+            frame.found = true;
+            frame.stage = EPSILONS;
+        }
+    }
+}
+
+template <class Tables>
+void LookupEngine::step_epsilons(const Tables & tables, size_t level)
+{
+    LookupFrame & frame = frames[level];
+    TransitionTableIndex i = frame.cursor;
+    SymbolNumber input = tables.get_transition_input(i);
+    if (input == 0) {
+        write_output(frame.output_pos, tables.get_transition_output(i));
+        frame.pending = EPSILON_ARC;
+        if (!enter(tables.get_transition_target(i), frame.input_pos,
+                   frame.output_pos + 1,
+                   frame.weight + tables.get_weight(i))) {
+            finish_arc(tables, level);
+        }
+    } else if (alphabet.is_flag_diacritic(input)) {
+        if (saved_flags.size() <= level) {
+            saved_flags.resize(level + 1);
+        }
+        FlagDiacriticState & flags = saved_flags[level];
+        flags = flag_state.save();
+        if (flag_state.apply_operation(*alphabet.get_operation(input))) {
+            TransitionTableIndex target = tables.get_transition_target(i);
+            if (visited_contains(target, flags)) {
+                // We've been here before at this input, back out
+                flag_state.restore(flags);
+                ++frame.cursor;
+                return;
             }
-            if (alphabet->get_unknown_symbol() != NO_SYMBOL_NUMBER) {
-                find_transitions(alphabet->get_unknown_symbol(),
-                                 input_pos, output_pos, i+1);
+            visited_insert(target, flags);
+            write_output(frame.output_pos, tables.get_transition_output(i));
+            frame.pending = FLAG_ARC;
+            if (!enter(target, frame.input_pos, frame.output_pos + 1,
+                       frame.weight + tables.get_weight(i))) {
+                finish_arc(tables, level);
             }
+        } else {
+            flag_state.restore(flags);
+            ++frame.cursor;
         }
-        if (alphabet->get_default_symbol() != NO_SYMBOL_NUMBER &&
-            !found_transition) {
-            find_transitions(alphabet->get_default_symbol(),
-                             input_pos, output_pos, i+1);
+    } else {
+        // it's not epsilon and it's not a flag, so go on to the input
+        prepare_input(frame);
+    }
+}
+
+void LookupEngine::prepare_input(LookupFrame & frame)
+{
+    frame.stage = INPUT;
+    frame.candidate_count = 0;
+    frame.next_candidate = 0;
+    SymbolNumber input = input_tape[frame.input_pos];
+    if (input == NO_SYMBOL_NUMBER) {
+        return;
+    }
+    if (input < orig_symbol_count) {
+        // Input is in the alphabet
+        frame.candidates[frame.candidate_count++] = input;
+    } else {
+        if (identity_symbol != NO_SYMBOL_NUMBER) {
+            frame.candidates[frame.candidate_count++] = identity_symbol;
+        }
+        if (unknown_symbol != NO_SYMBOL_NUMBER) {
+            frame.candidates[frame.candidate_count++] = unknown_symbol;
         }
     }
-    else
-    {
-        if (input_tape[input_pos] == NO_SYMBOL_NUMBER) {
-            if (max_lookups < 0 || lookup_paths->size() < max_lookups) {
-                output_tape.write(output_pos, NO_SYMBOL_NUMBER);
-                if (tables->get_index_finality(i)) {
-                    current_weight += tables->get_final_weight(i);
-                    note_analysis();
-                    current_weight -= tables->get_final_weight(i);
-                }
-            }
+}
+
+template <class Tables>
+void LookupEngine::step_input(const Tables & tables, size_t level)
+{
+    LookupFrame & frame = frames[level];
+    SymbolNumber input = input_tape[frame.input_pos];
+    if (input == NO_SYMBOL_NUMBER) {
+        // No more input, so this state is done
+        --depth;
+        if (depth > 0) {
+            finish_arc(tables, depth - 1);
         }
-        
-        try_epsilon_indices(input_pos,
-                            output_pos,
-                            i+1);
-        
-        if (input_tape[input_pos] == NO_SYMBOL_NUMBER) {
-            ++recursion_depth_left;
-            return;
+        return;
+    }
+    SymbolNumber symbol = NO_SYMBOL_NUMBER;
+    if (frame.next_candidate < frame.candidate_count) {
+        symbol = frame.candidates[frame.next_candidate++];
+    } else if (default_symbol != NO_SYMBOL_NUMBER && !frame.found &&
+               !frame.tried_default) {
+        frame.tried_default = true;
+        symbol = default_symbol;
+    } else {
+        --depth;
+        if (depth > 0) {
+            finish_arc(tables, depth - 1);
         }
-      
-        SymbolNumber input = input_tape[input_pos];
-        ++input_pos;
+        return;
+    }
+    frame.symbol = symbol;
+    if (indexes_transition_table(frame.state)) {
+        frame.cursor = frame.state - TRANSITION_TARGET_TABLE_START + 1;
+        frame.stage = MATCH;
+    } else {
+        TransitionTableIndex i = frame.state + 1 + symbol;
+        if (tables.get_index_input(i) == symbol) {
+            frame.cursor = tables.get_index_target(i) -
+                TRANSITION_TARGET_TABLE_START;
+            frame.found = true;
+            frame.stage = MATCH;
+        }
+    }
+}
 
-        if (input < alphabet->get_orig_symbol_count()) {
-            // Input is in the alphabet
-            find_index(input, input_pos, output_pos, i+1);
-        } else {
-            if (alphabet->get_identity_symbol() != NO_SYMBOL_NUMBER) {
-                find_index(alphabet->get_identity_symbol(),
-                           input_pos, output_pos, i+1);
-            }
-            if (alphabet->get_unknown_symbol() != NO_SYMBOL_NUMBER) {
-                find_index(alphabet->get_unknown_symbol(),
-                           input_pos, output_pos, i+1);
-            }
+template <class Tables>
+void LookupEngine::step_match(const Tables & tables, size_t level)
+{
+    LookupFrame & frame = frames[level];
+    TransitionTableIndex i = frame.cursor;
+    if (tables.get_transition_input(i) != frame.symbol) {
+        frame.stage = INPUT;
+        return;
+    }
+    // We're not going to find an epsilon / flag loop
+    visited_count = 0;
+    SymbolNumber output = tables.get_transition_output(i);
+    if (output == default_symbol || output == identity_symbol ||
+        output == unknown_symbol) {
+        // we got here via default, identity or unknown, so look
+        // back in the input tape to find the symbol we want to write
+        output = input_tape[frame.input_pos];
+        if (output >= first_extra_symbol) {
+            output = extra_outputs[output - first_extra_symbol];
         }
-        // If we have a default symbol defined and we didn't find an index,
-        // check for that
-        if (alphabet->get_default_symbol() != NO_SYMBOL_NUMBER && !found_transition) {
-            find_index(alphabet->get_default_symbol(),
-                       input_pos, output_pos, i+1);
+    }
+    write_output(frame.output_pos, output);
+    frame.pending = INPUT_ARC;
+    if (!enter(tables.get_transition_target(i), frame.input_pos + 1,
+               frame.output_pos + 1, frame.weight + tables.get_weight(i))) {
+        finish_arc(tables, level);
+    }
+}
+
+template <class Tables>
+void LookupEngine::finish_arc(const Tables & tables, size_t level)
+{
+    LookupFrame & frame = frames[level];
+    if (frame.pending == FLAG_ARC) {
+        visited_erase(tables.get_transition_target(frame.cursor),
+                      saved_flags[level]);
+        flag_state.restore(saved_flags[level]);
+    }
+    frame.pending = NONE;
+    frame.found = true;
+    ++frame.cursor;
+}
+
+bool LookupEngine::visited_contains(TransitionTableIndex i,
+                                    const FlagDiacriticState & flags) const
+{
+    for (size_t j = 0; j < visited_count; ++j) {
+        if (visited[j].index == i && visited[j].flags == flags) {
+            return true;
         }
     }
-    output_tape.write(output_pos, NO_SYMBOL_NUMBER);
-    ++recursion_depth_left;
+    return false;
+}
+
+void LookupEngine::visited_insert(TransitionTableIndex i,
+                                  const FlagDiacriticState & flags)
+{
+    if (visited_count == visited.size()) {
+        visited.push_back(VisitedFlagState());
+    }
+    visited[visited_count].index = i;
+    visited[visited_count].flags = flags;
+    ++visited_count;
 }
 
-void Transducer::note_analysis(void)
+void LookupEngine::visited_erase(TransitionTableIndex i,
+                                 const FlagDiacriticState & flags)
 {
-    HfstOneLevelPath result;
-    for (SymbolNumberVector::const_iterator it = output_tape.begin();
-         *it != NO_SYMBOL_NUMBER; ++it) {
-        result.second.push_back(alphabet->string_from_symbol(*it));
+    for (size_t j = 0; j < visited_count; ++j) {
+        if (visited[j].index == i && visited[j].flags == flags) {
+            --visited_count;
+            if (j != visited_count) {
+                std::swap(visited[j], visited[visited_count]);
+            }
+            return;
+        }
     }
-    result.first = current_weight;
-    lookup_paths->insert(result);
 }
 
 
 
 Transducer::Transducer():
     header(NULL), alphabet(NULL), tables(NULL),
-    current_weight(0.0), lookup_paths(NULL), encoder(NULL),
-    input_tape(), output_tape(),
-    flag_state(), found_transition(false), max_lookups(-1),
-    recursion_depth_left(MAX_RECURSION_DEPTH){}
+    encoder(NULL) {}
 
 Transducer::Transducer(std::istream& is):
     header(new TransducerHeader(is)),
     alphabet(new TransducerAlphabet(is, header->symbol_count())),
-    tables(NULL), current_weight(0.0), lookup_paths(NULL),
+    tables(NULL),
     encoder(new Encoder(alphabet->get_symbol_table(),
-                        header->input_symbol_count())),
-    input_tape(), output_tape(),
-    flag_state(alphabet->get_fd_table()), found_transition(false), max_lookups(-1),
-    recursion_depth_left(MAX_RECURSION_DEPTH)
+                        header->input_symbol_count()))
 {
     load_tables(is);
 }
 
+Transducer::Transducer(std::istream& is, const std::string & filename):
+    header(new TransducerHeader(is)),
+    alphabet(new TransducerAlphabet(is, header->symbol_count())),
+    tables(NULL),
+    encoder(new Encoder(alphabet->get_symbol_table(),
+                        header->input_symbol_count()))
+{
+    load_tables(is, filename);
+}
 
 Transducer::Transducer(bool weighted):
     header(new TransducerHeader(weighted)),
     alphabet(new TransducerAlphabet()),
-    current_weight(0.0),
-    lookup_paths(NULL),
     encoder(new Encoder(alphabet->get_symbol_table(),
-                        header->input_symbol_count())),
-    input_tape(), output_tape(),
-    flag_state(alphabet->get_fd_table()), found_transition(false),
-    max_lookups(-1), recursion_depth_left(MAX_RECURSION_DEPTH)
+                        header->input_symbol_count()))
 {
     if(weighted)
         tables = new TransducerTables<TransitionWIndex,TransitionW>();
@@ -646,13 +853,8 @@ Transducer::Transducer(const TransducerHeader& header,
     alphabet(new TransducerAlphabet(alphabet)),
     tables(new TransducerTables<TransitionIndex,Transition>(
                index_table, transition_table)),
-    current_weight(0.0),
-    lookup_paths(NULL),
     encoder(new Encoder(alphabet.get_symbol_table(),
-                        header.input_symbol_count())),
-    input_tape(), output_tape(),
-    flag_state(alphabet.get_fd_table()), found_transition(false), max_lookups(-1),
-    recursion_depth_left(MAX_RECURSION_DEPTH)
+                        header.input_symbol_count()))
 {}
 
 Transducer::Transducer(const TransducerHeader& header,
@@ -663,17 +865,26 @@ Transducer::Transducer(const TransducerHeader& header,
     alphabet(new TransducerAlphabet(alphabet)),
     tables(new TransducerTables<TransitionWIndex,TransitionW>(
                index_table, transition_table)),
-    current_weight(0.0),
-    lookup_paths(NULL),
     encoder(new Encoder(alphabet.get_symbol_table(),
-                        header.input_symbol_count())),
-    input_tape(), output_tape(),
-    flag_state(alphabet.get_fd_table()), found_transition(false), max_lookups(-1),
-    recursion_depth_left(MAX_RECURSION_DEPTH)
+                        header.input_symbol_count()))
+{}
+
+Transducer::Transducer(const TransducerHeader& header,
+                       const TransducerAlphabet& alphabet,
+                       TransducerTablesInterface * tables):
+    header(new TransducerHeader(header)),
+    alphabet(new TransducerAlphabet(alphabet)),
+    tables(tables),
+    encoder(new Encoder(alphabet.get_symbol_table(),
+                        header.input_symbol_count()))
 {}
 
 Transducer::~Transducer()
 {
+    for (std::vector<LookupContext*>::iterator it = idle_contexts.begin();
+         it != idle_contexts.end(); ++it) {
+        delete *it;
+    }
     delete header;
     delete alphabet;
     delete tables;
@@ -743,6 +954,90 @@ void Transducer::load_tables(std::istream& is)
     }
 }
 
+void Transducer::load_tables(std::istream& is, const std::string & filename)
+{
+    std::streampos tables_start = is.tellg();
+    if (tables_start < 0) {
+        // Not a seekable file, fall back to copying
+        is.clear();
+        load_tables(is);
+        return;
+    }
+    bool weighted = header->probe_flag(Weighted);
+    size_t tables_length =
+        header->index_table_size() *
+        (weighted ? TransitionWIndex::size : TransitionIndex::size) +
+        header->target_table_size() *
+        (weighted ? TransitionW::size : Transition::size);
+    std::shared_ptr<MappedFileRegion> region(new MappedFileRegion(
+        filename, tables_start, tables_length));
+    if (weighted) {
+        tables = new MappedTransducerTables<TransitionWIndex, TransitionW>(
+            region, header->index_table_size(), header->target_table_size());
+    } else {
+        tables = new MappedTransducerTables<TransitionIndex, Transition>(
+            region, header->index_table_size(), header->target_table_size());
+    }
+    is.seekg(tables_start + (std::streamoff) tables_length);
+    if(!is) {
+        HFST_THROW(TransducerHasWrongTypeException);
+    }
+}
+
+#ifndef _MSC_VER
+
+MappedFileRegion::MappedFileRegion(const std::string & filename,
+                                   size_t offset, size_t length)
+{
+    int fd = open(filename.c_str(), O_RDONLY);
+    if (fd < 0) {
+        HFST_THROW_MESSAGE(HfstFatalException,
+                           "could not open " + filename + " for mapping");
+    }
+    struct stat file_stat;
+    if (fstat(fd, &file_stat) != 0 ||
+        (size_t) file_stat.st_size < offset + length) {
+        close(fd);
+        HFST_THROW(TransducerHasWrongTypeException);
+    }
+    // mmap wants a page-aligned offset
+    size_t page_size = sysconf(_SC_PAGESIZE);
+    size_t aligned_offset = offset - offset % page_size;
+    mapping_length = length + (offset - aligned_offset);
+    if (mapping_length == 0) {
+        // Nothing to map, but data() should still be a valid pointer
+        mapping_length = 1;
+    }
+    mapping = mmap(NULL, mapping_length, PROT_READ, MAP_SHARED,
+                   fd, aligned_offset);
+    close(fd);
+    if (mapping == MAP_FAILED) {
+        HFST_THROW_MESSAGE(HfstFatalException,
+                           "could not map " + filename + " into memory");
+    }
+    region = static_cast<const char *>(mapping) + (offset - aligned_offset);
+}
+
+MappedFileRegion::~MappedFileRegion()
+{
+    munmap(mapping, mapping_length);
+}
+
+#else // _MSC_VER
+
+MappedFileRegion::MappedFileRegion(const std::string & filename,
+                                   size_t offset, size_t length):
+    mapping(NULL), mapping_length(0), region(NULL)
+{
+    (void)filename; (void)offset; (void)length;
+    HFST_THROW_MESSAGE(FunctionNotImplementedException,
+                       "memory-mapped transducer tables");
+}
+
+MappedFileRegion::~MappedFileRegion() {}
+
+#endif // _MSC_VER
+
 void Transducer::write(std::ostream& os) const
 {
     header->write(os);
@@ -755,6 +1050,20 @@ void Transducer::write(std::ostream& os) const
 
 Transducer * Transducer::copy(Transducer * t, bool weighted)
 {
+    MappedTransducerTables<TransitionWIndex, TransitionW> * mapped_w =
+        dynamic_cast<MappedTransducerTables<TransitionWIndex, TransitionW> *>
+        (t->tables);
+    if (mapped_w != NULL) {
+        return new Transducer(t->get_header(), t->get_alphabet(),
+                              mapped_w->share());
+    }
+    MappedTransducerTables<TransitionIndex, Transition> * mapped =
+        dynamic_cast<MappedTransducerTables<TransitionIndex, Transition> *>
+        (t->tables);
+    if (mapped != NULL) {
+        return new Transducer(t->get_header(), t->get_alphabet(),
+                              mapped->share());
+    }
     Transducer * another;
     if (weighted) {
         another = new Transducer(
@@ -22,6 +22,7 @@
 
 #include <vector>
 #include <set>
+#include <algorithm>
 #include <iostream>
 #include <limits>
 #include <string>
@@ -30,11 +31,15 @@
 #include <climits>
 #include <utility>
 #include <deque>
+#include <unordered_map>
 #include <queue>
 #include <stdexcept>
+#include <mutex>
+#include <memory>
 #include <time.h>
 
 #include "../../HfstExceptionDefs.h"
+#include "../../HfstDeadline.h"
 #include "../../HfstFlagDiacritics.h"
 #include "../../HfstSymbolDefs.h"
 
@@ -70,7 +75,7 @@ typedef std::set<HfstOneLevelPath> HfstOneLevelPaths;
 typedef std::vector<std::string> StringVector;
 
 // for ospell
-typedef std::vector<short> FlagDiacriticState;
+typedef hfst::FdStateValues FlagDiacriticState;
 typedef std::map<SymbolNumber, hfst::FdOperation> OperationMap;
 typedef std::map<std::string, SymbolNumber> StringSymbolMap;
 class STransition;
@@ -494,7 +499,11 @@ public:
         { return input_symbol; }
   
     bool matches(const SymbolNumber s) const;
-    virtual bool final(void) const;
+    virtual bool final(void) const
+        {
+            return input_symbol == NO_SYMBOL_NUMBER
+                && first_transition_index != NO_TABLE_INDEX;
+        }
     virtual Weight final_weight(void) const { return 0.0; }
   
     static TransitionIndex create_final()
@@ -513,7 +522,16 @@ public:
     TransitionWIndex(char * p):
         TransitionIndex(p) {}
     
-    Weight final_weight(void) const;
+    Weight final_weight(void) const
+        {
+            union to_weight
+            {
+                TransitionTableIndex i;
+                Weight w;
+            } weight;
+            weight.i = first_transition_index;
+            return weight.w;
+        }
   
     static TransitionWIndex create_final()
         { return TransitionWIndex(NO_SYMBOL_NUMBER, 0); }
@@ -586,7 +604,11 @@ public:
     SymbolNumber get_input_symbol(void) const {return input_symbol;}
   
     bool matches(const SymbolNumber s) const;
-    virtual bool final(void) const;
+    virtual bool final(void) const
+        {
+            return input_symbol == NO_SYMBOL_NUMBER
+                && output_symbol == NO_SYMBOL_NUMBER && target_index == 1;
+        }
     virtual Weight get_weight(void) const { return 0.0; }
 };
 
@@ -640,13 +662,22 @@ public:
         {
             char * p = (char*) malloc(T::size * index_count);
             is.read(p, T::size * index_count);
-            char * p_orig = p;
+            read_entries(p, index_count);
+            free(p);
+        }
+    // A constructor for reading index_count packed entries from a char array
+    TransducerTable(const char * p, TransitionTableIndex index_count): table()
+        {
+            read_entries(p, index_count);
+        }
+    void read_entries(const char * p, TransitionTableIndex index_count)
+        {
+            table.reserve(index_count);
             while(index_count) {
-                table.push_back(T(p));
+                table.push_back(T(const_cast<char *>(p)));
                 --index_count;
                 p += T::size;
             }
-            free(p_orig);
         }
     TransducerTable(const TransducerTable& t): table(t.table) {}
   
@@ -705,8 +736,12 @@ public:
     virtual void display() const {}
 };
 
+/* The tables proper. The classes are final and call the entries' own
+   methods directly, so code that knows which instantiation it has (see
+   LookupEngine) reads the tables without any virtual calls.
+*/
 template <class T1, class T2>
-class TransducerTables : public TransducerTablesInterface
+class TransducerTables final : public TransducerTablesInterface
 {
 protected:
     TransducerTable<T1> index_table;
@@ -723,13 +758,19 @@ public:
     TransducerTables(const TransducerTable<T1>& index_table,
                      const TransducerTable<T2>& transition_table):
         index_table(index_table), transition_table(transition_table) {}
+    TransducerTables(const char * index_data,
+                     TransitionTableIndex index_table_size,
+                     const char * transition_data,
+                     TransitionTableIndex transition_table_size):
+        index_table(index_data, index_table_size),
+        transition_table(transition_data, transition_table_size) {}
 
     const TransitionIndex& get_index(TransitionTableIndex i) const
         {return index_table[i];}
     const Transition& get_transition(TransitionTableIndex i) const
         {return transition_table[i];}
     Weight get_weight(TransitionTableIndex i) const
-        { return transition_table[i].get_weight(); }
+        { return transition_table[i].T2::get_weight(); }
     SymbolNumber get_transition_input(TransitionTableIndex i) const
         { return transition_table[i].get_input_symbol(); }
     SymbolNumber get_transition_output(TransitionTableIndex i) const
@@ -737,15 +778,15 @@ public:
     TransitionTableIndex get_transition_target(TransitionTableIndex i) const
         { return transition_table[i].get_target(); }
     bool get_transition_finality(TransitionTableIndex i) const
-        { return transition_table[i].final(); }
+        { return transition_table[i].T2::final(); }
     SymbolNumber get_index_input(TransitionTableIndex i) const
         { return index_table[i].get_input_symbol(); }
     TransitionTableIndex get_index_target(TransitionTableIndex i) const
         { return index_table[i].get_target(); }
     bool get_index_finality(TransitionTableIndex i) const
-        { return index_table[i].final(); }
+        { return index_table[i].T1::final(); }
     Weight get_final_weight(TransitionTableIndex i) const
-        { return index_table[i].final_weight(); }
+        { return index_table[i].T1::final_weight(); }
 
   
     void display() const
@@ -758,6 +799,147 @@ public:
 };
 
 
+// Read a value of type V from a possibly unaligned position in a packed table
+template <class V>
+inline V read_packed(const char * p)
+{
+    V v;
+    memcpy(&v, p, sizeof(V));
+    return v;
+}
+
+// A region of a file mapped read-only into memory. Pages are shared with
+// every other process mapping the same file.
+class MappedFileRegion
+{
+private:
+    void * mapping;
+    size_t mapping_length;
+    const char * region;
+public:
+    // Map length bytes starting at offset of the file filename.
+    // Throws TransducerHasWrongTypeException if the file is too short and
+    // FunctionNotImplementedException if mapping is not supported.
+    MappedFileRegion(const std::string & filename, size_t offset,
+                     size_t length);
+    ~MappedFileRegion();
+
+    const char * data(void) const { return region; }
+};
+
+/* Tables read in place from a memory-mapped file, without copying the
+   entries into TransitionIndex / Transition objects. The lookup accessors
+   read the packed on-disk records directly. get_index() and
+   get_transition() need real objects, so the first call to either of them
+   builds an ordinary in-memory copy of the tables (not thread-safe); they
+   are only used when converting or writing the transducer. Copies made
+   with share() read the same mapping, which is unmapped when the last of
+   them is deleted.
+*/
+template <class T1, class T2>
+class MappedTransducerTables final : public TransducerTablesInterface
+{
+protected:
+    std::shared_ptr<MappedFileRegion> region;
+    const char * index_data;
+    const char * transition_data;
+    TransitionTableIndex index_table_size;
+    TransitionTableIndex transition_table_size;
+    mutable TransducerTables<T1, T2> * materialized;
+
+    static const bool weighted = (T2::size == TransitionW::size);
+
+    static TransitionTableIndex offset(TransitionTableIndex i)
+        {
+            return (i < TRANSITION_TARGET_TABLE_START) ?
+                i : i - TRANSITION_TARGET_TABLE_START;
+        }
+    const char * index_entry(TransitionTableIndex i) const
+        { return index_data + offset(i) * T1::size; }
+    const char * transition_entry(TransitionTableIndex i) const
+        { return transition_data + offset(i) * T2::size; }
+    const TransducerTables<T1, T2> & get_materialized(void) const
+        {
+            if (materialized == NULL) {
+                materialized = new TransducerTables<T1, T2>(
+                    index_data, index_table_size,
+                    transition_data, transition_table_size);
+            }
+            return *materialized;
+        }
+public:
+    // The data of region must begin with the index table immediately
+    // followed by the transition table
+    MappedTransducerTables(const std::shared_ptr<MappedFileRegion> & region,
+                           TransitionTableIndex index_table_size,
+                           TransitionTableIndex transition_table_size):
+        region(region),
+        index_data(region->data()),
+        transition_data(region->data() + index_table_size * T1::size),
+        index_table_size(index_table_size),
+        transition_table_size(transition_table_size),
+        materialized(NULL) {}
+    ~MappedTransducerTables()
+        { delete materialized; }
+
+    // New tables reading the same mapping
+    MappedTransducerTables * share(void) const
+        {
+            return new MappedTransducerTables(
+                region, index_table_size, transition_table_size);
+        }
+
+    const TransitionIndex& get_index(TransitionTableIndex i) const
+        { return get_materialized().get_index(i); }
+    const Transition& get_transition(TransitionTableIndex i) const
+        { return get_materialized().get_transition(i); }
+    Weight get_weight(TransitionTableIndex i) const
+        {
+            return weighted ? read_packed<Weight>(
+                transition_entry(i) + 2 * sizeof(SymbolNumber)
+                + sizeof(TransitionTableIndex)) : 0.0;
+        }
+    SymbolNumber get_transition_input(TransitionTableIndex i) const
+        { return read_packed<SymbolNumber>(transition_entry(i)); }
+    SymbolNumber get_transition_output(TransitionTableIndex i) const
+        {
+            return read_packed<SymbolNumber>(
+                transition_entry(i) + sizeof(SymbolNumber));
+        }
+    TransitionTableIndex get_transition_target(TransitionTableIndex i) const
+        {
+            return read_packed<TransitionTableIndex>(
+                transition_entry(i) + 2 * sizeof(SymbolNumber));
+        }
+    bool get_transition_finality(TransitionTableIndex i) const
+        {
+            return get_transition_input(i) == NO_SYMBOL_NUMBER
+                && get_transition_output(i) == NO_SYMBOL_NUMBER
+                && get_transition_target(i) == 1;
+        }
+    SymbolNumber get_index_input(TransitionTableIndex i) const
+        { return read_packed<SymbolNumber>(index_entry(i)); }
+    TransitionTableIndex get_index_target(TransitionTableIndex i) const
+        {
+            return read_packed<TransitionTableIndex>(
+                index_entry(i) + sizeof(SymbolNumber));
+        }
+    bool get_index_finality(TransitionTableIndex i) const
+        {
+            return get_index_input(i) == NO_SYMBOL_NUMBER
+                && get_index_target(i) != NO_TABLE_INDEX;
+        }
+    Weight get_final_weight(TransitionTableIndex i) const
+        {
+            return weighted ? read_packed<Weight>(
+                index_entry(i) + sizeof(SymbolNumber)) : 0.0;
+        }
+
+    void display() const
+        { get_materialized().display(); }
+};
+
+
 // There follow some classes for implementing lookup
     
 class OlLetterTrie;
@@ -785,7 +967,7 @@ public:
     void add_string(const char * p,SymbolNumber symbol_key);
     bool has_key_starting_with(const char c) const;
     
-    SymbolNumber find_key(char ** p);
+    SymbolNumber find_key(char ** p) const;
     
 };
 
@@ -807,7 +989,7 @@ public:
             read_input_symbols(st);
         }
 
-    SymbolNumber find_key(char ** p);
+    SymbolNumber find_key(char ** p) const;
 
     friend class Transducer;
     friend class PmatchContainer;
@@ -831,6 +1013,8 @@ public:
         }
 };
 
+class LookupContext;
+
 /** \brief A compiled transducer format, suitable for fast lookup operations.
  */
 class Transducer
@@ -840,63 +1024,20 @@ protected:
     TransducerAlphabet* alphabet;
     TransducerTablesInterface* tables;
     void load_tables(std::istream& is);
+    void load_tables(std::istream& is, const std::string & filename);
 
     // for lookup
-    Weight current_weight;
-    HfstOneLevelPaths * lookup_paths;
     Encoder * encoder;
-    Tape input_tape;
-    Tape output_tape;
-    hfst::FdState<SymbolNumber> flag_state;
-    // This is to keep track of whether we're going to take a default transition
-    bool found_transition;
-    // For keeping a tally of previously epsilon-visited states to control
-    // going into loops
-    TraversalStates traversal_states;
-
-    ssize_t max_lookups;
-    unsigned int recursion_depth_left;
-    double max_time;
-    clock_t start_clock;
-
-    void try_epsilon_transitions(unsigned int input_tape_pos,
-                                 unsigned int output_tape_pos,
-                                 TransitionTableIndex i);
-  
-    void try_epsilon_indices(unsigned int input_tape_pos,
-                             unsigned int output_tape_pos,
-                             TransitionTableIndex i);
-
-    void find_transitions(SymbolNumber input,
-                          unsigned int input_tape_pos,
-                          unsigned int output_tape_pos,
-                          TransitionTableIndex i);
-
-    void find_index(SymbolNumber input,
-                    unsigned int input_tape_pos,
-                    unsigned int output_tape_pos,
-                    TransitionTableIndex i);
-    
-    void get_analyses(unsigned int input_tape_pos,
-                      unsigned int output_tape_pos,
-                      TransitionTableIndex i);
-    
-    void find_loop_epsilon_transitions(unsigned int input_pos,
-                                       TransitionTableIndex i);
-    void find_loop_epsilon_indices(unsigned int input_pos,
-                                   TransitionTableIndex i);
-    void find_loop_transitions(SymbolNumber input,
-                               unsigned int input_pos,
-                               TransitionTableIndex i);
-    void find_loop_index(SymbolNumber input,
-                         unsigned int input_pos,
-                         TransitionTableIndex i);
-    void find_loop(unsigned int input_pos,
-                   TransitionTableIndex i);
-
+    // Contexts of finished lookups, kept for reuse by later ones
+    mutable std::vector<LookupContext*> idle_contexts;
+    mutable std::mutex idle_contexts_mutex;
 
 public:
     Transducer(std::istream& is);
+    /* Read the header and alphabet from \a is, but map the tables in place
+       from \a filename, the file \a is is reading, instead of copying them.
+       \a is is left positioned after the tables. */
+    Transducer(std::istream& is, const std::string & filename);
     Transducer(bool weighted);
     Transducer(Transducer * t);
     Transducer();
@@ -908,9 +1049,15 @@ public:
                const TransducerAlphabet& alphabet,
                const TransducerTable<TransitionWIndex>& index_table,
                const TransducerTable<TransitionW>& transition_table);
+    // Takes ownership of tables
+    Transducer(const TransducerHeader& header,
+               const TransducerAlphabet& alphabet,
+               TransducerTablesInterface * tables);
     virtual ~Transducer();
 
     void write(std::ostream& os) const;
+    /* A new transducer with the contents of \a t. Memory-mapped tables are
+       shared with \a t instead of being read into memory. */
     Transducer * copy(Transducer * t, bool weighted = false);
     void display() const;
 
@@ -943,8 +1090,8 @@ public:
             return header->probe_flag(Has_input_epsilon_cycles);
         }
 
-    bool is_lookup_infinitely_ambiguous(const StringVector & s);
-    bool is_lookup_infinitely_ambiguous(const std::string & input);
+    bool is_lookup_infinitely_ambiguous(const StringVector & s) const;
+    bool is_lookup_infinitely_ambiguous(const std::string & input) const;
     
     TransducerTable<TransitionWIndex> copy_windex_table();
     TransducerTable<TransitionW> copy_transitionw_table();
@@ -961,18 +1108,29 @@ public:
         TransitionTableIndex state_index) const;
 
 
-    bool initialize_input(const char * input_str);
     HfstOneLevelPaths * lookup_fd(const StringVector & s, ssize_t limit = -1,
-        double time_cutoff = 0.0);
+        double time_cutoff = 0.0) const;
     /* Tokenize and lookup, accounting for flag diacritics, the surface string
        \a s. The return value, a pointer to HfstOneLevelPaths
        (which is a set) of analyses, is newly allocated.
+       The transducer is not modified, so lookups may run in several threads
+       at once; each one borrows a LookupContext from the transducer.
     */
     HfstOneLevelPaths * lookup_fd(const std::string & s, ssize_t limit = -1,
-                                  double time_cutoff = 0.0);
+                                  double time_cutoff = 0.0) const;
     HfstOneLevelPaths * lookup_fd(const char * s, ssize_t limit = -1,
-                                  double time_cutoff = 0.0);
-    void note_analysis(void);
+                                  double time_cutoff = 0.0) const;
+    /* As above, but use the caller's \a context, which must have been made
+       for this transducer and must not be used by another thread meanwhile.
+    */
+    HfstOneLevelPaths * lookup_fd(const char * s, LookupContext & context,
+                                  ssize_t limit = -1,
+                                  double time_cutoff = 0.0) const;
+
+    /* Take an idle lookup context of this transducer, or make a new one if
+       there is none. Give it back with release_lookup_context. */
+    LookupContext * acquire_lookup_context(void) const;
+    void release_lookup_context(LookupContext * context) const;
 
     // Methods for supporting ospell
     SymbolNumber get_unknown_symbol(void) const
@@ -997,6 +1155,254 @@ public:
 
     
     friend class ConvertTransducer;
+    friend class LookupEngine;
+    friend class EpsilonLoopFinder;
+};
+
+/** \brief The results of a lookup as paths of symbol numbers.
+
+    All the paths are stored back to back in one buffer, which keeps its
+    capacity when the arena is cleared, so an arena that is reused from
+    lookup to lookup stops allocating once it has grown to fit the largest
+    result. Identical paths with identical weights are stored only once;
+    they are found through a hash table of the paths, which keeps its
+    capacity as well.
+*/
+class SymbolPathArena
+{
+private:
+    struct PathEntry
+    {
+        size_t begin;
+        size_t end;
+        Weight weight;
+        size_t hash;
+    };
+    SymbolNumberVector symbols;
+    std::vector<PathEntry> paths;
+    // Open addressing with linear probing: each slot is zero or the index
+    // of a path plus one. There are at least twice as many slots as paths
+    // and the number of slots is a power of two.
+    std::vector<size_t> slots;
+
+    void grow_slots(void);
+
+public:
+    void clear(void)
+        {
+            if (!paths.empty()) {
+                std::fill(slots.begin(), slots.end(), 0);
+            }
+            symbols.clear();
+            paths.clear();
+        }
+    size_t size(void) const
+        { return paths.size(); }
+    bool empty(void) const
+        { return paths.empty(); }
+    Weight weight(size_t i) const
+        { return paths[i].weight; }
+    size_t length(size_t i) const
+        { return paths[i].end - paths[i].begin; }
+    /* The symbols of path \a i are [begin(i), end(i)). */
+    const SymbolNumber * begin(size_t i) const
+        { return symbols.empty() ? NULL : &symbols[0] + paths[i].begin; }
+    const SymbolNumber * end(size_t i) const
+        { return symbols.empty() ? NULL : &symbols[0] + paths[i].end; }
+
+    /* Add the path of \a length symbols at \a path with \a weight unless it
+       is already present. Return whether it was added. */
+    bool add(const SymbolNumber * path, size_t length, Weight weight);
+};
+
+/** \brief Iterative lookup over the tables of a Transducer.
+
+    The depth-first search is driven by an explicit stack instead of
+    recursion, and the tapes, the stack and the flag diacritic bookkeeping
+    are kept between lookups, so a long-lived engine does not allocate once
+    it has seen inputs of the lengths it is given. Results are written as
+    symbol numbers to a SymbolPathArena; strings are produced only when
+    asked for with symbol_string() or collect_paths().
+
+    Input characters that are not in the alphabet are numbered by the engine
+    itself and the transducer is not modified, but an engine is not safe to
+    use from several threads at once: each thread should own its engine.
+    The engine must not outlive its transducer.
+*/
+class LookupEngine
+{
+private:
+    enum Stage { START, EPSILONS, INPUT, MATCH };
+    enum Pending { NONE, EPSILON_ARC, FLAG_ARC, INPUT_ARC };
+
+    // One state on the current path of the search
+    struct LookupFrame
+    {
+        TransitionTableIndex state;
+        TransitionTableIndex cursor;
+        unsigned int input_pos;
+        unsigned int output_pos;
+        Weight weight;
+        SymbolNumber symbol;
+        SymbolNumber candidates[2];
+        unsigned char candidate_count;
+        unsigned char next_candidate;
+        unsigned char stage;
+        unsigned char pending;
+        bool found;
+        bool tried_default;
+    };
+
+    struct VisitedFlagState
+    {
+        TransitionTableIndex index;
+        FlagDiacriticState flags;
+    };
+
+    const Transducer & transducer;
+    const TransducerAlphabet & alphabet;
+    // The search loop instantiated for the type of the transducer's tables,
+    // chosen when the engine is made
+    void (LookupEngine::*search)(void);
+    SymbolNumber orig_symbol_count;
+    SymbolNumber identity_symbol;
+    SymbolNumber unknown_symbol;
+    SymbolNumber default_symbol;
+    SymbolNumber first_extra_symbol;
+
+    SymbolNumberVector input_tape;
+    SymbolNumberVector output_tape;
+    std::vector<std::string> extra_symbols;
+    // What to write when an extra symbol is copied to the output: an
+    // output-only symbol of the alphabet with the same string if there is
+    // one, so that equal results are equal as symbol numbers too
+    SymbolNumberVector extra_outputs;
+    size_t extra_symbol_count;
+
+    std::vector<LookupFrame> frames;
+    size_t depth;
+    hfst::FdState<SymbolNumber> flag_state;
+    std::vector<FlagDiacriticState> saved_flags;
+    std::vector<VisitedFlagState> visited;
+    size_t visited_count;
+
+    SymbolPathArena * results;
+    ssize_t max_lookups;
+    hfst::HfstDeadline deadline;
+    bool stopped;
+
+    SymbolNumber add_extra_symbol(const char * p, int bytes);
+    bool enter(TransitionTableIndex i, unsigned int input_pos,
+               unsigned int output_pos, Weight weight);
+    // The steps that read the tables are templates on their concrete type,
+    // so that every probe of the tables is an inlined read
+    template <class Tables> void run_search(void);
+    template <class Tables>
+    void start_frame(const Tables & tables, size_t level);
+    void prepare_input(LookupFrame & frame);
+    template <class Tables>
+    void step_epsilons(const Tables & tables, size_t level);
+    template <class Tables>
+    void step_input(const Tables & tables, size_t level);
+    template <class Tables>
+    void step_match(const Tables & tables, size_t level);
+    template <class Tables>
+    void finish_arc(const Tables & tables, size_t level);
+    void write_output(unsigned int output_pos, SymbolNumber symbol);
+    void note_analysis(unsigned int output_pos, Weight weight);
+    bool visited_contains(TransitionTableIndex i,
+                          const FlagDiacriticState & flags) const;
+    void visited_insert(TransitionTableIndex i,
+                        const FlagDiacriticState & flags);
+    void visited_erase(TransitionTableIndex i,
+                       const FlagDiacriticState & flags);
+
+public:
+    LookupEngine(const Transducer & t);
+
+    /* Split \a input into symbols the way lookup() does, leaving them in
+       the input tape. Return false if it could not be tokenized. */
+    bool tokenize(const char * input);
+    const SymbolNumberVector & get_input_tape(void) const
+        { return input_tape; }
+
+    /* Tokenize \a input and look it up, accounting for flag diacritics,
+       replacing the contents of \a paths with the results. At most \a limit
+       results are collected if it is not negative, and the search is
+       abandoned after \a time_cutoff seconds if it is positive.
+       Return false if the input could not be tokenized. The results refer
+       to symbols of this engine and are valid until its next lookup. */
+    bool lookup(const char * input, SymbolPathArena & paths,
+                ssize_t limit = -1, double time_cutoff = 0.0);
+
+    /* Abandon the lookup that is running, keeping the results found so
+       far, as if its time had run out. This may be called from another
+       thread than the one running the lookup. */
+    void cancel(void) { deadline.cancel(); }
+
+    /* The string of \a symbol, which may have been numbered during the
+       most recent lookup. Epsilon is the empty string. */
+    std::string symbol_string(SymbolNumber symbol) const;
+
+    /* Add the paths in \a paths, which must come from the most recent
+       lookup, to \a result as strings. */
+    void collect_paths(const SymbolPathArena & paths,
+                       HfstOneLevelPaths & result) const;
+};
+
+/* Checks whether an input can be looked up along an input-epsilon loop,
+   ie. whether it has infinitely many results. The state of the search lives
+   here rather than in the transducer, so each thread needs its own finder.
+*/
+class EpsilonLoopFinder
+{
+private:
+    const TransducerTablesInterface & tables;
+    const TransducerAlphabet & alphabet;
+    const SymbolNumber * input_tape;
+    hfst::FdState<SymbolNumber> flag_state;
+    // This is to keep track of whether we're going to take a default transition
+    bool found_transition;
+    // For keeping a tally of previously epsilon-visited states to control
+    // going into loops
+    TraversalStates traversal_states;
+
+    void find_loop_epsilon_transitions(unsigned int input_pos,
+                                       TransitionTableIndex i);
+    void find_loop_epsilon_indices(unsigned int input_pos,
+                                   TransitionTableIndex i);
+    void find_loop_transitions(SymbolNumber input,
+                               unsigned int input_pos,
+                               TransitionTableIndex i);
+    void find_loop_index(SymbolNumber input,
+                         unsigned int input_pos,
+                         TransitionTableIndex i);
+    void find_loop(unsigned int input_pos,
+                   TransitionTableIndex i);
+
+public:
+    EpsilonLoopFinder(const Transducer & t);
+
+    /* Whether \a input, a tape ending in NO_SYMBOL_NUMBER, reaches
+       an epsilon loop. */
+    bool has_loop(const SymbolNumber * input);
+};
+
+/** \brief What one thread needs to look up strings in a Transducer.
+
+    The transducer is only read during lookup, so any number of threads can
+    share it as long as each one uses its own context. A context belongs to
+    the transducer it was made for and must not outlive it.
+*/
+class LookupContext
+{
+public:
+    LookupContext(const Transducer & t):
+        engine(t), paths(), loop_finder(t) {}
+
+    LookupEngine engine;
+    SymbolPathArena paths;
+    EpsilonLoopFinder loop_finder;
 };
 
 class STransition{
@@ -1135,65 +1541,95 @@ typedef std::priority_queue<StringWeightPair,
 
   };*/
 
+/** \brief A configuration of the search of a Speller: how much of the
+    input has been read, where the mutator and the lexicon are and the
+    values of the flag diacritics, with the suggestion made so far and its
+    weight.
+
+    The suggestion is kept as a back pointer into a tree of suggestion
+    prefixes held by the Speller, so making a node does not copy it.
+*/
 class TreeNode
 {
 public:
-    SymbolNumberVector string;
+    // the suggestion so far, an index to Speller::string_nodes
+    unsigned int string;
     unsigned int input_state;
     TransitionTableIndex mutator_state;
     TransitionTableIndex lexicon_state;
-    hfst::FdState<SymbolNumber> flag_state;
+    hfst::FdStateValues flag_values;
     Weight weight;
+    // whether the suggestion is complete and its weight includes the final
+    // weights of the mutator and the lexicon
+    bool finished;
 
-    TreeNode(SymbolNumberVector prev_string,
-             unsigned int i,
-             TransitionTableIndex mutator,
-             TransitionTableIndex lexicon,
-             hfst::FdState<SymbolNumber> state,
-             Weight w):
-        string(prev_string),
-        input_state(i),
-        mutator_state(mutator),
-        lexicon_state(lexicon),
-        flag_state(state),
-        weight(w)
-        { }
-
-    TreeNode(hfst::FdState<SymbolNumber> start_state): // starting state node
-        string(SymbolNumberVector()),
+    TreeNode(const hfst::FdStateValues & start_values): // starting state node
+        string(0),
         input_state(0),
         mutator_state(0),
         lexicon_state(0),
-        flag_state(start_state),
-        weight(0.0)
+        flag_values(start_values),
+        weight(0.0),
+        finished(false)
         { }
+};
 
-    TreeNode update_lexicon(SymbolNumber next_symbol,
-                            TransitionTableIndex next_lexicon,
-                            Weight weight);
-
-    TreeNode update_mutator(SymbolNumber next_symbol,
-                            TransitionTableIndex next_mutator,
-                            Weight weight);
-
-    void increment_mutator(void);
+/** \brief The lighter of two TreeNodes comes first. */
+class TreeNodeComparison
+{
+public:
+    bool operator() (const TreeNode & lhs, const TreeNode & rhs) const
+        { // return true when we want rhs to appear before lhs
+            return (lhs.weight > rhs.weight);
+        }
+};
 
-    TreeNode update(SymbolNumber next_symbol,
-                    unsigned int next_input,
-                    TransitionTableIndex next_mutator,
-                    TransitionTableIndex next_lexicon,
-                    Weight weight);
+/** \brief Hash and compare TreeNodes by their configuration and
+    suggestion, ignoring the weight.
 
-    TreeNode update(SymbolNumber next_symbol,
-                    TransitionTableIndex next_mutator,
-                    TransitionTableIndex next_lexicon,
-                    Weight weight);
+    The suggestion is part of the key because two suggestions that reach
+    the same configuration may both be corrections; keeping only the
+    lighter one would lose the other from the results. */
+class TreeNodeConfiguration
+{
+public:
+    size_t operator() (const TreeNode & node) const
+        {
+            size_t h = node.string;
+            h = h * 31 + node.input_state;
+            h = h * 31 + node.mutator_state;
+            h = h * 31 + node.lexicon_state;
+            for (unsigned int i = 0;
+                 i < hfst::FdStateValues::packed_words; i++) {
+                h = h * 31 + static_cast<size_t>(node.flag_values.packed[i]);
+            }
+            for (size_t i = 0; i < node.flag_values.unpacked.size(); i++) {
+                h = h * 31 + static_cast<size_t>(node.flag_values.unpacked[i]);
+            }
+            return h;
+        }
+    bool operator() (const TreeNode & lhs, const TreeNode & rhs) const
+        {
+            return lhs.string == rhs.string &&
+                lhs.input_state == rhs.input_state &&
+                lhs.mutator_state == rhs.mutator_state &&
+                lhs.lexicon_state == rhs.lexicon_state &&
+                lhs.flag_values == rhs.flag_values;
+        }
+};
 
+typedef std::priority_queue<TreeNode,
+                            std::vector<TreeNode>,
+                            TreeNodeComparison> TreeNodeQueue;
 
+/** \brief A suggestion prefix: the prefix it extends and its last
+    symbol. */
+struct StringNode
+{
+    unsigned int parent;
+    SymbolNumber symbol;
 };
 
-typedef std::deque<TreeNode> TreeNodeQueue;
-
 int nByte_utf8(unsigned char c);
 
 class InputString
@@ -1232,6 +1668,17 @@ public:
 
 /** \brief A spellchecker, constructed from two optimized-lookup transducer
     instances. An alphabet translator is built at construction time.
+
+    Corrections are searched best first: the lightest configuration of
+    the mutator and the lexicon is always extended next, so corrections
+    are found in the order of their weights and the search can stop as
+    soon as enough of them have been found. A configuration that has
+    already been reached with the same suggestion and a smaller weight is
+    not searched again.
+
+    Stopping early is only right when no weight is negative. If the mutator
+    or the lexicon has a negative weight, every correction is searched for
+    and the limits are applied to them afterwards.
 */
 class Speller
 {
@@ -1251,25 +1698,73 @@ public:
         queue(TreeNodeQueue()),
         alphabet_translator(SymbolNumberVector()),
 //  operations(lexicon->get_fd_table()),
-        symbol_table(lexicon->get_symbol_table())
+        symbol_table(lexicon->get_symbol_table()),
+        flag_state(lexicon->get_fd_table()),
+        record_strings(true),
+        weight_limit(std::numeric_limits<Weight>::max())
         {
             build_alphabet_translator();
+            negative_weights = has_negative_weights(mutator) ||
+                has_negative_weights(lexicon);
         }
     
     bool init_input(char * str, const Encoder & encoder, SymbolNumber other);
 
     void build_alphabet_translator(void);
-    void lexicon_epsilons(void);
-    void mutator_epsilons(void);
-    void consume_input(void);
-    void lexicon_consume(void);
+    void lexicon_epsilons(const TreeNode & node);
+    void mutator_epsilons(const TreeNode & node);
+    void consume_input(const TreeNode & node);
+    void lexicon_consume(const TreeNode & node);
     /** See if \a line is in the lexicon.
      */
     bool check(char * line);
     /** Return a priority queue of corrections of \a line.
+
+        If \a nbest is positive, at most that many of the best corrections
+        are returned. If \a max_weight is not negative, corrections heavier
+        than it are not searched for, and if \a beam is not negative,
+        neither are those heavier than the best correction by more than
+        \a beam. If \a time_cutoff is positive, the search stops after that
+        many seconds and the corrections found so far are returned.
+
+        Epsilons and flag diacritics are not written into the corrections.
+     */
+    CorrectionQueue correct(char * line, int nbest = 0,
+                            Weight max_weight = -1.0, Weight beam = -1.0,
+                            double time_cutoff = 0.0);
+    /** Ask a running correct() or check() to stop as if its time had run
+        out. May be called from another thread.
      */
-    CorrectionQueue correct(char * line);
-    std::string stringify(SymbolNumberVector symbol_vector);
+    void cancel(void) { deadline.cancel(); }
+    std::string stringify(unsigned int string);
+
+protected:
+    // The tree of suggestion prefixes; the empty suggestion is number zero.
+    // A prefix is added only once, so equal suggestions have equal numbers.
+    std::vector<StringNode> string_nodes;
+    std::unordered_map<unsigned long long, unsigned int> string_numbers;
+    // the smallest weight each configuration has been reached with
+    std::unordered_map<TreeNode, Weight, TreeNodeConfiguration,
+                       TreeNodeConfiguration> best_weights;
+    hfst::FdState<SymbolNumber> flag_state;
+    hfst::HfstDeadline deadline;
+    bool record_strings;
+    // configurations heavier than this are not searched
+    Weight weight_limit;
+    // whether the mutator or the lexicon has a negative weight, so that
+    // corrections do not come out lightest first
+    bool negative_weights;
+
+    static bool has_negative_weights(const Transducer * t);
+
+    void start_search(void);
+    unsigned int extend_string(unsigned int string, SymbolNumber symbol);
+    void push(const TreeNode & node, SymbolNumber symbol,
+              unsigned int input_state,
+              TransitionTableIndex mutator_state,
+              TransitionTableIndex lexicon_state,
+              Weight weight);
+    bool is_stale(const TreeNode & node) const;
 };
 
 }
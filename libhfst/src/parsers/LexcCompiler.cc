@@ -35,6 +35,7 @@ using std::set_difference;
 
 #include "LexcCompiler.h"
 #include "HfstTransducer.h"
+#include "HfstThreadPool.h"
 #include "XreCompiler.h"
 #include "lexc-utils.h"
 
@@ -54,8 +55,10 @@ using hfst::hfst_fprintf_console;
 #endif // WINDOWS
 
 using hfst::HfstTransducer;
+using hfst::HfstThreadPool;
 using hfst::implementations::HfstTransitionGraph;
 using hfst::implementations::HfstBasicTransducer;
+using hfst::implementations::HfstMinimalAcyclicBuilder;
 using hfst::implementations::HfstState;
 using hfst::implementations::HfstBasicTransition;
 using hfst::ImplementationType;
@@ -100,6 +103,7 @@ LexcCompiler::LexcCompiler() :
     minimize_flags_(false),
     rename_flags_(false),
     allow_multiple_sublexicon_definitions_(false),
+    threads_(1),
     error_(&std::cerr)
 #ifdef WINDOWS
     , output_to_console_(false),
@@ -127,6 +131,7 @@ LexcCompiler::LexcCompiler(ImplementationType impl) :
     minimize_flags_(false),
     rename_flags_(false),
     allow_multiple_sublexicon_definitions_(false),
+    threads_(1),
     error_(&std::cerr)
 #ifdef WINDOWS
     , output_to_console_(false),
@@ -161,6 +166,7 @@ LexcCompiler::LexcCompiler(ImplementationType impl, bool withFlags, bool alignSt
     minimize_flags_(false),
     rename_flags_(false),
     allow_multiple_sublexicon_definitions_(false),
+    threads_(1),
     error_(&std::cerr)
 #ifdef WINDOWS
     , output_to_console_(false),
@@ -372,6 +378,13 @@ LexcCompiler::setRenameFlags(bool value)
     return *this;
 }
 
+LexcCompiler&
+LexcCompiler::setThreads(unsigned int threads)
+{
+    threads_ = (threads > 0) ? threads : 1;
+    return *this;
+}
+
 
 LexcCompiler&
 LexcCompiler::addNoFlag(const string& lexname)
@@ -435,7 +448,7 @@ LexcCompiler::addStringEntry(const string& data,
     }
     tokenizer_.add_multichar_symbol(joinerEnc);
     StringPairVector newVector(tokenizer_.tokenize(joinerEnc + str + encodedCont));
-    stringsTrie_.disjunct(newVector, weight);
+    lexiconBuilders_[currentLexiconName_].add(newVector, weight);
 
     return *this;
 }
@@ -634,7 +647,7 @@ LexcCompiler::addStringPairEntry(const string& upper, const string& lower,
         }
         
     }
-    stringsTrie_.disjunct(newVector, weight);
+    lexiconBuilders_[currentLexiconName_].add(newVector, weight);
 
     return *this;
 }
@@ -678,7 +691,6 @@ LexcCompiler::addXreEntry(const string& regexp, const string& continuation,
 //      {
 //        newPaths->set_final_weights(weight);
 //      }
-    newPaths->minimize();
 
 
     //printf("newPaths: \n");
@@ -695,12 +707,8 @@ LexcCompiler::addXreEntry(const string& regexp, const string& continuation,
    // cout << "lexicon " << regex_key << "\n";
 
     // FIXME: add all implicit chars to multichar symbols
-    if (regexps_.find(regex_key) == regexps_.end())
-      {
-        regexps_.insert(pair<string,HfstTransducer*>(regex_key,
-                                                   new HfstTransducer(format_)));
-      }
-    regexps_[regex_key]->disjunct(*newPaths).minimize();
+    // the entries are minimized and joined in compileLexical
+    regexpEntries_[regex_key].push_back(newPaths);
     if (!quiet_)
       {
         if ((currentEntries_ % 10000) == 0)
@@ -734,7 +742,7 @@ LexcCompiler::addXreEntry(const string& regexp, const string& continuation,
       }
       tokenizer_.add_multichar_symbol(joinerEnc);
       StringPairVector newVector(tokenizer_.tokenize(joinerEnc + regex_key + encodedCont));
-      stringsTrie_.disjunct(newVector, weight);
+      lexiconBuilders_[currentLexiconName_].add(newVector, weight);
 
 
 
@@ -829,6 +837,81 @@ LexcCompiler::setInitialLexiconName(const string& lexiconName)
     return *this;
 }
 
+HfstTransducer
+LexcCompiler::unionOfLexicons(HfstThreadPool & pool)
+{
+    vector<HfstMinimalAcyclicBuilder*> builders;
+    for (map<string,HfstMinimalAcyclicBuilder>::iterator it
+           = lexiconBuilders_.begin(); it != lexiconBuilders_.end(); ++it)
+      {
+        builders.push_back(&it->second);
+      }
+    if (builders.empty())
+      {
+        return HfstTransducer(format_);
+      }
+
+    // The lexicons are minimal already, but only as far as weights in
+    // their final states allow, so they are left for the rounds below
+    // to minimize
+    vector<HfstTransducer*> parts(builders.size(), (HfstTransducer*)NULL);
+    pool.run(builders.size(), [&](unsigned int, size_t i)
+      {
+        parts[i] = new HfstTransducer(builders[i]->get_transducer(), format_);
+      });
+
+    // Join the lexicons pairwise, halving their number in each round, so
+    // that the rounds can run in parallel too
+    while (parts.size() > 1)
+      {
+        pool.run(parts.size() / 2, [&](unsigned int, size_t i)
+          {
+            parts[2*i]->disjunct(*parts[2*i+1]).minimize();
+            delete parts[2*i+1];
+            parts[2*i+1] = NULL;
+          });
+        vector<HfstTransducer*> joined;
+        for (size_t i = 0; i < parts.size(); i += 2)
+          {
+            joined.push_back(parts[i]);
+          }
+        parts.swap(joined);
+      }
+
+    HfstTransducer lexicons(*parts[0]);
+    delete parts[0];
+    return lexicons;
+}
+
+void
+LexcCompiler::unionRegexps(HfstThreadPool & pool)
+{
+    vector<HfstTransducer*> unions;
+    vector<vector<HfstTransducer*>*> entries;
+    for (map<string,vector<HfstTransducer*> >::iterator it
+           = regexpEntries_.begin(); it != regexpEntries_.end(); ++it)
+      {
+        if (regexps_.find(it->first) == regexps_.end())
+          {
+            regexps_[it->first] = new HfstTransducer(format_);
+          }
+        unions.push_back(regexps_[it->first]);
+        entries.push_back(&it->second);
+      }
+
+    pool.run(unions.size(), [&](unsigned int, size_t i)
+      {
+        for (vector<HfstTransducer*>::iterator it = entries[i]->begin();
+             it != entries[i]->end(); ++it)
+          {
+            (*it)->minimize();
+            unions[i]->disjunct(**it).minimize();
+            delete *it;
+          }
+      });
+    regexpEntries_.clear();
+}
+
 HfstTransducer*
 LexcCompiler::compileLexical()
   {
@@ -849,10 +932,19 @@ LexcCompiler::compileLexical()
         return 0;
       }
 
-    HfstTransducer lexicons(stringsTrie_, format_);
-
+    // The OpenFst formats can minimize their lexicons in parallel: copies
+    // of a transducer share its implementation and symbol table only
+    // through the atomic reference counts of fst/lock.h, and the symbol
+    // numbers come from the thread-safe HfstSymbolInterner
+    unsigned int threads = 1;
+    if (format_ == TROPICAL_OPENFST_TYPE || format_ == LOG_OPENFST_TYPE)
+      {
+        threads = threads_;
+      }
+    HfstThreadPool pool(threads);
 
-    lexicons.minimize();
+    HfstTransducer lexicons = unionOfLexicons(pool);
+    unionRegexps(pool);
 
     // repeat star to overgenerate
     lexicons.repeat_star().minimize();
@@ -32,10 +32,11 @@
 #include <cstdio>
 
 //#include "HfstTransducer.h"
-namespace hfst { class HfstTransducer; }
+namespace hfst { class HfstTransducer; class HfstThreadPool; }
 #include "XreCompiler.h"
 #include "../HfstTokenizer.h"
 #include "../implementations/HfstTransitionGraph.h"
+#include "../implementations/HfstMinimalAcyclicBuilder.h"
 
 namespace hfst {
 //! @brief Namespace for Xerox LexC related specific functions and classes.
@@ -100,6 +101,11 @@ class LexcCompiler
 
   LexcCompiler& setRenameFlags(bool value);
 
+  //! @brief minimize the lexicons and the regular expression entries in
+  //! at most @a threads threads at a time when compiling.
+  //! Only the OpenFst formats are processed in parallel.
+  LexcCompiler& setThreads(unsigned int threads);
+
   //! @brief add @a alphabet to multicharacter symbol set.
   //! These symbolse may be used for regular expression ? for backends that do
   //! not support open alphabets.
@@ -153,6 +159,14 @@ class LexcCompiler
   const LexcCompiler& printConnectedness(bool & warnings_printed);
 
   private:
+  //! @brief the union of the lexicons, each converted separately in
+  //! @a pool.
+  hfst::HfstTransducer unionOfLexicons(hfst::HfstThreadPool & pool);
+
+  //! @brief build the union of the entries of each regular expression
+  //! key into regexps_, the keys in parallel in @a pool.
+  void unionRegexps(hfst::HfstThreadPool & pool);
+
   bool quiet_;
   bool verbose_;
   bool align_strings_;
@@ -161,6 +175,7 @@ class LexcCompiler
   bool rename_flags_;
   bool treat_warnings_as_errors_;
   bool allow_multiple_sublexicon_definitions_;
+  unsigned int threads_;
   std::ostream * error_;
 #ifdef WINDOWS
   bool output_to_console_;
@@ -174,10 +189,13 @@ class LexcCompiler
   std::string initialLexiconName_;
   std::map<std::string,hfst::HfstTransducer*> stringTries_;
   std::map<std::string,HfstBasicTransducer*> stringVectors_;
-  HfstBasicTransducer stringsTrie_;
-
-
+  // the string entries of each lexicon, kept minimal as they are added
+  std::map<std::string,hfst::implementations::HfstMinimalAcyclicBuilder>
+    lexiconBuilders_;
 
+  // the compiled regular expression entries of each key, until
+  // compileLexical makes their unions
+  std::map<std::string,std::vector<hfst::HfstTransducer*> > regexpEntries_;
   std::map<std::string,hfst::HfstTransducer*> regexps_;
   std::set<std::string> lexiconNames_;
   std::set<std::string> noFlags_;
@@ -12,6 +12,7 @@ namespace hfst { namespace pmatch {
 PmatchCompiler::PmatchCompiler() :
     flatten(false),
     verbose(false),
+    threads(1),
     definitions_(),
     format_(hfst::TROPICAL_OPENFST_TYPE)
 {}
@@ -19,6 +20,7 @@ PmatchCompiler::PmatchCompiler() :
 PmatchCompiler::PmatchCompiler(hfst::ImplementationType impl) :
     flatten(false),
     verbose(false),
+    threads(1),
     definitions_(),
     format_(impl)
 {}
@@ -36,7 +38,7 @@ std::map<std::string, HfstTransducer*>
 PmatchCompiler::compile(const std::string& pmatch)
 {
     return hfst::pmatch::compile(pmatch, definitions_, format_,
-                                 verbose, flatten);
+                                 verbose, flatten, threads);
 }
 
 }}
@@ -43,6 +43,7 @@ class PmatchCompiler
 private:
     bool flatten;
     bool verbose;
+    unsigned int threads;
   public:
   //! @brief Construct compiler for unknown format transducers.
   PmatchCompiler();
@@ -51,6 +52,10 @@ private:
 
   void set_flatten(bool val) { flatten = val; }
   void set_verbose(bool val) { verbose = val; }
+  //! @brief Harmonize and minimize the compiled transducers in at most
+  //!        @a val threads at a time. Only the OpenFst formats are
+  //!        processed in parallel.
+  void set_threads(unsigned int val) { threads = (val > 0) ? val : 1; }
 
   //! @brief Add a definition macro.
   //!        Compilers will replace arcs labeled @a name, with the transducer
@@ -652,21 +652,135 @@ namespace xfst {
     return size;
   }
 
+    XfstCompiler::PreparedLookup::PreparedLookup() :
+        prepared(false),
+        changes(0),
+        direction(APPLY_UP_DIRECTION),
+        transducer(NULL),
+        inverted(NULL),
+        fsm(NULL),
+        basic_lookup(NULL),
+        tokenizer(NULL),
+        infinitely_ambiguous(false)
+    {}
+
+    XfstCompiler::PreparedLookup::~PreparedLookup()
+    {
+      clear();
+    }
+
+    void
+    XfstCompiler::PreparedLookup::clear()
+    {
+      delete inverted;
+      delete fsm;
+      delete basic_lookup;
+      delete tokenizer;
+      inverted = NULL;
+      fsm = NULL;
+      basic_lookup = NULL;
+      tokenizer = NULL;
+      transducer = NULL;
+      prepared = false;
+    }
+
+    const XfstCompiler::PreparedLookup *
+    XfstCompiler::prepare_lookup(ApplyDirection direction)
+      {
+        if (stack_.size() < 1)
+          {
+            EMPTY_STACK;
+            xfst_lesser_fail();
+            return NULL;
+          }
+        const HfstTransducer * t = stack_.peek();
+        bool optimized = (t->get_type() == hfst::HFST_OL_TYPE ||
+                          t->get_type() == hfst::HFST_OLW_TYPE);
+
+        if (direction == APPLY_DOWN_DIRECTION)
+          {
+            if (optimized)
+              {
+                error() << "Operation not supported for optimized lookup format. Consider 'remove-optimization' to convert into ordinary format." << std::endl;
+                flush(&error());
+                xfst_lesser_fail();
+                return NULL;
+              }
+            // lookdown not yet implemented in HFST
+            if (verbose_)
+              {
+                error() << "warning: lookdown not implemented, inverting transducer and performing lookup" << std::endl
+                        << "for faster performance, invert and minimize top network and do lookup instead" << std::endl << std::endl;
+                flush(&error());
+              }
+          }
+
+        PreparedLookup & lookup = prepared_lookup_;
+        if (!lookup.prepared || lookup.changes != stack_.get_changes() ||
+            lookup.direction != direction)
+          {
+            lookup.clear();
+            if (direction == APPLY_DOWN_DIRECTION)
+              {
+                lookup.inverted = new HfstTransducer(*t);
+                lookup.inverted->invert().minimize();
+                t = lookup.inverted;
+              }
+            lookup.transducer = t;
+            if (!optimized)
+              {
+                lookup.fsm = new HfstBasicTransducer(*t);
+                lookup.basic_lookup = new HfstBasicLookup(*lookup.fsm);
+                lookup.tokenizer = new HfstTokenizer();
+                const HfstBasicTransducer::HfstTransitionGraphAlphabet & alpha
+                  = lookup.fsm->get_alphabet();
+                for (HfstBasicTransducer::HfstTransitionGraphAlphabet::const_iterator it
+                       = alpha.begin(); it != alpha.end(); it++)
+                  {
+                    lookup.tokenizer->add_multichar_symbol(*it);
+                  }
+                // if no input epsilon cycle exists, no input can be
+                // infinitely ambiguous and the lines need not be checked
+                lookup.infinitely_ambiguous
+                  = lookup.fsm->is_infinitely_ambiguous();
+              }
+            else
+              {
+                StringVector foo; // this gets ignored by ol transducer's is_lookup_infinitely_ambiguous
+                lookup.infinitely_ambiguous
+                  = t->is_lookup_infinitely_ambiguous(foo);
+              }
+            lookup.direction = direction;
+            lookup.changes = stack_.get_changes();
+            lookup.prepared = true;
+          }
+
+        if (lookup.fsm == NULL && lookup.infinitely_ambiguous && verbose_)
+          {
+            error() << "warning: transducer is infinitely ambiguous, limiting number of cycles to " << variables_["lookup-cycle-cutoff"] << std::endl;
+            flush(&error());
+          }
+        return &lookup;
+      }
+
     XfstCompiler&
-    XfstCompiler::apply_line(char* line, HfstBasicTransducer * t)
+    XfstCompiler::apply_line(char* line, const PreparedLookup & lookup)
       {
-        char* token = strstrip(line);
-        StringSet alpha = t->get_alphabet();
-        HfstTokenizer tok;
-        for (StringSet::const_iterator it = alpha.begin();
-             it != alpha.end(); it++)
+        if (lookup.fsm == NULL)
           {
-            tok.add_multichar_symbol(*it);
+            // number of cycles needs to be limited for an infinitely ambiguous ol transducer
+            // because it doesn't support is_lookup_infinitely_ambiguous(const string &)
+            size_t ol_cutoff = string_to_size_t(variables_["lookup-cycle-cutoff"]);
+            return this->apply_line(line, lookup.transducer, ol_cutoff);
           }
-        StringVector lookup_path = tok.tokenize_one_level(std::string(token));
+
+        char* token = strstrip(line);
+        StringVector lookup_path
+          = lookup.tokenizer->tokenize_one_level(std::string(token));
 
         size_t cutoff = -1;
-        if (t->is_lookup_infinitely_ambiguous(lookup_path))
+        if (lookup.infinitely_ambiguous &&
+            lookup.fsm->is_lookup_infinitely_ambiguous(lookup_path))
           {
             cutoff = string_to_size_t(variables_["lookup-cycle-cutoff"]);
             if (verbose_)
@@ -683,11 +797,11 @@ namespace xfst {
         // todo: variables_["obey-flags"] == ["ON"|"OFF"]
 
         if (variables_["maximum-weight"] == "OFF")
-          t->lookup_fd(lookup_path, results, &cutoff, NULL);
+          lookup.basic_lookup->lookup_fd(lookup_path, results, &cutoff, NULL);
         else
           {
             float max_weight = string_to_float(variables_["maximum-weight"]);
-            t->lookup_fd(lookup_path, results, &cutoff, &max_weight);
+            lookup.basic_lookup->lookup_fd(lookup_path, results, &cutoff, &max_weight);
           }
 
         HfstOneLevelPaths paths = extract_output_paths(results);
@@ -858,61 +972,23 @@ namespace xfst {
     XfstCompiler&
     XfstCompiler::apply_up_line(char* line)
       {
-        if (stack_.size() < 1)
-          {
-            EMPTY_STACK;
-            xfst_lesser_fail();
-            prompt();
-            return *this;
-          }
-        HfstTransducer * t = stack_.top();
-        if (t->get_type() != hfst::HFST_OL_TYPE && t->get_type() != hfst::HFST_OLW_TYPE)
-          {
-            //hfst_fprintf(warnstream_, "lookup might be slow, consider 'convert net'\n");
-            HfstBasicTransducer fsm(*t);
-            return this->apply_line(line, &fsm);
-          }
-
-        size_t ol_cutoff = string_to_size_t(variables_["lookup-cycle-cutoff"]); // -1; fix this
-        StringVector foo; // this gets ignored by ol transducer's is_lookup_infinitely_ambiguous
-        if (t->is_lookup_infinitely_ambiguous(foo))
+        const PreparedLookup * lookup = prepare_lookup(APPLY_UP_DIRECTION);
+        if (lookup == NULL)
           {
-            ol_cutoff = string_to_size_t(variables_["lookup-cycle-cutoff"]);;
-            if (verbose_)
-              {
-                error() << "warning: transducer is infinitely ambiguous, limiting number of cycles to " << ol_cutoff << std::endl;
-                flush(&error());
-            //hfst_fprintf(warnstream_, 
-            //                "warning: transducer is infinitely ambiguous, limiting number of cycles to " SIZE_T_SPECIFIER "\n", ol_cutoff);
-              }
+            PROMPT_AND_RETURN_THIS;
           }
-        
-        return this->apply_line(line, t, ol_cutoff);
+        return this->apply_line(line, *lookup);
       }
 
     XfstCompiler&
     XfstCompiler::apply_down_line(char* line)
       {
-        GET_TOP(t);
-        // lookdown not yet implemented in HFST
-        if (verbose_)
+        const PreparedLookup * lookup = prepare_lookup(APPLY_DOWN_DIRECTION);
+        if (lookup == NULL)
           {
-            error() << "warning: lookdown not implemented, inverting transducer and performing lookup" << std::endl
-                    << "for faster performance, invert and minimize top network and do lookup instead" << std::endl << std::endl;
-            flush(&error());
-        //hfst_fprintf(warnstream_, 
-        //                 "warning: lookdown not implemented, inverting transducer and performing lookup\n"
-        //                 "for faster performance, invert and minimize top network and do lookup instead\n\n");
+            PROMPT_AND_RETURN_THIS;
           }
-        t = new HfstTransducer(*(stack_.top()));
-        t->invert().minimize();
-
-        //hfst_fprintf(warnstream_, "lookup might be slow, consider 'convert net'\n");
-
-        HfstBasicTransducer fsm(*t);
-        this->apply_line(line, &fsm);
-        delete t;
-        return *this;
+        return this->apply_line(line, *lookup);
       }
 
     XfstCompiler&
@@ -1039,64 +1115,10 @@ namespace xfst {
   XfstCompiler&
   XfstCompiler::apply(FILE* infile, ApplyDirection direction)
       {
-        if (stack_.size() < 1)
-          {
-            EMPTY_STACK;
-            xfst_lesser_fail();
-            prompt();
-            return *this;
-          }
-        HfstTransducer * t = stack_.top();
-        size_t ol_cutoff = string_to_size_t(variables_["lookup-cycle-cutoff"]); ; // -1; fix this // number of cycles needs to be limited for an infinitely ambiguous ol transducer
-                               // because it doesn't support is_lookup_infinitely_ambiguous(const string &)
-
-        HfstBasicTransducer * fsm = NULL;
-
-        if (direction == APPLY_DOWN_DIRECTION)
-          {
-            if (t->get_type() == hfst::HFST_OL_TYPE ||
-                t->get_type() == hfst::HFST_OLW_TYPE)
-              {
-                error() << "Operation not supported for optimized lookup format. Consider 'remove-optimization' to convert into ordinary format." << std::endl; 
-                flush(&error());
-                //hfst_fprintf(stderr, "Operation not supported for optimized lookup format. "
-                //             "Consider 'remove-optimization' to convert into ordinary format.\n");
-                prompt();
-                return *this;
-              }
-
-            // lookdown not yet implemented in HFST
-            if (verbose_)
-              {
-                error() << "warning: lookdown not implemented, inverting transducer and performing lookup" << std::endl
-                        << "for faster performance, invert and minimize top network and do lookup instead" << std::endl << std::endl;
-                flush(&error());
-                //hfst_fprintf(warnstream_, 
-                //             "warning: lookdown not implemented, inverting transducer and performing lookup\n"
-                //             "for faster performance, invert and minimize top network and do lookup instead\n\n");
-              }
-            t = new HfstTransducer(*(stack_.top()));
-            t->invert().minimize();
-          }
-
-        if (t->get_type() != hfst::HFST_OL_TYPE && t->get_type() != hfst::HFST_OLW_TYPE)
-          {
-            fsm = new HfstBasicTransducer(*t);
-          }
-        else
+        const PreparedLookup * lookup = prepare_lookup(direction);
+        if (lookup == NULL)
           {
-            StringVector foo; // this gets ignored by ol transducer's is_lookup_infinitely_ambiguous
-            if (t->is_lookup_infinitely_ambiguous(foo))
-              {
-                ol_cutoff = string_to_size_t(variables_["lookup-cycle-cutoff"]);
-                if (verbose_)
-                  {
-                    error() << "warning: transducer is infinitely ambiguous, limiting number of cycles to " << ol_cutoff << std::endl;
-                    flush(&error());
-                //hfst_fprintf(warnstream_, 
-                //                 "warning: transducer is infinitely ambiguous, limiting number of cycles to " SIZE_T_SPECIFIER "\n", ol_cutoff);
-                  }
-              }
+            PROMPT_AND_RETURN_THIS;
           }
 
         char * line = NULL;
@@ -1128,21 +1150,13 @@ namespace xfst {
               }
 
             // perform lookup/lookdown
-            if (fsm != NULL)
-              apply_line(line, fsm);
-            else
-              apply_line(line, t, ol_cutoff);
+            apply_line(line, *lookup);
             free(line);
           }
 
         // ignore all readline history given to the apply command
         ignore_history_after_index(ind);
 
-        if (direction == APPLY_DOWN_DIRECTION)
-          delete t;
-        if (fsm != NULL)
-          delete fsm;
-
         PROMPT_AND_RETURN_THIS;
       }
 
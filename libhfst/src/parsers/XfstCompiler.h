@@ -33,6 +33,7 @@
 #include <stack>
 
 #include "HfstTransducer.h"
+#include "HfstBasicLookup.h"
 #include "XreCompiler.h"
 #include "LexcCompiler.h"
 
@@ -61,6 +62,26 @@ namespace xfst {
 
   typedef std::map<std::string,std::string> StringMap;
 
+  // The stack of transducers. It counts its changes, so that a lookup
+  // prepared for the transducer on top can tell whether it is out of date.
+  // top() gives the transducer for changing it in place, so it counts as a
+  // change; peek() gives it for reading only.
+  class TransducerStack : public std::stack<hfst::HfstTransducer*>
+  {
+  public:
+    typedef std::stack<hfst::HfstTransducer*> Base;
+    TransducerStack(): changes_(0) {}
+    TransducerStack & operator=(const Base & another)
+      { Base::operator=(another); ++changes_; return *this; }
+    void push(hfst::HfstTransducer * t) { Base::push(t); ++changes_; }
+    void pop() { Base::pop(); ++changes_; }
+    hfst::HfstTransducer *& top() { ++changes_; return Base::top(); }
+    const hfst::HfstTransducer * peek() const { return Base::top(); }
+    unsigned long get_changes() const { return changes_; }
+  private:
+    unsigned long changes_;
+  };
+
 //! @brief Xfst compiler contains all the methods and variables a session of
 //! XFST script parser needs.
 class XfstCompiler
@@ -688,8 +709,41 @@ class XfstCompiler
   XfstCompiler& print_transducer_info();
   XfstCompiler& add_prop_line(char* line);
 
+  /* A lookup prepared for the transducer on top of the stack. It is
+     reused by apply up and apply down until the stack changes, so that
+     the transducer is converted, inverted and its symbols collected only
+     once for all the lines looked up. */
+  struct PreparedLookup
+  {
+    PreparedLookup();
+    ~PreparedLookup();
+    void clear();
+
+    bool prepared;
+    // the number of changes of the stack when this was prepared
+    unsigned long changes;
+    ApplyDirection direction;
+    // what is looked up in: the top of the stack or inverted
+    const hfst::HfstTransducer * transducer;
+    // the inverted top of the stack for apply down, else NULL
+    hfst::HfstTransducer * inverted;
+    // transducer in basic format and indexed for lookup, NULL for
+    // optimized lookup
+    hfst::HfstBasicTransducer * fsm;
+    hfst::HfstBasicLookup * basic_lookup;
+    // splits input into the symbols of fsm
+    hfst::HfstTokenizer * tokenizer;
+    // whether some input may have infinitely many results
+    bool infinitely_ambiguous;
+  };
+
+  /* The lookup of the top of the stack in \a direction, prepared now if
+     the stack has changed since the last time. If there is nothing to
+     look up in, print an error and return NULL. */
+  const PreparedLookup * prepare_lookup(ApplyDirection direction);
+
+  XfstCompiler& apply_line(char* line, const PreparedLookup & lookup);
   XfstCompiler& apply_line(char* line, const HfstTransducer * t, size_t cutoff);
-  XfstCompiler& apply_line(char* line, HfstBasicTransducer * t);
 
   XfstCompiler& apply_up_line(char* line);
   XfstCompiler& apply_down_line(char* line);
@@ -720,7 +774,8 @@ class XfstCompiler
   std::map<std::string,std::string> original_function_definitions_;
   std::map<std::string,std::string> function_definitions_;
   std::map<std::string,unsigned int> function_arguments_;
-  std::stack<hfst::HfstTransducer*> stack_;
+  TransducerStack stack_;
+  PreparedLookup prepared_lookup_;
   std::map<std::string,hfst::HfstTransducer*> names_;
   std::map<std::string,std::string> aliases_;
   std::map<std::string,std::string> variables_;
@@ -7,10 +7,12 @@
 #include <cassert>
 #include <cstdlib>
 #include <cstring>
+#include <mutex>
 #include <sstream>
 
 #include "pmatch_utils.h"
 #include "HfstTransducer.h"
+#include "HfstThreadPool.h"
 //#include "tools/src/HfstUtf8.h"
 #include "implementations/optimized-lookup/pmatch.h"
 
@@ -54,26 +56,28 @@ namespace hfst
 namespace pmatch 
 {
 
-char* data;
-std::map<std::string, hfst::pmatch::PmatchObject*> definitions;
-std::vector<std::map<std::string, PmatchObject*> > call_stack;
-std::map<std::string, PmatchObject*> def_insed_expressions;
-std::set<std::string> inserted_names;
-std::set<std::string> unsatisfied_insertions;
-std::set<std::string> used_definitions;
-std::map<std::string, PmatchFunction> functions;
-char* startptr;
-hfst::ImplementationType format;
-size_t len;
-bool verbose;
-bool flatten;
-clock_t timer;
-clock_t tmp_timer;
-int minimization_guard_count;
-bool need_delimiters;
+thread_local char* data;
+thread_local std::map<std::string, hfst::pmatch::PmatchObject*> definitions;
+thread_local std::vector<std::map<std::string, PmatchObject*> > call_stack;
+thread_local std::map<std::string, PmatchObject*> def_insed_expressions;
+thread_local std::set<std::string> inserted_names;
+thread_local std::set<std::string> unsatisfied_insertions;
+thread_local std::set<std::string> used_definitions;
+thread_local std::map<std::string, PmatchFunction> functions;
+thread_local char* startptr;
+thread_local hfst::ImplementationType format;
+thread_local size_t len;
+thread_local bool verbose;
+thread_local bool flatten;
+thread_local clock_t timer;
+thread_local clock_t tmp_timer;
+thread_local int minimization_guard_count;
+thread_local bool need_delimiters;
 
 std::map<std::string, hfst::HfstTransducer> named_transducers;
-PmatchUtilityTransducers* utils=NULL;
+
+// The parser and the lexer keep their state in globals
+static std::mutex parser_mutex;
 
 void warn(std::string warning)
 {
@@ -83,10 +87,8 @@ void warn(std::string warning)
 PmatchUtilityTransducers*
 get_utils()
 {
-  if (utils == NULL) 
-    {
-      utils = new PmatchUtilityTransducers(); 
-    }
+  // made by the first thread that needs them
+  static PmatchUtilityTransducers* utils = new PmatchUtilityTransducers();
   return utils;
 }
 
@@ -690,9 +692,9 @@ void init_globals(void)
 
 std::map<std::string, HfstTransducer*>
 compile(const string& pmatch, map<string,HfstTransducer*>& defs,
-        ImplementationType impl, bool be_verbose, bool do_flatten)
+        ImplementationType impl, bool be_verbose, bool do_flatten,
+        unsigned int threads)
 {
-    // lock here?
     init_globals();
     data = strdup(pmatch.c_str());
     startptr = data;
@@ -708,7 +710,12 @@ compile(const string& pmatch, map<string,HfstTransducer*>& defs,
         timer = clock();
         std::cerr << std::endl;
     }
-    pmatchparse();
+    int parse_errors;
+    {
+        std::lock_guard<std::mutex> lock(parser_mutex);
+        pmatchparse();
+        parse_errors = pmatchnerrs;
+    }
     free(startptr);
     data = 0;
     len = 0;
@@ -733,37 +740,65 @@ compile(const string& pmatch, map<string,HfstTransducer*>& defs,
          }
      }
 
-    if (pmatchnerrs != 0) {
+    if (parse_errors != 0) {
         return retval;
     }
-    // Our helper for harmonizing all the networks' alphabets with
-    // each other
     if (hfst::pmatch::verbose) {
         std::cerr << "\nCompiling and harmonizing...\n";
         timer = clock();
     }
 
+    // The OpenFst formats can harmonize and minimize the networks in
+    // parallel: the networks share implementations and symbol tables with
+    // each other and with the cached evaluations only through the atomic
+    // reference counts of fst/lock.h, and the symbol numbers come from the
+    // thread-safe HfstSymbolInterner
+    if (format != TROPICAL_OPENFST_TYPE && format != LOG_OPENFST_TYPE) {
+        threads = 1;
+    }
+
     if (inserted_names.size() > 0) {
-        HfstTransducer dummy(format);
-        // We keep TOP and any inserted transducers
+        // We keep TOP and any inserted transducers. They are evaluated one
+        // at a time, as they share the evaluations of the definitions they
+        // refer to.
+        std::vector<HfstTransducer *> nets;
+        // The symbols of all the networks and of the ones before each
+        std::vector<StringSet> symbols_before;
+        StringSet symbols;
         std::map<std::string, PmatchObject *>::iterator defs_it;
         for (defs_it = definitions.begin(); defs_it != definitions.end();
              ++defs_it) {
             if (defs_it->first.compare("TOP") == 0 ||
                 inserted_names.count(defs_it->first) != 0) {
                 HfstTransducer * tmp = defs_it->second->evaluate();
-                dummy.harmonize(*tmp);
+                symbols_before.push_back(symbols);
+                StringSet alphabet = tmp->get_alphabet();
+                symbols.insert(alphabet.begin(), alphabet.end());
+                nets.push_back(tmp);
                 retval[defs_it->first] = tmp;
             }
         }
-        
-        // Now that dummy is harmonized with everything, we harmonize everything
-        // with dummy and minimize the results
-        std::map<std::string, HfstTransducer *>::iterator tr_it;
-        for(tr_it = retval.begin(); tr_it != retval.end(); ++tr_it) {
-            tr_it->second->harmonize(dummy);
-            tr_it->second->minimize();
-        }
+
+        // Each network is harmonized with the symbols of the ones before
+        // it and then with all the symbols, as when a single helper
+        // transducer was harmonized with the networks in turn, so that
+        // the transitions come out in the same order.
+        // The parser globals are thread-local, so the workers get what
+        // they need from here
+        ImplementationType type = format;
+        HfstThreadPool pool(threads);
+        pool.run(nets.size(),
+                 [&nets, &symbols_before, &symbols, type]
+                 (unsigned int, size_t i)
+          {
+            HfstTransducer before(type);
+            before.insert_to_alphabet(symbols_before[i]);
+            before.harmonize(*nets[i]);
+            HfstTransducer all(type);
+            all.insert_to_alphabet(symbols);
+            nets[i]->harmonize(all);
+            nets[i]->minimize();
+          });
     } else {
         hfst::HfstTransducer * tmp = definitions["TOP"]->evaluate();
         tmp->minimize();
@@ -801,23 +836,22 @@ HfstTransducer * read_text(char * filename, ImplementationType type)
     std::string line;
     infile.open(filename);
     HfstTokenizer tok;
-    HfstTransducer * retval = new HfstTransducer(type);
+    StringVector lines;
     if(!infile.good()) {
         std::cerr << "Pmatch: could not open text file " << filename <<
             " for reading\n";
     } else {
-        size_t n = 0;
         while(infile.good()) {
             std::getline(infile, line);
             if(!line.empty()) {
-                ++n;
-                StringPairVector spv = tok.tokenize(line);
-                retval->disjunct(spv);
+                lines.push_back(line);
             }
         }
     }
     infile.close();
-    return retval;
+    // Build the word list in one pass instead of disjuncting each line
+    return new HfstTransducer(
+        HfstTransducer::from_word_list(lines, tok, type));
 }
 
 std::vector<std::vector<std::string> > read_args(char * filename, unsigned int argcount)
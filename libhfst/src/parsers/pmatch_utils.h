@@ -26,22 +26,24 @@ struct PmatchTransducerContainer;
 
 typedef std::pair<std::string, std::string> StringPair;
 
-extern char* data;
-extern char* startptr;
-extern size_t len;
-extern std::map<std::string, PmatchObject*> definitions;
-extern std::vector<std::map<std::string, PmatchObject*> > call_stack;
-extern std::map<std::string, PmatchObject*> def_insed_expressions;
-extern std::set<std::string> inserted_names;
-extern std::set<std::string> unsatisfied_insertions;
-extern std::set<std::string> used_definitions;
-extern ImplementationType format;
-extern bool verbose;
-extern bool flatten;
-extern clock_t timer;
-extern clock_t tmp_timer;
-extern int minimization_guard_count;
-extern bool need_delimiters;
+// The state of the compilation in progress. Each thread has its own, so
+// compilations in different threads do not see each other's definitions.
+extern thread_local char* data;
+extern thread_local char* startptr;
+extern thread_local size_t len;
+extern thread_local std::map<std::string, PmatchObject*> definitions;
+extern thread_local std::vector<std::map<std::string, PmatchObject*> > call_stack;
+extern thread_local std::map<std::string, PmatchObject*> def_insed_expressions;
+extern thread_local std::set<std::string> inserted_names;
+extern thread_local std::set<std::string> unsatisfied_insertions;
+extern thread_local std::set<std::string> used_definitions;
+extern thread_local ImplementationType format;
+extern thread_local bool verbose;
+extern thread_local bool flatten;
+extern thread_local clock_t timer;
+extern thread_local clock_t tmp_timer;
+extern thread_local int minimization_guard_count;
+extern thread_local bool need_delimiters;
 
 struct PmatchUtilityTransducers;
 const std::string RC_ENTRY_SYMBOL = "@PMATCH_RC_ENTRY@";
@@ -140,12 +142,17 @@ void init_globals(void);
 
 /**
  * @brief compile new transducer
+ *
+ * The transducers that are kept are harmonized and minimized in at most
+ * @a threads threads at a time. Only the OpenFst formats are processed in
+ * parallel.
  */
 std::map<std::string, HfstTransducer*>
     compile(const std::string& pmatch,
             std::map<std::string,hfst::HfstTransducer*>& defs,
             hfst::ImplementationType type,
-            bool be_verbose, bool do_flatten);
+            bool be_verbose, bool do_flatten,
+            unsigned int threads = 1);
 
 void print_size_info(HfstTransducer * net);
 
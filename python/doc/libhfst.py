@@ -1608,6 +1608,32 @@ class HfstTransducer:
     def lookup(self, input, **kvargs):
         pass
 
+    ## Lookup each string in \a inputs.
+    # @param inputs A list of strings.
+    # @param kvargs Possible parameters and their default values are: max_number=-1, time_cutoff=0.0, threads=1
+    # @param max_number Maximum number of results returned for each string, defaults to -1, i.e. infinity.
+    # @param time_cutoff How long the search for each string can go on, expressed in seconds. Defaults to 0.0, i.e. infinitely.
+    # @param threads How many strings are looked up at a time, defaults to 1.
+    # @return A list with an item for each string in \a inputs, in the same order.
+    #         Each item is a tuple of tuples of an output string and a weight, as with lookup(input, output='tuple').
+    #
+    # The lookups run with the Python interpreter lock released, so other Python threads can run
+    # at the same time, and with \a threads greater than 1 they use more than one core.
+    # Flag diacritics are obeyed.
+    #
+    # @note This function is implemented only for optimized lookup format (libhfst.HFST_OL_TYPE or libhfst.HFST_OLW_TYPE).
+    #
+    # An example:
+    #
+    # \verbatim
+    # >>> tr = libhfst.regex('foo:bar::0.5 | foo:baz')
+    # >>> tr.convert(libhfst.HFST_OLW_TYPE)
+    # >>> tr.lookup_many(['foo', 'bar'], threads=2)
+    # [(('baz', 0.0), ('bar', 0.5)), ()]
+    # \endverbatim
+    def lookup_many(self, inputs, **kvargs):
+        pass
+
     ## Extract paths that are recognized by the transducer. 
     #
     # @param kvargs Arguments recognized are filter_flags, max_cycles, max_number, obey_flags, output, random.
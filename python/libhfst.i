@@ -8,12 +8,16 @@
 
 %feature("autodoc", "3");
 
+// used by HfstTransducer.lookup_many_
+%fragment("SWIG_FromCharPtrAndSize");
+
 %init %{
     hfst::set_warning_stream(&std::cerr);
 %}
 
 %{
 #define HFSTIMPORT
+#include <memory>
 #include "HfstDataTypes.h"
 #include "HfstTransducer.h"
 #include "HfstOutputStream.h"
@@ -27,6 +31,7 @@
 #include "parsers/PmatchCompiler.h"
 #include "parsers/XfstCompiler.h"
 #include "implementations/HfstTransitionGraph.h"
+#include "HfstThreadPool.h"
 
 // todo instead: #include "hfst_extensions.h"
 
@@ -311,6 +316,53 @@ std::string two_level_paths_to_string(const hfst::HfstTwoLevelPaths & paths)
     return oss.str();
 }
 
+/* The paths returned by HfstTransducer::lookup functions, which the caller
+   owns. */
+hfst::HfstOneLevelPaths take_one_level_paths(hfst::HfstOneLevelPaths * paths)
+{
+    hfst::HfstOneLevelPaths result;
+    result.swap(*paths);
+    delete paths;
+    return result;
+}
+
+/* The results of looking up one string: the output strings with their
+   symbols put together, and their weights, best first. */
+typedef std::vector<std::pair<std::string, float> > LookupResults;
+
+/* Look up each string in inputs in t on threads threads, putting the
+   results of inputs[i] in results[i]. No Python objects are touched, so
+   this can run with the interpreter lock released. */
+void lookup_many(const hfst::HfstTransducer & t,
+                 const hfst::StringVector & inputs,
+                 std::vector<LookupResults> & results,
+                 int limit, double time_cutoff, unsigned int threads)
+{
+    if (t.get_type() != hfst::HFST_OL_TYPE && t.get_type() != hfst::HFST_OLW_TYPE)
+      HFST_THROW(FunctionNotImplementedException);
+
+    results.clear();
+    results.resize(inputs.size());
+    hfst::HfstThreadPool pool(threads);
+    pool.run(inputs.size(), [&](unsigned int thread, size_t i)
+    {
+      (void)thread;
+      std::unique_ptr<hfst::HfstOneLevelPaths> paths
+        (t.lookup_fd(inputs[i], limit, time_cutoff));
+      LookupResults & result = results[i];
+      result.reserve(paths->size());
+      for (hfst::HfstOneLevelPaths::const_iterator it = paths->begin(); it != paths->end(); it++)
+      {
+        std::string output;
+        for (hfst::StringVector::const_iterator svit = it->second.begin(); svit != it->second.end(); svit++)
+        {
+          output += *svit;
+        }
+        result.push_back(std::pair<std::string, float>(output, it->first));
+      }
+    });
+}
+
 
 }
 
@@ -690,13 +742,47 @@ int longest_path_size(bool obey_flags=true) const;
 // Wrappers for lookup functions
 
 HfstOneLevelPaths lookup_fd_vector(const StringVector& s, int limit = -1, double time_cutoff = 0.0) const throw(FunctionNotImplementedException)
-{ return *($self->lookup_fd(s, limit, time_cutoff)); }
+{ return hfst::take_one_level_paths($self->lookup_fd(s, limit, time_cutoff)); }
 HfstOneLevelPaths lookup_fd_string(const std::string& s, int limit = -1, double time_cutoff = 0.0) const throw(FunctionNotImplementedException)
-{ return *($self->lookup_fd(s, limit, time_cutoff)); }
+{ return hfst::take_one_level_paths($self->lookup_fd(s, limit, time_cutoff)); }
 HfstOneLevelPaths lookup_vector(const StringVector& s, int limit = -1, double time_cutoff = 0.0) const throw(FunctionNotImplementedException)
-{ return *($self->lookup(s, limit, time_cutoff)); }
+{ return hfst::take_one_level_paths($self->lookup(s, limit, time_cutoff)); }
 HfstOneLevelPaths lookup_string(const std::string & s, int limit = -1, double time_cutoff = 0.0) const throw(FunctionNotImplementedException)
-{ return *($self->lookup(s, limit, time_cutoff)); }
+{ return hfst::take_one_level_paths($self->lookup(s, limit, time_cutoff)); }
+
+// The lookups run with the interpreter lock released, and the results go
+// straight into a list of tuples of (output, weight) tuples.
+PyObject * lookup_many_(const StringVector & inputs, int limit, double time_cutoff, unsigned int threads) const throw(FunctionNotImplementedException)
+{
+  std::vector<hfst::LookupResults> results;
+  PyThreadState * state = PyEval_SaveThread();
+  try
+  {
+    hfst::lookup_many(*$self, inputs, results, limit, time_cutoff, threads);
+  }
+  catch (...)
+  {
+    PyEval_RestoreThread(state);
+    throw;
+  }
+  PyEval_RestoreThread(state);
+
+  PyObject * list = PyList_New(results.size());
+  for (size_t i = 0; i < results.size(); i++)
+  {
+    PyObject * paths = PyTuple_New(results[i].size());
+    for (size_t j = 0; j < results[i].size(); j++)
+    {
+      const std::string & output = results[i][j].first;
+      PyObject * path = PyTuple_New(2);
+      PyTuple_SetItem(path, 0, SWIG_FromCharPtrAndSize(output.c_str(), output.size()));
+      PyTuple_SetItem(path, 1, PyFloat_FromDouble(results[i][j].second));
+      PyTuple_SetItem(paths, j, path);
+    }
+    PyList_SetItem(list, i, paths);
+  }
+  return list;
+}
 
 
 %pythoncode %{
@@ -756,6 +842,26 @@ HfstOneLevelPaths lookup_string(const std::string & s, int limit = -1, double ti
       else:
          return retval
 
+  def lookup_many(self, inputs, **kvargs):
+
+      max_number=-1
+      time_cutoff=0.0
+      threads=1
+
+      for k,v in kvargs.items():
+          if k == 'max_number' :
+             max_number=v
+          elif k == 'time_cutoff' :
+             time_cutoff=v
+          elif k == 'threads' :
+             if v < 1:
+                raise RuntimeError('threads must be at least 1.')
+             threads=v
+          else:
+             print('Warning: ignoring unknown argument %s.' % (k))
+
+      return self.lookup_many_(inputs, max_number, time_cutoff, threads)
+
   def extract_longest_paths(self, **kvargs):
       obey_flags=True
       output='dict' # 'dict' (default), 'text', 'raw'
@@ -201,6 +201,13 @@ for type in (libhfst.TROPICAL_OPENFST_TYPE, libhfst.FOMA_TYPE):
         TR.convert(libhfst.HFST_OLW_TYPE)
         print(TR.lookup('foo', max_number=5, output='text'))
 
+    print('TR.lookup_many')
+    TR = libhfst.HfstTransducer(tr)
+    TR.convert(libhfst.HFST_OLW_TYPE)
+    results = TR.lookup_many(['foo', 'bar', 'foo'], threads=2)
+    if results != [TR.lookup('foo'), (), TR.lookup('foo')]:
+        raise RuntimeError('lookup_many failed')
+
 #  def lookup_fd(self, lookup_path, **kvargs):
 #      max_weight = None
 #      infinite_cutoff = -1 # Is this right?
@@ -72,7 +72,7 @@ for file in \
 FormatSpecifiers.h HarmonizeUnknownAndIdentitySymbols.h \
 HfstDataTypes.h HfstEpsilonHandler.h HfstExceptionDefs.h \
 HfstExceptions.h HfstExtractStrings.h HfstFlagDiacritics.h \
-HfstInputStream.h HfstLookupFlagDiacritics.h HfstOutputStream.h \
+HfstInputStream.h HfstLookupFlagDiacritics.h HfstLookupCache.h HfstClockCache.h HfstDelayedComposition.h HfstBasicLookup.h HfstDeadline.h HfstOutputStream.h \
 HfstSymbolDefs.h HfstTokenizer.h HfstTransducer.h HfstXeroxRules.h \
 HfstStrings2FstTokenizer.h hfst.h hfst.hpp.in hfst_apply_schemas.h hfstdll.h \
 HfstPrintDot.h HfstPrintPCKimmo.h;
@@ -83,7 +83,7 @@ done
 for file in \
 HarmonizeUnknownAndIdentitySymbols HfstApply HfstDataTypes \
 HfstEpsilonHandler HfstExceptionDefs HfstExceptions HfstFlagDiacritics \
-HfstInputStream HfstLookupFlagDiacritics HfstOutputStream HfstRules \
+HfstInputStream HfstLookupFlagDiacritics HfstLookupCache HfstDelayedComposition HfstBasicLookup HfstOutputStream HfstRules \
 HfstSymbolDefs HfstTokenizer HfstTransducer HfstXeroxRules \
 HfstStrings2FstTokenizer HfstXeroxRulesTest HfstPrintDot HfstPrintPCKimmo;
 do
@@ -93,9 +93,9 @@ done
 # libhfst/src/implementations without subdirectories
 for file in \
 ConvertTransducerFormat.h FomaTransducer.h HfstFastTransitionData.h \
-HfstOlTransducer.h HfstTransition.h HfstTransitionGraph.h \
-HfstTropicalTransducerTransitionData.h LogWeightTransducer.h \
-TropicalWeightTransducer.h;
+HfstOlTransducer.h HfstTransition.h HfstTransitionGraph.h HfstAttReader.h \
+HfstTropicalTransducerTransitionData.h HfstSymbolInterner.h \
+HfstMinimalAcyclicBuilder.h LogWeightTransducer.h TropicalWeightTransducer.h;
 do
     cp libhfst/src/implementations/$file $1/libhfst/src/implementations/
 done
@@ -104,7 +104,8 @@ for file in \
 ConvertFomaTransducer ConvertLogWeightTransducer ConvertOlTransducer \
 ConvertTransducerFormat ConvertTropicalWeightTransducer FomaTransducer \
 HfstOlTransducer HfstTransitionGraph HfstTropicalTransducerTransitionData \
-LogWeightTransducer TropicalWeightTransducer;
+HfstSymbolInterner HfstMinimalAcyclicBuilder LogWeightTransducer \
+TropicalWeightTransducer;
 do
     cp libhfst/src/implementations/$file.cc $1/libhfst/src/implementations/$file.cpp
 done
@@ -40,6 +40,9 @@ HfstFlagDiacritics.cpp ^
 HfstExceptionDefs.cpp ^
 HarmonizeUnknownAndIdentitySymbols.cpp ^
 HfstLookupFlagDiacritics.cpp ^
+HfstLookupCache.cpp ^
+HfstDelayedComposition.cpp ^
+HfstBasicLookup.cpp ^
 HfstEpsilonHandler.cpp ^
 HfstStrings2FstTokenizer.cpp ^
 HfstPrintDot.cpp ^
@@ -47,6 +50,8 @@ HfstPrintPCKimmo.cpp ^
 implementations\HfstTransitionGraph.cpp ^
 implementations\ConvertTransducerFormat.cpp ^
 implementations\HfstTropicalTransducerTransitionData.cpp ^
+implementations\HfstSymbolInterner.cpp ^
+implementations\HfstMinimalAcyclicBuilder.cpp ^
 implementations\ConvertTropicalWeightTransducer.cpp ^
 implementations\ConvertLogWeightTransducer.cpp ^
 implementations\ConvertFomaTransducer.cpp ^
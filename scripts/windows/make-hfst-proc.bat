@@ -50,6 +50,9 @@ HfstFlagDiacritics.cpp ^
 HfstExceptionDefs.cpp ^
 HarmonizeUnknownAndIdentitySymbols.cpp ^
 HfstLookupFlagDiacritics.cpp ^
+HfstLookupCache.cpp ^
+HfstDelayedComposition.cpp ^
+HfstBasicLookup.cpp ^
 HfstEpsilonHandler.cpp ^
 HfstStrings2FstTokenizer.cpp ^
 HfstPrintDot.cpp ^
@@ -57,6 +60,8 @@ HfstPrintPCKimmo.cpp ^
 implementations\HfstTransitionGraph.cpp ^
 implementations\ConvertTransducerFormat.cpp ^
 implementations\HfstTropicalTransducerTransitionData.cpp ^
+implementations\HfstSymbolInterner.cpp ^
+implementations\HfstMinimalAcyclicBuilder.cpp ^
 implementations\ConvertTropicalWeightTransducer.cpp ^
 implementations\ConvertLogWeightTransducer.cpp ^
 implementations\ConvertFomaTransducer.cpp ^
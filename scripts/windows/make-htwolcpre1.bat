@@ -48,6 +48,8 @@ HfstFlagDiacritics.cpp ^
 HfstExceptionDefs.cpp ^
 HarmonizeUnknownAndIdentitySymbols.cpp ^
 HfstLookupFlagDiacritics.cpp ^
+HfstLookupCache.cpp ^
+HfstDelayedComposition.cpp ^
 HfstEpsilonHandler.cpp ^
 HfstStrings2FstTokenizer.cpp ^
 HfstPrintDot.cpp ^
@@ -55,6 +57,8 @@ HfstPrintPCKimmo.cpp ^
 implementations\HfstTransitionGraph.cpp ^
 implementations\ConvertTransducerFormat.cpp ^
 implementations\HfstTropicalTransducerTransitionData.cpp ^
+implementations\HfstSymbolInterner.cpp ^
+implementations\HfstMinimalAcyclicBuilder.cpp ^
 implementations\ConvertTropicalWeightTransducer.cpp ^
 implementations\ConvertLogWeightTransducer.cpp ^
 implementations\ConvertFomaTransducer.cpp ^
@@ -56,6 +56,9 @@ HfstFlagDiacritics.cpp ^
 HfstExceptionDefs.cpp ^
 HarmonizeUnknownAndIdentitySymbols.cpp ^
 HfstLookupFlagDiacritics.cpp ^
+HfstLookupCache.cpp ^
+HfstDelayedComposition.cpp ^
+HfstBasicLookup.cpp ^
 HfstEpsilonHandler.cpp ^
 HfstStrings2FstTokenizer.cpp ^
 HfstPrintDot.cpp ^
@@ -63,6 +66,8 @@ HfstPrintPCKimmo.cpp ^
 implementations\HfstTransitionGraph.cpp ^
 implementations\ConvertTransducerFormat.cpp ^
 implementations\HfstTropicalTransducerTransitionData.cpp ^
+implementations\HfstSymbolInterner.cpp ^
+implementations\HfstMinimalAcyclicBuilder.cpp ^
 implementations\ConvertTropicalWeightTransducer.cpp ^
 implementations\ConvertLogWeightTransducer.cpp ^
 implementations\ConvertFomaTransducer.cpp ^
@@ -2,6 +2,8 @@ cl /c /EHsc /I..\..\..\libhfst\src /I..\..\..\back-ends\foma /I..\..\..\back-end
 HfstTransitionGraph.cpp ^
 ConvertTransducerFormat.cpp ^
 HfstTropicalTransducerTransitionData.cpp ^
+HfstSymbolInterner.cpp ^
+HfstMinimalAcyclicBuilder.cpp ^
 ConvertTropicalWeightTransducer.cpp ^
 ConvertLogWeightTransducer.cpp ^
 ConvertFomaTransducer.cpp ^
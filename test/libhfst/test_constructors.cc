@@ -63,6 +63,26 @@ int main(int argc, char **argv)
       assert(foo.compare(foo_tok));
       assert(foobar.compare(foobar_tok));
 
+      /* From a word list. */
+      verbose_print("Construction from a word list", types[i]);
+      StringVector words;
+      words.push_back("foobaz");
+      words.push_back("foo");
+      words.push_back("barfoo");
+      words.push_back("foo");
+      HfstTransducer words_tok
+        = HfstTransducer::from_word_list(words, tok, types[i]);
+      /* the caller's strings are left as they were */
+      assert(words.size() == 4);
+      assert(words[0] == "foobaz" && words[3] == "foo");
+      HfstTransducer words_disj("barfoo", tok, types[i]);
+      words_disj.disjunct(foo).minimize();
+      assert(words_disj.compare(words_tok));
+      StringVector no_words;
+      HfstTransducer empty_words
+        = HfstTransducer::from_word_list(no_words, tok, types[i]);
+      assert(empty_words.compare(HfstTransducer(types[i])));
+
       /* From AT&T format. */
       verbose_print("Construction from AT&T format", types[i]);
       FILE * file = fopen((std::string(getenv("srcdir")) + 
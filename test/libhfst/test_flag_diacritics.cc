@@ -108,5 +108,47 @@ int main(int argc, char **argv)
       // TODO: More tests...
 
     }
+
+  verbose_print("Flag diacritic states");
+
+  /* A table with a few features packs its values, one with many features
+     keeps them in a vector. Both must behave the same. */
+  for (unsigned int features=1; features <= 200; features += 199)
+    {
+      FdTable<long long> table;
+      for (unsigned int f=0; f < features; f++)
+        {
+          std::ostringstream feature;
+          feature << "F" << f;
+          table.define_diacritic(3*f, "@P." + feature.str() + ".A@");
+          table.define_diacritic(3*f+1, "@N." + feature.str() + ".B@");
+          table.define_diacritic(3*f+2, "@U." + feature.str() + ".B@");
+        }
+      // a symbol that is too large to be indexed directly
+      table.define_diacritic(10000000000LL, "@R.F0.A@");
+      assert(table.packs_values() == (features == 1));
+      assert(not table.is_diacritic(3*features));
+      assert(table.is_diacritic(10000000000LL));
+
+      FdState<long long> state(table);
+      unsigned int last = features - 1;
+      assert(state.apply_operation(3*last+1));         // @N.F.B@
+      FdStateValues saved = state.save();
+      assert(state.apply_operation(3*last));           // @P.F.A@
+      assert(state.apply_operation(3*last+2) == false); // @U.F.B@
+      state.restore(saved);
+      assert(state.save() == saved);
+      assert(state.get_values()[last] < 0);
+      assert(state.apply_operation(3*last+2) == false);
+      state.reset();
+      assert(state.apply_operation(0));
+      assert(state.apply_operation(10000000000LL));    // @R.F0.A@
+      assert(not (state.save() == saved));
+      std::vector<FdValue> values = state.get_values();
+      state.restore(saved);
+      state.assign_values(values);
+      assert(state.apply_operation(10000000000LL));
+      assert(not state.fails());
+    }
 }
 
@@ -6,6 +6,7 @@
 */
 
 #include "HfstTransducer.h"
+#include "HfstBasicLookup.h"
 #include "auxiliary_functions.cc"
 
 using namespace hfst;
@@ -152,6 +153,66 @@ int main(int argc, char **argv)
   }
 
 
+  verbose_print("HfstBasicTransducer: indexed lookup");
+
+  {
+    // [ ?:foo | [?:? | 0:d] [bar | a:a] | a:b [@P.X.Y@ | 0:c]* ] with weights
+    HfstBasicTransducer tr;
+    tr.add_state(1);
+    tr.add_state(2);
+    tr.add_state(3);
+    tr.add_state(4);
+    tr.set_final_weight(1, 0.5);
+    tr.set_final_weight(2, 0);
+    tr.set_final_weight(3, 1);
+    tr.add_transition
+      (0, HfstBasicTransition(1, "@_UNKNOWN_SYMBOL_@", "foo", 1));
+    tr.add_transition
+      (0, HfstBasicTransition(4, "@_IDENTITY_SYMBOL_@",
+                              "@_IDENTITY_SYMBOL_@", 0));
+    tr.add_transition(4, HfstBasicTransition(2, "bar", "bar", 0));
+    tr.add_transition(0, HfstBasicTransition(3, "a", "b", 2));
+    tr.add_transition(3, HfstBasicTransition(3, "@P.X.Y@", "@P.X.Y@", 0));
+    tr.add_transition
+      (3, HfstBasicTransition(3, "@_EPSILON_SYMBOL_@", "c", 0.25));
+    tr.add_transition
+      (0, HfstBasicTransition(4, "@_EPSILON_SYMBOL_@", "d", 0));
+    tr.add_transition(4, HfstBasicTransition(2, "a", "a", 3));
+
+    HfstBasicLookup lookup(tr);
+    HfstTokenizer tok;
+    tok.add_multichar_symbol("bar");
+    const char * inputs[] = { "a", "x", "bar", "xbar", "abar", "", "b" };
+    for (unsigned int i = 0; i < sizeof(inputs) / sizeof(inputs[0]); i++)
+      {
+        StringVector input = tok.tokenize_one_level(inputs[i]);
+        size_t cutoffs[] = { 0, 2 };
+        for (unsigned int c = 0; c < 2; c++)
+          {
+            HfstTwoLevelPaths expected;
+            HfstTwoLevelPaths results;
+            tr.lookup_fd(input, expected, &cutoffs[c]);
+            lookup.lookup_fd(input, results, &cutoffs[c]);
+            assert(results == expected);
+          }
+        float max_weight = 2.3;
+        HfstTwoLevelPaths expected;
+        HfstTwoLevelPaths results;
+        tr.lookup_fd(input, expected, &cutoffs[1], &max_weight);
+        lookup.lookup_fd(input, results, &cutoffs[1], &max_weight);
+        assert(results == expected);
+      }
+
+    HfstTwoLevelPaths results;
+    StringVector input;
+    input.push_back("a");
+    size_t cutoff = 2;
+    lookup.lookup_fd(input, results, &cutoff);
+    // a:b, and a:a after 0:d, with 0 to 2 flags and [0:c]* cycles
+    assert(results.size() > 2);
+  }
+
+
   verbose_print("HfstBasicTransducer: iterating through");
 
   { 
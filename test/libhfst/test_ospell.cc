@@ -0,0 +1,173 @@
+/*
+   Test file for the spellchecker of the optimized-lookup format.
+*/
+
+#include "HfstTransducer.h"
+#include "implementations/ConvertTransducerFormat.h"
+#include "implementations/optimized-lookup/transducer.h"
+#include "auxiliary_functions.cc"
+
+using namespace hfst;
+using hfst::implementations::HfstState;
+using hfst::implementations::HfstBasicTransducer;
+using hfst::implementations::HfstBasicTransition;
+using hfst::implementations::ConversionFunctions;
+
+typedef std::vector<hfst_ol::StringWeightPair> Corrections;
+
+/* A lexicon of the words "cat", "car", "cart" and "at", weighted
+   0, 1, 2 and 0.5, or "cart" weighted \a cart_weight if it is given. */
+HfstBasicTransducer make_lexicon(float cart_weight=2)
+{
+  HfstBasicTransducer t;
+  HfstState c = t.add_state();
+  HfstState ca = t.add_state();
+  HfstState cat = t.add_state();
+  HfstState car = t.add_state();
+  HfstState cart = t.add_state();
+  HfstState a = t.add_state();
+  HfstState at = t.add_state();
+  t.add_transition(0, HfstBasicTransition(c, "c", "c", 0));
+  t.add_transition(c, HfstBasicTransition(ca, "a", "a", 0));
+  t.add_transition(ca, HfstBasicTransition(cat, "t", "t", 0));
+  t.add_transition(ca, HfstBasicTransition(car, "r", "r", 0));
+  t.add_transition(car, HfstBasicTransition(cart, "t", "t", 0));
+  t.add_transition(0, HfstBasicTransition(a, "a", "a", 0));
+  t.add_transition(a, HfstBasicTransition(at, "t", "t", 0));
+  t.set_final_weight(cat, 0);
+  t.set_final_weight(car, 1);
+  t.set_final_weight(cart, cart_weight);
+  t.set_final_weight(at, 0.5);
+  return t;
+}
+
+/* An error model that makes at most one substitution, deletion or
+   insertion of weight 1. */
+HfstBasicTransducer make_mutator()
+{
+  const char * symbols[] = { "a", "c", "r", "t" };
+  HfstBasicTransducer t;
+  HfstState edited = t.add_state();
+  for (int i = 0; i < 4; i++) {
+    t.add_transition(0, HfstBasicTransition(0, symbols[i], symbols[i], 0));
+    t.add_transition(edited, HfstBasicTransition
+                     (edited, symbols[i], symbols[i], 0));
+    t.add_transition(0, HfstBasicTransition
+                     (edited, symbols[i], internal_epsilon, 1));
+    t.add_transition(0, HfstBasicTransition
+                     (edited, internal_epsilon, symbols[i], 1));
+    for (int j = 0; j < 4; j++) {
+      if (i != j) {
+        t.add_transition(0, HfstBasicTransition
+                         (edited, symbols[i], symbols[j], 1));
+      }
+    }
+  }
+  t.set_final_weight(0, 0);
+  t.set_final_weight(edited, 0);
+  return t;
+}
+
+Corrections correct(hfst_ol::Speller & speller, const char * word,
+                    int nbest=0, float max_weight=-1, float beam=-1,
+                    double time_cutoff=0)
+{
+  std::string line(word);
+  hfst_ol::CorrectionQueue queue =
+    speller.correct(&line[0], nbest, max_weight, beam, time_cutoff);
+  Corrections corrections;
+  while (!queue.empty()) {
+    corrections.push_back(queue.top());
+    queue.pop();
+  }
+  return corrections;
+}
+
+bool is_correction(const Corrections & corrections, size_t i,
+                   const std::string & string, float weight)
+{
+  return i < corrections.size() &&
+    corrections[i].first == string &&
+    corrections[i].second == weight;
+}
+
+int main(int argc, char **argv)
+{
+  HfstBasicTransducer lexicon_basic = make_lexicon();
+  HfstBasicTransducer mutator_basic = make_mutator();
+  hfst_ol::Transducer * lexicon =
+    ConversionFunctions::hfst_basic_transducer_to_hfst_ol
+    (&lexicon_basic, true);
+  hfst_ol::Transducer * mutator =
+    ConversionFunctions::hfst_basic_transducer_to_hfst_ol
+    (&mutator_basic, true);
+  hfst_ol::Speller speller(mutator, lexicon);
+
+  verbose_print("Speller::check");
+  std::string word("cart");
+  assert(speller.check(&word[0]));
+  word = "cta";
+  assert(!speller.check(&word[0]));
+
+  /* The breadth-first search used before the limits were added made
+     these corrections too, but wrote "@_EPSILON_SYMBOL_@at" for "at". */
+  verbose_print("Speller::correct without limits");
+  Corrections all = correct(speller, "cat");
+  assert(all.size() == 4);
+  assert(is_correction(all, 0, "cat", 0));
+  assert(is_correction(all, 1, "at", 1.5));
+  assert(is_correction(all, 2, "car", 2));
+  assert(is_correction(all, 3, "cart", 3));
+
+  verbose_print("Speller::correct with nbest");
+  Corrections best = correct(speller, "cat", 2);
+  assert(best.size() == 2);
+  assert(is_correction(best, 0, "cat", 0));
+  assert(is_correction(best, 1, "at", 1.5));
+
+  verbose_print("Speller::correct with max_weight");
+  Corrections light = correct(speller, "cat", 0, 2);
+  assert(light.size() == 3);
+  assert(is_correction(light, 2, "car", 2));
+  assert(correct(speller, "ct", 0, 0.5).empty());
+
+  verbose_print("Speller::correct with beam");
+  Corrections beamed = correct(speller, "cat", 0, -1, 1.5);
+  assert(beamed.size() == 2);
+  assert(is_correction(beamed, 0, "cat", 0));
+  assert(is_correction(beamed, 1, "at", 1.5));
+  beamed = correct(speller, "ct", 0, -1, 0.25);
+  assert(beamed.size() == 1);
+  assert(is_correction(beamed, 0, "cat", 1));
+
+  /* A search that runs out of time returns some of the lightest
+     corrections. */
+  verbose_print("Speller::correct with time_cutoff");
+  Corrections hurried = correct(speller, "cat", 0, -1, -1, 1e-9);
+  assert(hurried.size() <= all.size());
+  for (size_t i = 0; i < hurried.size(); i++) {
+    assert(is_correction(hurried, i, all[i].first, all[i].second));
+  }
+  speller.cancel();
+  assert(correct(speller, "cat", 0, -1, -1, 10).size() == 4);
+
+  /* "cart" now weighs 1 - 3, less than "cat", although the search
+     reaches it through a heavier configuration. */
+  verbose_print("Speller::correct with negative weights");
+  HfstBasicTransducer negative_basic = make_lexicon(-3);
+  hfst_ol::Transducer * negative =
+    ConversionFunctions::hfst_basic_transducer_to_hfst_ol
+    (&negative_basic, true);
+  hfst_ol::Speller negative_speller(mutator, negative);
+  Corrections first = correct(negative_speller, "cat", 1);
+  assert(first.size() == 1);
+  assert(is_correction(first, 0, "cart", -2));
+  Corrections negative_light = correct(negative_speller, "cat", 0, 0.5);
+  assert(negative_light.size() == 2);
+  assert(is_correction(negative_light, 0, "cart", -2));
+  assert(is_correction(negative_light, 1, "cat", 0));
+
+  delete negative;
+  delete mutator;
+  delete lexicon;
+}
@@ -68,6 +68,41 @@ int main(int argc, char **argv)
       remove("transducer2.att");
       remove("transducer.att");
 
+      /* Escaped symbols and lines longer than 255 characters. */
+      verbose_print("AT&T format: escapes and long lines", types[i]);
+
+      std::string long_symbol(300, 'x');
+      f2 = fopen("transducer.att", "wb");
+      fprintf(f2,
+          "0\t1\t%s\t@_SPACE_@\n"
+          "1\t2\tEPS\t@_COLON_@@_TAB_@\n"
+          "2\n", long_symbol.c_str());
+      fclose(f2);
+
+      FILE * ifile = fopen("transducer.att", "rb");
+      unsigned int linecount = 0;
+      HfstTransducer t3(ifile, types[i], "EPS", linecount);
+      fclose(ifile);
+      assert(linecount == 3);
+      assert(t3.get_alphabet().count(long_symbol) == 1);
+      assert(t3.get_alphabet().count(" ") == 1);
+      assert(t3.get_alphabet().count(":\t") == 1);
+      assert(t3.get_alphabet().count("EPS") == 0);
+
+      f2 = fopen("transducer.att", "wb");
+      fprintf(f2,
+          "0\t1\t%s\t@_SPACE_@\t0.000000\n"
+          "1\t2\t@0@\t:@_TAB_@\t0.000000\n"
+          "2\t0.000000\n", long_symbol.c_str());
+      fclose(f2);
+
+      ofile = fopen("transducer2.att", "wb");
+      t3.write_in_att_format(ofile, true);
+      fclose(ofile);
+      assert(system("diff transducer2.att transducer.att") == 0);
+      remove("transducer2.att");
+      remove("transducer.att");
+
       /* From HfstInputStream. */      
       verbose_print("Writing to HfstOutputStream", types[i]);
 
@@ -107,4 +142,57 @@ int main(int argc, char **argv)
 
     }
 
+  /* Memory-mapped optimized-lookup tables. */
+  if (HfstTransducer::is_implementation_type_available(TROPICAL_OPENFST_TYPE))
+    {
+      verbose_print("Memory-mapped reading", HFST_OLW_TYPE);
+
+      HfstTransducer foo("foo", "bar", TROPICAL_OPENFST_TYPE);
+      HfstTransducer baz("baz", TROPICAL_OPENFST_TYPE);
+      baz.set_final_weights(1.5);
+      foo.convert(HFST_OLW_TYPE);
+      baz.convert(HFST_OLW_TYPE);
+
+      HfstOutputStream out("testfile.hfst", HFST_OLW_TYPE);
+      out << foo;
+      out << baz;
+      out.close();
+
+      HfstInputStream in("testfile.hfst");
+      in.set_mmap_tables(true);
+      HfstTransducer mapped_foo(in);
+      HfstTransducer mapped_baz(in);
+      assert(in.is_eof());
+      in.close();
+
+      HfstOneLevelPaths * results = mapped_foo.lookup_fd("foo");
+      assert(results->size() == 1);
+      assert(results->begin()->second.size() == 1);
+      assert(results->begin()->second[0] == "bar");
+      delete results;
+      results = mapped_baz.lookup_fd("baz");
+      assert(results->size() == 1);
+      assert(results->begin()->first == 1.5);
+      delete results;
+      results = mapped_baz.lookup_fd("foo");
+      assert(results->size() == 0);
+      delete results;
+
+      /* A copy shares the mapping and keeps it after the original is gone. */
+      HfstTransducer * foo_copy = NULL;
+      {
+        HfstInputStream in2("testfile.hfst");
+        in2.set_mmap_tables(true);
+        HfstTransducer original(in2);
+        foo_copy = new HfstTransducer(original);
+        in2.close();
+      }
+      results = foo_copy->lookup_fd("foo");
+      assert(results->size() == 1);
+      assert(results->begin()->second[0] == "bar");
+      delete results;
+      delete foo_copy;
+      remove("testfile.hfst");
+    }
+
 }
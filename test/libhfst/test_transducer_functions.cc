@@ -36,7 +36,10 @@
 */
 
 #include "HfstTransducer.h"
+#include "HfstLookupCache.h"
+#include "HfstDelayedComposition.h"
 #include "auxiliary_functions.cc"
+#include <thread>
 
 using namespace hfst;
 
@@ -287,6 +290,27 @@ int main(int argc, char **argv)
     t3.set_final_weights(5);
     t1.compose(t2);
     assert(t1.compare(t3));
+
+    /* Identity and unknown symbols match the symbols of the other
+       transducer. */
+    HfstTransducer id2id(internal_identity, types[i]);
+    HfstTransducer a2b("a", "b", types[i]);
+    id2id.compose(a2b);
+    assert(id2id.compare(a2b));
+
+    HfstTransducer a2b_copy(a2b);
+    HfstTransducer unk2c(internal_unknown, "c", types[i]);
+    a2b_copy.compose(unk2c);
+    HfstTransducer a2c("a", "c", types[i]);
+    assert(a2b_copy.compare(a2c));
+
+    /* ?:? maps b to anything but b itself. */
+    HfstTransducer unk2unk(internal_unknown, internal_unknown, types[i]);
+    HfstTransducer a2a("a", types[i]);
+    HfstTransducer a2b_copy2(a2b);
+    a2b_copy2.compose(unk2unk);
+    a2b_copy2.compose(a2a);
+    assert(a2b_copy2.compare(a2a));
       }
 
       /* Function shuffle. */
@@ -503,6 +527,123 @@ int main(int argc, char **argv)
       assert(do_hfst_lookup_paths_contain
          (*results_hippopotamus, expected_path, 1.4, test_weight));
 
+    /* the number of results can be limited */
+    HfstOneLevelPaths * results_limited
+      = animals_ol.lookup(lookup_hippopotamus, 1);
+    if (types[i] != LOG_OPENFST_TYPE)
+      assert(results_limited->size() == 1);
+    delete results_limited;
+
+    /* symbols outside the alphabet give no results and do not
+       affect later lookups */
+    HfstOneLevelPaths * results_unknown
+      = animals_ol.lookup(tok.tokenize_one_level("gnu"), limit);
+    assert(results_unknown->size() == 0);
+    delete results_unknown;
+    results_unknown = animals_ol.lookup(lookup_cat, limit);
+    assert(results_unknown->size() == 1);
+    delete results_unknown;
+
+    /* lookups can share one transducer between threads */
+    std::vector<std::thread> lookup_threads;
+    std::vector<int> lookup_failures(4, 0);
+    for (unsigned int n = 0; n < lookup_failures.size(); ++n)
+      {
+        lookup_threads.push_back(std::thread([&, n]() {
+              for (int round = 0; round < 200; ++round)
+                {
+                  HfstOneLevelPaths * r
+                    = animals_ol.lookup_fd(round % 2 ? "mouse" : "gnu");
+                  if (r->size() != (round % 2 ? 1u : 0u))
+                    ++lookup_failures[n];
+                  if (animals_ol.is_lookup_infinitely_ambiguous("mouse"))
+                    ++lookup_failures[n];
+                  delete r;
+                }
+            }));
+      }
+    for (unsigned int n = 0; n < lookup_threads.size(); ++n)
+      {
+        lookup_threads[n].join();
+        assert(lookup_failures[n] == 0);
+      }
+
+    /* a cache of two strings gives the same results and forgets
+       strings that are not looked up again */
+    HfstLookupCache cache(animals_ol, 2);
+    const char * cached_inputs[] = { "mouse", "mouse", "cat", "gnu",
+                                     "mouse", "cat" };
+    for (unsigned int n = 0; n < 6; ++n)
+      {
+        HfstOneLevelPaths * cached = cache.lookup_fd(cached_inputs[n]);
+        HfstOneLevelPaths * uncached = animals_ol.lookup_fd(cached_inputs[n]);
+        assert(*cached == *uncached);
+        delete cached;
+        delete uncached;
+      }
+    assert(cache.get_hits() == 2);
+    assert(cache.get_misses() == 4);
+    assert(cache.size() == 2);
+
+    /* asking for the ambiguity and the results uses an entry once, so
+       "gnu" is forgotten before "cat", which was looked up again */
+    delete cache.lookup_fd("cat");
+    bool infinitely_ambiguous = true;
+    HfstOneLevelPaths * bounded = cache.lookup_fd_bounded
+      (tok.tokenize_one_level("gnu"), 5, infinitely_ambiguous);
+    assert(!infinitely_ambiguous);
+    assert(bounded->size() == 0);
+    delete bounded;
+    delete cache.lookup_fd("dog");
+    delete cache.lookup_fd("cat");
+    assert(cache.get_hits() == 4);
+    assert(cache.get_misses() == 6);
+
+    /* lookup in a cascade gives the results of lookup in the
+       composition of the cascade */
+    HfstTransducer marker("@_EPSILON_SYMBOL_@", "<", types[i]);
+    HfstTransducer i2I("i", "I", types[i]);
+    HfstTransducer rule("@_IDENTITY_SYMBOL_@", types[i]);
+    rule.disjunct(i2I).repeat_star().concatenate(marker);
+    std::vector<HfstTransducer> cascade;
+    cascade.push_back(animals);
+    cascade.push_back(rule);
+    HfstDelayedComposition composition(cascade);
+    assert(composition.size() == 2);
+    HfstOneLevelPaths * results_cascade = composition.lookup(lookup_mouse);
+    assert(results_cascade->size() == 2);
+    assert(do_hfst_lookup_paths_contain
+           (*results_cascade, tok.tokenize_one_level("mice<"), 1.7,
+            test_weight));
+    assert(do_hfst_lookup_paths_contain
+           (*results_cascade, tok.tokenize_one_level("mIce<"), 1.7,
+            test_weight));
+    delete results_cascade;
+    results_cascade = composition.lookup(tok.tokenize_one_level("gnu"));
+    assert(results_cascade->size() == 0);
+    delete results_cascade;
+
+    /* an epsilon cycle in the cascade is followed infinite_cutoff times
+       and reported */
+    bool infinite_cascade = true;
+    results_cascade = composition.lookup(lookup_mouse, 5, NULL,
+                                         &infinite_cascade);
+    assert(!infinite_cascade);
+    delete results_cascade;
+    HfstTransducer x_loop("@_EPSILON_SYMBOL_@", "x", types[i]);
+    x_loop.repeat_star();
+    HfstTransducer x_rule("@_IDENTITY_SYMBOL_@", types[i]);
+    x_rule.repeat_star().concatenate(x_loop);
+    std::vector<HfstTransducer> x_cascade;
+    x_cascade.push_back(animals);
+    x_cascade.push_back(x_rule);
+    HfstDelayedComposition x_composition(x_cascade);
+    results_cascade = x_composition.lookup(lookup_mouse, 2, NULL,
+                                           &infinite_cascade);
+    assert(infinite_cascade);
+    assert(results_cascade->size() > 0);
+    delete results_cascade;
+
 
     // if type is LOG_OPENFST_TYPE:
     // FATAL: SingleShortestPath: Weight needs to have the path property
@@ -97,6 +97,53 @@ if ((test -z "$i") || $TOOLDIR/hfst-format --list-formats | grep $i > /dev/null)
 fi
 done
 
+# the composition of a cascade warns about infinite ambiguity as well
+printf '0\t0\t@_IDENTITY_SYMBOL_@\t@_IDENTITY_SYMBOL_@\n0\n' \
+    | $TOOLDIR/hfst-txt2fst > test.id_star
+cat infinitely_ambiguous.hfst test.id_star > test.cascade
+if ! echo "ad" | $TOOLDIR/hfst-lookup --compose-cascade test.cascade \
+    2> warnings > test.lookups;
+then
+    exit 1
+fi
+if ! grep -q "infinite" warnings; then
+    echo "FAIL: infinitely ambiguous string 'ad' should give a warning with --compose-cascade"
+    exit 1
+fi
+rm test.id_star test.cascade
+
+# --threads gives the same results, warnings and verbose messages in the
+# same order as one thread; the input is long enough for several chunks
+awk 'BEGIN { for (i = 0; i < 5000; i++)
+             print (i % 500 == 0) ? "ad" : (i % 2) ? "b" : "cat" }' \
+    > test.strings
+for threads in 1 3; do
+    if ! $TOOLDIR/hfst-lookup -p -v --threads=$threads \
+        infinitely_ambiguous.hfstol < test.strings > test.lookups$threads 2>&1
+    then
+        exit 1
+    fi
+done
+if ! grep -q "infinite" test.lookups1; then
+    echo "FAIL: infinitely ambiguous string 'ad' should give a warning"
+    exit 1
+fi
+if ! cmp test.lookups1 test.lookups3; then
+    echo "FAIL: --threads=3 should give the same output as --threads=1"
+    exit 1
+fi
+
+# --mmap gives the same output as reading the tables into memory
+if ! $TOOLDIR/hfst-lookup -p -v --mmap --threads=3 \
+    infinitely_ambiguous.hfstol < test.strings > test.lookups_mmap 2>&1
+then
+    exit 1
+fi
+if ! cmp test.lookups1 test.lookups_mmap; then
+    echo "FAIL: --mmap should give the same output as reading into memory"
+    exit 1
+fi
+
 rm TMP
-rm test.lookups
+rm test.lookups test.lookups1 test.lookups3 test.lookups_mmap test.strings
 rm warnings
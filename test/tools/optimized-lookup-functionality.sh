@@ -10,4 +10,18 @@ if ! $TOOLDIR/hfst-optimized-lookup cat2dog.hfstol < empty > test.lookups ; then
     exit 1
 fi
 
-rm test.lookups empty
+# --threads gives the same analyses in the same order as one thread
+awk 'BEGIN { for (i = 0; i < 5000; i++) print (i % 3) ? "cat" : "dog" }' \
+    > test.strings
+for threads in 1 3; do
+    if ! $TOOLDIR/hfst-optimized-lookup --threads=$threads cat2dog.hfstol \
+        < test.strings > test.lookups$threads ; then
+        exit 1
+    fi
+done
+if ! cmp test.lookups1 test.lookups3; then
+    echo "FAIL: --threads=3 should give the same output as --threads=1"
+    exit 1
+fi
+
+rm test.lookups test.lookups1 test.lookups3 test.strings empty
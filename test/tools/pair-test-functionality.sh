@@ -0,0 +1,49 @@
+#!/bin/sh
+TOOLDIR=../../tools/src
+
+# two rules: a:b only before c, and a:b anywhere
+printf '0\t0\t@#@\t@0@\n0\t0\ta\ta\n0\t0\tb\tb\n0\t0\tc\tc\n0\t0\t@_IDENTITY_SYMBOL_@\t@_IDENTITY_SYMBOL_@\n0\t1\ta\tb\n1\t0\tc\tc\n0\n--\n0\t0\t@#@\t@0@\n0\t0\ta\ta\n0\t0\ta\tb\n0\t0\tb\tb\n0\t0\tc\tc\n0\t0\t@_IDENTITY_SYMBOL_@\t@_IDENTITY_SYMBOL_@\n0\n' > pair-test.att
+if ! $TOOLDIR/hfst-txt2fst -i pair-test.att -o pair-test.hfst ; then
+    exit 1
+fi
+
+printf 'a:b c\nx a b\n! a comment\n' > pair-test.strings
+if ! $TOOLDIR/hfst-pair-test -i pair-test.hfst -I pair-test.strings > test.pairs ; then
+    echo "FAIL: pair strings should be accepted"
+    exit 1
+fi
+if $TOOLDIR/hfst-pair-test -N -i pair-test.hfst -I pair-test.strings > test.pairs ; then
+    echo "FAIL: pair strings should not be rejected"
+    exit 1
+fi
+
+# the failing rules and where they run out of transitions
+printf 'a:b b\nd:e\n' > pair-test.strings
+if $TOOLDIR/hfst-pair-test -i pair-test.hfst -I pair-test.strings > test.pairs ; then
+    echo "FAIL: pair strings should be rejected"
+    exit 1
+fi
+if ! grep -q '^#:0 a:b HERE ---> b #:0 $' test.pairs ; then
+    echo "FAIL: a:b b should fail at b"
+    exit 1
+fi
+if test `grep -c '^#:0 HERE ---> d:e #:0 $' test.pairs` != 2 ; then
+    echo "FAIL: d:e should fail in both rules"
+    exit 1
+fi
+if ! $TOOLDIR/hfst-pair-test -N -i pair-test.hfst -I pair-test.strings > test.pairs ; then
+    echo "FAIL: pair strings should be rejected"
+    exit 1
+fi
+
+# threads give the same results in the same order
+printf 'a:b b\nd:e\na:b c\nc a:b\nx\n' > pair-test.strings
+$TOOLDIR/hfst-pair-test -i pair-test.hfst -I pair-test.strings > test.pairs
+$TOOLDIR/hfst-pair-test -T 3 -i pair-test.hfst -I pair-test.strings > test2.pairs
+if ! cmp test.pairs test2.pairs ; then
+    echo "FAIL: --threads changes the results"
+    exit 1
+fi
+
+rm -f pair-test.att pair-test.hfst pair-test.strings test.pairs test2.pairs
+exit 0
@@ -19,6 +19,28 @@ if ! echo "cat" | $TOOLDIR/hfst-pmatch pmatch_endtag.pmatch > test.pmatch;
     
 rm test.pmatch
 
+# --threads gives the same output and verbose messages in the same order
+# as one thread; the input is long enough for several chunks
+awk 'BEGIN { for (i = 0; i < 3000; i++)
+             print (i % 100 == 0) ? "a cat" : "dog" }' > test.strings
+for tool in hfst-pmatch hfst-tokenize; do
+    for threads in 1 3; do
+        if ! $TOOLDIR/$tool -n -v --threads=$threads pmatch_conflict.pmatch \
+            < test.strings > test.output$threads 2>&1 ; then
+            exit 1
+        fi
+    done
+    if test $tool = hfst-pmatch && ! grep -q "conflicting" test.output1; then
+        echo "FAIL: 'cat' should give a verbose message about conflicting matches"
+        exit 1
+    fi
+    if ! cmp test.output1 test.output3; then
+        echo "FAIL: $tool --threads=3 should give the same output as --threads=1"
+        exit 1
+    fi
+done
+rm test.strings test.output1 test.output3
+
 # Jyrki's suite
 if ! $srcdir/pmatch-tests.sh --log none; then
     if [ -e $srcdir/pmatch-tests.sh.* ]; then
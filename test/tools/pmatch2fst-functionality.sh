@@ -7,9 +7,16 @@ fi
 if ! $TOOLDIR/hfst-pmatch2fst $srcdir/pmatch_blanks.txt > test ; then
         exit 1
     fi
+# Compiling in several threads gives the same result
+if ! $TOOLDIR/hfst-pmatch2fst --threads=2 $srcdir/pmatch_blanks.txt > test2 ; then
+        exit 1
+    fi
+if ! cmp -s test test2 ; then
+        exit 1
+    fi
 # Test with any old string
 if ! $TOOLDIR/hfst-pmatch test < $srcdir/cat.strings > pmatch.out ; then
         exit 1
     fi
-rm -f pmatch.out test
+rm -f pmatch.out test test2
 exit 0
@@ -157,6 +157,29 @@ if ! diff test.strings $srcdir/proc-compounds-out.strings ; then
     echo compound diffs
     exit 1
 fi
+
+# threaded mode, with input long enough to be split into several chunks
+for case in "proc-caps.hfstol proc-caps-in.strings" \
+            "compounds.hfstol proc-compounds.strings" ; do
+    set -- $case
+    awk '{ lines[NR] = $0 }
+         END { for (i = 0; i < 6000; i++)
+                 for (j = 1; j <= NR; j++) print lines[j] }' \
+        $srcdir/$2 > test.input
+    if ! $TOOLDIR/hfst-proc/hfst-apertium-proc $1 < test.input > test.strings ; then
+        echo $1 fail
+        exit 1
+    fi
+    if ! $TOOLDIR/hfst-proc/hfst-apertium-proc --threads=3 $1 < test.input > test.threaded.strings ; then
+        echo $1 --threads fail
+        exit 1
+    fi
+    if ! cmp test.strings test.threaded.strings ; then
+        echo $1 --threads diffs
+        exit 1
+    fi
+done
+rm test.input test.threaded.strings
 rm test.strings
 
 ## skip new test introduced in version 3014...
@@ -68,6 +68,7 @@ static bool treat_warnings_as_errors = false;
 static bool xerox_composition = true;  // Compatibility with Xerox tools is the default
 static bool encode_weights = false;
 static bool enc = false;
+static unsigned int threads = 1;
 
 void
 print_usage()
@@ -90,7 +91,9 @@ print_usage()
                "  -x, --xerox-composition=VALUE Whether flag diacritics are treated as ordinary\n"
                "                                symbols in composition (default is true).\n"
                "  -X, --xfst=VARIABLE     toggle xfst compatibility option VARIABLE.\n"
-               "  -W, --Werror            treat warnings as errors\n");
+               "  -W, --Werror            treat warnings as errors\n"
+               "  -T, --threads=N         minimize lexicons in N threads at a time\n"
+               "                          (openfst formats only, default is 1)\n");
         fprintf(message_out, "\n");
         fprintf(message_out,
                 "If INFILE or OUTFILE are omitted or -, standard streams will "
@@ -142,11 +145,12 @@ parse_options(int argc, char** argv)
           {"xerox-composition", required_argument,    0, 'x'},
           {"xfst", required_argument, 0, 'X'},
           {"Werror", no_argument,    0, 'W'},
+          {"threads", required_argument, 0, 'T'},
           {0,0,0,0}
         };
         int option_index = 0;
         char c = getopt_long(argc, argv, HFST_GETOPT_COMMON_SHORT
-                             "Ef:o:AFMRx:X:W",
+                             "Ef:o:AFMRx:X:WT:",
                              long_options, &option_index);
         if (-1 == c)
         {
@@ -212,6 +216,14 @@ parse_options(int argc, char** argv)
         case 'W':
           treat_warnings_as_errors = true;
           break;
+        case 'T':
+          if (atoi(optarg) < 1)
+            {
+              fprintf(stderr, "Error: invalid argument for --threads: '%s'\n", optarg);
+              return EXIT_FAILURE;
+            }
+          threads = (unsigned int)atoi(optarg);
+          break;
 
 #include "inc/getopt-cases-error.h"
         }
@@ -357,6 +369,7 @@ int main( int argc, char **argv ) {
     LexcCompiler lexc(format, with_flags, align_strings);
     lexc.setMinimizeFlags(minimize_flags);
     lexc.setRenameFlags(rename_flags);
+    lexc.setThreads(threads);
    // lexc.with_flags_ = with_flags;
     if (silent)
       {
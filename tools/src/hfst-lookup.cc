@@ -52,6 +52,9 @@ using hfst::hfst_fprintf_console;
 #include "HfstLookupFlagDiacritics.h"
 #include "HfstFlagDiacritics.h"
 #include "HfstTransducer.h"
+#include "HfstLookupCache.h"
+#include "HfstDelayedComposition.h"
+#include "HfstBasicLookup.h"
 #include "HfstInputStream.h"
 #include "HfstOutputStream.h"
 #include "implementations/HfstTransitionGraph.h"
@@ -60,6 +63,7 @@ using hfst::hfst_fprintf_console;
 #include "inc/globals-unary.h"
 #include "HfstStrings2FstTokenizer.h"
 #include "HfstSymbolDefs.h"
+#include "HfstThreadPool.h"
 
 using hfst::internal_epsilon;
 using hfst::internal_identity;
@@ -67,6 +71,10 @@ using hfst::is_epsilon;
 using hfst::is_identity;
 
 using hfst::HfstTransducer;
+using hfst::HfstLookupCache;
+using hfst::HfstDelayedComposition;
+using hfst::HfstBasicLookup;
+using hfst::HfstThreadPool;
 using hfst::HFST_OL_TYPE;
 using hfst::HFST_OLW_TYPE;
 using hfst::implementations::HfstState;
@@ -100,10 +108,30 @@ static size_t linen = 0;
 static bool lookup_given = false;
 static size_t infinite_cutoff = 5;
 static float beam=-1;
+static unsigned int threads = 1;
+// how many input lines each thread gets at a time in threaded mode
+static const size_t LINES_PER_THREAD = 1024;
+// how many input strings to remember the results of, per transducer
+// and thread
+static size_t cache_size = 0;
 
 // symbols actually seen in (non-ol) transducers
 static std::vector<std::set<std::string> > cascade_symbols_seen;
 static std::vector<bool> cascade_unknown_or_identity_seen;
+// the (non-ol) transducers indexed for lookup
+static std::vector<HfstBasicLookup*> cascade_lookups;
+
+// result caches of an (ol) cascade, one for each thread and transducer
+static std::vector<std::vector<HfstLookupCache*> > lookup_caches;
+
+// whether to map optimized-lookup tables from the file instead of reading them
+static bool mmap_tables = false;
+
+// whether to look up strings in the composition of the cascade
+static bool compose_cascade = false;
+// the composition of the cascade, if compose_cascade and there are
+// several transducers
+static HfstDelayedComposition* composition = NULL;
 
 enum lookup_input_format
 {
@@ -251,7 +279,17 @@ print_usage()
             "                                   the best analysis\n"
             "  -t, --time-cutoff=S              Limit search after having used S seconds per input\n"
             "                                   (currently only works in optimized-lookup mode\n"
-            "  -P, --progress                   Show neat progress bar if possible\n");
+            "  -P, --progress                   Show neat progress bar if possible\n"
+            "  -T, --threads=N                  Look up N input strings at a time in\n"
+            "                                   parallel (only in optimized-lookup mode\n"
+            "                                   or with --compose-cascade)\n"
+            "  -C, --cache-size=N               Remember the results of the N most recently\n"
+            "                                   looked up strings (only in optimized-lookup\n"
+            "                                   mode)\n"
+            "  -M, --compose-cascade            Look up strings in the composition of the\n"
+            "                                   transducers instead of in each of them\n"
+            "  -m, --mmap                       Map optimized-lookup transducers from INFILE\n"
+            "                                   into memory instead of reading them\n");
     fprintf(message_out, "\n");
     print_common_unary_program_parameter_instructions(message_out);
     fprintf(message_out, 
@@ -264,8 +302,17 @@ print_usage()
             "Epsilon is printed by default as an empty string.\n"
             "B must be a non-negative float.\n"
             "S must be a non-negative float. The default, 0.0, indicates no cutoff.\n"
+            "N must be a positive integer, by default 1. With N > 1 the input is read\n"
+            "in chunks, so it is meant for batch processing rather than interactive\n"
+            "use. The results are printed in the order of the input.\n"
             "If the input contains several transducers, a set containing\n"
-            "results from all transducers is printed for each input string.\n");
+            "results from all transducers is printed for each input string.\n"
+            "With --compose-cascade, the transducers are applied one after another\n"
+            "instead, as if they had been composed. The composition is not built;\n"
+            "each lookup only visits the parts of it that its input reaches.\n"
+            "With --mmap, loading is nearly instantaneous and processes looking up\n"
+            "with the same INFILE share its pages. It has no effect when the\n"
+            "transducers are read from standard input.\n");
     fprintf(message_out, "\n");
 
     fprintf(message_out, "STREAM can be { input, output, both }. If not given, defaults to {both}.\n"
@@ -322,12 +369,16 @@ parse_options(int argc, char** argv)
             {"time-cutoff", required_argument, 0, 't'},
             {"pipe-mode", optional_argument, 0, 'p'},
             {"progress", no_argument, 0, 'P'},
+            {"threads", required_argument, 0, 'T'},
+            {"cache-size", required_argument, 0, 'C'},
+            {"compose-cascade", no_argument, 0, 'M'},
+            {"mmap", no_argument, 0, 'm'},
             {0,0,0,0}
         };
         int option_index = 0;
         // add tool-specific options here 
         char c = getopt_long(argc, argv, HFST_GETOPT_COMMON_SHORT
-                             HFST_GETOPT_UNARY_SHORT "I:O:F:xc:X:e:E:b:t:p::P",
+                             HFST_GETOPT_UNARY_SHORT "I:O:F:xc:X:e:E:b:t:p::PT:C:Mm",
                              long_options, &option_index);
         if (-1 == c)
         {
@@ -460,6 +511,28 @@ parse_options(int argc, char** argv)
         case 'P':
             show_progress_bar = true;
             break;
+        case 'T':
+            if (atoi(optarg) < 1)
+            {
+                std::cerr << "Invalid argument for --threads\n";
+                return EXIT_FAILURE;
+            }
+            threads = (unsigned int)atoi(optarg);
+            break;
+        case 'C':
+            if (atol(optarg) < 0)
+            {
+                std::cerr << "Invalid argument for --cache-size\n";
+                return EXIT_FAILURE;
+            }
+            cache_size = (size_t)atol(optarg);
+            break;
+        case 'M':
+            compose_cascade = true;
+            break;
+        case 'm':
+            mmap_tables = true;
+            break;
 #include "inc/getopt-cases-error.h"
         }
     }
@@ -1112,28 +1185,144 @@ line_to_lookup_path(char** s, hfst::HfstStrings2FstTokenizer& tok,
     return rv;
 }
 
+// The messages of one input line and the streams they go to
+typedef std::vector<std::pair<FILE*, std::string> > LookupMessages;
+
+// the messages of the line this thread is looking up in threaded mode
+static thread_local LookupMessages* lookup_messages = NULL;
+
+// Print text to stream, or keep it in lookup_messages in threaded mode so
+// that the messages are printed in input order.
+static void
+add_lookup_message(FILE* stream, const std::string& text)
+{
+  if (lookup_messages != NULL)
+    {
+      lookup_messages->push_back(std::make_pair(stream, text));
+    }
+  else
+    {
+      fputs(text.c_str(), stream);
+    }
+}
+
+static std::string
+format_lookup_message(const char* fmt, va_list ap)
+{
+  va_list aq;
+  va_copy(aq, ap);
+  int length = vsnprintf(NULL, 0, fmt, aq);
+  va_end(aq);
+  if (length <= 0)
+    {
+      return std::string();
+    }
+  std::string text(length + 1, '\0');
+  vsnprintf(&text[0], length + 1, fmt, ap);
+  text.resize(length);
+  return text;
+}
+
+// verbose_printf for messages about looking up a line
+static void
+lookup_verbose_printf(const char* fmt, ...)
+{
+  if (verbose)
+    {
+      va_list ap;
+      va_start(ap, fmt);
+      add_lookup_message(message_out, format_lookup_message(fmt, ap));
+      va_end(ap);
+    }
+}
+
+// warning(0, 0, ...) for warnings about looking up a line
+static void
+lookup_warning(const char* fmt, ...)
+{
+  va_list ap;
+  va_start(ap, fmt);
+  add_lookup_message(stderr, std::string(program_name) + ": warning: "
+                     + format_lookup_message(fmt, ap) + "\n");
+  va_end(ap);
+}
+
+// Print the messages of a line looked up in threaded mode.
+static void
+print_lookup_messages(const LookupMessages& messages, FILE* outstream)
+{
+  if (messages.empty())
+    {
+      return;
+    }
+  // keep the order of results and messages when they go to one terminal
+  fflush(outstream);
+  for (LookupMessages::const_iterator it = messages.begin();
+       it != messages.end(); ++it)
+    {
+      fputs(it->second.c_str(), it->first);
+    }
+}
+
+static void
+verbose_print_tokens(const HfstOneLevelPath& kv)
+{
+  if (verbose)
+    {
+      lookup_verbose_printf("Tokenized to: ");
+      for (StringVector::const_iterator s = kv.second.begin();
+           s != kv.second.end();
+           ++s)
+        {
+          lookup_verbose_printf("%s ", s->c_str());
+        }
+      lookup_verbose_printf("\n");
+    }
+}
+
+// If cache is not null, it holds results of earlier lookups in t.
 HfstOneLevelPaths*
-lookup_simple(const HfstOneLevelPath& s, HfstTransducer& t, bool* infinity)
+lookup_simple(const HfstOneLevelPath& s, HfstTransducer& t, bool* infinity,
+              HfstLookupCache* cache = 0)
 {
   HfstOneLevelPaths* results = 0;
-  if (time_cutoff == 0.0 && t.is_lookup_infinitely_ambiguous(s.second))
+  bool infinitely_ambiguous = false;
+  if (cache != 0)
+    {
+      // one use of the cache entry for both questions
+      if (time_cutoff == 0.0)
+        {
+          results = cache->lookup_fd_bounded(s.second, infinite_cutoff,
+                                             infinitely_ambiguous);
+        }
+      else
+        {
+          results = cache->lookup_fd(s.second, -1, time_cutoff);
+        }
+    }
+  else
+    {
+      ssize_t limit = -1;
+      if (time_cutoff == 0.0 && t.is_lookup_infinitely_ambiguous(s.second))
+        {
+          infinitely_ambiguous = true;
+          limit = infinite_cutoff;
+        }
+      results = t.lookup_fd(s.second, limit, time_cutoff);
+    }
+  if (infinitely_ambiguous)
     {
       if (!silent && infinite_cutoff > 0) {
-    warning(0, 0, "Got infinite results, number of cycles limited to " SIZE_T_SPECIFIER "",
+    lookup_warning("Got infinite results, number of cycles limited to " SIZE_T_SPECIFIER "",
         infinite_cutoff);
       }
-      results = t.lookup_fd(s.second, infinite_cutoff, time_cutoff);
       *infinity = true;
     }
-  else
-    {
-        results = t.lookup_fd(s.second, -1, time_cutoff);
-    }
 
   if (results->size() == 0)
     {
        // no results as empty result
-      verbose_printf("Got no results\n");
+      lookup_verbose_printf("Got no results\n");
     }
   return results;
 }
@@ -1201,7 +1390,7 @@ bool is_possible_to_get_result(const HfstOneLevelPath & s,
 // which transducer in the cascade we are handling
 static unsigned int transducer_number=0;
 
-void lookup_fd_and_print(HfstBasicTransducer &t, HfstOneLevelPaths& results, 
+void lookup_fd_and_print(const HfstBasicLookup &t, HfstOneLevelPaths& results, 
                          const HfstOneLevelPath& s, ssize_t limit = -1)
 {
   (void)limit; // FIX ???
@@ -1308,21 +1497,22 @@ lookup_simple(const HfstOneLevelPath& s, HfstBasicTransducer& t, bool* infinity)
   if (possible && t.is_lookup_infinitely_ambiguous(s))
     {
       if (!silent && infinite_cutoff > 0) {
-    warning(0, 0, "Got infinite results, number of cycles limited to " SIZE_T_SPECIFIER "",
+    lookup_warning("Got infinite results, number of cycles limited to " SIZE_T_SPECIFIER "",
         infinite_cutoff);
       }
-      lookup_fd_and_print(t, *results, s, infinite_cutoff);
+      lookup_fd_and_print(*cascade_lookups[transducer_number], *results, s,
+                          infinite_cutoff);
       *infinity = true;
     }
   else
     {
-        lookup_fd_and_print(t, *results, s);
+        lookup_fd_and_print(*cascade_lookups[transducer_number], *results, s);
     }
 
   if (results->size() == 0)
     {
        // no results as empty result
-      verbose_printf("Got no results\n");
+      lookup_verbose_printf("Got no results\n");
     }
 
   return results;
@@ -1330,29 +1520,32 @@ lookup_simple(const HfstOneLevelPath& s, HfstBasicTransducer& t, bool* infinity)
 
 
 
+// caches, if not null, has a cache for each transducer of cascade.
 HfstOneLevelPaths*
-lookup_cascading(const HfstOneLevelPath& s, vector<HfstTransducer> cascade,
-                 bool* infinity)
+lookup_cascading(const HfstOneLevelPath& s, vector<HfstTransducer>& cascade,
+                 bool* infinity, vector<HfstLookupCache*>* caches = 0)
 {
   HfstOneLevelPaths* results = new HfstOneLevelPaths;
 
   // go through all transducers in the cascade
   for (unsigned int i = 0; i < cascade.size(); i++)
     {
-      HfstOneLevelPaths* result = lookup_simple(s, cascade[i], infinity);
+      HfstOneLevelPaths* result = lookup_simple
+        (s, cascade[i], infinity, (caches != 0) ? caches->at(i) : 0);
       if (infinity)
         {
-          verbose_printf("Inf results @ level %u\n", i);
+          lookup_verbose_printf("Inf results @ level %u\n", i);
         }
       else
         {
-          verbose_printf("" SIZE_T_SPECIFIER " results @ level %u\n", result->size(), i);
+          lookup_verbose_printf("" SIZE_T_SPECIFIER " results @ level %u\n", result->size(), i);
         }
       for (HfstOneLevelPaths::const_iterator it = result->begin();
            it != result->end(); it++)
         {
           results->insert(*it);
         }
+      delete result;
     }
   // all transducers gone through
 
@@ -1361,7 +1554,7 @@ lookup_cascading(const HfstOneLevelPath& s, vector<HfstTransducer> cascade,
 
 
 HfstOneLevelPaths*
-lookup_cascading(const HfstOneLevelPath& s, vector<HfstBasicTransducer> cascade,
+lookup_cascading(const HfstOneLevelPath& s, vector<HfstBasicTransducer>& cascade,
                  bool* infinity)
 {
   HfstOneLevelPaths* results = new HfstOneLevelPaths;
@@ -1373,11 +1566,11 @@ lookup_cascading(const HfstOneLevelPath& s, vector<HfstBasicTransducer> cascade,
       HfstOneLevelPaths* result = lookup_simple(s, cascade[i], infinity);
       if (infinity)
         {
-          verbose_printf("Inf results @ level %u\n", i);
+          lookup_verbose_printf("Inf results @ level %u\n", i);
         }
       else
         {
-          verbose_printf("" SIZE_T_SPECIFIER " results @ level %u\n", result->size(), i);
+          lookup_verbose_printf("" SIZE_T_SPECIFIER " results @ level %u\n", result->size(), i);
         }
       for (HfstOneLevelPaths::const_iterator it = result->begin();
            it != result->end(); it++)
@@ -1458,18 +1651,20 @@ print_lookups(const HfstOneLevelPaths& kvs,
 
 HfstOneLevelPaths*
 perform_lookups(HfstOneLevelPath& origin, std::vector<HfstTransducer>& cascade, 
-                bool unknown, bool* infinite)
+                bool unknown, bool* infinite,
+                std::vector<HfstLookupCache*>* caches = 0)
 {
   HfstOneLevelPaths* kvs;
     if (!unknown)
       {
         if (cascade.size() == 1)
           {
-            kvs = lookup_simple(origin, cascade[0], infinite);
+            kvs = lookup_simple(origin, cascade[0], infinite,
+                                (caches != 0) ? caches->at(0) : 0);
           }
         else
          {
-           kvs = lookup_cascading(origin, cascade, infinite);
+           kvs = lookup_cascading(origin, cascade, infinite, caches);
          }
       }
     else
@@ -1502,6 +1697,142 @@ perform_lookups(HfstOneLevelPath& origin, std::vector<HfstBasicTransducer>& casc
     return kvs;
 }
 
+HfstOneLevelPaths*
+perform_lookups(HfstOneLevelPath& origin,
+                const HfstDelayedComposition& composition,
+                bool unknown, bool* infinite)
+{
+  if (unknown)
+    {
+      return new HfstOneLevelPaths;
+    }
+  bool infinitely_ambiguous = false;
+  HfstOneLevelPaths* kvs = composition.lookup(origin.second, infinite_cutoff,
+                                              NULL, &infinitely_ambiguous);
+  if (infinitely_ambiguous)
+    {
+      if (!silent && infinite_cutoff > 0) {
+    lookup_warning("Got infinite results, number of cycles limited to " SIZE_T_SPECIFIER "",
+        infinite_cutoff);
+      }
+      *infinite = true;
+    }
+  return kvs;
+}
+
+// An input line in threaded mode and the results of looking it up
+struct LookupItem
+{
+  HfstOneLevelPath* kv;
+  char* markup;
+  bool unknown;
+  bool infinite;
+  HfstOneLevelPaths* kvs;
+  LookupMessages messages;
+};
+
+// Read lookup_file in chunks of LINES_PER_THREAD lines per thread, look up
+// the lines of each chunk in parallel and print the results and messages
+// in input order.
+// Return the position in lookup_file after the last line.
+static long
+lookup_in_parallel(std::vector<HfstTransducer>& cascade,
+                   hfst::HfstStrings2FstTokenizer& input_tokenizer,
+                   FILE* outstream, long filesize)
+{
+    HfstThreadPool pool(threads);
+    std::vector<LookupItem> items;
+    char* line = 0;
+    size_t llen = 0;
+    long filepos = ftell(lookup_file);
+    bool input_left = true;
+    while (input_left)
+      {
+        items.clear();
+        while (items.size() < LINES_PER_THREAD * pool.size())
+          {
+            if (hfst_getline(&line, &llen, lookup_file) == -1)
+              {
+                input_left = false;
+                break;
+              }
+            linen++;
+            char * p = line;
+            while (*p != '\0')
+              {
+                if (*p == '\n' || *p == '\r')
+                  {
+                    *p = '\0';
+                    break;
+                  }
+                p++;
+              }
+            items.push_back(LookupItem());
+            LookupItem& item = items.back();
+            item.markup = 0;
+            item.unknown = false;
+            item.infinite = false;
+            item.kvs = 0;
+            lookup_messages = &item.messages;
+            lookup_verbose_printf("Looking up %s...\n", line);
+            item.kv = line_to_lookup_path(&line, input_tokenizer,
+                                          &item.markup, &item.unknown,
+                                          composition == NULL);
+            verbose_print_tokens(*item.kv);
+            lookup_messages = NULL;
+            // apertium input may have replaced line with a shorter buffer
+            llen = strlen(line) + 1;
+          }
+
+        pool.run(items.size(),
+                 [&items, &cascade](unsigned int thread, size_t i)
+                 {
+                   lookup_messages = &items[i].messages;
+                   if (composition != NULL)
+                     {
+                       items[i].kvs = perform_lookups
+                         (*items[i].kv, *composition, items[i].unknown,
+                          &items[i].infinite);
+                     }
+                   else
+                     {
+                       items[i].kvs = perform_lookups
+                         (*items[i].kv, cascade, items[i].unknown,
+                          &items[i].infinite,
+                          lookup_caches.empty() ? 0 : &lookup_caches[thread]);
+                     }
+                   lookup_messages = NULL;
+                 });
+
+        for (std::vector<LookupItem>::iterator it = items.begin();
+             it != items.end(); ++it)
+          {
+            print_lookup_messages(it->messages, outstream);
+            print_lookups(*it->kvs, *it->kv, it->markup, it->unknown,
+                          it->infinite, outstream);
+            delete it->kv;
+            delete it->kvs;
+            free(it->markup);
+          }
+        fflush(outstream);
+
+        filepos = ftell(lookup_file);
+        if (show_progress_bar)
+          {
+            if (filesize != -1)
+              {
+                fprintf(stderr, "%ld / %ld...\r", filepos, filesize);
+              }
+            else
+              {
+                fprintf(stderr, "%ld / ?...\r", linen);
+              }
+          }
+      }
+    free(line);
+    return filepos;
+}
+
 int
 process_stream(HfstInputStream& inputstream, FILE* outstream)
 {
@@ -1539,11 +1870,13 @@ process_stream(HfstInputStream& inputstream, FILE* outstream)
                            transducer_n); 
           }
 
-        // add multicharacter symbols to mc_symbols
+        // add multicharacter symbols to mc_symbols, also of optimized
+        // lookup transducers if the input is tokenized for a composition
         if (type == hfst::SFST_TYPE || 
             type == hfst::TROPICAL_OPENFST_TYPE ||
             type == hfst::LOG_OPENFST_TYPE ||
-            type == hfst::FOMA_TYPE)
+            type == hfst::FOMA_TYPE ||
+            compose_cascade)
         {
             HfstBasicTransducer basic(trans);
             for (HfstBasicTransducer::const_iterator it = basic.begin();
@@ -1563,12 +1896,16 @@ process_stream(HfstInputStream& inputstream, FILE* outstream)
                     }
                   }
               }
-            cascade_mut.push_back(basic);
-            cascade_symbols_seen.push_back(symbols_seen);
-            if (id_or_unk_seen)
-              cascade_unknown_or_identity_seen.push_back(true);
-            else
-              cascade_unknown_or_identity_seen.push_back(false);
+            if (type != HFST_OL_TYPE && type != HFST_OLW_TYPE)
+              {
+                cascade_mut.push_back(basic);
+                cascade_lookups.push_back(new HfstBasicLookup(basic));
+                cascade_symbols_seen.push_back(symbols_seen);
+                if (id_or_unk_seen)
+                  cascade_unknown_or_identity_seen.push_back(true);
+                else
+                  cascade_unknown_or_identity_seen.push_back(false);
+              }
         }
 
         cascade.push_back(trans);
@@ -1584,6 +1921,17 @@ process_stream(HfstInputStream& inputstream, FILE* outstream)
               "optimized lookup transducers");
     }
 
+    if (compose_cascade && cascade.size() > 1)
+      {
+        if (print_pairs) {
+          error(EXIT_FAILURE, 0, "pair printing not supported with "
+                "--compose-cascade");
+        }
+        verbose_printf("Preparing the composition of " SIZE_T_SPECIFIER
+                       " transducers...\n", cascade.size());
+        composition = new HfstDelayedComposition(cascade);
+      }
+
     // if transducer type is other than optimized_lookup,
     // convert to HfstBasicTransducer
 
@@ -1593,7 +1941,7 @@ process_stream(HfstInputStream& inputstream, FILE* outstream)
     hfst::HfstStrings2FstTokenizer input_tokenizer(mc_symbols, 
                          std::string(epsilon_format));
 
-    if (!only_optimized_lookup)
+    if (!only_optimized_lookup && composition == NULL)
       {
         char* format_string = hfst_strformat(cascade[0].get_type());
         if (!silent) {
@@ -1615,9 +1963,48 @@ process_stream(HfstInputStream& inputstream, FILE* outstream)
         fprintf(stderr, "%ld... rewinding\n", filesize);
         rewind(lookup_file);
       }
-    print_prompt();
     long filepos = ftell(lookup_file);
-    while (true)
+    if (threads > 1 && ((!only_optimized_lookup && composition == NULL)
+                        || print_pairs))
+      {
+        if (!silent) {
+          warning(0, 0, "--threads is only supported for optimized-lookup "
+                  "transducers or --compose-cascade without pair "
+                  "printing, looking up one string at a time");
+        }
+        threads = 1;
+      }
+    if (cache_size > 0 && (!only_optimized_lookup || composition != NULL))
+      {
+        if (!silent) {
+          warning(0, 0, "--cache-size is only supported for "
+                  "optimized-lookup transducers without --compose-cascade, "
+                  "not caching results");
+        }
+      }
+    else if (cache_size > 0)
+      {
+        lookup_caches.resize(threads);
+        for (unsigned int t = 0; t < threads; t++)
+          {
+            for (unsigned int i = 0; i < cascade.size(); i++)
+              {
+                lookup_caches[t].push_back
+                  (new HfstLookupCache(cascade[i], cache_size));
+              }
+          }
+      }
+    if (threads > 1)
+      {
+        filepos = lookup_in_parallel(cascade, input_tokenizer, outstream,
+                                     filesize);
+      }
+    else
+      {
+        print_prompt();
+      }
+    // in threaded mode, lookup_in_parallel has read all of the input
+    while (threads == 1)
       {
 #ifdef WINDOWS
         if (lookup_file == stdin && !pipe_input)
@@ -1672,23 +2059,21 @@ process_stream(HfstInputStream& inputstream, FILE* outstream)
 
         HfstOneLevelPath* kv = line_to_lookup_path(&line, input_tokenizer,
                                                    &markup,
-                                                   &unknown, only_optimized_lookup);
+                                                   &unknown, only_optimized_lookup &&
+                                                   composition == NULL);
 
-        if (verbose)
+        verbose_print_tokens(*kv);
+        if (composition != NULL)
           {
-            verbose_printf("Tokenized to: ");
-            for (StringVector::const_iterator s = kv->second.begin();
-                 s != kv->second.end();
-                 ++s)
-              {
-                verbose_printf("%s ", s->c_str());
-              }
-            verbose_printf("\n");
+            kvs = perform_lookups(*kv, *composition, unknown,
+                                  &infinite);
           }
-        if (only_optimized_lookup)
+        else if (only_optimized_lookup)
           {
             kvs = perform_lookups(*kv, cascade, unknown,
-                                  &infinite);
+                                  &infinite,
+                                  lookup_caches.empty() ?
+                                  0 : &lookup_caches[0]);
           }
         else
           {
@@ -1720,7 +2105,37 @@ process_stream(HfstInputStream& inputstream, FILE* outstream)
                 "%f\t%f\n",
                 (float)analysed/(float)inputs,
                 (float)analyses/(float)inputs);
+        if (!lookup_caches.empty())
+          {
+            unsigned long hits = 0;
+            unsigned long misses = 0;
+            for (unsigned int t = 0; t < lookup_caches.size(); t++)
+              {
+                for (unsigned int i = 0; i < lookup_caches[t].size(); i++)
+                  {
+                    hits += lookup_caches[t][i]->get_hits();
+                    misses += lookup_caches[t][i]->get_misses();
+                  }
+              }
+            fprintf(outstream, "Cache hits\tCache misses\n"
+                    "%lu\t%lu\n", hits, misses);
+          }
+      }
+    for (unsigned int t = 0; t < lookup_caches.size(); t++)
+      {
+        for (unsigned int i = 0; i < lookup_caches[t].size(); i++)
+          {
+            delete lookup_caches[t][i];
+          }
+      }
+    lookup_caches.clear();
+    for (unsigned int i = 0; i < cascade_lookups.size(); i++)
+      {
+        delete cascade_lookups[i];
       }
+    cascade_lookups.clear();
+    delete composition;
+    composition = NULL;
     return EXIT_SUCCESS;
 }
 
@@ -1783,6 +2198,7 @@ int main( int argc, char **argv ) {
               inputfilename);
         return EXIT_FAILURE;
       }
+    instream->set_mmap_tables(mmap_tables);
     process_stream(*instream, outfile);
     if (outfile != stdout)
     {
@@ -37,6 +37,11 @@ using hfst::hfst_fprintf_console;
 
 #include <cstdarg>
 #include <iostream> // DEBUG
+#include <sstream>
+
+#include "HfstThreadPool.h"
+
+using hfst::HfstThreadPool;
 
 static float beam=-1;
 static bool pipe_input = false;
@@ -68,8 +73,13 @@ bool print_usage(void)
     "                              (with this option enabled -u and -n don't work and\n" <<
     "                              output won't be ordered by weight).\n" <<
     "  -p, --pipe-mode[=STREAM]    Control input and output streams.\n" <<
+    "  -T, --threads=T             Analyze T input lines at a time in parallel\n" <<
+    "                              (input is read in chunks, for batch use)\n" <<
+    "  -C, --cache-size=C          Remember the analyses of the C most recently\n" <<
+    "                              seen input lines\n" <<
     "\n" <<
-    "N must be a positive integer. B must be a non-negative float.\n" <<
+    "N and T must be positive integers. B must be a non-negative float.\n" <<
+    "C must be a non-negative integer. The default, 0, disables the cache.\n" <<
     "S must be a non-negative float. The default, 0.0, indicates no cutoff.\n"
     "Options -n and -b are combined with AND, i.e. they both restrict the output.\n" <<
     "\n" << 
@@ -130,11 +140,13 @@ int main(int argc, char **argv)
           {"fast",         no_argument,       0, 'f'},
           {"pipe-mode",    optional_argument,       0, 'p'},
           {"analyses",     required_argument, 0, 'n'},
+          {"threads",      required_argument, 0, 'T'},
+          {"cache-size",   required_argument, 0, 'C'},
           {0,              0,                 0,  0 }
         };
       
       int option_index = 0;
-      c = getopt_long(argc, argv, "hVvqsewb:t:uxfn:p::", long_options, &option_index);
+      c = getopt_long(argc, argv, "hVvqsewb:t:uxfn:p::T:C:", long_options, &option_index);
 
       if (c == -1) // no more options to look at
         break;
@@ -213,6 +225,24 @@ int main(int argc, char **argv)
             }
           break;
 
+        case 'T':
+          if (atoi(optarg) < 1)
+            {
+              std::cerr << "Invalid argument for --threads\n";
+              return EXIT_FAILURE;
+            }
+          threads = atoi(optarg);
+          break;
+
+        case 'C':
+          if (atol(optarg) < 0)
+            {
+              std::cerr << "Invalid argument for --cache-size\n";
+              return EXIT_FAILURE;
+            }
+          cache_size = atol(optarg);
+          break;
+
         case 'x':
           outputType = xerox;
           break;
@@ -249,6 +279,11 @@ int main(int argc, char **argv)
   //hfst::print_output_to_console(!pipe_output); // has no effect on windows or mac
 #endif
 
+  if (threads > 1 || cache_size > 0)
+    { // output is collected in streams, not printed on the console
+      pipe_output = true;
+    }
+
   // no more options, we should now be at the input filename
   if ( (optind + 1) < argc)
     {
@@ -454,38 +489,12 @@ SymbolNumber Encoder::find_key(char ** p)
   return s;
 }
 
+// Tokenize the input line str and print its analyses by T to the output
+// stream of T. input_string must have room for the symbols of str.
 template <class genericTransducer>
-void runTransducer (genericTransducer T)
+void lookupLine(genericTransducer & T, SymbolNumber * input_string, char * str)
 {
-  SymbolNumber * input_string = (SymbolNumber*)(malloc(2000));
-  for (int i = 0; i < 1000; ++i)
-    {
-      input_string[i] = NO_SYMBOL_NUMBER;
-    }
-
-  char * str = (char*)(malloc(MAX_IO_STRING*sizeof(char)));  
-  *str = 0;
-  char * old_str = str;
-
-  while(true)
-    {
-#ifdef WINDOWS
-      if (!pipe_input)
-        {
-          free(str);
-          std::string linestr("");
-          if (! hfst::get_line_from_console(linestr, MAX_IO_STRING*sizeof(char)))
-            break;
-          str = strdup(linestr.c_str());
-          old_str = str;     
-        }
-      else
-#endif
-        {
-          if (! std::cin.getline(str,MAX_IO_STRING))
-            break;
-        }
-                        
+      std::ostream & out = T.get_output_stream();
       if (echoInputsFlag)
         {
 #ifdef WINDOWS
@@ -493,12 +502,13 @@ void runTransducer (genericTransducer T)
             hfst_fprintf_console(stdout, "%s\n", str); // fix: add \r?
           else
 #endif
-            std::cout << str << std::endl;
+            out << str << std::endl;
         }
       int i = 0;
       SymbolNumber k = NO_SYMBOL_NUMBER;
       bool failed = false;
-      for ( char ** Str = &str; **Str != 0; )
+      char * p = str;
+      for ( char ** Str = &p; **Str != 0; )
         {
           k = T.find_next_key(Str);
 #if OL_FULL_DEBUG
@@ -508,7 +518,7 @@ void runTransducer (genericTransducer T)
             {
               if (echoInputsFlag)
                 {
-                  std::cout << std::endl;
+                  out << std::endl;
                 }
               failed = true;
               break;
@@ -516,7 +526,6 @@ void runTransducer (genericTransducer T)
           input_string[i] = k;
           ++i;
         }
-      str = old_str;
       if (failed)
         { // tokenization failed
           if (outputType == xerox)
@@ -526,28 +535,175 @@ void runTransducer (genericTransducer T)
               hfst_fprintf_console(stdout, "%s\t+?\n\n", str);
           else
 #endif
-              std::cout << str << "\t+?" << std::endl << std::endl;
+              out << str << "\t+?" << std::endl << std::endl;
 
 #ifdef WINDOWS
           if (!pipe_output)
             hfst_fprintf_console(stdout, "\n\n");
           else
 #endif
-              std::cout << std::endl << std::endl;
+              out << std::endl << std::endl;
             }
-          continue;
+          return;
         }
 
       input_string[i] = NO_SYMBOL_NUMBER;
 
-      if (time_cutoff > 0.0) {
-          start_clock = clock();
-          call_counter = 0;
-          limit_reached = false;
-      }
-      
       T.analyze(input_string);
       T.printAnalyses(std::string(str));
+}
+
+// Like lookupLine, but return the output instead of printing it, and
+// reuse the output of an earlier line with the same input if it is still
+// in cache. buffer must be the output stream of T.
+template <class genericTransducer>
+const std::string & cachedLookupLine(genericTransducer & T,
+                                     SymbolNumber * input_string, char * str,
+                                     AnalysisCache & cache,
+                                     std::ostringstream & buffer)
+{
+  std::string input(str);
+  const std::string * output = cache.find(input);
+  if (output != NULL)
+    {
+      return *output;
+    }
+  buffer.str("");
+  lookupLine(T, input_string, str);
+  return cache.insert(input, buffer.str());
+}
+
+// Read the input in chunks of lines and analyze each chunk in threads
+// threads, every thread with its own copy of T. The analyses are gathered
+// per line and printed in the order of the input.
+template <class genericTransducer>
+void runTransducerThreaded (genericTransducer & T)
+{
+  HfstThreadPool pool(threads);
+  std::vector<genericTransducer> workers(pool.size(), T);
+  std::vector<SymbolNumberVector> input_strings
+    (pool.size(), SymbolNumberVector(MAX_IO_STRING + 1, NO_SYMBOL_NUMBER));
+  std::vector<std::ostringstream *> streams;
+  std::vector<AnalysisCache> caches(pool.size(), AnalysisCache(cache_size));
+  for (size_t w = 0; w < workers.size(); ++w)
+    {
+      streams.push_back(new std::ostringstream());
+      workers[w].set_output_stream(*streams[w]);
+    }
+
+  const size_t lines_per_chunk = 1024 * pool.size();
+  std::vector<std::string> lines;
+  std::vector<std::string> results;
+  char * str = (char*)(malloc(MAX_IO_STRING*sizeof(char)));
+  bool input_left = true;
+  while (input_left)
+    {
+      lines.clear();
+      while (lines.size() < lines_per_chunk)
+        {
+          if (! std::cin.getline(str,MAX_IO_STRING))
+            {
+              input_left = false;
+              break;
+            }
+          lines.push_back(std::string(str));
+        }
+      results.resize(lines.size());
+      pool.run(lines.size(), [&](unsigned int w, size_t i)
+               {
+                 if (cache_size > 0)
+                   {
+                     results[i] = cachedLookupLine
+                       (workers[w], &input_strings[w][0], &lines[i][0],
+                        caches[w], *streams[w]);
+                     return;
+                   }
+                 streams[w]->str("");
+                 lookupLine(workers[w], &input_strings[w][0], &lines[i][0]);
+                 results[i] = streams[w]->str();
+               });
+      for (size_t i = 0; i < results.size(); ++i)
+        {
+          std::cout << results[i];
+        }
+      std::cout.flush();
+    }
+  free(str);
+  for (size_t w = 0; w < streams.size(); ++w)
+    {
+      delete streams[w];
+    }
+  if (verboseFlag && cache_size > 0)
+    {
+      unsigned long hits = 0;
+      unsigned long misses = 0;
+      for (size_t w = 0; w < caches.size(); ++w)
+        {
+          hits += caches[w].hits;
+          misses += caches[w].misses;
+        }
+      std::cerr << "cache hits: " << hits << ", misses: " << misses
+                << std::endl;
+    }
+}
+
+template <class genericTransducer>
+void runTransducer (genericTransducer & T)
+{
+  if (threads > 1)
+    {
+      runTransducerThreaded(T);
+      return;
+    }
+
+  SymbolNumber * input_string = (SymbolNumber*)(malloc(2000));
+  for (int i = 0; i < 1000; ++i)
+    {
+      input_string[i] = NO_SYMBOL_NUMBER;
+    }
+
+  char * str = (char*)(malloc(MAX_IO_STRING*sizeof(char)));  
+  *str = 0;
+
+  AnalysisCache cache(cache_size);
+  std::ostringstream buffer;
+  if (cache_size > 0)
+    {
+      T.set_output_stream(buffer);
+    }
+
+  while(true)
+    {
+#ifdef WINDOWS
+      if (!pipe_input)
+        {
+          free(str);
+          std::string linestr("");
+          if (! hfst::get_line_from_console(linestr, MAX_IO_STRING*sizeof(char)))
+            break;
+          str = strdup(linestr.c_str());
+        }
+      else
+#endif
+        {
+          if (! std::cin.getline(str,MAX_IO_STRING))
+            break;
+        }
+
+      if (cache_size > 0)
+        {
+          std::cout << cachedLookupLine(T, input_string, str, cache, buffer);
+          std::cout.flush();
+        }
+      else
+        {
+          lookupLine(T, input_string, str);
+        }
+    }
+  if (verboseFlag && cache_size > 0)
+    {
+      std::cerr << "cache hits: " << cache.hits << ", misses: "
+                << cache.misses << std::endl;
     }
 }
 
@@ -953,7 +1109,7 @@ void Transducer::note_analysis(SymbolNumber * whole_output_string)
             hfst_fprintf_console(stdout, "%s", symbol_table[*num]);
           else
 #endif
-            std::cout << symbol_table[*num];
+            *output_stream << symbol_table[*num];
         }
 
 #ifdef WINDOWS
@@ -961,7 +1117,7 @@ void Transducer::note_analysis(SymbolNumber * whole_output_string)
         hfst_fprintf_console(stdout, "\n");
       else
 #endif
-        std::cout << std::endl;
+        *output_stream << std::endl;
     } else
     {
       std::string str = "";
@@ -998,16 +1154,9 @@ void Transducer::get_analyses(SymbolNumber * input_symbol,
                               SymbolNumber * original_output_string,
                               TransitionTableIndex i)
 {
-    if (time_cutoff > 0.0) {
-        // Check to see if time has been overspent. For speed, only check every
-        // million calls and set a flag.
-        ++call_counter;
-        if (limit_reached ||
-            (call_counter % 1000000 == 0 &&
-             ((((double) clock() - start_clock) / CLOCKS_PER_SEC) > time_cutoff))) {
-            limit_reached = true;
-            return;
-        }
+    // Check to see if time has been overspent
+    if (deadline.expired()) {
+        return;
     }
 #if OL_FULL_DEBUG
   std::cout << "get_analyses " << i << std::endl;
@@ -1090,14 +1239,14 @@ void Transducer::printAnalyses(std::string prepend)
             hfst_fprintf_console(stdout, "%s\t+?\n\n", prepend.c_str());
           else
 #endif
-          std::cout << prepend << "\t+?" << std::endl << std::endl;
+          *output_stream << prepend << "\t+?" << std::endl << std::endl;
 
 #ifdef WINDOWS
           if (!pipe_output)
             hfst_fprintf_console(stdout, "\n\n");
           else
 #endif
-          std::cout << std::endl << std::endl;
+          *output_stream << std::endl << std::endl;
           return;
         }
       int i = 0;
@@ -1111,7 +1260,7 @@ void Transducer::printAnalyses(std::string prepend)
                 hfst_fprintf_console(stdout, "%s\t", prepend.c_str());
               else
 #endif
-                std::cout << prepend << "\t";
+                *output_stream << prepend << "\t";
             }                   
 
 #ifdef WINDOWS
@@ -1119,7 +1268,7 @@ void Transducer::printAnalyses(std::string prepend)
             hfst_fprintf_console(stdout, "%s\n", it->c_str());
           else
 #endif
-            std::cout << *it << std::endl;
+            *output_stream << *it << std::endl;
 
           ++it;
           ++i;
@@ -1131,7 +1280,7 @@ void Transducer::printAnalyses(std::string prepend)
         hfst_fprintf_console(stdout, "\n");
       else
 #endif
-        std::cout << std::endl;
+        *output_stream << std::endl;
 
     }
 }
@@ -1146,14 +1295,14 @@ void TransducerUniq::printAnalyses(std::string prepend)
         hfst_fprintf_console(stdout, "%s\t+?\n\n", prepend.c_str());
       else
 #endif
-        std::cout << prepend << "\t+?" << std::endl << std::endl;
+        *output_stream << prepend << "\t+?" << std::endl << std::endl;
 
 #ifdef WINDOWS
       if (!pipe_mode)
         hfst_fprintf_console("\n\n");
       else
 #endif
-        std::cout << std::endl << std::endl;
+        *output_stream << std::endl << std::endl;
 
       return;
     }
@@ -1168,7 +1317,7 @@ void TransducerUniq::printAnalyses(std::string prepend)
         hfst_fprintf_console(stdout, "%s\t", prepend.c_str());
       else
 #endif
-        std::cout << prepend << "\t";
+        *output_stream << prepend << "\t";
         }
 
 #ifdef WINDOWS
@@ -1176,7 +1325,7 @@ void TransducerUniq::printAnalyses(std::string prepend)
         hfst_fprintf_console(stdout, "%s\n", it->c_str());
       else
 #endif
-        std::cout << *it << std::endl;
+        *output_stream << *it << std::endl;
 
       ++it;
       ++i;
@@ -1187,7 +1336,7 @@ void TransducerUniq::printAnalyses(std::string prepend)
     hfst_fprintf_console("\n");
   else
 #endif
-    std::cout << std::endl;
+    *output_stream << std::endl;
 }
 
 void TransducerFdUniq::printAnalyses(std::string prepend)
@@ -1199,14 +1348,14 @@ void TransducerFdUniq::printAnalyses(std::string prepend)
     hfst_fprintf_console(stdout, "%s\t+?\n\n", prepend.c_str());
   else
 #endif
-      std::cout << prepend << "\t+?" << std::endl << std::endl;
+      *output_stream << prepend << "\t+?" << std::endl << std::endl;
 
 #ifdef WINDOWS
   if (!pipe_mode)
     hfst_fprintf_console(stdout, "\n\n");
   else
 #endif
-      std::cout << std::endl << std::endl;
+      *output_stream << std::endl << std::endl;
   return;
     }
   int i = 0;
@@ -1220,7 +1369,7 @@ void TransducerFdUniq::printAnalyses(std::string prepend)
             hfst_fprintf_console(stdout, "%s\t", prepend.c_str());
           else
 #endif
-            std::cout << prepend << "\t";
+            *output_stream << prepend << "\t";
         }
 
 #ifdef WINDOWS
@@ -1228,7 +1377,7 @@ void TransducerFdUniq::printAnalyses(std::string prepend)
         hfst_fprintf_console(stdout, "%s\n", it->c_str());
       else
 #endif
-        std::cout << *it << std::endl;
+        *output_stream << *it << std::endl;
 
       ++it;
       ++i;
@@ -1240,7 +1389,7 @@ void TransducerFdUniq::printAnalyses(std::string prepend)
     hfst_fprintf_console("\n");
   else
 #endif
-    std::cout << std::endl;
+    *output_stream << std::endl;
 }
 
 /**
@@ -1636,13 +1785,13 @@ void TransducerW::printAnalyses(std::string prepend)
         hfst_fprintf_console(stdout, "%s\t+?\n\n", prepend.c_str());
       else
 #endif
-          std::cout << prepend << "\t+?" << std::endl << std::endl;
+          *output_stream << prepend << "\t+?" << std::endl << std::endl;
 
 #ifdef WINDOWS
       if (!pipe_output)
         hfst_fprintf_console(stdout, "\n\n");
       else
-          std::cout << std::endl << std::endl;
+          *output_stream << std::endl << std::endl;
 #endif
 
       return;
@@ -1665,7 +1814,7 @@ void TransducerW::printAnalyses(std::string prepend)
               hfst_fprintf_console(stdout, "%s\t", prepend.c_str()); 
             else
 #endif
-              std::cout << prepend << "\t";
+              *output_stream << prepend << "\t";
           }
 
 #ifdef WINDOWS
@@ -1673,7 +1822,7 @@ void TransducerW::printAnalyses(std::string prepend)
           hfst_fprintf_console(stdout, "%s", (*it).second.c_str());
         else
 #endif
-          std::cout << (*it).second;
+          *output_stream << (*it).second;
         
         if (displayWeightsFlag)
           {
@@ -1682,7 +1831,7 @@ void TransducerW::printAnalyses(std::string prepend)
               hfst_fprintf_console(stdout, "\t%f", (*it).first);
             else
 #endif
-              std::cout << '\t' << (*it).first;
+              *output_stream << '\t' << (*it).first;
           }
 
 #ifdef WINDOWS
@@ -1690,7 +1839,7 @@ void TransducerW::printAnalyses(std::string prepend)
           hfst_fprintf_console(stdout, "\n");
         else
 #endif
-          std::cout << std::endl;
+          *output_stream << std::endl;
  
       }
       ++it;
@@ -1703,7 +1852,7 @@ void TransducerW::printAnalyses(std::string prepend)
     hfst_fprintf_console(stdout, "\n");
   else
 #endif
-    std::cout << std::endl;
+    *output_stream << std::endl;
 }
 
 void TransducerWUniq::printAnalyses(std::string prepend)
@@ -1715,14 +1864,14 @@ void TransducerWUniq::printAnalyses(std::string prepend)
         hfst_fprintf_console(stdout, "%s\t+?\n", prepend.c_str());
       else
 #endif
-        std::cout << prepend << "\t+?" << std::endl;
+        *output_stream << prepend << "\t+?" << std::endl;
 
 #ifdef WINDOWS
       if (!pipe_output)
         hfst_fprintf_console(stdout, "\n");
       else
 #endif
-        std::cout << std::endl;
+        *output_stream << std::endl;
 
       return;
     }
@@ -1748,7 +1897,7 @@ void TransducerWUniq::printAnalyses(std::string prepend)
             hfst_fprintf_console(stdout, "%s\t", prepend.c_str());
           else
 #endif
-            std::cout << prepend << "\t";
+            *output_stream << prepend << "\t";
         }
 
 #ifdef WINDOWS
@@ -1756,7 +1905,7 @@ void TransducerWUniq::printAnalyses(std::string prepend)
             hfst_fprintf_console(stdout, "%s", (*display_it).second.c_str());
           else
 #endif
-            std::cout << (*display_it).second;
+            *output_stream << (*display_it).second;
 
       if (displayWeightsFlag)
         {
@@ -1765,7 +1914,7 @@ void TransducerWUniq::printAnalyses(std::string prepend)
             hfst_fprintf_console("\t%f", (*display_it).first);
           else
 #endif
-            std::cout << '\t' << (*display_it).first;
+            *output_stream << '\t' << (*display_it).first;
         }
 
 #ifdef WINDOWS
@@ -1773,7 +1922,7 @@ void TransducerWUniq::printAnalyses(std::string prepend)
         hfst_fprintf_console(stdout, "\n");
       else
 #endif
-        std::cout << std::endl;
+        *output_stream << std::endl;
 
       ++display_it;
       ++i;
@@ -1785,7 +1934,7 @@ void TransducerWUniq::printAnalyses(std::string prepend)
         hfst_fprintf_console(stdout, "\n");
       else
 #endif
-        std::cout << std::endl;
+        *output_stream << std::endl;
 }
 
 void TransducerWFdUniq::printAnalyses(std::string prepend)
@@ -1797,14 +1946,14 @@ void TransducerWFdUniq::printAnalyses(std::string prepend)
         hfst_fprintf_console(stdout, "%s\t+?", prepend);
       else
 #endif
-        std::cout << prepend << "\t+?" << std::endl;
+        *output_stream << prepend << "\t+?" << std::endl;
 
 #ifdef WINDOWS
       if (!pipe_output)
         hfst_fprintf_console(stdout, "\n");
       else
 #endif
-        std::cout << std::endl;
+        *output_stream << std::endl;
 
       return;
     }
@@ -1831,7 +1980,7 @@ void TransducerWFdUniq::printAnalyses(std::string prepend)
             hfst_fprintf_console(stdout, "%s\t", prepend);
           else
 #endif
-            std::cout << prepend << "\t";
+            *output_stream << prepend << "\t";
         }
 
 #ifdef WINDOWS
@@ -1839,7 +1988,7 @@ void TransducerWFdUniq::printAnalyses(std::string prepend)
         hfst_fprintf_console("%s", (*display_it).second);
       else
 #endif
-        std::cout << (*display_it).second;
+        *output_stream << (*display_it).second;
 
       if (displayWeightsFlag)
         {
@@ -1848,7 +1997,7 @@ void TransducerWFdUniq::printAnalyses(std::string prepend)
             hfst_fprintf("\t%f", (*display_it).first);
           else
 #endif
-            std::cout << '\t' << (*display_it).first;
+            *output_stream << '\t' << (*display_it).first;
         }
 
 #ifdef WINDOWS
@@ -1856,7 +2005,7 @@ void TransducerWFdUniq::printAnalyses(std::string prepend)
             hfst_fprintf_console("\n");
           else
 #endif
-            std::cout << std::endl;
+            *output_stream << std::endl;
     }
   display_map.clear();
 
@@ -1865,7 +2014,7 @@ void TransducerWFdUniq::printAnalyses(std::string prepend)
     hfst_fprintf_console("\n");
   else
 #endif
-    std::cout << std::endl;
+    *output_stream << std::endl;
 }
 
 void TransducerW::get_analyses(SymbolNumber * input_symbol,
@@ -1876,16 +2025,9 @@ void TransducerW::get_analyses(SymbolNumber * input_symbol,
 #if OL_FULL_DEBUG
   std::cerr << "get analyses " << i << " " << current_weight << std::endl;
 #endif
-  if (time_cutoff > 0.0) {
-      // Check to see if time has been overspent. For speed, only check every
-      // million calls and set a flag.
-      ++call_counter;
-      if (limit_reached ||
-          (call_counter % 1000000 == 0 &&
-           ((((double) clock() - start_clock) / CLOCKS_PER_SEC) > time_cutoff))) {
-          limit_reached = true;
-          return;
-      }
+  // Check to see if time has been overspent
+  if (deadline.expired()) {
+      return;
   }
   if (i >= TRANSITION_TARGET_TABLE_START )
     {
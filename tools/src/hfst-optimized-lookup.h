@@ -47,8 +47,12 @@ const char * PACKAGE_STRING = "hfst-optimized-lookup 1.2";
 #include <ctime>
 #include <iostream>
 #include <string>
+#include <unordered_map>
 #include <time.h>
 
+#include "HfstDeadline.h"
+#include "HfstClockCache.h"
+
 enum OutputType {HFST, xerox};
 OutputType outputType = xerox;
 
@@ -60,10 +64,9 @@ bool echoInputsFlag = false;
 bool beFast = false;
 int maxAnalyses = INT_MAX;
 bool preserveDiacriticRepresentationsFlag = false;
-bool limit_reached = false;
-unsigned long call_counter = 0;
 double time_cutoff = 0.0;
-clock_t start_clock;
+unsigned int threads = 1;
+size_t cache_size = 0;
 
 #define MAX_IO_STRING 5000
 
@@ -344,6 +347,40 @@ int setup(FILE * f);
 typedef std::vector<std::string> DisplayVector;
 typedef std::set<std::string> DisplaySet;
 
+// Remembers the printed analyses of recent input lines, at most
+// capacity of them, and counts how often it is asked.
+class AnalysisCache
+{
+private:
+    hfst::HfstClockCache<std::string> outputs;
+public:
+    unsigned long hits;
+    unsigned long misses;
+
+    AnalysisCache(size_t c):
+        outputs(c), hits(0), misses(0)
+        {}
+
+    // the output of input, or NULL if it isn't cached
+    const std::string * find(const std::string & input)
+        {
+            const std::string * output = outputs.find(input);
+            if (output == NULL)
+            {
+                ++misses;
+            } else {
+                ++hits;
+            }
+            return output;
+        }
+
+    const std::string & insert(const std::string & input,
+                               const std::string & output)
+        {
+            return outputs.insert(input, output);
+        }
+};
+
 class TransitionIndex
 {
 protected:
@@ -550,6 +587,12 @@ protected:
     TransitionIndexVector &indices;
   
     TransitionVector &transitions;
+
+    // for --time-cutoff
+    hfst::HfstDeadline deadline;
+
+    // where the analyses are printed
+    std::ostream * output_stream;
   
     void set_symbol_table(void);
 
@@ -604,7 +647,8 @@ public:
         display_vector(),
         output_string((SymbolNumber*)(malloc(2000))),
         indices(index_reader()),
-        transitions(transition_reader())
+        transitions(transition_reader()),
+        output_stream(&std::cout)
         {
             for (int i = 0; i < 1000; ++i)
             {
@@ -613,6 +657,27 @@ public:
             set_symbol_table();
         }
 
+    // A copy shares the tables with t but has its own lookup state,
+    // so copies can analyze in different threads.
+    Transducer(const Transducer & t):
+        header(t.header),
+        alphabet(t.alphabet),
+        keys(t.keys),
+        index_reader(t.index_reader),
+        transition_reader(t.transition_reader),
+        encoder(t.encoder),
+        display_vector(),
+        output_string((SymbolNumber*)(malloc(2000))),
+        symbol_table(t.symbol_table),
+        indices(index_reader()),
+        transitions(transition_reader()),
+        output_stream(t.output_stream)
+        {
+            for (int i = 0; i < 1000; ++i)
+            {
+                output_string[i] = NO_SYMBOL_NUMBER;
+            }
+        }
     
     KeyTable * get_key_table(void)
         {
@@ -626,9 +691,20 @@ public:
 
     void analyze(SymbolNumber * input_string)
         {
+            deadline.start(time_cutoff);
             get_analyses(input_string,output_string,output_string,START_INDEX);
         }
 
+    std::ostream & get_output_stream(void)
+        {
+            return *output_stream;
+        }
+
+    void set_output_stream(std::ostream & os)
+        {
+            output_stream = &os;
+        }
+
     virtual void printAnalyses(std::string prepend);
 };
 
@@ -935,6 +1011,12 @@ protected:
 
     Weight current_weight;
 
+    // for --time-cutoff
+    hfst::HfstDeadline deadline;
+
+    // where the analyses are printed
+    std::ostream * output_stream;
+
     void set_symbol_table(void);
 
     virtual void try_epsilon_transitions(SymbolNumber * input_symbol,
@@ -996,7 +1078,8 @@ public:
         output_string((SymbolNumber*)(malloc(2000))),
         indices(index_reader()),
         transitions(transition_reader()),
-        current_weight(0.0)
+        current_weight(0.0),
+        output_stream(&std::cout)
         {
             for (int i = 0; i < 1000; ++i)
             {
@@ -1005,6 +1088,29 @@ public:
             set_symbol_table();
         }
 
+    // A copy shares the tables with t but has its own lookup state,
+    // so copies can analyze in different threads.
+    TransducerW(const TransducerW & t):
+        header(t.header),
+        alphabet(t.alphabet),
+        keys(t.keys),
+        index_reader(t.index_reader),
+        transition_reader(t.transition_reader),
+        encoder(t.encoder),
+        display_map(),
+        output_string((SymbolNumber*)(malloc(2000))),
+        symbol_table(t.symbol_table),
+        indices(index_reader()),
+        transitions(transition_reader()),
+        current_weight(0.0),
+        output_stream(t.output_stream)
+        {
+            for (int i = 0; i < 1000; ++i)
+            {
+                output_string[i] = NO_SYMBOL_NUMBER;
+            }
+        }
+
     KeyTable * get_key_table(void)
         {
             return keys;
@@ -1012,9 +1118,20 @@ public:
 
     void analyze(SymbolNumber * input_string)
         {
+            deadline.start(time_cutoff);
             get_analyses(input_string,output_string,output_string,START_INDEX);
         }
 
+    std::ostream & get_output_stream(void)
+        {
+            return *output_stream;
+        }
+
+    void set_output_stream(std::ostream & os)
+        {
+            output_stream = &os;
+        }
+
 
     SymbolNumber find_next_key(char ** p)
         {
@@ -28,6 +28,10 @@
 
 #include <iostream>
 #include <fstream>
+#include <algorithm>
+#include <map>
+#include <set>
+#include <vector>
 
 #include <cstdio>
 #include <cstdlib>
@@ -46,6 +50,7 @@
 
 #include "HfstStrings2FstTokenizer.h"
 #include "HfstSymbolDefs.h"
+#include "HfstThreadPool.h"
 
 static char*  pair_test_file_name;
 static FILE*  pair_test_file;
@@ -53,16 +58,19 @@ static size_t linen = 0;
 static bool   pair_test_given = false;
 static bool   positive_test = true;
 static bool   xerox_mode = false;
+static unsigned int threads = 1;
+
+// how many pair strings each thread tests at a time
+static const size_t PAIR_STRINGS_PER_THREAD = 1024;
 
 using hfst::HfstInputStream;
 using hfst::HfstTransducer;
 using hfst::implementations::HfstBasicTransducer;
 using hfst::implementations::HfstState;
-using hfst::implementations::HfstBasicTransition;
 using hfst::TROPICAL_OPENFST_TYPE;
 using hfst::ImplementationType;
+using hfst::HfstThreadPool;
 
-typedef std::vector<HfstBasicTransducer> BasicTransducerVector;
 typedef std::vector<std::string> StringVector;
 typedef std::set<std::string> SymbolSet;
 
@@ -88,7 +96,8 @@ print_usage()
 
     fprintf(message_out, "Pair test options:\n"
             "  -I, --input-strings=SFILE        Read pair test strings from\n"
-        "                                   SFILE\n");
+        "                                   SFILE\n"
+            "  -T, --threads=N                  Test N pair strings at a time\n");
     fprintf(message_out, "\n");
     fprintf(message_out,
         "If SFILE is missing, the test pair strings are read from STDIN.\n"
@@ -167,12 +176,13 @@ parse_options(int argc, char** argv)
             {"input-strings", required_argument, 0, 'I'},
             {"negative-test", no_argument, 0, 'N'},
             {"xerox-mode", no_argument, 0, 'X'},
+            {"threads", required_argument, 0, 'T'},
             {0,0,0,0}
         };
         int option_index = 0;
         // add tool-specific options here 
         char c = getopt_long(argc, argv, HFST_GETOPT_COMMON_SHORT
-                             HFST_GETOPT_UNARY_SHORT "I:Nx",
+                             HFST_GETOPT_UNARY_SHORT "I:NxT:",
                              long_options, &option_index);
         if (-1 == c)
         {
@@ -195,6 +205,14 @@ parse_options(int argc, char** argv)
         case 'X':
         xerox_mode = true;
         break;
+        case 'T':
+            if (atoi(optarg) < 1)
+            {
+                std::cerr << "Invalid argument for --threads\n";
+                return EXIT_FAILURE;
+            }
+            threads = (unsigned int)atoi(optarg);
+            break;
 #include "inc/getopt-cases-error.h"
         }
     }
@@ -216,83 +234,209 @@ parse_options(int argc, char** argv)
     return EXIT_CONTINUE;
 }
 
-HfstState get_target(const std::string &isymbol,
-             const std::string &osymbol,
-             HfstState s,const HfstBasicTransducer &t,
-             const SymbolSet &known_symbols)
+static const unsigned int NO_STATE = (unsigned int)-1;
+static const unsigned int NO_PAIR = (unsigned int)-1;
+
+//! A symbol pair of a pair string, numbered for the rule tables.
+struct TestPair
 {
-  HfstState identity_target = -1;
+  //! The number of the pair, or NO_PAIR if no rule has it.
+  unsigned int pair;
+  //! Whether the identity transitions of the rules match the pair.
+  bool identity;
+};
 
-  for (HfstBasicTransducer::HfstTransitions::const_iterator it = t[s].begin();
-       it != t[s].end();
-       ++it)
+typedef std::vector<TestPair> TestPairVector;
+
+//! The rules of a grammar as tables for testing pair strings.
+//!
+//! The symbol pairs of all rules are numbered together and the transitions
+//! of each state are sorted by pair number, so a pair string is numbered
+//! once and each step of a rule is a binary search. The rules are run in
+//! lockstep over the pair string, which tells in one pass whether each
+//! rule accepts it and where the others run out of transitions. Testing
+//! does not change the tables, so several threads can test at once.
+class PairTestGrammar
+{
+ public:
+  //! Add the rule @a t named @a name.
+  void add_rule(const HfstBasicTransducer &t, const std::string &name);
+
+  //! Set the symbols that identity transitions do not match.
+  void set_known_symbols(const SymbolSet &symbols)
+  { known_symbols = symbols; }
+
+  //! The number of rules.
+  size_t size() const
+  { return rules.size(); }
+
+  //! The name of rule @a rule.
+  const std::string &get_name(size_t rule) const
+  { return rules[rule].name; }
+
+  //! The pairs of @a pair_string as numbered for the rules.
+  TestPairVector number(const StringPairVector &pair_string) const;
+
+  //! Run all rules over @a pair_string. Set @a stops[r] to the number of
+  //! pairs rule r read before it ran out of transitions and @a accepted[r]
+  //! to whether it accepts @a pair_string.
+  void run(const TestPairVector &pair_string,
+           std::vector<size_t> &stops,
+           std::vector<bool> &accepted) const;
+
+ protected:
+  struct Arc
+  {
+    unsigned int pair;
+    unsigned int target;
+    bool operator<(const Arc &another) const
+    { return pair < another.pair; }
+  };
+
+  struct Rule
+  {
+    std::string name;
+    // the arcs of state s are arcs[first_arcs[s]] ... arcs[first_arcs[s+1]-1]
+    std::vector<unsigned int> first_arcs;
+    std::vector<Arc> arcs;
+    // the target of the identity transition of each state or NO_STATE
+    std::vector<unsigned int> identity_targets;
+    std::vector<bool> finals;
+
+    unsigned int step(unsigned int s, const TestPair &pair) const;
+  };
+
+  std::vector<Rule> rules;
+  std::map<StringPair, unsigned int> pair_numbers;
+  SymbolSet known_symbols;
+};
+
+void PairTestGrammar::add_rule(const HfstBasicTransducer &t,
+                               const std::string &name)
+{
+  rules.push_back(Rule());
+  Rule &rule = rules.back();
+  rule.name = name;
+
+  HfstState s = 0;
+  for (HfstBasicTransducer::const_iterator it = t.begin(); it != t.end();
+       ++it, ++s)
     {
-      if (it->get_input_symbol() == isymbol and 
-      it->get_output_symbol() == osymbol)
-    { return it->get_target_state(); }
-      if (it->get_input_symbol() == "@_IDENTITY_SYMBOL_@" and
-      it->get_output_symbol() == "@_IDENTITY_SYMBOL_@")
-    { identity_target = it->get_target_state(); }
-    }
+      rule.first_arcs.push_back(rule.arcs.size());
+      rule.identity_targets.push_back(NO_STATE);
+      rule.finals.push_back(t.is_final_state(s));
+
+      for (HfstBasicTransducer::HfstTransitions::const_iterator jt =
+             it->begin();
+           jt != it->end();
+           ++jt)
+        {
+          if (jt->get_input_symbol() == "@_IDENTITY_SYMBOL_@" and
+              jt->get_output_symbol() == "@_IDENTITY_SYMBOL_@")
+            {
+              rule.identity_targets.back() = jt->get_target_state();
+              continue;
+            }
+
+          StringPair pair(jt->get_input_symbol(),jt->get_output_symbol());
+          std::map<StringPair, unsigned int>::const_iterator number =
+            pair_numbers.find(pair);
+          if (number == pair_numbers.end())
+            {
+              unsigned int new_number = pair_numbers.size();
+              number = pair_numbers.insert
+                (std::make_pair(pair,new_number)).first;
+            }
+
+          Arc arc;
+          arc.pair = number->second;
+          arc.target = jt->get_target_state();
+          rule.arcs.push_back(arc);
+        }
 
-  if 
-    (isymbol == osymbol and known_symbols.find(isymbol) == known_symbols.end())
-    { return identity_target; }
-  else
-    { return -1; }
+      std::stable_sort
+        (rule.arcs.begin() + rule.first_arcs.back(),rule.arcs.end());
+    }
+  rule.first_arcs.push_back(rule.arcs.size());
 }
 
-bool is_final_state(HfstState s,const HfstBasicTransducer &t)
-{ return t.is_final_state(s); }
-
-int test(const StringPairVector &tokenized_pair_string,
-     const HfstBasicTransducer &t,
-     bool positive,
-     FILE * outfile,
-     const SymbolSet &known_symbols)
+TestPairVector PairTestGrammar::number
+(const StringPairVector &pair_string) const
 {
-  HfstState s = 0;
-  for (StringPairVector::const_iterator it = tokenized_pair_string.begin();
-       it != tokenized_pair_string.end();
+  TestPairVector numbers;
+  numbers.reserve(pair_string.size());
+  for (StringPairVector::const_iterator it = pair_string.begin();
+       it != pair_string.end();
        ++it)
     {
-      s = get_target(it->first,it->second,s,t,known_symbols);
-      if (s == (unsigned int)-1)
-    { 
-      if (positive)
-        { return 1; }
-      else
-        { return 0; }
-    }
+      TestPair pair;
+      std::map<StringPair, unsigned int>::const_iterator number =
+        pair_numbers.find(*it);
+      pair.pair = (number == pair_numbers.end() ? NO_PAIR : number->second);
+      pair.identity = it->first == it->second and
+        known_symbols.find(it->first) == known_symbols.end();
+      numbers.push_back(pair);
     }
+  return numbers;
+}
 
-  if (is_final_state(s,t) and positive)
-    { return 0; }
-  else if (positive)
-    { return 1; }
-  else if (not is_final_state(s,t))
-    { return 0; }
-  else 
-    { return 1; }
+unsigned int PairTestGrammar::Rule::step(unsigned int s,
+                                         const TestPair &pair) const
+{
+  std::vector<Arc>::const_iterator begin = arcs.begin() + first_arcs[s];
+  std::vector<Arc>::const_iterator end = arcs.begin() + first_arcs[s + 1];
+
+  Arc key;
+  key.pair = pair.pair;
+  std::vector<Arc>::const_iterator it = std::lower_bound(begin,end,key);
+  if (it != end and it->pair == pair.pair)
+    { return it->target; }
+  if (pair.identity)
+    { return identity_targets[s]; }
+  return NO_STATE;
 }
 
-HfstTransducer get_transducer(const StringPairVector &tokenized_pair_string)
+void PairTestGrammar::run(const TestPairVector &pair_string,
+                          std::vector<size_t> &stops,
+                          std::vector<bool> &accepted) const
 {
-  HfstBasicTransducer t;
-  HfstState s = 0;
-  for (StringPairVector::const_iterator it = tokenized_pair_string.begin();
-       it != tokenized_pair_string.end();
-       ++it)
+  std::vector<unsigned int> states(rules.size(),0);
+  stops.assign(rules.size(),pair_string.size());
+  size_t running = rules.size();
+
+  for (size_t i = 0; i < pair_string.size() and running > 0; ++i)
     {
-      HfstState target = t.add_state();
-      t.add_transition
-    (s,HfstBasicTransition(target,it->first,it->second,0.0));
-      s = target;
+      for (size_t r = 0; r < rules.size(); ++r)
+        {
+          if (states[r] == NO_STATE)
+            { continue; }
+          states[r] = rules[r].step(states[r],pair_string[i]);
+          if (states[r] == NO_STATE)
+            {
+              stops[r] = i;
+              --running;
+            }
+        }
     }
-  t.set_final_weight(s,0.0);
-  return HfstTransducer(t,TROPICAL_OPENFST_TYPE);
+
+  accepted.resize(rules.size());
+  for (size_t r = 0; r < rules.size(); ++r)
+    { accepted[r] = states[r] != NO_STATE and rules[r].finals[states[r]]; }
 }
 
+//! A pair string to test and what is printed about it.
+struct PairTest
+{
+  //! The input line, announced in verbose mode, or empty.
+  std::string line;
+  //! The pair string as it is printed in the results.
+  std::string pair_string;
+  StringPairVector pairs;
+  bool positive;
+  std::string output;
+  int exit_code;
+};
+
 std::string unescape(std::string symbol)
 {
   if (hfst::is_epsilon(symbol))
@@ -302,116 +446,91 @@ std::string unescape(std::string symbol)
   return symbol;
 }
 
-void print_recognized_prefix(const StringPairVector &tokenized_pair_string,
-                 const HfstBasicTransducer &str_transducer,
-                 const std::string &name,
-                 FILE * outfile,
-                 const SymbolSet &known_symbols)
+void append_pairs(std::string &output,
+                  StringPairVector::const_iterator begin,
+                  StringPairVector::const_iterator end)
 {
-  if (silent)
-    { return; }
-
-  fprintf(outfile,"Rule %s fails:\n",name.c_str());
-
-  HfstState s = 0;
-  StringPairVector::const_iterator it = tokenized_pair_string.begin();
-  for ( ; it != tokenized_pair_string.end(); ++it)
+  for (StringPairVector::const_iterator it = begin; it != end; ++it)
     {
-      s = get_target(it->first,it->second.c_str(),s,str_transducer,
-             known_symbols);
-
-      if (s == (unsigned int)-1)
-    { break; }
-
-      if (it->first == it->second)
-    { fprintf(outfile,"%s ",unescape(it->first).c_str()); }
-      else
-    { fprintf(outfile,"%s:%s ",unescape(it->first).c_str(),
-          unescape(it->second).c_str()); }
-
+      output += unescape(it->first);
+      if (it->first != it->second)
+        { output += ":" + unescape(it->second); }
+      output += " ";
     }
-  
-  fprintf(outfile,"HERE ---> ");
-
-  for ( ; it != tokenized_pair_string.end(); ++it)
-    {
-      if (it->first == it->second)
-    { fprintf(outfile,"%s ",unescape(it->first).c_str()); }
-      else
-    { fprintf(outfile,"%s:%s ",unescape(it->first).c_str(),
-          unescape(it->second).c_str()); }
-    }
-  fprintf(outfile,"\n\n");
-}
-
-void print_failure_info(const StringPairVector &tokenized_pair_string,
-            const HfstBasicTransducer &t,const std::string &name,
-            FILE * outfile,
-            const SymbolSet &known_symbols)
-{
-  HfstTransducer str_transducer = get_transducer(tokenized_pair_string);
-  HfstTransducer tt(t,TROPICAL_OPENFST_TYPE);
-  str_transducer.input_project().compose(tt).minimize();
-  print_recognized_prefix(tokenized_pair_string,str_transducer,name,outfile,
-              known_symbols);
 }
 
-int test(const StringPairVector &tokenized_pair_string,
-     const std::string pair_string,
-     const BasicTransducerVector &grammar,
-     const StringVector &names,
-     bool positive,
-     FILE * outfile,
-     const SymbolSet &known_symbols)
+void test(PairTest &pair_test,
+          const PairTestGrammar &grammar,
+          std::vector<size_t> &stops,
+          std::vector<bool> &accepted)
 {
-  int positive_exit_code = 0;
-  int negative_exit_code = 1;
+  grammar.run(grammar.number(pair_test.pairs),stops,accepted);
 
-  size_t ind = 0;
-
-  for (BasicTransducerVector::const_iterator it = grammar.begin();
-       it != grammar.end();
-       ++it)
+  bool all_accept = true;
+  for (size_t r = 0; r < grammar.size(); ++r)
     {
-      int new_exit_code = test(tokenized_pair_string,*it,positive,outfile,
-                   known_symbols);
-
-      if (positive and new_exit_code == 1)
-    { print_failure_info
-        (tokenized_pair_string,*it,names.at(ind),outfile,known_symbols); }
-      
-      if (positive and positive_exit_code == 0)
-    { positive_exit_code = new_exit_code; }
-      
-      if (not positive and negative_exit_code == 1)
-    { negative_exit_code = new_exit_code; }
-
-      ++ind;
+      if (accepted[r])
+        { continue; }
+      all_accept = false;
+
+      if (pair_test.positive and not silent)
+        {
+          StringPairVector::const_iterator here =
+            pair_test.pairs.begin() + stops[r];
+          pair_test.output += "Rule " + grammar.get_name(r) + " fails:\n";
+          append_pairs(pair_test.output,pair_test.pairs.begin(),here);
+          pair_test.output += "HERE ---> ";
+          append_pairs(pair_test.output,here,pair_test.pairs.end());
+          pair_test.output += "\n\n";
+        }
     }
 
-  if (positive)
+  if (pair_test.positive)
     {
-      if (positive_exit_code == 1 and not silent)
-    { 
-      fprintf(outfile,"FAIL: %s REJECTED\n\n",pair_string.c_str()); 
-    }
-      if (positive_exit_code == 0 and verbose)
-    { 
-      fprintf(outfile,"%s PASSED\n\n",pair_string.c_str()); }
-      return positive_exit_code;
+      pair_test.exit_code = all_accept ? 0 : 1;
+      if (not all_accept and not silent)
+        { pair_test.output += "FAIL: " + pair_test.pair_string
+            + " REJECTED\n\n"; }
+      if (all_accept and verbose)
+        { pair_test.output += pair_test.pair_string + " PASSED\n\n"; }
     }
   else
     {
-      if (negative_exit_code == 1 and not silent)
-    { 
-      fprintf(outfile,"FAIL: %s PASSED\n\n",pair_string.c_str()); 
+      pair_test.exit_code = all_accept ? 1 : 0;
+      if (all_accept and not silent)
+        { pair_test.output += "FAIL: " + pair_test.pair_string
+            + " PASSED\n\n"; }
+      if (not all_accept and verbose)
+        { pair_test.output += pair_test.pair_string + " REJECTED\n\n"; }
     }
-      if (negative_exit_code == 0 and verbose)
-    { 
-      fprintf(outfile,"%s REJECTED\n\n",pair_string.c_str()); }
-      return negative_exit_code;
+}
+
+//! Test the pair strings of @a tests in @a pool, print the results in
+//! order and clear @a tests. Return 1 if a test failed and 0 otherwise.
+int run_tests(std::vector<PairTest> &tests,
+              const PairTestGrammar &grammar,
+              HfstThreadPool &pool,
+              FILE * outfile)
+{
+  std::vector<std::vector<size_t> > stops(pool.size());
+  std::vector<std::vector<bool> > accepted(pool.size());
+  pool.run(tests.size(),
+           [&](unsigned int thread, size_t i)
+           { test(tests[i],grammar,stops[thread],accepted[thread]); });
+
+  int exit_code = 0;
+  for (std::vector<PairTest>::const_iterator it = tests.begin();
+       it != tests.end();
+       ++it)
+    {
+      if (not it->line.empty())
+        { verbose_printf("Pair test on %s...\n", it->line.c_str()); }
+      fputs(it->output.c_str(),outfile);
+      if (exit_code == 0)
+        { exit_code = it->exit_code; }
     }
-  return 1;
+  tests.clear();
+  return exit_code;
 }
 
 std::string demangle(std::string name)
@@ -475,8 +594,8 @@ bool is_negative_test_line(const std::string &line)
 int
 process_stream(HfstInputStream& inputstream, FILE* outstream)
 {
-    BasicTransducerVector grammar;
-    StringVector rule_names;
+    PairTestGrammar grammar;
+    SymbolSet known_symbols;
 
     // Read transducers in rule file.
     size_t transducer_n=0;
@@ -494,22 +613,30 @@ process_stream(HfstInputStream& inputstream, FILE* outstream)
           }
         HfstTransducer trans(inputstream);
     rule_transducer_type = trans.get_type();
-        grammar.push_back(trans);
-    rule_names.push_back(demangle(trans.get_name()));
+        HfstBasicTransducer rule(trans);
+        if (transducer_n == 1)
+          { get_symbols(rule,known_symbols); }
+        grammar.add_rule(rule,demangle(trans.get_name()));
       }
 
     inputstream.close();
 
-    SymbolSet known_symbols;
-    if (not grammar.empty())
+    if (grammar.size() > 0)
       {
     verbose_printf("Defining known symbols.\n");
-    get_symbols(grammar[0],known_symbols);
     for (SymbolSet::const_iterator it = known_symbols.begin();
          it != known_symbols.end();
          ++it)
       { verbose_printf("Symbol %s\n",it->c_str()); }
       }
+    grammar.set_known_symbols(known_symbols);
+
+    HfstThreadPool pool(threads);
+    std::vector<PairTest> tests;
+    // With one thread each pair string is tested and printed as soon as
+    // it has been read.
+    size_t batch_size =
+      threads == 1 ? 1 : PAIR_STRINGS_PER_THREAD * pool.size();
 
     char* line = 0;
     size_t llen = 0;
@@ -540,29 +667,28 @@ process_stream(HfstInputStream& inputstream, FILE* outstream)
               }
             if (is_empty_or_comment(line))
               { continue; }
-            verbose_printf("Pair test on %s...\n", line);
-            
-            int new_exit_code = 0;
             
+            PairTest pair_test;
+            pair_test.line = line;
+            pair_test.pair_string = line;
+            pair_test.positive = positive_test;
             try
               {
-                StringPairVector tokenized_pair_string =
+                pair_test.pairs =
                   input_tokenizer.tokenize_pair_string(line,true);
                 
-                tokenized_pair_string.insert
-                  (tokenized_pair_string.begin(),
+                pair_test.pairs.insert
+                  (pair_test.pairs.begin(),
                    StringPair("@#@",hfst::internal_epsilon));
-                tokenized_pair_string.insert
-                  (tokenized_pair_string.end(),
+                pair_test.pairs.insert
+                  (pair_test.pairs.end(),
                    StringPair("@#@",hfst::internal_epsilon));
-                
-                new_exit_code = 
-                  test(tokenized_pair_string,line,grammar,rule_names,
-                       positive_test,outfile,known_symbols);
-                
               }
             catch (const hfst::UnescapedColsFound &e)
               {
+                // report the lines before this one first
+                run_tests(tests,grammar,pool,outfile);
+                verbose_printf("Pair test on %s...\n", line);
                 error(EXIT_FAILURE, 0, 
                       "The correspondence %s contains unquoted colon-symbols. If "
                       "you want to input pairs where either symbol is epsilon, "
@@ -570,13 +696,20 @@ process_stream(HfstInputStream& inputstream, FILE* outstream)
                       line);
                 
               }
+            tests.push_back(pair_test);
             
-            
-            if (exit_code == 0)
-              { exit_code = new_exit_code; }
-            
+            if (tests.size() == batch_size)
+              {
+                int new_exit_code = run_tests(tests,grammar,pool,outfile);
+                if (exit_code == 0)
+                  { exit_code = new_exit_code; }
+              }
           } // while lines in input
         free(line); 
+
+        int new_exit_code = run_tests(tests,grammar,pool,outfile);
+        if (exit_code == 0)
+          { exit_code = new_exit_code; }
       }
     else
       {
@@ -657,19 +790,12 @@ process_stream(HfstInputStream& inputstream, FILE* outstream)
             const std::string &input_case = positive_test_cases[i];
             const std::string &output_case = positive_test_cases[i + 1];
 
-            StringPairVector test_case = input_tokenizer.tokenize_string_pair
+            PairTest pair_test;
+            pair_test.pairs = input_tokenizer.tokenize_string_pair
               (input_case + ":" + output_case, false);
-            
-            int new_exit_code = test(test_case,
-                                     input_case + " : " + output_case,
-                                     grammar,
-                                     rule_names,
-                                     true,
-                                     outfile,
-                                     known_symbols);
-            
-            if (exit_code == 0)
-              { exit_code = new_exit_code; }
+            pair_test.pair_string = input_case + " : " + output_case;
+            pair_test.positive = true;
+            tests.push_back(pair_test);
           }
 
         for (int i = 0; i < negative_test_cases.size(); i += 2)
@@ -677,20 +803,15 @@ process_stream(HfstInputStream& inputstream, FILE* outstream)
             const std::string &input_case = negative_test_cases[i];
             const std::string &output_case = negative_test_cases[i + 1];
 
-            StringPairVector test_case = input_tokenizer.tokenize_string_pair
+            PairTest pair_test;
+            pair_test.pairs = input_tokenizer.tokenize_string_pair
               (input_case + ":" + output_case, false);
-            
-            int new_exit_code = test(test_case,
-                                     input_case + " : " + output_case,
-                                     grammar,
-                                     rule_names,
-                                     false,
-                                     outfile,
-                                     known_symbols);
-            
-            if (exit_code == 0)
-              { exit_code = new_exit_code; }
+            pair_test.pair_string = input_case + " : " + output_case;
+            pair_test.positive = false;
+            tests.push_back(pair_test);
           }
+
+        exit_code = run_tests(tests,grammar,pool,outfile);
       }
 
     return exit_code;
@@ -24,6 +24,7 @@
 
 #include <iostream>
 #include <fstream>
+#include <sstream>
 
 #include <vector>
 #include <map>
@@ -51,16 +52,23 @@ using std::pair;
 #include "hfst-commandline.h"
 #include "hfst-program-options.h"
 #include "hfst-tool-metadata.h"
+#include "HfstThreadPool.h"
 #include "implementations/optimized-lookup/pmatch.h"
 
 #include "inc/globals-common.h"
 #include "inc/globals-unary.h"
 
+using hfst::HfstThreadPool;
+
 static bool blankline_separated = true;
 static bool extract_tags = false;
 static bool locate_mode = false;
 static double time_cutoff = 0.0;
 static bool profile = false;
+static unsigned int threads = 1;
+// how many inputs to read for each thread before matching them
+static const size_t INPUTS_PER_THREAD = 256;
+static unsigned long inputs_matched = 0;
 std::string pmatch_filename;
 
 void
@@ -76,7 +84,8 @@ print_usage()
             "  -x  --extract-tags     Only print tagged parts in output\n"
             "  -l  --locate           Only print locations of matches\n"
             "  -t, --time-cutoff=S    Limit search after having used S seconds per input\n"
-            "  -p  --profile          Produce profiling data\n");
+            "  -p  --profile          Produce profiling data\n"
+            "  -T, --threads=N        Match N inputs at a time in parallel\n");
     fprintf(message_out, 
             "Use standard streams for input and output.\n"
             "\n"
@@ -88,7 +97,7 @@ print_usage()
     fprintf(message_out, "\n");
 }
 
-void match_and_print(hfst_ol::PmatchContainer & container,
+void match_and_print(hfst_ol::PmatchSession & session,
                 std::ostream & outstream,
                 std::string & input_text)
 {
@@ -98,12 +107,12 @@ void match_and_print(hfst_ol::PmatchContainer & container,
     }
     if (!locate_mode) {
 #ifndef _MSC_VER
-        outstream << container.match(input_text, time_cutoff);
+        outstream << session.match(input_text, time_cutoff);
 #else
-        hfst::hfst_fprintf(stdout, "%s", container.match(input_text, time_cutoff).c_str());
+        hfst::hfst_fprintf(stdout, "%s", session.match(input_text, time_cutoff).c_str());
 #endif
     } else {
-        hfst_ol::LocationVectorVector locations = container.locate(input_text, time_cutoff);
+        hfst_ol::LocationVectorVector locations = session.locate(input_text, time_cutoff);
         for(hfst_ol::LocationVectorVector::const_iterator it = locations.begin();
             it != locations.end(); ++it) {
             if (it->at(0).output.compare("@_NONMATCHING_@") != 0) {
@@ -119,10 +128,68 @@ void match_and_print(hfst_ol::PmatchContainer & container,
     outstream << std::endl;
 }
 
+// Match the queued inputs on all the threads, each thread with a session
+// of its own, and print the results in the original order.
+void match_in_parallel(HfstThreadPool & pool,
+                       std::vector<hfst_ol::PmatchSession *> & sessions,
+                       std::vector<std::string> & queue,
+                       std::ostream & outstream)
+{
+    std::vector<std::string> results(queue.size());
+    std::vector<std::string> messages(queue.size());
+    unsigned long first_input = inputs_matched;
+    pool.run(queue.size(),
+             [&](unsigned int thread, size_t i)
+             {
+                 std::ostringstream result;
+                 std::ostringstream message_stream;
+                 // for verbose messages, which give the input number
+                 sessions[thread]->line_number = first_input + i;
+                 sessions[thread]->messages = &message_stream;
+                 match_and_print(*sessions[thread], result, queue[i]);
+                 sessions[thread]->messages = &std::cerr;
+                 results[i] = result.str();
+                 messages[i] = message_stream.str();
+             });
+    for (size_t i = 0; i < results.size(); ++i) {
+        if (!messages[i].empty()) {
+            // keep them in place when both go to the same terminal
+            outstream.flush();
+            std::cerr << messages[i];
+        }
+        outstream << results[i];
+    }
+    inputs_matched += queue.size();
+    queue.clear();
+}
+
+// With one thread, match and print input_text right away. Otherwise queue
+// it and match the queue once there's enough input for all the threads.
+void match_or_queue(HfstThreadPool & pool,
+                    std::vector<hfst_ol::PmatchSession *> & sessions,
+                    std::vector<std::string> & queue,
+                    std::ostream & outstream,
+                    std::string & input_text)
+{
+    if (pool.size() == 1) {
+        match_and_print(*sessions[0], outstream, input_text);
+        return;
+    }
+    queue.push_back(input_text);
+    if (queue.size() >= INPUTS_PER_THREAD * pool.size()) {
+        match_in_parallel(pool, sessions, queue, outstream);
+    }
+}
 
 int process_input(hfst_ol::PmatchContainer & container,
                   std::ostream & outstream)
 {
+    HfstThreadPool pool(threads);
+    std::vector<hfst_ol::PmatchSession *> sessions;
+    for (unsigned int t = 0; t < pool.size(); ++t) {
+        sessions.push_back(new hfst_ol::PmatchSession(container));
+    }
+    std::vector<std::string> queue;
     std::string input_text;
     char * line = NULL;
     size_t len = 0;
@@ -142,9 +209,9 @@ int process_input(hfst_ol::PmatchContainer & container,
         if (!blankline_separated) {
             // newline separated
             input_text = line;
-            match_and_print(container, outstream, input_text);
+            match_or_queue(pool, sessions, queue, outstream, input_text);
         } else if (line[0] == '\n') {
-            match_and_print(container, outstream, input_text);
+            match_or_queue(pool, sessions, queue, outstream, input_text);
             input_text.clear();
         } else {
             input_text.append(line);
@@ -154,10 +221,16 @@ int process_input(hfst_ol::PmatchContainer & container,
     }
     
     if (blankline_separated && !input_text.empty()) {
-        match_and_print(container, outstream, input_text);
+        match_or_queue(pool, sessions, queue, outstream, input_text);
+    }
+    if (!queue.empty()) {
+        match_in_parallel(pool, sessions, queue, outstream);
     }
     if (profile) {
-        outstream << "\n" << container.get_profiling_info() << "\n";
+        outstream << "\n" << sessions[0]->get_profiling_info() << "\n";
+    }
+    for (unsigned int t = 0; t < sessions.size(); ++t) {
+        delete sessions[t];
     }
     return EXIT_SUCCESS;
 }
@@ -177,10 +250,11 @@ int parse_options(int argc, char** argv)
                 {"locate", no_argument, 0, 'l'},
                 {"time-cutoff", required_argument, 0, 't'},
                 {"profile", no_argument, 0, 'p'},
+                {"threads", required_argument, 0, 'T'},
                 {0,0,0,0}
             };
         int option_index = 0;
-        char c = getopt_long(argc, argv, HFST_GETOPT_COMMON_SHORT "nxlt:p",
+        char c = getopt_long(argc, argv, HFST_GETOPT_COMMON_SHORT "nxlt:pT:",
                              long_options, &option_index);
         if (-1 == c)
         {
@@ -211,6 +285,14 @@ int parse_options(int argc, char** argv)
         case 'p':
             profile = true;
             break;
+        case 'T':
+            if (atoi(optarg) < 1)
+            {
+                std::cerr << "Invalid argument for --threads\n";
+                return EXIT_FAILURE;
+            }
+            threads = (unsigned int)atoi(optarg);
+            break;
 #include "inc/getopt-cases-error.h"
         }
 
@@ -257,6 +339,20 @@ int main(int argc, char ** argv)
     if (retval != EXIT_CONTINUE) {
         return retval;
     }
+#ifdef _MSC_VER
+    // Output goes straight to the console, so it can't be collected from
+    // the threads and put in order
+    if (threads > 1) {
+        std::cerr << "Warning: --threads is not supported on Windows, "
+            "using one thread\n";
+        threads = 1;
+    }
+#endif
+    if (threads > 1 && profile) {
+        std::cerr << "Warning: profiling counts one thread only, "
+            "using one thread\n";
+        threads = 1;
+    }
     std::ifstream instream(pmatch_filename.c_str(),
                            std::ifstream::binary);
     if (!instream.good()) {
@@ -73,6 +73,7 @@ static char *epsilonname=NULL;
 static bool disjunct_expressions=false;
 static bool line_separated = false;
 static bool flatten = false;
+static unsigned int threads = 1;
 static clock_t timer;
 
 #if HAVE_OPENFST
@@ -96,7 +97,9 @@ print_usage()
     print_common_unary_program_options(message_out); 
     fprintf(message_out, "String and format options:\n"
             "  -e, --epsilon=EPS         Map EPS as zero\n"
-            "      --flatten             Compile in all RTNs\n");
+            "      --flatten             Compile in all RTNs\n"
+            "  -T, --threads=N           Harmonize and minimize N transducers\n"
+            "                            at a time\n");
     fprintf(message_out, "\n");
 
     fprintf(message_out, 
@@ -129,11 +132,12 @@ parse_options(int argc, char** argv)
                 HFST_GETOPT_UNARY_LONG,
                 {"epsilon", required_argument, 0, 'e'},
                 {"flatten", no_argument, 0, '1'},
+                {"threads", required_argument, 0, 'T'},
                 {0,0,0,0}
             };
         int option_index = 0;
         char c = getopt_long(argc, argv, HFST_GETOPT_COMMON_SHORT
-                             HFST_GETOPT_UNARY_SHORT "e:1:",
+                             HFST_GETOPT_UNARY_SHORT "e:1:T:",
                              long_options, &option_index);
         if (-1 == c)
         {
@@ -150,6 +154,14 @@ parse_options(int argc, char** argv)
         case '1':
             flatten = true;
             break;
+        case 'T':
+            if (atoi(optarg) < 1)
+            {
+                error(EXIT_FAILURE, 0,
+                      "invalid argument for --threads: '%s'", optarg);
+            }
+            threads = (unsigned int)atoi(optarg);
+            break;
 #include "inc/getopt-cases-error.h"
         }
     }
@@ -165,6 +177,7 @@ process_stream(HfstOutputStream& outstream)
     PmatchCompiler comp(compilation_format);
     comp.set_verbose(verbose);
     comp.set_flatten(flatten);
+    comp.set_threads(threads);
     std::string file_contents;
     std::map<std::string, HfstTransducer*> definitions;
     int c;
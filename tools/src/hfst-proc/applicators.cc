@@ -91,13 +91,13 @@ AnalysisApplicator::apply()
     if(printDebuggingInformationFlag)
     {
       if(next_token.type == Symbol)
-        std::cout << "Got symbol #" << next_token.symbol << "(" << transducer.get_alphabet().symbol_to_string(next_token.symbol) << ")" << std::endl;
+        debug_stream() << "Got symbol #" << next_token.symbol << "(" << transducer.get_alphabet().symbol_to_string(next_token.symbol) << ")" << std::endl;
       else if(next_token.type == Character)
-        std::cout << "Got non-symbolic character '" << next_token.character << "'" << (token_stream.is_space(next_token)?" (space)":"") << std::endl;
+        debug_stream() << "Got non-symbolic character '" << next_token.character << "'" << (token_stream.is_space(next_token)?" (space)":"") << std::endl;
       else if(next_token.type == Superblank)
-        std::cout << "Got superblank " << token_stream.get_superblank(next_token.superblank_index) << std::endl;
+        debug_stream() << "Got superblank " << token_stream.get_superblank(next_token.superblank_index) << std::endl;
       else if(next_token.type == ReservedCharacter)
-        std::cout << "Got reserved character '" << next_token.character << "'" << std::endl;
+        debug_stream() << "Got reserved character '" << next_token.character << "'" << std::endl;
     }
     if(next_token.type == ReservedCharacter)
       stream_error(std::string("Found unexpected character ")+next_token.character+" unescaped in stream");
@@ -118,13 +118,13 @@ AnalysisApplicator::apply()
           last_stream_location = token_stream.get_pos()-1;
           
           if(printDebuggingInformationFlag)
-            std::cout << "Final paths (" << finals.size() << ") found and saved, stream location is " << last_stream_location << std::endl;
+            debug_stream() << "Final paths (" << finals.size() << ") found and saved, stream location is " << last_stream_location << std::endl;
         }
         
         state.step(token_stream.to_symbol(next_token), caps_mode);
     
     if(printDebuggingInformationFlag)
-      std::cout << "After stepping, there are " << state.num_active() << " active paths" << std::endl;
+      debug_stream() << "After stepping, there are " << state.num_active() << " active paths" << std::endl;
     
     if(state.is_active())
     {
@@ -172,8 +172,8 @@ AnalysisApplicator::apply()
                          next_token_is_part_of_word ? 0 : 1;
           
           if(printDebuggingInformationFlag)
-            std::cout << "word_length=" << word_length << ", surface_form.size()=" << surface_form.size() 
-                      << ", moving back " << revert_count << " characters" << std::endl;
+            debug_stream() << "word_length=" << word_length << ", surface_form.size()=" << surface_form.size() 
+                           << ", moving back " << revert_count << " characters" << std::endl;
           
           formatter.print_unknown_word(TokenVector(surface_form.begin(),
                                                 surface_form.begin()+word_length));
@@ -198,7 +198,9 @@ AnalysisApplicator::apply()
   }
   
   if(verboseFlag)
-    std::cout << std::endl << "Got None/EOF symbol; done." << std::endl;
+    debug_stream() << std::endl << "Got None/EOF symbol; done." << std::endl;
+  
+  between_words = surface_form.empty();
   
   // print any valid transductions stored
   if(analyzed_forms.size() != 0)// && token_stream.get_pos() == last_stream_location)
@@ -279,7 +281,7 @@ GenerationApplicator::apply()
             invariant = invariant.substr(0, invariant.length()-1);
             token_stream.write_escaped(invariant);
             if(printDebuggingInformationFlag)
-              std::cout << std::endl << "Invariant: '" << invariant << "'" << std::endl;
+              debug_stream() << std::endl << "Invariant: '" << invariant << "'" << std::endl;
           }
         }
       }
@@ -325,7 +327,7 @@ GenerationApplicator::lookup(const TokenVector& tokens, bool generate_on_fail)
     LookupPathSet finals = state.get_finals_set();
     
     if(printDebuggingInformationFlag)
-            std::cout << "Generated " << finals.size() << " forms" << std::endl;
+            debug_stream() << "Generated " << finals.size() << " forms" << std::endl;
     
     token_stream.put_symbols((*finals.begin())->get_output_symbols(),capitalization_state);
     if(finals.size() > 1)
@@ -29,6 +29,12 @@ class Applicator
   virtual ~Applicator() {}
   
   virtual void apply() = 0;
+  
+  /**
+   * Whether the last call to apply() stopped between two words. If it did,
+   * any input that would have followed can be processed on its own
+   */
+  virtual bool ended_between_words() const {return true;}
 };
 
 /**
@@ -48,11 +54,13 @@ class AnalysisApplicator: public Applicator
  private:
   OutputFormatter& formatter;
   CapitalizationMode caps_mode;
+  bool between_words;
  public:
   AnalysisApplicator(const ProcTransducer& t, TokenIOStream& ts,
                      OutputFormatter& o, CapitalizationMode c):
-    Applicator(t,ts), formatter(o), caps_mode(c) {}
+    Applicator(t,ts), formatter(o), caps_mode(c), between_words(true) {}
   void apply();
+  bool ended_between_words() const {return between_words;}
 };
 
 class GenerationApplicator: public Applicator
@@ -55,7 +55,7 @@ OutputFormatter::filter_compound_analyses(LookupPathSet& finals) const
       it++;
       finals.erase(to_delete);
       if(printDebuggingInformationFlag)
-        std::cout << "Filtering compound analysis with " << boundary_counts[i] << " boundary(s)" << std::endl;
+        debug_stream() << "Filtering compound analysis with " << boundary_counts[i] << " boundary(s)" << std::endl;
     }
     else
       it++;
@@ -77,7 +77,7 @@ OutputFormatter::preprocess_finals(const LookupPathSet& finals) const
     if(printDebuggingInformationFlag)
     {
             if(goodcmp_finals.size() < finals.size()) {
-        std::cout << "Filtered " << finals.size()-goodcmp_finals.size() << " compound analyses" << std::endl;
+        debug_stream() << "Filtered " << finals.size()-goodcmp_finals.size() << " compound analyses" << std::endl;
             }
     }
   }
@@ -158,7 +158,7 @@ ApertiumOutputFormatter::print_word(const TokenVector& surface_form,
   }
 
   if(printDebuggingInformationFlag)
-    std::cout << "surface_form consists of " << output_surface_form.size() << " tokens" << std::endl;
+    debug_stream() << "surface_form consists of " << output_surface_form.size() << " tokens" << std::endl;
 
   token_stream.ostream() << '^';
   token_stream.write_escaped(output_surface_form);
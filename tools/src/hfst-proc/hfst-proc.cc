@@ -21,7 +21,10 @@
 #include "../inc/globals-common.h"
 
 #include <fstream>
+#include <sstream>
+#include <exception>
 #include <cstdlib>
+#include "HfstThreadPool.h"
 #include "hfst-proc.h"
 #include "transducer.h"
 #include "formatter.h"
@@ -40,6 +43,43 @@ bool processCompounds = false;
 bool rawMode = false;
 bool displayRawAnalysisInCG = false;
 
+// the messages of the chunk this thread is processing in threaded mode
+static thread_local std::ostream* chunk_messages = NULL;
+
+std::ostream& debug_stream()
+{
+  return chunk_messages != NULL ? *chunk_messages : std::cout;
+}
+
+// how many chunks of the input each thread gets at a time in threaded mode
+static const size_t CHUNKS_PER_THREAD = 4;
+// a chunk ends at the first safe boundary after this many bytes
+static const size_t CHUNK_SIZE = 65536;
+
+/**
+ * The options that decide which applicator and output formatter are used,
+ * so that the threaded mode can make them for each chunk of the input
+ */
+struct ApplicatorOptions
+{
+  int cmd;
+  int output_type;
+  bool filter_compound_analyses;
+  CapitalizationMode capitalization_mode;
+};
+
+/**
+ * The output of processing a chunk of the input on its own
+ */
+struct ChunkResult
+{
+  std::string output;
+  // the verbose and debugging messages, written to std::cout
+  std::string messages;
+  bool between_words;
+  std::exception_ptr error;
+};
+
 static bool handle_hfst3_header(std::istream& is)
 {
   const char* header1 = "HFST";
@@ -99,12 +139,214 @@ void stream_error(const char* e)
 void stream_error(std::string e) {stream_error(e.c_str());}
 
 
+/**
+ * Make the applicator chosen by the options, and the output formatter it
+ * uses if any. The caller owns both
+ */
+static Applicator* make_applicator(const ProcTransducer& t,
+                                   TokenIOStream& token_stream,
+                                   const ApplicatorOptions& options,
+                                   OutputFormatter*& output_formatter)
+{
+  output_formatter = NULL;
+  switch(options.cmd)
+  {
+    case 't':
+      return new TokenizationApplicator(t, token_stream);
+    case 'g':
+      return new GenerationApplicator(t, token_stream, gm_unknown, options.capitalization_mode);
+    case 'n':
+      return new GenerationApplicator(t, token_stream, gm_clean, options.capitalization_mode);
+    case 'd':
+      return new GenerationApplicator(t, token_stream, gm_all, options.capitalization_mode);
+    case 'a':
+    default:
+      switch(options.output_type)
+      {
+        case 'C':
+          output_formatter = (OutputFormatter*)new CGOutputFormatter(token_stream, options.filter_compound_analyses);
+          break;
+        case 'x':
+          output_formatter = (OutputFormatter*)new XeroxOutputFormatter(token_stream, options.filter_compound_analyses);
+          break;
+        default:
+          output_formatter = (OutputFormatter*)new ApertiumOutputFormatter(token_stream, options.filter_compound_analyses);
+      }
+      return new AnalysisApplicator(t, token_stream, *output_formatter, options.capitalization_mode);
+  }
+}
+
+/**
+ * Whether the input can be split after newlines and superblanks, ie. no
+ * symbol of the transducer longer than one character contains one of them
+ */
+static bool can_split_input(const ProcTransducer& t)
+{
+  const SymbolTable& symbols = t.get_alphabet().get_symbol_table();
+  for(SymbolTable::const_iterator it=symbols.begin(); it!=symbols.end(); it++)
+  {
+    if(it->size() > 1 && it->find_first_of("\n[]") != std::string::npos)
+      return false;
+  }
+  return true;
+}
+
+/**
+ * Read at most count chunks of the input. A chunk ends at the first newline
+ * or superblank after CHUNK_SIZE bytes that is not escaped or inside a word
+ * form or another superblank, so the chunk is tokenized the same way as it
+ * would be as a part of the whole input
+ * @return whether there may be more input
+ */
+static bool read_chunks(std::istream& is, std::vector<std::string>& chunks,
+                        size_t count)
+{
+  chunks.clear();
+  std::string chunk;
+  bool escaped = false, in_superblank = false, in_word = false;
+  int c;
+  while((c = is.get()) != EOF)
+  {
+    chunk += (char)c;
+    bool boundary = false;
+    if(escaped)
+      escaped = false;
+    else if(c == '\\')
+      escaped = true;
+    else if(in_superblank)
+    {
+      if(c == ']')
+      {
+        in_superblank = false;
+        boundary = !in_word;
+      }
+    }
+    else if(c == '[')
+      in_superblank = true;
+    else if(c == '^')
+      in_word = true;
+    else if(c == '$')
+      in_word = false;
+    else if(c == '\n')
+      boundary = !in_word;
+    
+    if(boundary && chunk.size() >= CHUNK_SIZE)
+    {
+      chunks.push_back(chunk);
+      chunk.clear();
+      if(chunks.size() == count)
+        return true;
+    }
+  }
+  if(!chunk.empty())
+    chunks.push_back(chunk);
+  return false;
+}
+
+/**
+ * Process text on its own, as if it were the whole input
+ */
+static void process_chunk(const ProcTransducer& t,
+                          const ApplicatorOptions& options,
+                          const std::string& text, ChunkResult& result)
+{
+  std::istringstream is(text);
+  std::ostringstream os;
+  std::ostringstream messages;
+  chunk_messages = &messages;
+  TokenIOStream token_stream(is, os, t.get_alphabet(), false, rawMode);
+  OutputFormatter* output_formatter = NULL;
+  Applicator* applicator = make_applicator(t, token_stream, options,
+                                           output_formatter);
+  result.error = std::exception_ptr();
+  try
+  {
+    applicator->apply();
+    result.between_words = applicator->ended_between_words();
+  }
+  catch (std::exception&)
+  {
+    result.error = std::current_exception();
+  }
+  delete applicator;
+  if(output_formatter != NULL)
+    delete output_formatter;
+  chunk_messages = NULL;
+  result.output = os.str();
+  result.messages = messages.str();
+}
+
+/**
+ * Process the input in chunks on the given number of threads, writing the
+ * same output as processing it in one go. A chunk gives the same output on
+ * its own as in the whole input if the input before it ended between two
+ * words. Otherwise it is processed again together with the input before it
+ */
+static void apply_threaded(const ProcTransducer& t,
+                           const ApplicatorOptions& options,
+                           std::istream& input, std::ostream& output,
+                           unsigned int threads)
+{
+  hfst::HfstThreadPool pool(threads);
+  std::vector<std::string> chunks;
+  std::vector<ChunkResult> results;
+  // input whose output is not written yet, because it ended inside a word
+  std::string pending;
+  bool more_input = true;
+  while(more_input)
+  {
+    more_input = read_chunks(input, chunks, threads*CHUNKS_PER_THREAD);
+    if(!pending.empty())
+    {
+      if(chunks.empty())
+        chunks.push_back(pending);
+      else
+        chunks[0] = pending + chunks[0];
+      pending.clear();
+    }
+    results.resize(chunks.size());
+    pool.run(chunks.size(),
+             [&](unsigned int thread, size_t i)
+             {
+               process_chunk(t, options, chunks[i], results[i]);
+             });
+    
+    for(size_t i=0; i<chunks.size(); i++)
+    {
+      if(!pending.empty())
+      {
+        pending += chunks[i];
+        process_chunk(t, options, pending, results[i]);
+      }
+      else
+        pending.swap(chunks[i]);
+      
+      const ChunkResult& result = results[i];
+      bool last = !more_input && i+1 == chunks.size();
+      if(result.error)
+      {
+        std::cout << result.messages;
+        output << result.output;
+        output.flush();
+        std::rethrow_exception(result.error);
+      }
+      if(result.between_words || last)
+      {
+        std::cout << result.messages;
+        output << result.output;
+        pending.clear();
+      }
+    }
+  }
+  output.flush();
+}
+
 bool print_usage(void)
 {
   std::cout <<
     "\n" <<
     "Usage: hfst-proc " <<
-    "[-a [-p|-C|-x] [-k]|-g|-n|-d|-t] [-W] [-n N] [-c|-w] [-z] [-v|-q|]\n" <<
+    "[-a [-p|-C|-x] [-k]|-g|-n|-d|-t] [-W] [-n N] [-c|-w] [-z] [-T N] [-v|-q|]\n" <<
     "    transducer_file [input_file [output_file]]\n" <<
     "Perform a transducer lookup on a text stream, tokenizing on the fly\n" <<
     "Transducer must be in HFST optimized lookup format\n" <<
@@ -131,6 +373,8 @@ bool print_usage(void)
     "  -w  --dictionary-case   Output results using dictionary case instead of\n" <<
     "                          surface case\n" <<
     "  -z  --null-flush        Flush output on the null character\n" <<
+    "  -T, --threads=N         Analyse or generate on N threads, in chunks that end\n" <<
+    "                          at newlines and superblanks\n" <<
     "  -v, --verbose           Be verbose\n" <<
     "  -q, --quiet             Don't be verbose (default)\n" <<
     "  -V, --version           Print version information\n" <<
@@ -172,6 +416,7 @@ int main(int argc, char **argv)
   int capitalization = 0;
   bool filter_compound_analyses = true;
   bool null_flush = false;
+  unsigned int threads = 1;
   
   while (true)
   {
@@ -203,11 +448,12 @@ int main(int argc, char **argv)
       {"dictionary-case",no_argument,       0, 'w'},
       {"null-flush",     no_argument,       0, 'z'},
       {"raw",            no_argument,       0, 'X'},
+      {"threads",        required_argument, 0, 'T'},
       {0,                0,                 0,  0 }
     };
     
     int option_index = 0;
-    int c = getopt_long(argc, argv, "hVvqsagndtpxCkeWrN:l:cwzX", long_options, &option_index);
+    int c = getopt_long(argc, argv, "hVvqsagndtpxCkeWrN:l:cwzXT:", long_options, &option_index);
 
     if (c == -1) // no more options to look at
       break;
@@ -320,6 +566,15 @@ int main(int argc, char **argv)
       null_flush = true;
       break;
       
+    case 'T':
+      if (atoi(optarg) < 1)
+        {
+          std::cerr << "Invalid or no argument for thread count\n";
+          return EXIT_FAILURE;
+        }
+      threads = (unsigned int)atoi(optarg);
+      break;
+      
     default:
       std::cerr << "Invalid option\n\n";
       print_short_help();
@@ -428,44 +683,35 @@ int main(int argc, char **argv)
     in.close();
     TokenIOStream token_stream(*input, *output, t.get_alphabet(), null_flush,
                                rawMode);
-    Applicator* applicator = NULL;
-    OutputFormatter* output_formatter = NULL;
-    switch(cmd)
+    ApplicatorOptions options;
+    options.cmd = cmd;
+    options.output_type = output_type;
+    options.filter_compound_analyses = filter_compound_analyses;
+    options.capitalization_mode = capitalization_mode;
+    
+    if(threads > 1 && (cmd == 't' || null_flush || !can_split_input(t)))
     {
-      case 't':
-        applicator = new TokenizationApplicator(t, token_stream);
-        break;
-      case 'g':
-        applicator = new GenerationApplicator(t, token_stream, gm_unknown, capitalization_mode);
-        break;
-      case 'n':
-        applicator = new GenerationApplicator(t, token_stream, gm_clean, capitalization_mode);
-        break;
-      case 'd':
-        applicator = new GenerationApplicator(t, token_stream, gm_all, capitalization_mode);
-        break;
-      case 'a':
-      default:
-        switch(output_type)
-        {
-          case 'C':
-            output_formatter = (OutputFormatter*)new CGOutputFormatter(token_stream, filter_compound_analyses);
-            break;
-          case 'x':
-            output_formatter = (OutputFormatter*)new XeroxOutputFormatter(token_stream, filter_compound_analyses);
-            break;
-          default:
-            output_formatter = (OutputFormatter*)new ApertiumOutputFormatter(token_stream, filter_compound_analyses);
-        }
-        applicator = new AnalysisApplicator(t, token_stream, *output_formatter, capitalization_mode);
-        break;
+      if(!silentFlag)
+        std::cerr << "hfst-proc: warning: --threads is not supported with "
+                  << "--tokenize or --null-flush, or with symbols containing "
+                  << "newlines or brackets; using one thread" << std::endl;
+      threads = 1;
     }
     
-    applicator->apply();
-    
-    delete applicator;
-    if(output_formatter != NULL)
-      delete output_formatter;
+    if(threads > 1)
+      apply_threaded(t, options, *input, *output, threads);
+    else
+    {
+      OutputFormatter* output_formatter = NULL;
+      Applicator* applicator = make_applicator(t, token_stream, options,
+                                               output_formatter);
+      
+      applicator->apply();
+      
+      delete applicator;
+      if(output_formatter != NULL)
+        delete output_formatter;
+    }
   }
   catch (std::exception& e)
   {
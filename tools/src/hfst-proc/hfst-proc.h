@@ -57,6 +57,13 @@ extern bool displayRawAnalysisInCG;
 // the following flags are only meaningful with certain debugging #defines
 extern bool printDebuggingInformationFlag;
 
+/**
+ * The stream for the verbose and debugging messages written while the input
+ * is processed: std::cout, or in threaded mode a buffer of the chunk the
+ * calling thread is processing, written out in the order of the input
+ */
+std::ostream& debug_stream();
+
 enum GenerationMode
 {
   gm_clean,      // clear all
@@ -12,6 +12,18 @@
 
 #include "lookup-path.h"
 
+//////////Function definitions for class PathArena
+
+SymbolNumberVector
+PathArena::get_symbols(size_t node) const
+{
+  SymbolNumberVector symbols;
+  for(; node != EMPTY; node = nodes[node].parent)
+    symbols.push_back(nodes[node].symbol);
+  std::reverse(symbols.begin(), symbols.end());
+  return symbols;
+}
+
 //////////Function definitions for class LookupPath
 
 void
@@ -35,7 +47,7 @@ LookupPath::follow(const Transition& transition)
     final = transducer.get_transition(index).final();
 
   if(transducer.get_alphabet().symbol_to_string(transition.get_output_symbol()) != "")
-    output_symbols.push_back(transition.get_output_symbol());
+    output_node = arena->extend(output_node, transition.get_output_symbol());
 
   return true;
 }
@@ -43,7 +55,9 @@ LookupPath::follow(const Transition& transition)
 bool
 LookupPath::operator<(const LookupPath& o) const
 {
-  return output_symbols < o.output_symbols;
+  if(output_node == o.output_node)
+    return false;
+  return get_output_symbols() < o.get_output_symbols();
 }
 
 
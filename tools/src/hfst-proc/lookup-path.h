@@ -17,6 +17,54 @@
 #include "transducer.h"
 #include "HfstFlagDiacritics.h"
 
+/**
+ * Stores the output symbols of lookup paths as a tree. Each node holds the
+ * last output symbol of a path and the node of the path it was extended
+ * from, so paths that branch from a common path share its output and
+ * extending a path does not copy anything. Nodes are never freed one by one;
+ * the whole arena is cleared when a new lookup starts.
+ */
+class PathArena
+{
+ private:
+  struct Node
+  {
+    SymbolNumber symbol;
+    size_t parent;
+  };
+  
+  /**
+   * The first node stands for the empty output and is never used otherwise
+   */
+  std::vector<Node> nodes;
+  
+ public:
+  static const size_t EMPTY = 0;
+  
+  PathArena(): nodes(1) {}
+  
+  /**
+   * Get rid of all the nodes. Any paths using the arena are invalidated
+   */
+  void clear() {nodes.resize(1);}
+  
+  /**
+   * Add a node for the output of the node at parent followed by symbol
+   * @return the new node
+   */
+  size_t extend(const size_t parent, const SymbolNumber symbol)
+  {
+    Node n = {symbol, parent};
+    nodes.push_back(n);
+    return nodes.size()-1;
+  }
+  
+  /**
+   * Get the output symbols of the path ending at the given node
+   */
+  SymbolNumberVector get_symbols(size_t node) const;
+};
+
 /**
  * Represents a (possibly partial) path through a transducer. This is used
  * during lookup for storing lookup paths that are continued as input symbols
@@ -42,16 +90,25 @@ class LookupPath
   bool final;
   
   /**
-   * The output symbols of the transitions this path has followed
+   * The arena holding the output symbols of the path
+   */
+  PathArena* arena;
+  
+  /**
+   * The node in the arena for the output symbols of the transitions this
+   * path has followed
    */
-  SymbolNumberVector output_symbols;
+  size_t output_node;
   
  public:
-  LookupPath(const ProcTransducer& t, const TransitionTableIndex initial): 
-    transducer(t), index(initial), final(false), output_symbols() {}
+  LookupPath(const ProcTransducer& t, const TransitionTableIndex initial,
+             PathArena& a): 
+    transducer(t), index(initial), final(false), arena(&a),
+    output_node(PathArena::EMPTY) {}
   
   LookupPath(const LookupPath& o):
-    transducer(o.transducer), index(o.index), final(o.final), output_symbols(o.output_symbols) {}
+    transducer(o.transducer), index(o.index), final(o.final), arena(o.arena),
+    output_node(o.output_node) {}
   
   virtual ~LookupPath() {}
   
@@ -78,7 +135,18 @@ class LookupPath
   
   TransitionTableIndex get_index() const {return index;}
   bool at_final() const {return final;}
-  const SymbolNumberVector& get_output_symbols() const {return output_symbols;}
+  SymbolNumberVector get_output_symbols() const
+  {return arena->get_symbols(output_node);}
+  
+  /**
+   * Move the path to another arena holding a copy of the nodes of its own
+   */
+  void set_arena(PathArena& a) {arena = &a;}
+  
+  /**
+   * The summed weight of the path, zero unless the path is weighted
+   */
+  virtual Weight get_weight() const {return 0.0f;}
 };
 
 typedef std::set<LookupPath*, bool (*)(LookupPath*,LookupPath*)> LookupPathSet;
@@ -109,8 +177,9 @@ class PathFd
 class LookupPathFd : public LookupPath, PathFd
 {
  public:
-  LookupPathFd(const ProcTransducer& t, const TransitionTableIndex initial):
-    LookupPath(t, initial), PathFd(t.get_alphabet().get_fd_table()) {}
+  LookupPathFd(const ProcTransducer& t, const TransitionTableIndex initial,
+               PathArena& a):
+    LookupPath(t, initial, a), PathFd(t.get_alphabet().get_fd_table()) {}
   LookupPathFd(const LookupPathFd& o): LookupPath(o), PathFd(o) {}
   
   virtual LookupPath* clone() const {return new LookupPathFd(*this);}
@@ -134,8 +203,9 @@ class LookupPathW : public LookupPath
    */
   Weight final_weight;
  public:
-  LookupPathW(const ProcTransducer& t, const TransitionTableIndex initial): 
-        LookupPath(t, initial), weight(0.0f), final_weight(0.0f) {}
+  LookupPathW(const ProcTransducer& t, const TransitionTableIndex initial,
+              PathArena& a): 
+        LookupPath(t, initial, a), weight(0.0f), final_weight(0.0f) {}
   LookupPathW(const LookupPathW& o): LookupPath(o), weight(o.weight),
     final_weight(o.final_weight) {}
   
@@ -144,15 +214,14 @@ class LookupPathW : public LookupPath
   virtual void follow(const TransitionIndex& index);
   virtual bool follow(const Transition& transition);
   
+  /**
+   * This sorts first by weight then by the value of the output symbols.
+   * Unweighted paths all have weight zero
+   */
   static bool compare_weights(LookupPath* p1, LookupPath* p2) {
-          LookupPathW* pw1 = dynamic_cast<LookupPathW*>(p1);
-          LookupPathW* pw2 = dynamic_cast<LookupPathW*>(p2);
-          if(pw1 != NULL && pw2 != NULL) {
-                  return (*pw1) < (*pw2);
-          }
-          else {
-                  return (*p1) < (*p2);
-          }
+          if(p1->get_weight() == p2->get_weight())
+                  return p1->LookupPath::operator<(*p2);
+          return p1->get_weight() < p2->get_weight();
   }
 
   /**
@@ -160,7 +229,7 @@ class LookupPathW : public LookupPath
    */
   virtual bool operator<(const LookupPathW& o) const;
   
-  Weight get_weight() const {return at_final() ? weight+final_weight : weight;}
+  virtual Weight get_weight() const {return at_final() ? weight+final_weight : weight;}
 };
 
 /**
@@ -169,8 +238,9 @@ class LookupPathW : public LookupPath
 class LookupPathWFd : public LookupPathW, PathFd
 {
  public:
-  LookupPathWFd(const ProcTransducer& t, const TransitionTableIndex initial):
-    LookupPathW(t, initial), PathFd(t.get_alphabet().get_fd_table()) {}
+  LookupPathWFd(const ProcTransducer& t, const TransitionTableIndex initial,
+                PathArena& a):
+    LookupPathW(t, initial, a), PathFd(t.get_alphabet().get_fd_table()) {}
   LookupPathWFd(const LookupPathWFd& o): LookupPathW(o), PathFd(o) {}
   
   virtual LookupPath* clone() const {return new LookupPathWFd(*this);}
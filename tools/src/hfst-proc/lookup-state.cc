@@ -38,10 +38,10 @@ LookupState::step(const SymbolNumber input, const SymbolNumber altinput)
   
   if(printDebuggingInformationFlag)
   {
-    std::cout << "Stepping with '" << transducer.get_alphabet().symbol_to_string(input) << "'";
+    debug_stream() << "Stepping with '" << transducer.get_alphabet().symbol_to_string(input) << "'";
     if(altinput != NO_SYMBOL_NUMBER)
-      std::cout << " and '" << transducer.get_alphabet().symbol_to_string(altinput) << "'";
-    std::cout << std::endl;
+      debug_stream() << " and '" << transducer.get_alphabet().symbol_to_string(altinput) << "'";
+    debug_stream() << std::endl;
   }
   
   apply_input(input, altinput);
@@ -113,7 +113,7 @@ const LookupPathSet
 LookupState::get_finals_set() const
 {
   if(printDebuggingInformationFlag)
-    std::cout << "Calculating final paths" << std::endl;
+    debug_stream() << "Calculating final paths" << std::endl;
   LookupPathSet finals(LookupPath::compare_pointers);
   for(LookupPathVector::const_iterator i=paths.begin(); i!=paths.end(); ++i)
   {
@@ -129,17 +129,18 @@ LookupState::get_finals_set() const
     {
       if(printDebuggingInformationFlag)
       {
-        std::cout << "  Final path found:";
-        for(SymbolNumberVector::const_iterator itr=(*i)->get_output_symbols().begin();itr!=(*i)->get_output_symbols().end(); itr++)
-          std::cout << " " << *itr;
-        std::cout << std::endl;
+        debug_stream() << "  Final path found:";
+        SymbolNumberVector output_symbols = (*i)->get_output_symbols();
+        for(SymbolNumberVector::const_iterator itr=output_symbols.begin();itr!=output_symbols.end(); itr++)
+          debug_stream() << " " << *itr;
+        debug_stream() << std::endl;
       }
       std::pair<LookupPathSet::iterator,bool> loc = finals.insert(*i);
       
       if(loc.second == false) // if this form was already in the set
       {
         if(printDebuggingInformationFlag)
-          std::cout << "  Duplicate LookupPath found" << std::endl;
+          debug_stream() << "  Duplicate LookupPath found" << std::endl;
         if(*i < *(loc.first)) // if this form has a lower weight than the one there
         {
           finals.erase(loc.first);
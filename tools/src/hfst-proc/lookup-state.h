@@ -33,6 +33,12 @@ class LookupState
    */
   LookupPathVector paths;
   
+  /**
+   * The output symbols of the paths. Paths that branch share the output
+   * they have in common, and the arena is cleared when the state is reset.
+   */
+  PathArena arena;
+  
   
   /**
    * Delete all active paths and clear the list
@@ -123,15 +129,19 @@ class LookupState
    * given transducer
    * @param t the transducer in which the lookup will occur
    */
-  LookupState(const ProcTransducer& t): transducer(t), paths()
+  LookupState(const ProcTransducer& t): transducer(t), paths(), arena()
   {
     reset();
   }
   
-  LookupState(const LookupState& o): transducer(o.transducer), paths()
+  LookupState(const LookupState& o): transducer(o.transducer), paths(),
+    arena(o.arena)
   {
     for(LookupPathVector::const_iterator it=o.paths.begin(); it!=o.paths.end(); it++)
+    {
       paths.push_back((*it)->clone());
+      paths.back()->set_arena(arena);
+    }
   }
   
   ~LookupState()
@@ -144,7 +154,9 @@ class LookupState
    */
   void reset()
   {
-    init(transducer.get_initial_path());
+    clear_paths();
+    arena.clear();
+    init(transducer.get_initial_path(arena));
   }
   
   /**
@@ -25,7 +25,7 @@ TokenIOStream::TokenIOStream(std::istream& i, std::ostream& o,
   symbolizer(a.get_symbolizer()), superblank_bucket(), token_buffer(1024)
 {
   if(printDebuggingInformationFlag)
-    std::cout << "Creating TokenIOStream" << std::endl;
+    debug_stream() << "Creating TokenIOStream" << std::endl;
   if(escaped_chars.size() == 0 && !is_raw)
     initialize_escaped_chars();
 }
@@ -20,10 +20,10 @@
 #include "formatter.h"
 
 
-static LookupPath* create_initial_path(const ProcTransducer& t) { return new LookupPath(t, 0);}
-static LookupPath* create_initial_path_fd(const ProcTransducer& t) { return new LookupPathFd(t, 0);}
-static LookupPath* create_initial_path_weighted(const ProcTransducer& t) { return new LookupPathW(t, 0);}
-static LookupPath* create_initial_path_weighted_fd(const ProcTransducer& t) { return new LookupPathWFd(t, 0);}
+static LookupPath* create_initial_path(const ProcTransducer& t, PathArena& a) { return new LookupPath(t, 0, a);}
+static LookupPath* create_initial_path_fd(const ProcTransducer& t, PathArena& a) { return new LookupPathFd(t, 0, a);}
+static LookupPath* create_initial_path_weighted(const ProcTransducer& t, PathArena& a) { return new LookupPathW(t, 0, a);}
+static LookupPath* create_initial_path_weighted_fd(const ProcTransducer& t, PathArena& a) { return new LookupPathWFd(t, 0, a);}
 
 //////////Function definitions for ProcTransducer
 
@@ -70,8 +70,8 @@ ProcTransducer::is_epsilon(const Transition& transition) const
 }
 
 LookupPath*
-ProcTransducer::get_initial_path() const
+ProcTransducer::get_initial_path(PathArena& arena) const
 {
-  return (*initial_path_creators[header->probe_flag(Weighted)][alphabet->has_flag_diacritics()])(*this);
+  return (*initial_path_creators[header->probe_flag(Weighted)][alphabet->has_flag_diacritics()])(*this, arena);
 }
 
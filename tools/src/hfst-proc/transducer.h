@@ -25,8 +25,9 @@
 using namespace hfst_ol;
 
 class ProcTransducer;
+class PathArena;
 
-typedef LookupPath* (*InitialPathCreator)(const ProcTransducer&);
+typedef LookupPath* (*InitialPathCreator)(const ProcTransducer&, PathArena&);
 
 class ProcTransducer : public Transducer
 {
@@ -46,9 +47,10 @@ class ProcTransducer : public Transducer
 
   /**
    * Create a new lookup path appropriate for initializing a lookup operation.
+   * @param arena the arena in which the path stores its output symbols
    * @return a new lookup path pointing to the beginning of the transducer
    */
-  LookupPath* get_initial_path() const;
+  LookupPath* get_initial_path(PathArena& arena) const;
 };
 
 #endif
@@ -52,6 +52,7 @@ using std::pair;
 #include "HfstInputStream.h"
 #include "HfstOutputStream.h"
 #include "implementations/HfstTransitionGraph.h"
+#include "implementations/HfstMinimalAcyclicBuilder.h"
 #include "hfst-commandline.h"
 #include "hfst-program-options.h"
 #include "hfst-tool-metadata.h"
@@ -64,6 +65,7 @@ using hfst::HfstOutputStream;
 using hfst::HfstTokenizer;
 using hfst::HfstTransducer;
 using hfst::implementations::HfstBasicTransducer;
+using hfst::implementations::HfstMinimalAcyclicBuilder;
 //using hfst::HfstInternalTransducer;
 //using hfst::implementations::HfstTrie;
 using hfst::StringPairVector;
@@ -266,7 +268,7 @@ process_stream(HfstOutputStream& outstream)
   char* line = 0;
   size_t len = 0;
   HfstTokenizer tok;
-  HfstBasicTransducer disjunction;
+  HfstMinimalAcyclicBuilder::WeightedPathVector disjunction;
   size_t line_n = 0;
 
   hfst::HfstStrings2FstTokenizer
@@ -376,13 +378,17 @@ process_stream(HfstOutputStream& outstream)
       else // disjunct all strings into a single transducer
         {
       // do not take negative logarithm yet
-          disjunction.disjunct(spv, path_weight);
+          disjunction.push_back(HfstMinimalAcyclicBuilder::WeightedPath
+                                (HfstMinimalAcyclicBuilder::to_numbers(spv),
+                                 path_weight));
         }
     }
   free(line);
   if (disjunct_strings)
     {
-      HfstTransducer res(disjunction, output_format);
+      // sort the strings and build the minimal transducer in one pass
+      HfstTransducer res(HfstMinimalAcyclicBuilder::build(disjunction),
+                         output_format);
 
       if (normalize_weights) 
         {
@@ -23,6 +23,7 @@
 
 #include <iostream>
 #include <fstream>
+#include <sstream>
 
 #include <vector>
 #include <map>
@@ -43,6 +44,7 @@ using std::pair;
 #include "hfst-commandline.h"
 #include "hfst-program-options.h"
 #include "hfst-tool-metadata.h"
+#include "HfstThreadPool.h"
 #include "implementations/optimized-lookup/pmatch.h"
 #include "HfstExceptionDefs.h"
 
@@ -54,6 +56,10 @@ static bool print_all = false;
 static bool print_weights = false;
 static bool tokenize_multichar = false;
 static double time_cutoff = 0.0;
+static unsigned int threads = 1;
+// how many inputs to read for each thread before tokenizing them
+static const size_t INPUTS_PER_THREAD = 256;
+static unsigned long inputs_matched = 0;
 std::string tokenizer_filename;
 enum OutputFormat {
     tokenize,
@@ -63,6 +69,7 @@ enum OutputFormat {
 };
 OutputFormat output_format = tokenize;
 
+using hfst::HfstThreadPool;
 using hfst_ol::Location;
 using hfst_ol::LocationVector;
 using hfst_ol::LocationVectorVector;
@@ -83,6 +90,7 @@ print_usage()
             "                         (by default only one utf-8 character is tokenized at a time\n"
             "                         regardless of what is present in the alphabet)\n"
             "  -t, --time-cutoff=S    Limit search after having used S seconds per input\n"
+            "  -T, --threads=N        Tokenize N inputs at a time in parallel\n"
             "  --segment              Segmenting / tokenization mode (default)\n"
             "  --xerox                Xerox output\n"
             "  --cg                   cg output\n"
@@ -214,7 +222,7 @@ void print_location_vector(LocationVector const & locations, std::ostream & outs
     outstream << std::endl;
 }
 
-void match_and_print(hfst_ol::PmatchContainer & container,
+void match_and_print(hfst_ol::PmatchSession & session,
                      std::ostream & outstream,
                      std::string & input_text)
 {
@@ -222,7 +230,7 @@ void match_and_print(hfst_ol::PmatchContainer & container,
         // Remove final newline
         input_text.erase(input_text.size() -1, 1);
     }
-    LocationVectorVector locations = container.locate(input_text, time_cutoff);
+    LocationVectorVector locations = session.locate(input_text, time_cutoff);
     if (locations.size() == 0 && print_all) {
         print_no_output(input_text, outstream);
     }
@@ -243,9 +251,69 @@ void match_and_print(hfst_ol::PmatchContainer & container,
 }
         
 
+// Tokenize the queued inputs on all the threads, each thread with a session
+// of its own, and print the results in the original order.
+void match_in_parallel(HfstThreadPool & pool,
+                       std::vector<hfst_ol::PmatchSession *> & sessions,
+                       std::vector<std::string> & queue,
+                       std::ostream & outstream)
+{
+    std::vector<std::string> results(queue.size());
+    std::vector<std::string> messages(queue.size());
+    unsigned long first_input = inputs_matched;
+    pool.run(queue.size(),
+             [&](unsigned int thread, size_t i)
+             {
+                 std::ostringstream result;
+                 std::ostringstream message_stream;
+                 // for verbose messages, which give the input number
+                 sessions[thread]->line_number = first_input + i;
+                 sessions[thread]->messages = &message_stream;
+                 match_and_print(*sessions[thread], result, queue[i]);
+                 sessions[thread]->messages = &std::cerr;
+                 results[i] = result.str();
+                 messages[i] = message_stream.str();
+             });
+    for (size_t i = 0; i < results.size(); ++i) {
+        if (!messages[i].empty()) {
+            // keep them in place when both go to the same terminal
+            outstream.flush();
+            std::cerr << messages[i];
+        }
+        outstream << results[i];
+    }
+    inputs_matched += queue.size();
+    queue.clear();
+}
+
+// With one thread, tokenize and print input_text right away. Otherwise
+// queue it and tokenize the queue once there's enough input for all the
+// threads.
+void match_or_queue(HfstThreadPool & pool,
+                    std::vector<hfst_ol::PmatchSession *> & sessions,
+                    std::vector<std::string> & queue,
+                    std::ostream & outstream,
+                    std::string & input_text)
+{
+    if (pool.size() == 1) {
+        match_and_print(*sessions[0], outstream, input_text);
+        return;
+    }
+    queue.push_back(input_text);
+    if (queue.size() >= INPUTS_PER_THREAD * pool.size()) {
+        match_in_parallel(pool, sessions, queue, outstream);
+    }
+}
+
 int process_input(hfst_ol::PmatchContainer & container,
                   std::ostream & outstream)
 {
+    HfstThreadPool pool(threads);
+    std::vector<hfst_ol::PmatchSession *> sessions;
+    for (unsigned int t = 0; t < pool.size(); ++t) {
+        sessions.push_back(new hfst_ol::PmatchSession(container));
+    }
+    std::vector<std::string> queue;
     std::string input_text;
     char * line = NULL;
     size_t len = 0;
@@ -253,9 +321,9 @@ int process_input(hfst_ol::PmatchContainer & container,
         if (!blankline_separated) {
             // newline separated
             input_text = line;
-            match_and_print(container, outstream, input_text);
+            match_or_queue(pool, sessions, queue, outstream, input_text);
         } else if (line[0] == '\n') {
-            match_and_print(container, outstream, input_text);
+            match_or_queue(pool, sessions, queue, outstream, input_text);
             input_text.clear();
         } else {
             input_text.append(line);
@@ -265,7 +333,13 @@ int process_input(hfst_ol::PmatchContainer & container,
     }
     
     if (blankline_separated && !input_text.empty()) {
-        match_and_print(container, outstream, input_text);
+        match_or_queue(pool, sessions, queue, outstream, input_text);
+    }
+    if (!queue.empty()) {
+        match_in_parallel(pool, sessions, queue, outstream);
+    }
+    for (unsigned int t = 0; t < sessions.size(); ++t) {
+        delete sessions[t];
     }
     return EXIT_SUCCESS;
 }
@@ -285,6 +359,7 @@ int parse_options(int argc, char** argv)
                 {"print-weights", no_argument, 0, 'w'},
                 {"tokenize-multichar", no_argument, 0, 'm'},
                 {"time-cutoff", required_argument, 0, 't'},
+                {"threads", required_argument, 0, 'T'},
                 {"segment", no_argument, 0, 'z'},
                 {"xerox", no_argument, 0, 'x'},
                 {"cg", no_argument, 0, 'c'},
@@ -292,7 +367,7 @@ int parse_options(int argc, char** argv)
                 {0,0,0,0}
             };
         int option_index = 0;
-        char c = getopt_long(argc, argv, HFST_GETOPT_COMMON_SHORT "nawt:zxcf",
+        char c = getopt_long(argc, argv, HFST_GETOPT_COMMON_SHORT "nawt:T:zxcf",
                              long_options, &option_index);
         if (-1 == c)
         {
@@ -323,6 +398,14 @@ int parse_options(int argc, char** argv)
                 return EXIT_FAILURE;
             }
             break;
+        case 'T':
+            if (atoi(optarg) < 1)
+            {
+                std::cerr << "Invalid argument for --threads\n";
+                return EXIT_FAILURE;
+            }
+            threads = (unsigned int)atoi(optarg);
+            break;
         case 'z':
             output_format = tokenize;
             break;